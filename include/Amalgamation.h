@@ -0,0 +1,71 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace Amalgamation
+ */
+// ======================================================================
+/*!
+ * \namespace Amalgamation
+ *
+ * The triangle filtering phase of amalgamation. Triangles inside the
+ * original polygons (nonzero regional attribute) are always accepted,
+ * triangles outside them only if all their sides are shorter than the
+ * given length limit. The result is the set of edges belonging to
+ * exactly one accepted triangle, that is, the boundaries of the
+ * amalgamated polygons.
+ *
+ * The triangles are partitioned into spatial tiles by their centroids.
+ * The tiles are filtered in parallel, and the edges shared by two
+ * triangles of the same tile cancel out immediately. The remaining
+ * edges, mostly along the tile seams, are then merged and cancelled
+ * once more. Since the result depends only on the parity of the edge
+ * counts, it is identical for any number of threads.
+ *
+ * Most edges outside the polygons are shared by two triangles, hence
+ * each tile first numbers its unique edges and measures each of them
+ * only once. The node coordinates are converted to radians and the
+ * cosines of the latitudes precomputed, the distances are identical
+ * to those of Point::geodistance.
+ *
+ * The edges are counted in hash tables keyed by the node indices and
+ * keep the direction they have in their triangle. Since the triangles
+ * are counter-clockwise, the boundary edges form counter-clockwise
+ * exterior rings and clockwise holes. The rings are chained by
+ * following the outgoing edges of each node from an adjacency array,
+ * no coordinates are compared. A ring touching itself at a node is
+ * split there into separate rings.
+ */
+// ======================================================================
+
+#ifndef AMALGAMATION_H
+#define AMALGAMATION_H
+
+#include "Polygon.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Amalgamation
+{
+//! A directed edge as a pair of node indices
+typedef std::pair<std::size_t, std::size_t> NodePair;
+
+void cancelPairs(std::vector<NodePair> &theEdges);
+
+std::vector<Polygon> rings(const std::vector<double> &theX,
+                           const std::vector<double> &theY,
+                           const std::vector<NodePair> &theEdges);
+
+std::vector<NodePair> boundary(const std::vector<double> &theX,
+                               const std::vector<double> &theY,
+                               const std::vector<std::size_t> &theCorners,
+                               const std::vector<double> &theRegions,
+                               double theLengthLimit,
+                               unsigned int theThreads = 0,
+                               std::vector<char> *theAccepted = nullptr);
+
+}  // namespace Amalgamation
+
+#endif  // AMALGAMATION_H
+
+// ======================================================================
@@ -0,0 +1,111 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of class AttributeTable
+ */
+// ======================================================================
+/*!
+ * \class AttributeTable
+ *
+ * A columnar cache of the attributes of a shape. Looking up an
+ * attribute of an element by name requires a search over the
+ * attribute names and the construction of strings, which dominates
+ * loops over all elements. Instead, the column index of an
+ * attribute is resolved once, and the values of a column are
+ * extracted into a typed vector the first time the column is
+ * requested. The loops then simply index the vector with the
+ * element number.
+ *
+ * Only the vector matching the type of the column is available.
+ * Null elements get default values (empty strings and zeros).
+ *
+ * Typical use:
+ * \code
+ * AttributeTable table(shape);
+ * const int column = table.requireColumn("NAME");
+ * const std::vector<std::string> &names = table.strings(column);
+ * for (std::size_t i = 0; i < names.size(); i++)
+ *   ... names[i] ...
+ * \endcode
+ *
+ * The table can also be built directly on a memory mapped .dbf
+ * file or shape cache, in which case the values are parsed from the mapped rows
+ * and the field types are mapped to the attribute types the same
+ * way NFmiEsriShape does it.
+ *
+ * The table refers to the shape, the .dbf file or the cache, which must
+ * outlive the table.
+ */
+// ======================================================================
+
+#ifndef ATTRIBUTETABLE_H
+#define ATTRIBUTETABLE_H
+
+#include "ShapeCache.h"
+#include "ShpFile.h"
+#include <imagine/NFmiEsriShape.h>
+#include <newbase/NFmiMetTime.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class AttributeTable
+{
+ public:
+  AttributeTable(const Imagine::NFmiEsriShape &theShape);
+  AttributeTable(const ShpFile::MappedDbf &theDbf);
+  AttributeTable(const ShapeCache::Reader &theCache);
+
+  std::size_t rows() const { return itsRows; }
+  std::size_t columns() const { return itsNames.size(); }
+
+  int column(const std::string &theName) const;
+  int requireColumn(const std::string &theName) const;
+
+  const std::string &name(int theColumn) const;
+  Imagine::NFmiEsriAttributeType type(int theColumn) const;
+
+  const std::vector<std::string> &strings(int theColumn);
+  const std::vector<int> &integers(int theColumn);
+  const std::vector<double> &doubles(int theColumn);
+  const std::vector<NFmiMetTime> &dates(int theColumn);
+  const std::vector<std::string> &texts(int theColumn);
+
+ private:
+  AttributeTable();
+  AttributeTable(const AttributeTable &theTable);
+  AttributeTable &operator=(const AttributeTable &theTable);
+
+  void check(int theColumn, Imagine::NFmiEsriAttributeType theType) const;
+
+  //! The cached values of a single column
+  struct Column
+  {
+    Column() : loaded(false), textsLoaded(false) {}
+    bool loaded;
+    bool textsLoaded;
+    std::vector<std::string> strings;
+    std::vector<int> integers;
+    std::vector<double> doubles;
+    std::vector<NFmiMetTime> dates;
+    std::vector<std::string> texts;
+  };
+
+  void load(int theColumn);
+  void loadShape(int theColumn, Column &theValues) const;
+  void loadRows(int theColumn, Column &theValues) const;
+  std::string rowValue(std::size_t theRow, int theColumn) const;
+
+  const Imagine::NFmiEsriShape *itsShape;
+  const ShpFile::MappedDbf *itsDbf;
+  const ShapeCache::Reader *itsCache;
+  std::size_t itsRows;
+  std::vector<std::string> itsNames;
+  std::vector<Imagine::NFmiEsriAttributeType> itsTypes;
+  std::vector<Column> itsColumns;
+
+};  // class AttributeTable
+
+#endif  // ATTRIBUTETABLE_H
+
+// ======================================================================
@@ -0,0 +1,55 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace Clipping
+ */
+// ======================================================================
+/*!
+ * \namespace Clipping
+ *
+ * Clipping of shapefile geometry to a rectangle.
+ *
+ * Polygons are clipped with the Weiler-Atherton algorithm specialized
+ * for a rectangle. The rings are cut into runs inside the rectangle,
+ * which are then joined along the rectangle boundary. A concave ring
+ * split by the rectangle hence becomes several separate rings. The
+ * rings must follow the shapefile convention of clockwise outer rings
+ * and counter-clockwise holes. Rings which degenerate into fewer than
+ * three distinct points or zero area are dropped.
+ *
+ * Polyline parts are clipped segment by segment with the
+ * Liang-Barsky algorithm, a part leaving and re-entering the
+ * rectangle becomes two parts.
+ *
+ * Z and M values are not preserved, clipped polygons, polylines and
+ * multipoints are written as plain 2D records.
+ */
+// ======================================================================
+
+#ifndef CLIPPING_H
+#define CLIPPING_H
+
+#include "Point.h"
+#include "ShpFile.h"
+#include <string>
+#include <vector>
+
+namespace Clipping
+{
+typedef std::vector<Point> Part;
+
+void clipRings(const std::vector<Part> &theRings,
+               const ShpFile::Box &theBox,
+               std::vector<Part> &theResult);
+
+void clipLine(const Part &theLine, const ShpFile::Box &theBox, std::vector<Part> &theParts);
+
+int clippedType(int theType);
+
+std::string clip(const ShpFile::Record &theRecord, const ShpFile::Box &theBox);
+
+}  // namespace Clipping
+
+#endif  // CLIPPING_H
+
+// ======================================================================
@@ -0,0 +1,50 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace Containment
+ */
+// ======================================================================
+/*!
+ * \namespace Containment
+ *
+ * The containment hierarchy of a set of non-crossing rings, such as
+ * the rings of a shapefile. The parent of a ring is the smallest ring
+ * enclosing it, the depth of a ring is the number of rings enclosing
+ * it. Rings at even depths are land, rings at odd depths lakes,
+ * islands in lakes are again at even depths and so on.
+ *
+ * The bounding boxes of the rings are stored in a packed R-tree.
+ * An interior point of each ring is located against the R-tree, and
+ * the candidate rings are tested with prepared rings whose edges are
+ * bucketed into horizontal bands, so that a point-in-polygon test
+ * touches only the edges of a single band.
+ *
+ * The interior points returned by insidePoints are inside the ring
+ * but outside all its children, hence they are suitable region seeds
+ * and hole points for a constrained triangulation. The points are
+ * chosen from the widest interior spans of a few horizontal scanlines,
+ * and are deterministic.
+ */
+// ======================================================================
+
+#ifndef CONTAINMENT_H
+#define CONTAINMENT_H
+
+#include "Point.h"
+#include "Polygon.h"
+#include <vector>
+
+namespace Containment
+{
+std::vector<long> parents(const std::vector<Polygon> &thePolygons);
+
+std::vector<int> depths(const std::vector<long> &theParents);
+
+std::vector<Point> insidePoints(const std::vector<Polygon> &thePolygons,
+                                const std::vector<long> &theParents);
+
+}  // namespace Containment
+
+#endif  // CONTAINMENT_H
+
+// ======================================================================
@@ -0,0 +1,76 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace EdgeCounter
+ */
+// ======================================================================
+/*!
+ * \namespace EdgeCounter
+ *
+ * Parallel counting of undirected segments. Segments are identified
+ * by the bit patterns of their endpoint coordinates, the endpoints
+ * are ordered canonically so that both directions of a segment are
+ * counted together.
+ *
+ * Each thread collects its segments into a Buffer, which partitions
+ * them into shards by their hash value. The shards are then counted
+ * in parallel, each shard by a single thread into an open addressing
+ * hash table of its own, hence no locking is needed and merging the
+ * results is just concatenation.
+ *
+ * Typical use:
+ * \code
+ * vector<EdgeCounter::Buffer> buffers(threads);
+ * // each thread calls buffers[t].add(x1,y1,x2,y2) for its segments
+ * vector<EdgeCounter::Count> counts = EdgeCounter::count(buffers);
+ * \endcode
+ */
+// ======================================================================
+
+#ifndef EDGECOUNTER_H
+#define EDGECOUNTER_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace EdgeCounter
+{
+//! Number of shards used for counting
+const std::size_t shard_count = 64;
+
+//! An undirected segment with canonically ordered endpoints
+struct Edge
+{
+  double x1;
+  double y1;
+  double x2;
+  double y2;
+};
+
+//! A segment and the number of its occurrences
+typedef std::pair<Edge, std::size_t> Count;
+
+//! Segments collected by a single thread, partitioned into shards
+class Buffer
+{
+ public:
+  Buffer() : itsShards(shard_count) {}
+
+  void add(double theX1, double theY1, double theX2, double theY2);
+
+  //! Access the segments of a shard
+  const std::vector<Edge> &shard(std::size_t theShard) const { return itsShards[theShard]; }
+
+ private:
+  std::vector<std::vector<Edge> > itsShards;
+
+};  // class Buffer
+
+std::vector<Count> count(const std::vector<Buffer> &theBuffers, unsigned int theThreads = 0);
+
+}  // namespace EdgeCounter
+
+#endif  // EDGECOUNTER_H
+
+// ======================================================================
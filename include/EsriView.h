@@ -0,0 +1,76 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace EsriView
+ */
+// ======================================================================
+/*!
+ * \namespace EsriView
+ *
+ * Record views to the elements of an NFmiEsriShape with the same
+ * interface as ShpFile::Record and ShapeCache::Record, so that code
+ * templated on the reader works on shapes read into memory too.
+ *
+ * Points added to a polyline or polygon without starting a part
+ * form a single part.
+ */
+// ======================================================================
+
+#ifndef ESRIVIEW_H
+#define ESRIVIEW_H
+
+#include <imagine/NFmiEsriPoint.h>
+#include <imagine/NFmiEsriShape.h>
+#include <cstddef>
+
+namespace EsriView
+{
+//! A view to the geometry of a single element
+class Record
+{
+ public:
+  Record(const Imagine::NFmiEsriElement *theElement);
+
+  int type() const { return itsType; }
+  int numParts() const { return itsNumParts; }
+  int numPoints() const { return itsNumPoints; }
+  int part(int theIndex) const { return (itsParts != nullptr ? itsParts[theIndex] : 0); }
+  double x(int theIndex) const { return (itsPoints != nullptr ? itsPoints[theIndex].X() : itsX); }
+  double y(int theIndex) const { return (itsPoints != nullptr ? itsPoints[theIndex].Y() : itsY); }
+
+ private:
+  Record();
+
+  int itsType;
+  int itsNumParts;
+  int itsNumPoints;
+  const int *itsParts;                         //!< null for a single part
+  const Imagine::NFmiEsriPoint *itsPoints;     //!< null for a point element
+  double itsX;
+  double itsY;
+
+};  // class Record
+
+//! Record access to the elements of a shape
+class Reader
+{
+ public:
+  Reader(const Imagine::NFmiEsriShape &theShape) : itsShape(theShape) {}
+
+  std::size_t size() const { return itsShape.Elements().size(); }
+  Record record(std::size_t theRecord) const { return Record(itsShape.Elements()[theRecord]); }
+
+ private:
+  Reader();
+  Reader(const Reader &theReader);
+  Reader &operator=(const Reader &theReader);
+
+  const Imagine::NFmiEsriShape &itsShape;
+
+};  // class Reader
+
+}  // namespace EsriView
+
+#endif  // ESRIVIEW_H
+
+// ======================================================================
@@ -0,0 +1,52 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace GeometryHash
+ */
+// ======================================================================
+/*!
+ * \namespace GeometryHash
+ *
+ * Canonical forms and hash values for the geometry of shapefile
+ * records, used for detecting duplicate elements.
+ *
+ * The coordinates are quantized to integer multiples of the given
+ * quantum, a zero quantum requires the coordinates to be exactly
+ * equal. Closing points and repeated vertices are removed from
+ * each part. A ring is rotated to start from its smallest vertex and
+ * traversed in whichever direction gives the lexicographically
+ * smaller sequence, a polyline part likewise starts from whichever
+ * end gives the smaller sequence. The parts are then sorted, as are
+ * the points of a multipoint. Multipatch parts are only quantized,
+ * since the vertex order of triangle strips is significant. Z and M
+ * values are ignored, and the plain, Z and M variants of a shape type
+ * are considered equal.
+ *
+ * Hence two elements which differ only by the starting vertex or
+ * orientation of their rings, by the order of their parts or by
+ * coordinate noise below the quantum have equal canonical forms.
+ * Equal hash values are only candidates, equality of the canonical
+ * forms should be verified.
+ */
+// ======================================================================
+
+#ifndef GEOMETRYHASH_H
+#define GEOMETRYHASH_H
+
+#include "ShpFile.h"
+#include <cstdint>
+#include <vector>
+
+namespace GeometryHash
+{
+typedef std::vector<std::int64_t> Canonical;
+
+Canonical canonical(const ShpFile::Record &theRecord, double theQuantum);
+
+std::uint64_t hash(const Canonical &theCanonical);
+
+}  // namespace GeometryHash
+
+#endif  // GEOMETRYHASH_H
+
+// ======================================================================
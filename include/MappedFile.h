@@ -0,0 +1,46 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of class MappedFile
+ */
+// ======================================================================
+/*!
+ * \class MappedFile
+ *
+ * A read-only memory mapping of a file. The file contents are
+ * paged in by the operating system only when they are accessed,
+ * hence the class is suitable for both parsing large files in
+ * a single sweep and for accessing small parts of huge files.
+ */
+// ======================================================================
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+ public:
+  ~MappedFile();
+  MappedFile(const std::string &theName);
+
+  const char *data() const { return itsData; }
+  std::size_t size() const { return itsSize; }
+  const std::string &name() const { return itsName; }
+
+ private:
+  MappedFile();
+  MappedFile(const MappedFile &theFile);
+  MappedFile &operator=(const MappedFile &theFile);
+
+  std::string itsName;
+  const char *itsData;
+  std::size_t itsSize;
+
+};  // class MappedFile
+
+#endif  // MAPPEDFILE_H
+
+// ======================================================================
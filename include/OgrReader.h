@@ -0,0 +1,72 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace OgrReader
+ */
+// ======================================================================
+/*!
+ * \namespace OgrReader
+ *
+ * Input of vector layers through OGR into an NFmiEsriShape, so that
+ * the tools can read FlatGeobuf and GeoPackage files directly.
+ *
+ * Unlike NFmiEsriShape::Read, which decodes the whole shapefile, the
+ * spatial and attribute filters are passed on to OGR. Formats with a
+ * spatial index then only decode the features which may match, and
+ * only those end up in the shape.
+ *
+ * The first layer of the data source is read. Lines and polygons
+ * become polylines and polygons with one part per line or ring, the
+ * rings being oriented as in the shapefile specification. Features
+ * without a geometry are skipped. Only the 2D coordinates are read.
+ */
+// ======================================================================
+
+#ifndef OGRREADER_H
+#define OGRREADER_H
+
+#include "ShpFile.h"
+#include <imagine/NFmiEsriShape.h>
+#include <memory>
+#include <string>
+
+class GDALDataset;
+class OGRLayer;
+
+namespace OgrReader
+{
+bool isOgrSource(const std::string &theName);
+
+//! The first vector layer of a data source opened through OGR
+class Layer
+{
+ public:
+  ~Layer();
+  Layer(const std::string &theName);
+
+  Imagine::NFmiEsriElementType shapeType() const { return itsType; }
+
+  std::string filterExpression(const std::string &theField,
+                               const std::string &theComparison,
+                               const std::string &theValue) const;
+
+  std::unique_ptr<Imagine::NFmiEsriShape> read(const ShpFile::Box *theBox = nullptr,
+                                               const std::string &theFilter = "");
+
+ private:
+  Layer();
+  Layer(const Layer &theLayer);
+  Layer &operator=(const Layer &theLayer);
+
+  std::string itsName;
+  GDALDataset *itsDataset;
+  OGRLayer *itsLayer;
+  Imagine::NFmiEsriElementType itsType;
+
+};  // class Layer
+
+}  // namespace OgrReader
+
+#endif  // OGRREADER_H
+
+// ======================================================================
@@ -0,0 +1,47 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace OgrWriter
+ */
+// ======================================================================
+/*!
+ * \namespace OgrWriter
+ *
+ * Output of an NFmiEsriShape through OGR into formats with a built-in
+ * spatial index:
+ *
+ *  - fgb  FlatGeobuf with a packed Hilbert R-tree
+ *  - gpkg GeoPackage with an R*Tree
+ *
+ * Unlike shapefiles, neither format is limited to 2 GB. Polylines are
+ * written as multilinestrings and polygons as multipolygons, the holes
+ * of the polygons being recognized by their orientation as in the
+ * shapefile specification. Null elements are written as features
+ * without a geometry so that the attributes are preserved.
+ *
+ * The format name "shape" denotes the ordinary shapefile output of
+ * the converters, which is not handled here.
+ */
+// ======================================================================
+
+#ifndef OGRWRITER_H
+#define OGRWRITER_H
+
+#include <imagine/NFmiEsriShape.h>
+#include <string>
+
+namespace OgrWriter
+{
+void checkFormat(const std::string &theFormat);
+
+bool isOgrFormat(const std::string &theFormat);
+
+void write(const Imagine::NFmiEsriShape &theShape,
+           const std::string &theName,
+           const std::string &theFormat);
+
+}  // namespace OgrWriter
+
+#endif  // OGRWRITER_H
+
+// ======================================================================
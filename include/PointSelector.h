@@ -10,6 +10,8 @@
 
 #include <memory>
 #include <list>
+#include <utility>
+#include <vector>
 
 class NFmiArea;
 
@@ -19,6 +21,8 @@ class PointSelector
   typedef std::list<int> IndexList;
   typedef IndexList::const_iterator const_iterator;
   typedef IndexList::size_type size_type;
+  typedef std::list<std::pair<int, double>> RankList;
+  typedef std::list<std::pair<int, int>> LevelList;
 
  public:
   ~PointSelector();
@@ -28,6 +32,10 @@ class PointSelector
   void boundingBox(double theX1, double theY1, double theX2, double theY2);
 
   bool add(int theID, double theValue, double theLon, double theLat);
+  size_type add(const std::vector<int> &theIDs,
+                const std::vector<double> &theValues,
+                const std::vector<double> &theLons,
+                const std::vector<double> &theLats);
 
   bool empty() const;
   size_type size() const;
@@ -35,6 +43,9 @@ class PointSelector
   const_iterator begin() const;
   const_iterator end() const;
 
+  RankList ranks() const;
+  LevelList levels(const std::vector<double> &theDistances) const;
+
  private:
   class Pimple;
   std::shared_ptr<Pimple> itsPimple;
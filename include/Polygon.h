@@ -63,11 +63,11 @@ class Polygon
 
   const DataType &data() const { return itsData; }
 
- private:
   //! Close the polygon by making sure the last point is equal to the first
   //! point
   void close() const;
 
+ private:
   //! The actual data is mutable, since we want close to be const
   mutable DataType itsData;
 
@@ -0,0 +1,49 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace ProjectionTools
+ */
+// ======================================================================
+
+#ifndef PROJECTIONTOOLS_H
+#define PROJECTIONTOOLS_H
+
+#include <cstddef>
+
+class NFmiArea;
+
+namespace ProjectionTools
+{
+void toXY(const NFmiArea &theArea,
+          const double *theLons,
+          const double *theLats,
+          double *theX,
+          double *theY,
+          std::size_t theCount);
+
+void toLatLon(const NFmiArea &theArea,
+              const double *theX,
+              const double *theY,
+              double *theLons,
+              double *theLats,
+              std::size_t theCount);
+
+void latLonToWorldXY(const NFmiArea &theArea,
+                     const double *theLons,
+                     const double *theLats,
+                     double *theX,
+                     double *theY,
+                     std::size_t theCount);
+
+void worldXYToLatLon(const NFmiArea &theArea,
+                     const double *theX,
+                     const double *theY,
+                     double *theLons,
+                     double *theLats,
+                     std::size_t theCount);
+
+}  // namespace ProjectionTools
+
+#endif  // PROJECTIONTOOLS_H
+
+// ======================================================================
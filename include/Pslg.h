@@ -0,0 +1,102 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace Pslg
+ */
+// ======================================================================
+/*!
+ * \namespace Pslg
+ *
+ * Reading and writing of the planar straight line graph files
+ * (.node, .poly and .ele) used by the Triangle package of
+ * Jonathan R. Shewchuk.
+ *
+ * Text input files are memory mapped and parsed in a single sweep,
+ * text output is formatted into a large buffer which is flushed to
+ * disk in big blocks. Numbers are written in their shortest form
+ * which reads back to the exact same value.
+ *
+ * The same data can also be stored in a compact binary form, which
+ * is several times faster to read and write. Binary files are
+ * recognized automatically by their magic header, hence all the
+ * read functions accept both forms. Note that the Triangle program
+ * itself understands only the text form.
+ *
+ * Node and triangle numbers are stored as is, numbering starts
+ * from the value given in the \c first member.
+ */
+// ======================================================================
+
+#ifndef PSLG_H
+#define PSLG_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Pslg
+{
+//! Contents of a .node file
+struct NodeData
+{
+  NodeData() : first(1), attributes(0), markers(false) {}
+
+  std::size_t size() const { return x.size(); }
+
+  long first;                  //!< number of the first node
+  std::size_t attributes;      //!< number of attributes per node
+  bool markers;                //!< true if nodes have boundary markers
+  std::vector<double> x;       //!< x-coordinates
+  std::vector<double> y;       //!< y-coordinates
+  std::vector<double> attr;    //!< size()*attributes attribute values
+  std::vector<long> marker;    //!< boundary markers if markers is true
+};
+
+//! Contents of a .poly file
+struct PolyData
+{
+  PolyData() : markers(false), maxareas(false) {}
+
+  std::size_t size() const { return idx1.size(); }
+
+  NodeData nodes;                //!< usually empty, nodes are in a .node file
+  bool markers;                  //!< true if edges have boundary markers
+  std::vector<long> idx1;        //!< first node of each edge
+  std::vector<long> idx2;        //!< second node of each edge
+  std::vector<long> marker;      //!< boundary markers if markers is true
+  std::vector<double> holex;     //!< hole x-coordinates
+  std::vector<double> holey;     //!< hole y-coordinates
+  bool maxareas;                 //!< true if regions have area constraints
+  std::vector<double> regionx;   //!< region seed x-coordinates
+  std::vector<double> regiony;   //!< region seed y-coordinates
+  std::vector<double> regionattr;  //!< regional attributes
+  std::vector<double> maxarea;     //!< regional area constraints if maxareas is true
+};
+
+//! Contents of a .ele file
+struct EleData
+{
+  EleData() : first(1), corners(3), attributes(0) {}
+
+  std::size_t size() const { return (corners == 0 ? 0 : idx.size() / corners); }
+
+  long first;               //!< number of the first triangle
+  std::size_t corners;      //!< nodes per triangle, 3 or 6
+  std::size_t attributes;   //!< number of attributes per triangle
+  std::vector<long> idx;    //!< size()*corners node numbers
+  std::vector<double> attr;  //!< size()*attributes attribute values
+};
+
+void read(const std::string &theFile, NodeData &theData);
+void read(const std::string &theFile, PolyData &theData);
+void read(const std::string &theFile, EleData &theData);
+
+void write(const std::string &theFile, const NodeData &theData, bool theBinaryFlag = false);
+void write(const std::string &theFile, const PolyData &theData, bool theBinaryFlag = false);
+void write(const std::string &theFile, const EleData &theData, bool theBinaryFlag = false);
+
+}  // namespace Pslg
+
+#endif  // PSLG_H
+
+// ======================================================================
@@ -0,0 +1,164 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace ShapeCache
+ */
+// ======================================================================
+/*!
+ * \namespace ShapeCache
+ *
+ * A preprocessed binary cache (.shpc) of a shapefile and its
+ * attributes, meant for shapefiles which are read over and over
+ * again. The cache is memory mapped, and all tables are stored in
+ * native byte order so that they can be used directly without any
+ * parsing:
+ *
+ *  - the shape types of the elements
+ *  - the part and point offsets of the elements
+ *  - the part offsets relative to the first point of the element
+ *  - the bounding boxes of the elements
+ *  - the coordinates as separate x and y arrays, or optionally
+ *    quantized to integers and delta and varint coded per element
+ *  - a packed R-tree of the element bounding boxes
+ *  - the attributes stored column by column
+ *
+ * The cache remembers the shapefile it was made from. Should the
+ * .shp or .dbf file be modified, the cache is rebuilt automatically
+ * when it is opened. The rebuilt cache replaces the old one
+ * atomically. If the cache cannot be replaced, a private copy is
+ * built from the shapefile instead.
+ *
+ * Only 2D shapes can be cached, that is points, multipoints,
+ * polylines and polygons.
+ */
+// ======================================================================
+
+#ifndef SHAPECACHE_H
+#define SHAPECACHE_H
+
+#include "MappedFile.h"
+#include "ShpFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ShapeCache
+{
+bool isCache(const std::string &theName);
+
+void write(const std::string &theShape, const std::string &theCache, double theQuantum = 0);
+
+//! A view to the geometry of a single cached element
+class Record
+{
+ public:
+  Record();
+
+  int type() const { return itsType; }
+  ShpFile::Box box() const { return itsBox; }
+
+  int numParts() const { return itsNumParts; }
+  int numPoints() const { return itsNumPoints; }
+  int part(int theIndex) const { return itsParts[theIndex]; }
+  double x(int theIndex) const { return itsX[theIndex]; }
+  double y(int theIndex) const { return itsY[theIndex]; }
+
+ private:
+  friend class Reader;
+
+  int itsType;
+  ShpFile::Box itsBox;
+  int itsNumParts;
+  int itsNumPoints;
+  const std::int32_t *itsParts;
+  const double *itsX;
+  const double *itsY;
+  std::shared_ptr<const std::vector<double> > itsDecoded;  //!< dequantized x and y arrays
+
+};  // class Record
+
+//! Zero-copy reader for memory mapped cache files
+class Reader
+{
+ public:
+  Reader(const std::string &theName);
+
+  int shapeType() const { return itsType; }
+  std::size_t size() const { return itsSize; }
+  const ShpFile::Box &box() const { return itsBox; }
+  bool quantized() const { return (itsQuantum > 0); }
+  double quantum() const { return itsQuantum; }
+
+  int type(std::size_t theRecord) const;
+  Record record(std::size_t theRecord) const;
+  ShpFile::Box box(std::size_t theRecord) const;
+  void query(const ShpFile::Box &theBox, std::vector<std::size_t> &theRecords) const;
+
+  std::string header() const;
+  std::string contents(std::size_t theRecord) const;
+
+  const std::string &dbfHeader() const { return itsDbfHeader; }
+  const std::vector<ShpFile::DbfField> &fields() const { return itsFields; }
+  std::size_t rowLength() const { return itsRowLength; }
+  int field(const std::string &theName) const;
+  std::string value(std::size_t theRow, int theField) const;
+  void row(std::size_t theRow, std::string &theContents) const;
+
+ private:
+  Reader();
+  Reader(const Reader &theReader);
+  Reader &operator=(const Reader &theReader);
+
+  void open(const std::string &theFile);
+  bool outdated() const;
+
+  std::string itsName;
+  std::unique_ptr<MappedFile> itsFile;
+
+  // Properties of the cache
+  int itsType;
+  std::size_t itsSize;
+  std::size_t itsPartCount;
+  std::size_t itsPointCount;
+  std::size_t itsTreeSize;
+  std::size_t itsTreeLevelCount;
+  ShpFile::Box itsBox;
+  double itsQuantum;
+  double itsXOrigin;
+  double itsYOrigin;
+
+  // The shapefile the cache was made from
+  std::string itsSource;
+  std::int64_t itsShpTime;
+  std::int64_t itsDbfTime;
+  std::uint64_t itsShpSize;
+  std::uint64_t itsDbfSize;
+
+  // The tables in the mapped file
+  const std::int32_t *itsTypes;
+  const std::uint64_t *itsElementParts;
+  const std::uint64_t *itsElementPoints;
+  const std::int32_t *itsParts;
+  const double *itsBoxes;
+  const std::uint64_t *itsElementBytes;
+  const char *itsCoordinates;
+  const std::uint64_t *itsTreeItems;
+  const std::uint64_t *itsTreeLevels;
+  const double *itsTreeNodes;
+  const char *itsAttributes;
+
+  std::string itsDbfHeader;
+  std::vector<ShpFile::DbfField> itsFields;
+  std::size_t itsRowLength;
+  std::vector<ShpFile::DbfField> itsCells;  //!< the fields relative to a column cell
+  std::vector<const char *> itsColumns;     //!< start of each attribute column
+
+};  // class Reader
+
+}  // namespace ShapeCache
+
+#endif  // SHAPECACHE_H
+
+// ======================================================================
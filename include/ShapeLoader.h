@@ -0,0 +1,52 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace ShapeLoader
+ */
+// ======================================================================
+/*!
+ * \namespace ShapeLoader
+ *
+ * Parallel loading of a shapefile into an NFmiEsriShape.
+ *
+ * NFmiEsriShape::Read decodes the records one at a time. Since the
+ * .shx file gives the offset of every record, the record range can
+ * instead be split into chunks which are decoded concurrently from
+ * the memory mapped files into preallocated slots. The elements and
+ * their attributes are then added to the shape in the original
+ * order, so the result is the same as from the serial reader.
+ *
+ * Point, multipoint, polyline and polygon shapes are decoded in
+ * parallel. Other shapes, and shapes with null records or records
+ * of a type other than the one in the file header, are read with
+ * NFmiEsriShape::Read.
+ *
+ * A .shpc shape cache can be given instead of a shapefile, see
+ * namespace ShapeCache. Since there is no serial reader to fall back
+ * to, caches with null elements or empty parts cannot be loaded.
+ */
+// ======================================================================
+
+#ifndef SHAPELOADER_H
+#define SHAPELOADER_H
+
+#include "ShpFile.h"
+#include <imagine/NFmiEsriShape.h>
+#include <newbase/NFmiMetTime.h>
+#include <memory>
+#include <string>
+
+namespace ShapeLoader
+{
+std::unique_ptr<Imagine::NFmiEsriShape> read(const std::string &theName,
+                                             bool theAttributes = false);
+
+Imagine::NFmiEsriAttributeType attributeType(const ShpFile::DbfField &theField);
+
+NFmiMetTime parseDate(const std::string &theValue);
+
+}  // namespace ShapeLoader
+
+#endif  // SHAPELOADER_H
+
+// ======================================================================
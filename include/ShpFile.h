@@ -0,0 +1,270 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace ShpFile
+ */
+// ======================================================================
+/*!
+ * \namespace ShpFile
+ *
+ * Record level access to ESRI .shp and .shx files. Unlike
+ * NFmiEsriShape, which decodes the full shapefile into memory,
+ * the reader here fetches single records via the offsets stored
+ * in the .shx file, and the writer appends records one at a time.
+ * This allows processing arbitrarily large shapefiles in constant
+ * memory.
+ *
+ * The records are handled as raw byte strings in the shapefile
+ * format, class Record provides access to the geometry in them.
+ *
+ * The attribute rows of the .dbf file are written one row at a time
+ * in the same manner, so that records and their attributes can be
+ * filtered as a stream.
+ *
+ * MappedReader and MappedDbf memory map the files instead, and
+ * return records and rows as views to the mapped bytes. Nothing is
+ * copied or allocated per record or per vertex, and only the pages
+ * actually accessed are read from disk.
+ */
+// ======================================================================
+
+#ifndef SHPFILE_H
+#define SHPFILE_H
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ShpFile
+{
+//! Size of the main file header in bytes
+const std::size_t header_size = 100;
+
+//! Size of a record header in bytes
+const std::size_t record_header_size = 8;
+
+int getBigInt(const char *theData);
+int getLittleInt(const char *theData);
+double getLittleDouble(const char *theData);
+
+void putBigInt(char *theData, int theValue);
+void putLittleInt(char *theData, int theValue);
+void putLittleDouble(char *theData, double theValue);
+
+//! A bounding box
+struct Box
+{
+  Box();
+  bool empty() const;
+  void update(double theX, double theY);
+  void update(const Box &theBox);
+  bool overlaps(const Box &theBox) const;
+
+  double xmin;
+  double ymin;
+  double xmax;
+  double ymax;
+};
+
+//! A view to the geometry in the contents of a single record
+class Record
+{
+ public:
+  Record(const char *theData, std::size_t theSize);
+
+  int type() const;
+  bool hasBox() const;
+  Box box() const;
+
+  int numParts() const;
+  int numPoints() const;
+  int part(int theIndex) const;
+  double x(int theIndex) const;
+  double y(int theIndex) const;
+
+  //! Byte offset of the XY-coordinates in the record
+  std::size_t pointsOffset() const { return itsPointsOffset; }
+
+  //! Byte offset of the bounding box in the record, 0 if there is none
+  std::size_t boxOffset() const { return (hasBox() ? 4 : 0); }
+
+  //! The raw record contents
+  const char *data() const { return itsData; }
+  std::size_t size() const { return itsSize; }
+
+ private:
+  const char *itsData;
+  std::size_t itsSize;
+  int itsType;
+  int itsNumParts;
+  int itsNumPoints;
+  std::size_t itsPartsOffset;
+  std::size_t itsPointsOffset;
+
+};  // class Record
+
+//! Random access reader for .shp records
+class Reader
+{
+ public:
+  Reader(const std::string &theName);
+
+  int shapeType() const;
+  const std::string &header() const { return itsHeader; }
+  std::size_t size() const { return itsOffsets.size(); }
+
+  std::size_t offset(std::size_t theRecord) const { return itsOffsets[theRecord]; }
+  std::size_t length(std::size_t theRecord) const { return itsLengths[theRecord]; }
+
+  void read(std::size_t theRecord, std::string &theContents);
+
+ private:
+  Reader();
+  Reader(const Reader &theReader);
+  Reader &operator=(const Reader &theReader);
+
+  std::string itsName;
+  std::ifstream itsShp;
+  std::string itsHeader;
+  std::vector<std::size_t> itsOffsets;  //!< record content offsets in bytes
+  std::vector<std::size_t> itsLengths;  //!< record content lengths in bytes
+
+};  // class Reader
+
+//! Sequential writer for .shp and .shx records
+class Writer
+{
+ public:
+  ~Writer();
+  Writer(const std::string &theName, const std::string &theHeader);
+
+  void write(const std::string &theContents);
+  void write(const char *theData, std::size_t theSize);
+  void close();
+
+  std::size_t size() const { return itsCount; }
+
+ private:
+  Writer();
+  Writer(const Writer &theWriter);
+  Writer &operator=(const Writer &theWriter);
+
+  std::string itsName;
+  std::string itsHeader;
+  std::ofstream itsShp;
+  std::ofstream itsShx;
+  std::size_t itsCount;
+  std::size_t itsShpSize;
+  Box itsBox;
+  bool itsClosed;
+
+};  // class Writer
+
+//! A field of a .dbf file
+struct DbfField
+{
+  std::string name;
+  char type;            //!< C, N, F, L, D etc
+  std::size_t length;   //!< field width in bytes
+  int decimals;         //!< number of decimals for numeric fields
+  std::size_t offset;   //!< offset in the row, the deletion flag is at 0
+};
+
+//! Sequential writer for .dbf rows
+class DbfWriter
+{
+ public:
+  ~DbfWriter();
+  DbfWriter(const std::string &theName, const std::string &theHeader);
+
+  void write(const std::string &theRow);
+  void write(const char *theRow);
+  void close();
+
+  std::size_t size() const { return itsCount; }
+
+ private:
+  DbfWriter();
+  DbfWriter(const DbfWriter &theWriter);
+  DbfWriter &operator=(const DbfWriter &theWriter);
+
+  std::string itsName;
+  std::string itsHeader;
+  std::ofstream itsDbf;
+  std::size_t itsCount;
+  std::size_t itsRowLength;
+  bool itsClosed;
+
+};  // class DbfWriter
+
+//! Zero-copy reader for memory mapped .shp and .shx files
+class MappedReader
+{
+ public:
+  MappedReader(const std::string &theName);
+
+  int shapeType() const;
+  std::string header() const;
+  std::size_t size() const { return itsCount; }
+
+  Record record(std::size_t theRecord) const;
+
+ private:
+  MappedReader();
+  MappedReader(const MappedReader &theReader);
+  MappedReader &operator=(const MappedReader &theReader);
+
+  std::string itsName;
+  MappedFile itsShp;
+  MappedFile itsShx;
+  std::size_t itsCount;
+
+};  // class MappedReader
+
+//! Zero-copy reader for memory mapped .dbf files
+class MappedDbf
+{
+ public:
+  MappedDbf(const std::string &theName);
+
+  std::string header() const;
+  std::size_t size() const { return itsCount; }
+  std::size_t rowLength() const { return itsRowLength; }
+  const std::vector<DbfField> &fields() const { return itsFields; }
+
+  int field(const std::string &theName) const;
+  const char *row(std::size_t theRow) const;
+
+ private:
+  MappedDbf();
+  MappedDbf(const MappedDbf &theDbf);
+  MappedDbf &operator=(const MappedDbf &theDbf);
+
+  MappedFile itsDbf;
+  std::vector<DbfField> itsFields;
+  std::size_t itsCount;
+  std::size_t itsHeaderLength;
+  std::size_t itsRowLength;
+
+};  // class MappedDbf
+
+std::vector<DbfField> dbfFields(const std::string &theHeader);
+std::string addDbfField(const std::string &theHeader,
+                        const std::string &theName,
+                        char theType,
+                        int theLength,
+                        int theDecimals = 0);
+
+std::string dbfValue(const std::string &theRow, const DbfField &theField);
+std::string dbfValue(const char *theRow, const DbfField &theField);
+
+void copyDbf(const std::string &theInput, const std::string &theOutput);
+void setBox(const std::string &theName, const Box &theBox);
+
+}  // namespace ShpFile
+
+#endif  // SHPFILE_H
+
+// ======================================================================
@@ -0,0 +1,111 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of class Topology
+ */
+// ======================================================================
+/*!
+ * \class Topology
+ *
+ * The shared arc topology of a set of polygons. The rings of the
+ * polygons are decomposed into arcs, maximal chains of segments
+ * which are shared by the same elements. Each arc is stored once,
+ * along with the elements on its left and right sides, and each ring
+ * is stored as a sequence of references to the arcs.
+ *
+ * The right side element of an arc is the one whose ring traverses
+ * the arc forwards. In shapefiles the outer rings are clockwise and
+ * the holes counter-clockwise, hence the interior of the element is
+ * then indeed on the right. An arc used by only one element has
+ * no left side element (-1).
+ *
+ * Arc references are encoded so that a nonnegative value a refers
+ * to arc a traversed forwards, a negative value -a-1 to arc a
+ * traversed backwards.
+ *
+ * Since each shared boundary is a single arc, borders (arcs with two
+ * elements), coastlines (arcs with one element) and dissolved
+ * polygons can be extracted in linear time, and simplifying the arcs
+ * keeps neighbouring polygons consistent.
+ *
+ * The topology can be saved into and loaded from a compact binary
+ * file, whose native byte order is verified when reading.
+ */
+// ======================================================================
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "Polygon.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Topology
+{
+ public:
+  //! Destructor
+  ~Topology() {}
+
+  //! Default constructor
+  Topology()
+      : itsArcStart(1, 0), itsElementStart(1, 0), itsRingStart(1, 0), itsSharedTooMany(0)
+  {
+  }
+
+  void build(const std::vector<Polygon> &theRings,
+             const std::vector<long> &theElements,
+             std::size_t theElementCount);
+
+  void read(const std::string &theFile);
+  void write(const std::string &theFile) const;
+
+  void simplify(double theTolerance);
+
+  // Arcs
+
+  std::size_t arcs() const { return itsLeft.size(); }
+  std::size_t arcBegin(std::size_t theArc) const { return itsArcStart[theArc]; }
+  std::size_t arcEnd(std::size_t theArc) const { return itsArcStart[theArc + 1]; }
+  double x(std::size_t thePoint) const { return itsX[thePoint]; }
+  double y(std::size_t thePoint) const { return itsY[thePoint]; }
+  long left(std::size_t theArc) const { return itsLeft[theArc]; }
+  long right(std::size_t theArc) const { return itsRight[theArc]; }
+
+  // Elements and their rings
+
+  std::size_t elements() const { return itsElementStart.size() - 1; }
+  std::size_t ringBegin(std::size_t theElement) const { return itsElementStart[theElement]; }
+  std::size_t ringEnd(std::size_t theElement) const { return itsElementStart[theElement + 1]; }
+  std::size_t refBegin(std::size_t theRing) const { return itsRingStart[theRing]; }
+  std::size_t refEnd(std::size_t theRing) const { return itsRingStart[theRing + 1]; }
+  long ref(std::size_t theIndex) const { return itsRefs[theIndex]; }
+
+  //! Number of segments used by more than two elements during the build
+  std::size_t sharedTooMany() const { return itsSharedTooMany; }
+
+  std::vector<Polygon> dissolve(const std::vector<long> &theGroups,
+                                std::vector<long> &theRingGroups) const;
+
+ private:
+  //! Copy constructor is disabled
+  Topology(const Topology &theTopology);
+
+  //! Assignment is disabled
+  Topology &operator=(const Topology &theTopology);
+
+  std::vector<std::size_t> itsArcStart;      //!< arc a has points start[a]...start[a+1]-1
+  std::vector<double> itsX;                  //!< arc point x-coordinates
+  std::vector<double> itsY;                  //!< arc point y-coordinates
+  std::vector<long> itsLeft;                 //!< element on the left side of each arc
+  std::vector<long> itsRight;                //!< element on the right side of each arc
+  std::vector<std::size_t> itsElementStart;  //!< element e has rings start[e]...start[e+1]-1
+  std::vector<std::size_t> itsRingStart;     //!< ring r has refs start[r]...start[r+1]-1
+  std::vector<long> itsRefs;                 //!< signed arc references
+  std::size_t itsSharedTooMany;
+
+};  // class Topology
+
+#endif  // TOPOLOGY_H
+
+// ======================================================================
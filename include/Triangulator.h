@@ -0,0 +1,84 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of class Triangulator
+ */
+// ======================================================================
+/*!
+ * \class Triangulator
+ *
+ * A constrained Delaunay triangulator for planar straight line graphs.
+ * The result is equivalent to running the Triangle program of
+ * Jonathan R. Shewchuk with options -pcA, that is, the convex hull of
+ * the points is triangulated so that the constraint edges are
+ * preserved, and each triangle is given the attribute of the region
+ * it belongs to. Regions are flood filled from the seed points
+ * without crossing the constraint edges, triangles outside all
+ * regions get attribute 0.
+ *
+ * Points are inserted incrementally in Hilbert order with Lawson
+ * flips, and the constraints by flipping away the edges they cross.
+ * Crossing constraint edges are split at their intersection point,
+ * which is then appended to the points. Duplicate points are merged.
+ * The orientation and incircle tests are exact.
+ *
+ * Usage:
+ * \code
+ * Triangulator tri;
+ * for(...)
+ *   tri.addPoint(x,y);
+ * for(...)
+ *   tri.addConstraint(i,j);
+ * tri.addRegion(x,y,attribute);
+ * tri.triangulate();
+ *
+ * for(Triangulator::size_type i=0; i<tri.size(); i++)
+ *   ... tri.corner(i,0), tri.corner(i,1), tri.corner(i,2), tri.attribute(i)
+ * \endcode
+ */
+// ======================================================================
+
+#ifndef TRIANGULATOR_H
+#define TRIANGULATOR_H
+
+#include <cstddef>
+#include <memory>
+
+class Triangulator
+{
+ public:
+  typedef std::size_t size_type;
+
+  ~Triangulator();
+  Triangulator();
+
+  size_type addPoint(double theX, double theY);
+  void addConstraint(size_type theFirst, size_type theSecond);
+  void addRegion(double theX, double theY, double theAttribute);
+
+  void triangulate();
+
+  // Points, including the intersections of the constraints
+
+  size_type points() const;
+  double x(size_type thePoint) const;
+  double y(size_type thePoint) const;
+
+  // Triangles in counter-clockwise order
+
+  size_type size() const;
+  size_type corner(size_type theTriangle, int theCorner) const;
+  double attribute(size_type theTriangle) const;
+
+ private:
+  class Pimple;
+  std::shared_ptr<Pimple> itsPimple;
+
+  Triangulator(const Triangulator &theTriangulator);
+  Triangulator &operator=(const Triangulator &theTriangulator);
+
+};  // class Triangulator
+
+#endif  // TRIANGULATOR_H
+
+// ======================================================================
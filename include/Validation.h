@@ -0,0 +1,78 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Interface of namespace Validation
+ */
+// ======================================================================
+/*!
+ * \namespace Validation
+ *
+ * Validation of polygon rings before triangulation. The problems
+ * detected are rings with too few points, unclosed rings, duplicate
+ * consecutive vertices, and segments crossing, touching or overlapping
+ * other segments of the same ring or of any other ring in the same
+ * group. Segments meeting only at a common vertex are accepted, hence
+ * rings may touch each other at their vertices. Rings in different
+ * groups are not tested against each other, since the neighbouring
+ * polygons of a tessellation share their borders.
+ *
+ * The segment pairs are found with a plane sweep. The segments enter
+ * the sweep in the order of their minimum x-coordinate, and the active
+ * segments are kept in horizontal rows so that a new segment is tested
+ * only against the active segments in the rows it spans. Segments
+ * leave the rows once the sweep has passed them.
+ *
+ * The trivial problems, duplicate vertices and unclosed rings, can be
+ * repaired. Rings which remain degenerate are then dropped.
+ */
+// ======================================================================
+
+#ifndef VALIDATION_H
+#define VALIDATION_H
+
+#include "Point.h"
+#include "Polygon.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Validation
+{
+//! The kinds of problems detected
+enum ProblemType
+{
+  kTooFewPoints,     //!< ring has less than 3 distinct points
+  kNotClosed,        //!< last point differs from the first one
+  kDuplicateVertex,  //!< vertex equals the previous one
+  kCrossing,         //!< segments cross each other
+  kTouching,         //!< a vertex lies inside another segment
+  kOverlap           //!< collinear segments overlap
+};
+
+//! A single detected problem
+struct Problem
+{
+  ProblemType type;
+  std::size_t ring;         //!< the ring
+  std::size_t vertex;       //!< the vertex, or the first vertex of the segment
+  std::size_t otherRing;    //!< the other ring for intersections
+  std::size_t otherVertex;  //!< first vertex of the other segment
+  Point where;              //!< location of the problem
+};
+
+std::string describe(ProblemType theType);
+
+int orientation(const Polygon &theRing);
+
+std::vector<Problem> validate(const std::vector<Polygon> &theRings);
+
+std::vector<Problem> validate(const std::vector<Polygon> &theRings,
+                              const std::vector<std::size_t> &theGroups);
+
+Polygon repair(const Polygon &theRing);
+
+}  // namespace Validation
+
+#endif  // VALIDATION_H
+
+// ======================================================================
@@ -11,7 +11,7 @@
  * (.node .poly and .ele), a limiting distance for the edges of the
  * triangles, and outputs a new set of PSLG files.
  *
- * Usage: amalgamate [lengthlimit] [arealimit] [inputname] [outputname]
+ * Usage: amalgamate [-b] [-j threads] [lengthlimit] [arealimit] [inputname] [outputname]
  *
  * One may wish to use inputname.1 as outputname so that the
  * triangle visualization program can be used to visualize input
@@ -24,16 +24,25 @@
  * If outputname is -debug, the .ele file will be overwritten by
  * a new one containing the triangles accepted for the amalgamation,
  * the .node and .poly files will remain the same.
+ *
+ * The input files may be in text or binary PSLG form, option -b
+ * selects the binary form for the output.
+ *
+ * The triangles are filtered in spatial tiles in parallel, option -j
+ * sets the number of threads. The default is to use all cores. The
+ * results do not depend on the number of threads.
  */
 // ======================================================================
 
+#include "Amalgamation.h"
 #include "Edges.h"
 #include "Nodes.h"
 #include "Polygon.h"
-#include <imagine/NFmiEdgeTree.h>
-#include <newbase/NFmiValueString.h>
-#include <fstream>
-#include <set>
+#include "Pslg.h"
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <stdexcept>
 #include <string>
 
 using namespace std;
@@ -44,9 +53,30 @@ using namespace std;
 int main(int argc, char *argv[])
 {
   // Read the command line arguments
+  bool binary = false;
+  unsigned int threads = 0;
+  while (argc > 1)
+  {
+    const string opt = argv[1];
+    if (opt == "-b")
+    {
+      binary = true;
+      --argc;
+      ++argv;
+    }
+    else if (opt == "-j" && argc > 2)
+    {
+      threads = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    }
+    else
+      break;
+  }
   if (argc != 5)
   {
-    cerr << "Usage: " << argv[0] << " [lengthlimit] [arealimit] [input] [output]" << endl;
+    cerr << "Usage: amalgamate [-b] [-j threads] [lengthlimit] [arealimit] [input] [output]"
+         << endl;
     return 1;
   }
 
@@ -58,212 +88,111 @@ int main(int argc, char *argv[])
   bool debug = (outname == "-debug");
   cout << "debug = " << debug << endl;
 
-  // Read in the nodes
+  // Read in the nodes, the edges and the triangles
 
-  Nodes inodes;
+  Pslg::NodeData inodes;
+  Pslg::PolyData ipoly;
+  Pslg::EleData itriangles;
+  try
   {
     string filename = inname + ".node";
-    ifstream in(filename.c_str());
-    if (!in)
-    {
-      cerr << "Error: Could not open " << filename << " for reading" << endl;
-      return 1;
-    }
-    // First row: #nodes dimension #attributes #boundary_markers
-
-    long number_of_nodes, number_of_attributes, dummy;
-    in >> number_of_nodes >> dummy >> number_of_attributes >> dummy;
-    if (number_of_attributes != 1)
-    {
-      cerr << "Error: " << filename << " must contain exactly one attribute field" << endl;
-      return 1;
-    }
-
-    cout << "Reading " << number_of_nodes << " nodes from " << filename << endl;
-    for (long i = 1; i <= number_of_nodes && !in.fail(); i++)
-    {
-      long node, id;
-      double x, y;
-      in >> node >> x >> y >> id;
-      static_cast<void>(inodes.add(Point(x, y), id));
-    }
-    if (in.fail())
-    {
-      cerr << "Error: Error reading " << filename << endl;
-      return 1;
-    }
-    in.close();
+    cout << "Reading nodes from " << filename << endl;
+    Pslg::read(filename, inodes);
+    if (inodes.attributes != 1)
+      throw runtime_error("Error: " + filename + " must contain exactly one attribute field");
+
+    filename = inname + ".poly";
+    cout << "Reading edges from " << filename << endl;
+    Pslg::read(filename, ipoly);
+    if (ipoly.nodes.size() != 0)
+      throw runtime_error("Error: .poly file also containing nodes is not supported");
+
+    filename = inname + ".ele";
+    cout << "Reading triangles from " << filename << endl;
+    Pslg::read(filename, itriangles);
+    if (itriangles.corners != 3)
+      throw runtime_error("Error: " + filename + " must have 3 points per line only");
+    if (itriangles.attributes < 1)
+      throw runtime_error("Error: " + filename + " must contain the regional attributes");
   }
-
-  // Read the edges
-
-  Edges constraints;
+  catch (std::exception &e)
   {
-    string filename = inname + ".poly";
-    ifstream in(filename.c_str());
-    if (!in)
-    {
-      cerr << "Error: Could not open " << filename << " for reading" << endl;
-      return 1;
-    }
-    // First row: number_of_nodes dimension number_of_attributes
-    // number_of_boundary_markers
-    long number_of_nodes, dummy;
-    in >> number_of_nodes >> dummy >> dummy >> dummy;
-    if (number_of_nodes != 0)
-    {
-      cerr << "Error: .poly file also containing nodes is not supported" << endl;
-      return 1;
-    }
-    // Second row: number_of_edges number_of_boundary_markers
-    long number_of_edges;
-    in >> number_of_edges >> dummy;
-    cout << "Reading " << number_of_edges << " edges from " << filename << endl;
-    for (long i = 1; i <= number_of_edges && !in.fail(); i++)
-    {
-      long edge, idx1, idx2;
-      in >> edge >> idx1 >> idx2;
-      if (edge != i)
-      {
-        cerr << "Error: Edges must be numbered sequentially starting from 1 in "
-                "file "
-             << filename << endl;
-        return 1;
-      }
-      constraints.add(Edge(idx1, idx2));
-    }
-
-    if (in.fail())
-    {
-      cerr << "Error: Error reading " << filename << endl;
-      return 1;
-    }
-    in.close();
+    cerr << e.what() << endl;
+    return 1;
   }
 
-  // Read the .ele file and build an edge tree obeying the area constraints
+  cout << "Read " << inodes.size() << " nodes, " << ipoly.size() << " edges and "
+       << itriangles.size() << " triangles" << endl;
 
-  Imagine::NFmiEdgeTree edges;
-  {
-    string filename = inname + ".ele";
-    ifstream in(filename.c_str());
-    if (!in)
-    {
-      cerr << "Error: Could not open " << filename << " for reading" << endl;
-      return 1;
-    }
-    // First row: #triangles #points #attributes
+  Edges constraints;
+  for (size_t i = 0; i < ipoly.size(); i++)
+    constraints.add(Edge(ipoly.idx1[i], ipoly.idx2[i]));
 
-    long number_of_triangles, number_of_points, dummy;
-    in >> number_of_triangles >> number_of_points >> dummy;
-    if (number_of_points != 3)
-    {
-      cerr << "Error: " << filename << " must have 3 points per line only" << endl;
-      return 1;
-    }
-    cout << "Reading " << number_of_triangles << " triangles from " << filename << endl;
+  // Filter the triangles and find the boundaries of the accepted ones
 
-    string debug_buffer;
-    long debug_triangles = 0;
+  vector<Amalgamation::NodePair> boundary;
+  {
+    const long number_of_nodes = inodes.size();
 
-    for (long i = 1; i <= number_of_triangles && !in.fail(); i++)
+    vector<size_t> corners(itriangles.idx.size());
+    vector<double> regions(itriangles.size());
+    for (size_t i = 0; i < itriangles.size(); i++)
     {
-      long edge, idx1, idx2, idx3, region;
-      in >> edge >> idx1 >> idx2 >> idx3 >> region;
-
-      bool triangle_ok = true;
-
-      // If all are from the same polygon, output triangle
-
-      const Point &pt1 = inodes.point(idx1);
-      const Point &pt2 = inodes.point(idx2);
-      const Point &pt3 = inodes.point(idx3);
-
-      if (region == 0)
-      {
-        triangle_ok &= (pt1.geodistance(pt2) <= lengthlimit);
-        triangle_ok &= (pt2.geodistance(pt3) <= lengthlimit);
-        triangle_ok &= (pt3.geodistance(pt1) <= lengthlimit);
-      }
-
-      if (triangle_ok)
+      for (size_t c = 0; c < 3; c++)
       {
-        edges.Add(Imagine::NFmiEdge(pt1.x(), pt1.y(), pt2.x(), pt2.y(), true, false));
-        edges.Add(Imagine::NFmiEdge(pt2.x(), pt2.y(), pt3.x(), pt3.y(), true, false));
-        edges.Add(Imagine::NFmiEdge(pt3.x(), pt3.y(), pt1.x(), pt1.y(), true, false));
-
-        if (debug)
+        const long idx = itriangles.idx[3 * i + c] - inodes.first;
+        if (idx < 0 || idx >= number_of_nodes)
         {
-          ++debug_triangles;
-          debug_buffer += static_cast<char *>(NFmiValueString(debug_triangles));
-          debug_buffer += '\t';
-          debug_buffer += static_cast<char *>(NFmiValueString(idx1));
-          debug_buffer += '\t';
-          debug_buffer += static_cast<char *>(NFmiValueString(idx2));
-          debug_buffer += '\t';
-          debug_buffer += static_cast<char *>(NFmiValueString(idx3));
-          debug_buffer += '\t';
-          debug_buffer += static_cast<char *>(NFmiValueString(region));
-          debug_buffer += '\n';
+          cerr << "Error: Triangle " << itriangles.first + i << " refers to a nonexistent node"
+               << endl;
+          return 1;
         }
+        corners[3 * i + c] = idx;
       }
+      regions[i] = static_cast<long>(itriangles.attr[i * itriangles.attributes]);
     }
-    if (in.fail())
-    {
-      cerr << "Error: Error reading " << filename << endl;
-      return 1;
-    }
-    in.close();
+
+    cout << "Filtering triangles" << endl;
+    vector<char> accepted;
+    boundary = Amalgamation::boundary(
+        inodes.x, inodes.y, corners, regions, lengthlimit, threads, debug ? &accepted : nullptr);
 
     if (debug)
     {
+      Pslg::EleData debug_triangles;
+      debug_triangles.attributes = 1;
+      for (size_t i = 0; i < itriangles.size(); i++)
+      {
+        if (!accepted[i])
+          continue;
+        for (size_t c = 0; c < 3; c++)
+          debug_triangles.idx.push_back(itriangles.idx[3 * i + c]);
+        debug_triangles.attr.push_back(regions[i]);
+      }
+
+      string filename = inname + ".ele";
       cout << "Writing " << filename << endl;
-      ofstream out(filename.c_str());
-      out << debug_triangles << " 3 1" << endl << debug_buffer << endl;
-      out.close();
+      try
+      {
+        Pslg::write(filename, debug_triangles, binary);
+      }
+      catch (std::exception &e)
+      {
+        cerr << e.what() << endl;
+        return 1;
+      }
     }
   }
 
-  // Build a path from the remaining edges
+  // Chain the boundary edges into rings and preserve all big enough polygons
 
-  cout << "Building a path" << endl;
-  Imagine::NFmiPath path = edges.Path();
-
-  // Preserve all big enough polygons in the path
-
-  cout << "Collecting polygons large enough" << endl;
+  cout << "Building polygons from " << boundary.size() << " edges" << endl;
   vector<Polygon> polygons;
   {
-    Polygon poly;
-    const Imagine::NFmiPathData::const_iterator begin = path.Elements().begin();
-    const Imagine::NFmiPathData::const_iterator end = path.Elements().end();
-
-    for (Imagine::NFmiPathData::const_iterator iter = begin; iter != end;)
-    {
-      bool doflush = false;
-      // Huom! Jostain syyst g++ knt vrin (iter++==end), pakko
-      // tehd nin
-      if ((*iter).Oper() == Imagine::kFmiMoveTo)
-        doflush = true;
-      else if (++iter == end)
-      {
-        --iter;
-        poly.add(Point((*iter).X(), (*iter).Y()));
-        doflush = true;
-      }
-      else
-        --iter;
-
-      if (doflush && !poly.empty())
-      {
-        if (arealimit <= 0 || poly.geoarea() >= arealimit)
-          polygons.push_back(poly);
-        poly.clear();
-      }
-
-      poly.add(Point((*iter).X(), (*iter).Y()));
-      ++iter;
-    }
+    const vector<Polygon> rings = Amalgamation::rings(inodes.x, inodes.y, boundary);
+    for (const Polygon &poly : rings)
+      if (arealimit <= 0 || poly.geoarea() >= arealimit)
+        polygons.push_back(poly);
   }
   cout << "Found " << polygons.size() << " large enough polygons" << endl;
 
@@ -286,18 +215,10 @@ int main(int argc, char *argv[])
   }
   cout << "Counted " << nodes.data().size() << " nodes" << endl;
 
-  // Output .node
+  // Output .node and .poly
 
   if (!debug)
   {
-    string nodefile = outname + ".node";
-    ofstream out(nodefile.c_str());
-    if (!out)
-    {
-      cerr << "Error: Could not open " << nodefile << " for writing" << endl;
-      return 1;
-    }
-
     // PSLG syntax has numbers for each point, but triangle seems to assume
     // the lines have been sorted.
 
@@ -309,40 +230,22 @@ int main(int argc, char *argv[])
       for (Nodes::DataType::const_iterator iter = begin; iter != end; ++iter)
         sortednodes.insert(make_pair(iter->second.first, iter->first));
     }
-    cout << "Writing " << nodefile << " with " << data.size() << " nodes" << endl;
-    out << data.size() << " 2 0 0" << endl;
+
+    Pslg::NodeData nodedata;
+    nodedata.x.reserve(data.size());
+    nodedata.y.reserve(data.size());
     {
       const map<unsigned long, Point>::const_iterator begin = sortednodes.begin();
       const map<unsigned long, Point>::const_iterator end = sortednodes.end();
       for (map<unsigned long, Point>::const_iterator iter = begin; iter != end; ++iter)
-        out << iter->first << '\t' << iter->second.x() << '\t' << iter->second.y() << endl;
-    }
-    out.close();
-  }
-
-  // Output .poly
-
-  if (!debug)
-  {
-    string polyfile = outname + ".poly";
-    cout << "Writing " << polyfile << endl;
-    ofstream out(polyfile.c_str());
-    if (!out)
-    {
-      cerr << "Error: Could not open " << polyfile << " for writing" << endl;
-      return 1;
-    }
-
-    long number_of_edges = 0;
-    for (unsigned int pass = 1; pass <= 2; pass++)
-    {
-      long edge = 0;
-      if (pass == 2)
       {
-        out << "0 2 0 0" << endl;  // no nodes in .poly
-        out << number_of_edges << " 0" << endl;
+        nodedata.x.push_back(iter->second.x());
+        nodedata.y.push_back(iter->second.y());
       }
+    }
 
+    Pslg::PolyData polydata;  // no nodes and no holes in .poly
+    {
       const vector<Polygon>::const_iterator begin = polygons.begin();
       const vector<Polygon>::const_iterator end = polygons.end();
       for (vector<Polygon>::const_iterator iter = begin; iter != end; ++iter)
@@ -354,23 +257,29 @@ int main(int argc, char *argv[])
         {
           if (piter != pbegin)
           {
-            if (pass == 1)
-              number_of_edges++;
-            else
-            {
-              out << ++edge << '\t' << nodes.number(previous_point) << '\t' << nodes.number(*piter)
-                  << endl;
-            }
+            polydata.idx1.push_back(nodes.number(previous_point));
+            polydata.idx2.push_back(nodes.number(*piter));
           }
-          if (pass == 2)
-            previous_point = *piter;
+          previous_point = *piter;
         }
       }
     }
 
-    // No holes
-    out << "0" << endl;
-    out.close();
+    try
+    {
+      string nodefile = outname + ".node";
+      cout << "Writing " << nodefile << " with " << data.size() << " nodes" << endl;
+      Pslg::write(nodefile, nodedata, binary);
+
+      string polyfile = outname + ".poly";
+      cout << "Writing " << polyfile << endl;
+      Pslg::write(polyfile, polydata, binary);
+    }
+    catch (std::exception &e)
+    {
+      cerr << e.what() << endl;
+      return 1;
+    }
   }
 
   cout << "Done" << endl;
@@ -5,6 +5,8 @@
  */
 // ======================================================================
 
+#include "MappedFile.h"
+#include "OgrWriter.h"
 #include <boost/iostreams/filter/bzip2.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -22,6 +24,7 @@
 #include <iomanip>
 #include <set>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace Imagine;
@@ -40,6 +43,7 @@ void usage()
        << endl
        << "   -h\t\tHelp" << endl
        << "   -v\t\tVerbose mode" << endl
+       << "   -F [format]\tOutput format: shape, fgb or gpkg (default: shape)" << endl
        << "   -b [x1,y1,x2,y2]\tThe bounding box to extract" << endl
        << "   -l [h1,h2,h3...]\tThe heights to extract" << endl
        << endl;
@@ -55,6 +59,7 @@ struct GlobalsList
 {
   bool verbose;           // verbose mode flag
   string shapename;       // output shape
+  string format;          // output format
   double x1, y1, x2, y2;  // the bounding box
   set<int> heights;       // the desired heights
 
@@ -73,6 +78,7 @@ void parse_command_line(int argc, const char *argv[])
 {
   // suitable defaults for Scandinavia (?)
   globals.verbose = false;
+  globals.format = "shape";
   globals.heights = NFmiStringTools::Split<set<int>>("100,200,300,500,700,1000");
   globals.x1 = 6;
   globals.y1 = 51;
@@ -81,7 +87,7 @@ void parse_command_line(int argc, const char *argv[])
 
   // Begin parsing
 
-  NFmiCmdLine cmdline(argc, argv, "hvb!l!");
+  NFmiCmdLine cmdline(argc, argv, "hvb!l!F!");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -100,6 +106,12 @@ void parse_command_line(int argc, const char *argv[])
   if (cmdline.isOption('v'))
     globals.verbose = true;
 
+  if (cmdline.isOption('F'))
+  {
+    globals.format = cmdline.OptionValue('F');
+    OgrWriter::checkFormat(globals.format);
+  }
+
   if (cmdline.isOption('b'))
   {
     const vector<double> values = NFmiStringTools::Split<vector<double>>(cmdline.OptionValue('b'));
@@ -123,6 +135,127 @@ void parse_command_line(int argc, const char *argv[])
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a row of big endian 16-bit heights
+ *
+ * The samples are decoded in blocks of fixed size, which the compiler
+ * vectorizes into a byte shuffle and a conversion to floats even at
+ * -O2. The remaining samples are decoded one at a time.
+ */
+// ----------------------------------------------------------------------
+
+void decode_row(const unsigned char *theData, float *theRow, unsigned int theCount)
+{
+  const unsigned int block = 16;
+
+  unsigned int i = 0;
+  for (; i + block <= theCount; i += block)
+  {
+    const unsigned char *in = theData + 2 * i;
+    short heights[block];
+    for (unsigned int k = 0; k < block; k++)
+      heights[k] = static_cast<short>((in[2 * k] << 8) | in[2 * k + 1]);
+    for (unsigned int k = 0; k < block; k++)
+      theRow[i + k] = heights[k];
+  }
+
+  for (; i < theCount; i++)
+    theRow[i] = static_cast<short>((theData[2 * i] << 8) | theData[2 * i + 1]);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the subgrid from an uncompressed file
+ *
+ * The file is memory mapped and only the rows of the subgrid are
+ * accessed, hence only the pages covering them are read from disk.
+ */
+// ----------------------------------------------------------------------
+
+void read_mapped(const string &theFile, int theColumns, int theI1, int theJ1)
+{
+  const MappedFile file(theFile);
+
+  const unsigned int nx = globals.values.NX();
+  const unsigned int ny = globals.values.NY();
+
+  const size_t needed = 2 * (static_cast<size_t>(theJ1 + ny - 1) * theColumns + theI1 + nx);
+  if (file.size() < needed)
+    throw runtime_error("'" + theFile + "' is too short to be ETOPO2 data");
+
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(file.data());
+
+  vector<float> row(nx);
+  for (unsigned int j = 0; j < ny; j++)
+  {
+    const size_t offset = 2 * (static_cast<size_t>(theJ1 + j) * theColumns + theI1);
+    decode_row(data + offset, &row[0], nx);
+    for (unsigned int i = 0; i < nx; i++)
+      globals.values[i][j] = row[i];
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the subgrid from a compressed file
+ *
+ * Compressed data cannot be accessed randomly, the preceding data
+ * is decompressed and skipped.
+ */
+// ----------------------------------------------------------------------
+
+void read_compressed(const string &theFile,
+                     const string &theSuffix,
+                     int theColumns,
+                     int theI1,
+                     int theJ1)
+{
+  ifstream in(theFile.c_str(), ios::in | ios::binary);
+  if (!in)
+    throw runtime_error("Failed to open '" + theFile + "' for reading");
+
+  using namespace boost;
+  using namespace boost::iostreams;
+  filtering_stream<input> filter;
+  if (theSuffix == "gz")
+    filter.push(gzip_decompressor());
+  else
+    filter.push(bzip2_decompressor());
+  filter.push(in);
+
+  const unsigned int nx = globals.values.NX();
+  const unsigned int ny = globals.values.NY();
+
+  // Skip to the first correct data element
+
+  const streamsize skip = 2 * (static_cast<streamsize>(theJ1) * theColumns + theI1);
+
+  if (globals.verbose)
+    cout << "Skipping first " << skip << " bytes..." << endl;
+  filter.ignore(skip);
+
+  if (globals.verbose)
+    cout << "Reading desired subgrid..." << endl;
+
+  vector<unsigned char> buffer(2 * nx);
+  vector<float> row(nx);
+  for (unsigned int j = 0; j < ny; j++)
+  {
+    // skip to next row if not the first row
+    if (j > 0)
+      filter.ignore(2 * (theColumns - nx));
+
+    filter.read(reinterpret_cast<char *>(&buffer[0]), buffer.size());
+    if (filter.gcount() != static_cast<streamsize>(buffer.size()))
+      throw runtime_error("'" + theFile + "' is too short to be ETOPO2 data");
+
+    decode_row(&buffer[0], &row[0], nx);
+    for (unsigned int i = 0; i < nx; i++)
+      globals.values[i][j] = row[i];
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Read ETOPO2 data withing bounding box
@@ -178,47 +311,13 @@ void read_etopo2()
 
   // Start reading
 
-  ifstream in(filename.c_str(), ios::in | ios::binary);
-  if (!in)
-    throw runtime_error("Failed to open '" + filename + "' for reading");
-
   const NFmiFileString tmpfilename(filename);
   const string suffix = tmpfilename.Extension().CharPtr();
 
-  using namespace boost;
-  using namespace boost::iostreams;
-  filtering_stream<input> filter;
-  if (suffix == "gz")
-    filter.push(gzip_decompressor());
-  else if (suffix == "bz2")
-    filter.push(bzip2_decompressor());
-  filter.push(in);
-
-  // Skip to the first correct data element
-
-  const int skip = 2 * (j1 * columns + i1);
-
-  if (globals.verbose)
-    cout << "Skipping first " << skip << " bytes..." << endl;
-  filter.ignore(skip);
-
-  if (globals.verbose)
-    cout << "Reading desired subgrid..." << endl;
-  for (unsigned int j = 0; j < globals.values.NY(); j++)
-  {
-    // skip to next row if not the first row
-    if (j > 0)
-      filter.ignore(2 * (columns - globals.values.NX()));
-
-    unsigned char ch1, ch2;
-    short height;
-    for (unsigned int i = 0; i < globals.values.NX(); i++)
-    {
-      filter >> noskipws >> ch1 >> ch2;
-      height = (ch1 << 8) | ch2;
-      globals.values[i][j] = height;
-    }
-  }
+  if (suffix == "gz" || suffix == "bz2")
+    read_compressed(filename, suffix, columns, i1, j1);
+  else
+    read_mapped(filename, columns, i1, j1);
 }
 
 // ----------------------------------------------------------------------
@@ -317,7 +416,10 @@ void create_shape()
   if (globals.verbose)
     cout << "Writing result..." << endl;
 
-  shape.Write(globals.shapename);
+  if (OgrWriter::isOgrFormat(globals.format))
+    OgrWriter::write(shape, globals.shapename, globals.format);
+  else
+    shape.Write(globals.shapename);
 }
 
 // ----------------------------------------------------------------------
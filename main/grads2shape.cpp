@@ -12,12 +12,16 @@
  *
  * Usage:
  * \code
- * grads2shape <mapfile> <shape>
+ * grads2shape [-F format] <mapfile> <shape>
  * \endcode
+ *
+ * The output format may be shape (the default), fgb for FlatGeobuf
+ * or gpkg for GeoPackage. The latter two include a spatial index.
  */
 // ----------------------------------------------------------------------
 
 #include "GradsTools.h"
+#include "OgrWriter.h"
 #include <imagine/NFmiEsriPoint.h>
 #include <imagine/NFmiEsriPolyLine.h>
 #include <imagine/NFmiEsriShape.h>
@@ -40,7 +44,7 @@ int domain(int argc, const char *argv[])
 {
   // Process the command line
 
-  NFmiCmdLine cmdline(argc, argv, "");
+  NFmiCmdLine cmdline(argc, argv, "F!");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -57,6 +61,9 @@ int domain(int argc, const char *argv[])
   if (shapename.empty())
     throw runtime_error("The name of the shape is empty");
 
+  const string format = (cmdline.isOption('F') ? cmdline.OptionValue('F') : "shape");
+  const bool ogr = OgrWriter::isOgrFormat(format);
+
   // Read the GrADS file into a shape
 
   Imagine::NFmiEsriShape shp(Imagine::kFmiEsriPolyLine);
@@ -102,9 +109,14 @@ int domain(int argc, const char *argv[])
                           " is unknown");
   }
 
-  string filename = shapename + ".shp";
-  if (!shp.WriteSHP(filename))
-    throw runtime_error("Failed to write '" + filename + "'");
+  if (ogr)
+    OgrWriter::write(shp, shapename, format);
+  else
+  {
+    string filename = shapename + ".shp";
+    if (!shp.WriteSHP(filename))
+      throw runtime_error("Failed to write '" + filename + "'");
+  }
 
   return 0;
 }
@@ -12,12 +12,15 @@
  *
  * Usage:
  * \code
- * gshhs2shape <gshhsfile> <shapename>
+ * gshhs2shape [-F format] <gshhsfile> <shapename>
  * \endcode
  *
+ * The output format may be shape (the default), fgb for FlatGeobuf
+ * or gpkg for GeoPackage. The latter two include a spatial index.
  */
 // ----------------------------------------------------------------------
 
+#include "OgrWriter.h"
 #include <imagine/NFmiEsriPoint.h>
 #include <imagine/NFmiEsriPolyLine.h>
 #include <imagine/NFmiEsriShape.h>
@@ -39,7 +42,7 @@ int domain(int argc, const char *argv[])
 {
   // Process the command line
 
-  NFmiCmdLine cmdline(argc, argv, "");
+  NFmiCmdLine cmdline(argc, argv, "F!");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -56,6 +59,9 @@ int domain(int argc, const char *argv[])
   if (shapename.empty())
     throw runtime_error("The name of the shape is empty");
 
+  const string format = (cmdline.isOption('F') ? cmdline.OptionValue('F') : "shape");
+  const bool ogr = OgrWriter::isOgrFormat(format);
+
   // Read the GSHHS data
 
   Imagine::NFmiPath path(Imagine::NFmiGshhsTools::ReadPath(gshhsfile, -180, -90, +180, +90));
@@ -93,9 +99,14 @@ int domain(int argc, const char *argv[])
   if (line != 0)
     shp.Add(line);
 
-  string filename = shapename + ".shp";
-  if (!shp.WriteSHP(filename))
-    throw runtime_error("Failed to write '" + filename + "'");
+  if (ogr)
+    OgrWriter::write(shp, shapename, format);
+  else
+  {
+    string filename = shapename + ".shp";
+    if (!shp.WriteSHP(filename))
+      throw runtime_error("Failed to write '" + filename + "'");
+  }
 
   return 0;
 }
@@ -5,6 +5,7 @@
  */
 // ======================================================================
 
+#include "OgrWriter.h"
 #include <boost/iostreams/filter/bzip2.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -43,6 +44,7 @@ void usage()
        << endl
        << "   -h\t\tHelp" << endl
        << "   -v\t\tVerbose mode" << endl
+       << "   -F [format]\tOutput format: shape, fgb or gpkg (default: shape)" << endl
        << "   -b [x1,y1,x2,y2]\tThe bounding box to extract" << endl
        << "   -l [l1,l2,l3...]\tThe intensity levels to extract" << endl
        << endl;
@@ -58,6 +60,7 @@ struct GlobalsList
 {
   bool verbose;           // verbose mode flag
   string shapename;       // output shape
+  string format;          // output format
   double x1, y1, x2, y2;  // the bounding box
   set<int> levels;        // the desired levels
 
@@ -76,6 +79,7 @@ void parse_command_line(int argc, const char *argv[])
 {
   // suitable defaults for Scandinavia (?)
   globals.verbose = false;
+  globals.format = "shape";
   globals.levels = NFmiStringTools::Split<set<int>>("32");  // average default
   globals.x1 = 6;
   globals.y1 = 51;
@@ -84,7 +88,7 @@ void parse_command_line(int argc, const char *argv[])
 
   // Begin parsing
 
-  NFmiCmdLine cmdline(argc, argv, "hvb!l!");
+  NFmiCmdLine cmdline(argc, argv, "hvb!l!F!");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -103,6 +107,12 @@ void parse_command_line(int argc, const char *argv[])
   if (cmdline.isOption('v'))
     globals.verbose = true;
 
+  if (cmdline.isOption('F'))
+  {
+    globals.format = cmdline.OptionValue('F');
+    OgrWriter::checkFormat(globals.format);
+  }
+
   if (cmdline.isOption('b'))
   {
     const vector<double> values = NFmiStringTools::Split<vector<double>>(cmdline.OptionValue('b'));
@@ -317,7 +327,10 @@ void create_shape()
   if (globals.verbose)
     cout << "Writing result..." << endl;
 
-  shape.Write(globals.shapename);
+  if (OgrWriter::isOgrFormat(globals.format))
+    OgrWriter::write(shape, globals.shapename, globals.format);
+  else
+    shape.Write(globals.shapename);
 }
 
 // ----------------------------------------------------------------------
@@ -81,10 +81,24 @@
  * - bezier cardinal <0-1>
  * - bezier approximate <maxerror>
  * - bezier tight <maxerror>
+ *
+ * The shapefile of the shape, subshape and exec commands may also be
+ * a shape cache (.shpc) made with shapecache. The polylines and
+ * polygons are then read directly from the memory mapped cache. The
+ * condition of the subshape command is of the form field=value.
+ *
+ * FlatGeobuf (.fgb) and GeoPackage (.gpkg) files are read through OGR.
+ * Only the features overlapping the area and satisfying the condition
+ * of the subshape command are then read, which with a spatially
+ * indexed file avoids decoding the rest of the data.
  */
 // ======================================================================
 
+#include "EsriView.h"
+#include "OgrReader.h"
 #include "Polyline.h"
+#include "ProjectionTools.h"
+#include "ShapeCache.h"
 #include <gis/CoordinateMatrix.h>
 #include <imagine/NFmiApproximateBezierFit.h>
 #include <imagine/NFmiCardinalBezierFit.h>
@@ -107,6 +121,7 @@
 #include <newbase/NFmiSmoother.h>
 #include <newbase/NFmiStreamQueryData.h>
 #include <newbase/NFmiValueString.h>
+#include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
@@ -114,6 +129,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <boost/lexical_cast.hpp>
 
@@ -360,6 +376,204 @@ void set_level(NFmiFastQueryInfo &theInfo, int theLevel)
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append the parts of a polyline or polygon to a path
+ */
+// ----------------------------------------------------------------------
+
+template <typename Record>
+void append_path(Imagine::NFmiPath &thePath, const Record &theRecord)
+{
+  for (int part = 0; part < theRecord.numParts(); part++)
+  {
+    const int first = theRecord.part(part);
+    const int last =
+        (part + 1 < theRecord.numParts() ? theRecord.part(part + 1) : theRecord.numPoints());
+    for (int j = first; j < last; j++)
+    {
+      if (j == first)
+        thePath.MoveTo(theRecord.x(j), theRecord.y(j));
+      else
+        thePath.LineTo(theRecord.x(j), theRecord.y(j));
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Split a shape condition of the form field=value
+ */
+// ----------------------------------------------------------------------
+
+void parse_condition(const string &theCondition, string &theField, string &theValue)
+{
+  const string::size_type pos = theCondition.find('=');
+  if (pos == string::npos)
+    throw runtime_error("Shape condition must be of the form name=value");
+  theField = theCondition.substr(0, pos);
+  theValue = theCondition.substr(pos + 1);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the path of the polylines and polygons in a shape cache
+ *
+ * \param theCache The name of the cache file
+ * \param theCondition Empty, or a condition of the form field=value
+ * \return The path in geographic coordinates
+ */
+// ----------------------------------------------------------------------
+
+Imagine::NFmiPath cache_path(const string &theCache, const string &theCondition)
+{
+  const ShapeCache::Reader reader(theCache);
+
+  int field = -1;
+  string value;
+  if (!theCondition.empty())
+  {
+    string name;
+    parse_condition(theCondition, name, value);
+    field = reader.field(name);
+    if (field < 0)
+      throw runtime_error("Field '" + name + "' does not exist in '" + theCache + "'");
+  }
+
+  Imagine::NFmiPath path;
+
+  for (std::size_t i = 0; i < reader.size(); i++)
+  {
+    const int type = reader.type(i);
+    if (type != Imagine::kFmiEsriPolyLine && type != Imagine::kFmiEsriPolygon)
+      continue;
+
+    if (field >= 0 && reader.value(i, field) != value)
+      continue;
+
+    append_path(path, reader.record(i));
+  }
+
+  return path;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The geographic bounding box of the rendered area
+ *
+ * The edges of the area extended by the clipping margin are sampled,
+ * and the box is widened by one sampling step to cover edges bulging
+ * between the samples. A pole inside the area extends the box to
+ * all longitudes.
+ *
+ * \param theArea The area
+ * \param theMargin The clipping margin in pixels
+ * \param theBox The box to be set
+ * \return False if the box could not be determined
+ */
+// ----------------------------------------------------------------------
+
+bool area_box(const NFmiArea &theArea, double theMargin, ShpFile::Box &theBox)
+{
+  const int samples = 32;
+
+  const double x1 = min(theArea.Left(), theArea.Right()) - theMargin;
+  const double x2 = max(theArea.Left(), theArea.Right()) + theMargin;
+  const double y1 = min(theArea.Top(), theArea.Bottom()) - theMargin;
+  const double y2 = max(theArea.Top(), theArea.Bottom()) + theMargin;
+
+  vector<double> xs, ys;
+  for (int i = 0; i <= samples; i++)
+  {
+    const double x = x1 + i * (x2 - x1) / samples;
+    const double y = y1 + i * (y2 - y1) / samples;
+    xs.insert(xs.end(), {x, x, x1, x2});
+    ys.insert(ys.end(), {y1, y2, y, y});
+  }
+
+  vector<double> lons(xs.size()), lats(ys.size());
+  ProjectionTools::toLatLon(theArea, &xs[0], &ys[0], &lons[0], &lats[0], xs.size());
+
+  ShpFile::Box box;
+  for (std::size_t i = 0; i < lons.size(); i++)
+  {
+    if (!std::isfinite(lons[i]) || !std::isfinite(lats[i]))
+      return false;
+    box.update(lons[i], lats[i]);
+  }
+
+  const double dx = (box.xmax - box.xmin) / samples;
+  const double dy = (box.ymax - box.ymin) / samples;
+  box.xmin = max(-180.0, box.xmin - dx);
+  box.xmax = min(180.0, box.xmax + dx);
+  box.ymin = max(-90.0, box.ymin - dy);
+  box.ymax = min(90.0, box.ymax + dy);
+
+  for (double lat : {-90.0, 90.0})
+  {
+    const NFmiPoint pole = theArea.ToXY(NFmiPoint(0, lat));
+    if (pole.X() >= x1 && pole.X() <= x2 && pole.Y() >= y1 && pole.Y() <= y2)
+    {
+      box.xmin = -180;
+      box.xmax = 180;
+      box.ymin = min(box.ymin, lat);
+      box.ymax = max(box.ymax, lat);
+    }
+  }
+
+  theBox = box;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the path of the polylines and polygons in an OGR layer
+ *
+ * Only the features overlapping the rendered area and satisfying the
+ * condition are read. Areas in the Pacific view are not filtered
+ * spatially, since their longitudes exceed 180 degrees.
+ *
+ * \param theName The name of the FlatGeobuf or GeoPackage file
+ * \param theCondition Empty, or a condition of the form field=value
+ * \param theArea The rendered area
+ * \param theMargin The clipping margin in pixels
+ * \return The path in geographic coordinates
+ */
+// ----------------------------------------------------------------------
+
+Imagine::NFmiPath layer_path(const string &theName,
+                             const string &theCondition,
+                             const NFmiArea &theArea,
+                             double theMargin)
+{
+  OgrReader::Layer layer(theName);
+
+  string filter;
+  if (!theCondition.empty())
+  {
+    string name, value;
+    parse_condition(theCondition, name, value);
+    filter = layer.filterExpression(name, "=", value);
+  }
+
+  ShpFile::Box box;
+  const bool spatial = (!theArea.PacificView() && area_box(theArea, theMargin, box));
+
+  const unique_ptr<Imagine::NFmiEsriShape> shape = layer.read(spatial ? &box : nullptr, filter);
+  const EsriView::Reader reader(*shape);
+
+  Imagine::NFmiPath path;
+
+  for (std::size_t i = 0; i < reader.size(); i++)
+  {
+    const EsriView::Record record = reader.record(i);
+    if (record.type() == Imagine::kFmiEsriPolyLine || record.type() == Imagine::kFmiEsriPolygon)
+      append_path(path, record);
+  }
+
+  return path;
+}
+
 // ----------------------------------------------------------------------
 // The main driver
 // ----------------------------------------------------------------------
@@ -767,10 +981,19 @@ int domain(int argc, const char *argv[])
       // Read the shape, project and get as path
       try
       {
-        Imagine::NFmiGeoShape geo(shapefile, Imagine::kFmiGeoShapeEsri, condition);
-        // geo.ProjectXY(*theArea);
+        Imagine::NFmiPath path;
+        if (ShapeCache::isCache(shapefile))
+          path = cache_path(shapefile, condition);
+        else if (OgrReader::isOgrSource(shapefile))
+          path = layer_path(shapefile, condition, *theArea, theClipMargin);
+        else
+        {
+          Imagine::NFmiGeoShape geo(shapefile, Imagine::kFmiGeoShapeEsri, condition);
+          // geo.ProjectXY(*theArea);
+          path = geo.Path();
+        }
 
-        Imagine::NFmiPath path = geo.Path().PacificView(theArea->PacificView());
+        path = path.PacificView(theArea->PacificView());
         path.Project(theArea.get());
 
         if (token == "shape" || token == "subshape")
@@ -816,13 +1039,25 @@ int domain(int argc, const char *argv[])
       NFmiFastQueryInfo *qi = qd.QueryInfoIter();
       qi->First();
 
+      // Project all the locations at once
+
+      vector<double> lons, lats;
       for (qi->ResetLocation(); qi->NextLocation();)
       {
         const NFmiPoint lonlat = qi->LatLon();
-        const NFmiPoint pt = theArea->ToXY(lonlat);
-        buffer << static_cast<char *>(NFmiValueString(pt.X())) << ' '
+        lons.push_back(lonlat.X());
+        lats.push_back(lonlat.Y());
+      }
+
+      vector<double> xs(lons.size()), ys(lats.size());
+      if (!lons.empty())
+        ProjectionTools::toXY(*theArea, &lons[0], &lats[0], &xs[0], &ys[0], lons.size());
+
+      for (std::size_t i = 0; i < xs.size(); i++)
+      {
+        buffer << static_cast<char *>(NFmiValueString(xs[i])) << ' '
                << static_cast<char *>(
-                      NFmiValueString(theArea->Bottom() - (pt.Y() - theArea->Top())))
+                      NFmiValueString(theArea->Bottom() - (ys[i] - theArea->Top())))
                << " e2" << endl;
       }
       buffer << "pop" << endl;
@@ -22,6 +22,8 @@
 #pragma warning(disable : 4786)  // STL name length warnings off
 #endif
 
+#include "AttributeTable.h"
+#include "ShapeLoader.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <imagine/NFmiEsriMultiPoint.h>
 #include <imagine/NFmiEsriPolyLine.h>
@@ -31,6 +33,7 @@
 #include <newbase/NFmiCmdLine.h>
 #include <fstream>
 #include <iomanip>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
@@ -90,11 +93,15 @@ int run(int argc, const char *argv[])
   if (cmdline.isOption('d'))
     options.outdir = cmdline.OptionValue('d');
 
-  Imagine::NFmiEsriShape shape;
-  if (!shape.Read(options.infile, true))
-    throw std::runtime_error("Failed to read " + options.infile);
+  const std::unique_ptr<Imagine::NFmiEsriShape> shapeptr = ShapeLoader::read(options.infile, true);
+  const Imagine::NFmiEsriShape &shape = *shapeptr;
 
-  const Imagine::NFmiEsriShape::attributes_type &attributes = shape.Attributes();
+  // Resolve the name attribute once instead of for each element
+
+  AttributeTable table(shape);
+  const int namecolumn = table.column(options.fieldname);
+  if (namecolumn >= 0 && table.type(namecolumn) != Imagine::kFmiEsriString)
+    throw runtime_error("Attribute " + options.fieldname + " must be of type string");
 
   // Collect the data fully before writing to files
   typedef std::map<std::string, Imagine::NFmiPath> Paths;
@@ -111,22 +118,8 @@ int run(int argc, const char *argv[])
       continue;
 
     string name;
-    for (Imagine::NFmiEsriShape::attributes_type::const_iterator ait = attributes.begin();
-         ait != attributes.end() && name.empty();
-         ++ait)
-    {
-      if ((*ait)->Name() != options.fieldname)
-        continue;
-
-      switch ((*ait)->Type())
-      {
-        case Imagine::kFmiEsriString:
-          name = (*it)->GetString((*ait)->Name());
-          break;
-        default:
-          throw runtime_error("Attribute " + options.fieldname + " must be of type string");
-      }
-    }
+    if (namecolumn >= 0)
+      name = table.strings(namecolumn)[shapenumber];
 
     if (name.empty())
       throw runtime_error("The shape does not contain a field named " + options.fieldname);
@@ -11,25 +11,38 @@
  * shapefiles, and outputs respective PSLG files to be used with
  * the Delaunay triangulation package by Jonathan R. Shewchuk.
  *
- * Usage: shape2triangle [arealimit] [shape] [outname]
+ * Usage: shape2triangle [-b] [-h] [arealimit] [shape] [outname]
  *
  * The program will generate outname.node and outname.poly files.
  * Any polygon smaller than the given area limit is not output.
+ *
+ * The nesting of the polygons is resolved first. Polygons inside an
+ * even number of other polygons are land and get a region seed whose
+ * attribute is the ordinal of the polygon, the seed is placed outside
+ * any lakes inside the polygon. Polygons at odd nesting depths are
+ * lakes and get no seed, hence their triangles get attribute 0 like
+ * the sea. Option -h outputs a hole point for each lake instead, the
+ * lakes are then left out of the triangulation.
+ *
+ * Option -b writes the files in the binary PSLG form, which
+ * amalgamate and triangle2shape read considerably faster.
+ * The Triangle program itself requires the text form.
  */
 // ======================================================================
 
+#include "Containment.h"
 #include "Nodes.h"
 #include "Polygon.h"
+#include "Pslg.h"
 #include <imagine/NFmiGeoShape.h>
 #include <imagine/NFmiPath.h>
 #include <newbase/NFmiArea.h>
 #include <newbase/NFmiFileSystem.h>
-#include <newbase/NFmiValueString.h>
 // system
 #include <cstdlib>
-#include <fstream>
-#include <map>
+#include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -39,9 +52,20 @@ using namespace std;
 int main(int argc, const char *argv[])
 {
   // Read the command line arguments
+  bool binary = false;
+  bool holes = false;
+  while (argc > 1 && (string(argv[1]) == "-b" || string(argv[1]) == "-h"))
+  {
+    if (string(argv[1]) == "-b")
+      binary = true;
+    else
+      holes = true;
+    --argc;
+    ++argv;
+  }
   if (argc != 4)
   {
-    cerr << "Usage: " << argv[0] << " [arealimit] [shape] [outname]" << endl;
+    cerr << "Usage: shape2triangle [-b] [-h] [arealimit] [shape] [outname]" << endl;
     return 1;
   }
   double arealimit = atof(argv[1]);
@@ -89,131 +113,122 @@ int main(int argc, const char *argv[])
   }
   cout << "Found " << polygons.size() << " large enough polygons" << endl;
 
-  // Create a table of unique nodes from the accepted polygons
+  // Create a table of unique nodes from the accepted polygons.
+  // The ordinals returned by Nodes::add are recorded per vertex,
+  // and since new nodes get consecutive ordinals the node table
+  // can be filled in ordinal order at the same time. The attribute
+  // is the id of the polygon owning the point.
 
   cout << "Calculating unique nodes" << endl;
   Nodes nodes;
+  Pslg::NodeData nodedata;
+  nodedata.attributes = 1;
+  vector<vector<unsigned long> > ordinals(polygons.size());
   {
-    const vector<Polygon>::const_iterator begin = polygons.begin();
-    const vector<Polygon>::const_iterator end = polygons.end();
-    unsigned long idx = 0;
-    for (vector<Polygon>::const_iterator iter = begin; iter != end; ++iter)
+    for (vector<Polygon>::size_type i = 0; i < polygons.size(); i++)
     {
-      ++idx;
-      const Polygon::DataType::const_iterator pbegin = iter->data().begin();
-      const Polygon::DataType::const_iterator pend = iter->data().end();
-      for (Polygon::DataType::const_iterator piter = pbegin; piter != pend; ++piter)
-        static_cast<void>(nodes.add(*piter, idx));
+      const long idx = i + 1;
+      const Polygon::DataType &data = polygons[i].data();
+      ordinals[i].reserve(data.size());
+      for (Polygon::DataType::const_iterator piter = data.begin(); piter != data.end(); ++piter)
+      {
+        const unsigned long ordinal = nodes.add(*piter, idx);
+        if (ordinal > nodedata.x.size())
+        {
+          nodedata.x.push_back(piter->x());
+          nodedata.y.push_back(piter->y());
+          nodedata.attr.push_back(idx);
+        }
+        ordinals[i].push_back(ordinal);
+      }
     }
   }
-  cout << "Counted " << nodes.data().size() << " nodes" << endl;
+  cout << "Counted " << nodedata.x.size() << " nodes" << endl;
 
   // Output a file containing all the nodes
   {
     string nodefile = outname + ".node";
     cout << "Writing " << nodefile << endl;
-    ofstream out(nodefile.c_str());
-    if (!out)
-    {
-      cerr << "Error: Could not open " << nodefile << " for writing" << endl;
-      return 1;
-    }
-
-    // PSLG syntax has numbers for each point, but triangle seems to assume
-    // the lines have been sorted.
 
-    map<long, Point> sortednodes;
-    const Nodes::DataType &data = nodes.data();
+    try
     {
-      const Nodes::DataType::const_iterator begin = data.begin();
-      const Nodes::DataType::const_iterator end = data.end();
-      for (Nodes::DataType::const_iterator iter = begin; iter != end; ++iter)
-        sortednodes.insert(make_pair(iter->second.first, iter->first));
+      Pslg::write(nodefile, nodedata, binary);
     }
-    // #points dimension #attributes #boundarymarkers
-    out << data.size() << " 2 1 0" << endl;
+    catch (std::exception &e)
     {
-      const map<long, Point>::const_iterator begin = sortednodes.begin();
-      const map<long, Point>::const_iterator end = sortednodes.end();
-      for (map<long, Point>::const_iterator iter = begin; iter != end; ++iter)
-        out << iter->first << '\t' << NFmiValueString(iter->second.x()).CharPtr() << '\t'
-            << NFmiValueString(iter->second.y()).CharPtr() << '\t' << nodes.id(iter->second)
-            << endl;
+      cerr << e.what() << endl;
+      return 1;
     }
-    out.close();
   }
 
   // Output a file containing all the edges
   {
     string polyfile = outname + ".poly";
     cout << "Writing " << polyfile << endl;
-    ofstream out(polyfile.c_str());
-    if (!out)
-    {
-      cerr << "Error: Could not open " << polyfile << " for writing" << endl;
-      return 1;
-    }
 
-    long number_of_edges = 0;
-    for (unsigned int pass = 1; pass <= 2; pass++)
-    {
-      long edge = 0;
-      if (pass == 2)
-      {
-        out << "0 2 0 0" << endl;  // no nodes in .poly
-        out << number_of_edges << " 0" << endl;
-      }
+    Pslg::PolyData polydata;  // no nodes in .poly
+
+    // Each polygon with n vertices has n-1 edges
 
-      const vector<Polygon>::const_iterator begin = polygons.begin();
-      const vector<Polygon>::const_iterator end = polygons.end();
-      for (vector<Polygon>::const_iterator iter = begin; iter != end; ++iter)
+    size_t edges = 0;
+    for (vector<vector<unsigned long> >::const_iterator iter = ordinals.begin();
+         iter != ordinals.end();
+         ++iter)
+      if (!iter->empty())
+        edges += iter->size() - 1;
+
+    polydata.idx1.reserve(edges);
+    polydata.idx2.reserve(edges);
+    for (vector<vector<unsigned long> >::const_iterator iter = ordinals.begin();
+         iter != ordinals.end();
+         ++iter)
+    {
+      for (vector<unsigned long>::size_type j = 1; j < iter->size(); j++)
       {
-        Point previous_point(0, 0);
-        const Polygon::DataType::const_iterator pbegin = iter->data().begin();
-        const Polygon::DataType::const_iterator pend = iter->data().end();
-        for (Polygon::DataType::const_iterator piter = pbegin; piter != pend; ++piter)
-        {
-          if (piter != pbegin)
-          {
-            if (pass == 1)
-              number_of_edges++;
-            else
-            {
-              out << ++edge << '\t' << nodes.number(previous_point) << '\t' << nodes.number(*piter)
-                  << endl;
-            }
-          }
-          if (pass == 2)
-            previous_point = *piter;
-        }
+        polydata.idx1.push_back((*iter)[j - 1]);
+        polydata.idx2.push_back((*iter)[j]);
       }
     }
 
-    // No holes
-    out << "0" << endl;
+    // For each land polygon we output a single point inside the
+    // polygon but outside the lakes in it. The attribute is the
+    // ordinal of the polygon itself. This is sufficient to uniquely
+    // identify all triangles in the subsequent triangulation as
+    // belonging to some original polygon, the triangles of the lakes
+    // get attribute 0 unless they are output as holes.
 
-    // For each polygon we output a single point inside the polygon.
-    // The attribute is the ordinal of the polygon itself. This
-    // is sufficient to uniquely identify all triangles in the
-    // subsequent triangulation as belonging to some original
-    // polygon, provided no polygon encloses another one.
+    cout << "Resolving the nesting of " << polygons.size() << " polygons" << endl;
+    const vector<long> parents = Containment::parents(polygons);
+    const vector<int> depths = Containment::depths(parents);
+    const vector<Point> insidepoints = Containment::insidePoints(polygons, parents);
 
+    for (vector<Polygon>::size_type i = 0; i < polygons.size(); i++)
     {
-      cout << "Finding an inside point for " << polygons.size() << " polygons" << endl;
-      out << polygons.size() << endl;
-      const vector<Polygon>::const_iterator begin = polygons.begin();
-      const vector<Polygon>::const_iterator end = polygons.end();
-      long poly = 0;
-      for (vector<Polygon>::const_iterator iter = begin; iter != end; ++iter)
+      const Point &pt = insidepoints[i];
+      if (depths[i] % 2 == 0)
       {
-        ++poly;
-        Point pt = iter->someInsidePoint();
-        out << poly << '\t' << NFmiValueString(pt.x()).CharPtr() << '\t'
-            << NFmiValueString(pt.y()).CharPtr() << '\t' << poly << endl;
+        polydata.regionx.push_back(pt.x());
+        polydata.regiony.push_back(pt.y());
+        polydata.regionattr.push_back(i + 1);
+      }
+      else if (holes)
+      {
+        polydata.holex.push_back(pt.x());
+        polydata.holey.push_back(pt.y());
       }
     }
+    cout << "Found " << polydata.regionx.size() << " land polygons and "
+         << polygons.size() - polydata.regionx.size() << " lakes" << endl;
 
-    out.close();
+    try
+    {
+      Pslg::write(polyfile, polydata, binary);
+    }
+    catch (std::exception &e)
+    {
+      cerr << e.what() << endl;
+      return 1;
+    }
   }
 
   cout << "Done" << endl;
@@ -21,10 +21,8 @@
 #pragma warning(disable : 4786)  // STL name length warnings off
 #endif
 
-#include <imagine/NFmiEsriMultiPoint.h>
-#include <imagine/NFmiEsriPolyLine.h>
-#include <imagine/NFmiEsriPolygon.h>
-#include <imagine/NFmiEsriShape.h>
+#include "AttributeTable.h"
+#include "ShpFile.h"
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
@@ -44,72 +42,68 @@ int main(int argc, char *argv[])
 
   try
   {
-    Imagine::NFmiEsriShape shape;
-    if (!shape.Read(shapefile, true))
-      throw std::runtime_error("Failed to read " + shapefile);
+    // The files are memory mapped, records are decoded only when printed
 
-    cout << "<shapefile filename=\"" << shapefile << "\">" << endl;
+    const ShpFile::MappedReader reader(shapefile);
+    const ShpFile::MappedDbf dbf(shapefile);
+
+    if (dbf.size() != reader.size())
+      throw std::runtime_error("The number of records in the .shp and .dbf files of " + shapefile +
+                               " differ");
 
-    const Imagine::NFmiEsriShape::attributes_type &attributes = shape.Attributes();
+    AttributeTable attributes(dbf);
+
+    cout << "<shapefile filename=\"" << shapefile << "\">" << endl;
 
     {
       cout << "<attributelist>" << endl;
-      for (Imagine::NFmiEsriShape::attributes_type::const_iterator ait = attributes.begin();
-           ait != attributes.end();
-           ++ait)
-        cout << " <attribute name=\"" << (*ait)->Name() << '"' << " type=\""
-             << static_cast<int>((*ait)->Type()) << '"' << "/>" << endl;
+      for (size_t col = 0; col < attributes.columns(); ++col)
+        cout << " <attribute name=\"" << attributes.name(col) << '"' << " type=\""
+             << static_cast<int>(attributes.type(col)) << '"' << "/>" << endl;
       cout << "</attributelist>" << endl;
     }
 
-    int shapenumber = -1;
-    for (Imagine::NFmiEsriShape::const_iterator it = shape.Elements().begin();
-         it != shape.Elements().end();
-         ++it)
+    for (size_t shapenumber = 0; shapenumber < reader.size(); ++shapenumber)
     {
-      ++shapenumber;
+      const ShpFile::Record elem = reader.record(shapenumber);
 
-      if (*it == 0)
+      if (elem.type() == Imagine::kFmiEsriNull)
         continue;
 
-      cout << "<shape id=\"" << shapenumber << '"' << " type=\"" << static_cast<int>((*it)->Type())
-           << '"';
+      cout << "<shape id=\"" << shapenumber << '"' << " type=\"" << elem.type() << '"';
 
-      for (Imagine::NFmiEsriShape::attributes_type::const_iterator ait = attributes.begin();
-           ait != attributes.end();
-           ++ait)
+      for (size_t col = 0; col < attributes.columns(); ++col)
       {
-        cout << ' ' << (*ait)->Name() << "=\"";
-        switch ((*ait)->Type())
+        cout << ' ' << attributes.name(col) << "=\"";
+        switch (attributes.type(col))
         {
           case Imagine::kFmiEsriString:
-            cout << (*it)->GetString((*ait)->Name());
+            cout << attributes.strings(col)[shapenumber];
             break;
           case Imagine::kFmiEsriInteger:
-            cout << (*it)->GetInteger((*ait)->Name());
+            cout << attributes.integers(col)[shapenumber];
             break;
           case Imagine::kFmiEsriDouble:
-            cout << (*it)->GetDouble((*ait)->Name());
+            cout << attributes.doubles(col)[shapenumber];
             break;
           case Imagine::kFmiEsriDate:
-            cout << (*it)->GetDate((*ait)->Name()).ToStr(kYYYYMMDD);
+            cout << attributes.dates(col)[shapenumber].ToStr(kYYYYMMDD);
             break;
         }
         cout << '"';
       }
       cout << '>' << endl;
 
-      switch ((*it)->Type())
+      switch (elem.type())
       {
-        case Imagine::kFmiEsriNull:
         case Imagine::kFmiEsriMultiPatch:
           break;
         case Imagine::kFmiEsriPoint:
         case Imagine::kFmiEsriPointM:
         case Imagine::kFmiEsriPointZ:
         {
-          const float x = (*it)->X();
-          const float y = (*it)->Y();
+          const float x = elem.x(0);
+          const float y = elem.y(0);
           cout << "M " << x << ' ' << y << endl;
           break;
         }
@@ -117,12 +111,10 @@ int main(int argc, char *argv[])
         case Imagine::kFmiEsriMultiPointM:
         case Imagine::kFmiEsriMultiPointZ:
         {
-          const Imagine::NFmiEsriMultiPoint *elem =
-              static_cast<const Imagine::NFmiEsriMultiPoint *>(*it);
-          for (int i = 0; i < elem->NumPoints(); i++)
+          for (int i = 0; i < elem.numPoints(); i++)
           {
-            const float x = elem->Points()[i].X();
-            const float y = elem->Points()[i].Y();
+            const float x = elem.x(i);
+            const float y = elem.y(i);
             if (i > 0)
               cout << ' ';
             cout << "M " << x << ' ' << y;
@@ -133,52 +125,28 @@ int main(int argc, char *argv[])
         case Imagine::kFmiEsriPolyLine:
         case Imagine::kFmiEsriPolyLineM:
         case Imagine::kFmiEsriPolyLineZ:
-        {
-          const Imagine::NFmiEsriPolyLine *elem =
-              static_cast<const Imagine::NFmiEsriPolyLine *>(*it);
-          for (int part = 0; part < elem->NumParts(); part++)
-          {
-            int i1, i2;
-            i1 = elem->Parts()[part];  // start of part
-            if (part + 1 == elem->NumParts())
-              i2 = elem->NumPoints() - 1;  // end of part
-            else
-              i2 = elem->Parts()[part + 1] - 1;  // end of part
-
-            if (i2 >= i1)
-            {
-              if (part > 0)
-                cout << endl;
-              cout << "M " << elem->Points()[i1].X() << ' ' << elem->Points()[i1].Y();
-              for (int i = i1 + 1; i <= i2; i++)
-                cout << " L " << elem->Points()[i].X() << ' ' << elem->Points()[i].Y();
-              cout << endl;
-            }
-          }
-          break;
-        }
         case Imagine::kFmiEsriPolygon:
         case Imagine::kFmiEsriPolygonM:
         case Imagine::kFmiEsriPolygonZ:
         {
-          const Imagine::NFmiEsriPolygon *elem = static_cast<const Imagine::NFmiEsriPolygon *>(*it);
-          for (int part = 0; part < elem->NumParts(); part++)
+          const bool polygon = (elem.type() % 10 == Imagine::kFmiEsriPolygon);
+          for (int part = 0; part < elem.numParts(); part++)
           {
             int i1, i2;
-            i1 = elem->Parts()[part];  // start of part
-            if (part + 1 == elem->NumParts())
-              i2 = elem->NumPoints() - 1;  // end of part
+            i1 = elem.part(part);  // start of part
+            if (part + 1 == elem.numParts())
+              i2 = elem.numPoints() - 1;  // end of part
             else
-              i2 = elem->Parts()[part + 1] - 1;  // end of part
+              i2 = elem.part(part + 1) - 1;  // end of part
 
             if (i2 >= i1)
             {
               if (part > 0)
                 cout << endl;
-              cout << "M " << elem->Points()[i1].X() << ' ' << elem->Points()[i1].Y();
+              cout << "M " << elem.x(i1) << ' ' << elem.y(i1);
               for (int i = i1 + 1; i <= i2; i++)
-                cout << " L " << elem->Points()[i].X() << ' ' << elem->Points()[i].Y();
-              cout << " Z" << endl;
+                cout << " L " << elem.x(i) << ' ' << elem.y(i);
+              cout << (polygon ? " Z" : "") << endl;
             }
           }
           break;
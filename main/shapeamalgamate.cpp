@@ -0,0 +1,254 @@
+// ======================================================================
+/*!
+ * \file shapeamalgamate.cpp
+ * \brief A program to amalgamate shapefile polygons
+ */
+// ======================================================================
+/*!
+ * \page shapeamalgamate shapeamalgamate
+ *
+ * shapeamalgamate performs the full amalgamation process in memory,
+ * replacing the chain
+ * \code
+ * shape2triangle [inputarealimit] [input] tmp
+ * triangle -pcAI tmp
+ * amalgamate [lengthlimit] [arealimit] tmp tmp.1
+ * triangle2shape 0 tmp.1 [output]
+ * \endcode
+ * with a single command
+ * \code
+ * shapeamalgamate [inputarealimit] [lengthlimit] [arealimit] [input] [output]
+ * \endcode
+ * The constrained Delaunay triangulation is done internally, hence
+ * the Triangle program is not needed.
+ *
+ * Polygons smaller than the input area limit are ignored. Triangles
+ * outside the original polygons are accepted if all their sides are
+ * shorter than the length limit, polygons smaller than the area limit
+ * are removed from the output.
+ *
+ * The triangles are filtered in parallel using all cores.
+ */
+// ======================================================================
+
+#include "Amalgamation.h"
+#include "Containment.h"
+#include "Nodes.h"
+#include "Polygon.h"
+#include "Triangulator.h"
+#include <imagine/NFmiEsriPolygon.h>
+#include <imagine/NFmiEsriShape.h>
+#include <imagine/NFmiGeoShape.h>
+#include <imagine/NFmiPath.h>
+// system
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect the closed polygons of a path which are large enough
+ */
+// ----------------------------------------------------------------------
+
+vector<Polygon> collect_polygons(const Imagine::NFmiPath &thePath, double theAreaLimit)
+{
+  vector<Polygon> polygons;
+  Polygon poly;
+
+  const Imagine::NFmiPathData::const_iterator begin = thePath.Elements().begin();
+  const Imagine::NFmiPathData::const_iterator end = thePath.Elements().end();
+
+  for (Imagine::NFmiPathData::const_iterator iter = begin; iter != end;)
+  {
+    bool doflush = false;
+    // Note: g++ has miscompiled (iter++ == end), hence the explicit form
+    if ((*iter).Oper() == Imagine::kFmiMoveTo)
+      doflush = true;
+    else if (++iter == end)
+    {
+      --iter;
+      poly.add(Point((*iter).X(), (*iter).Y()));
+      doflush = true;
+    }
+    else
+      --iter;
+
+    if (doflush && !poly.empty())
+    {
+      if (theAreaLimit <= 0 || poly.geoarea() >= theAreaLimit)
+        polygons.push_back(poly);
+      poly.clear();
+    }
+
+    poly.add(Point((*iter).X(), (*iter).Y()));
+    ++iter;
+  }
+
+  return polygons;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Triangulate the polygons
+ *
+ * Each land polygon is given an inside point outside its lakes, the
+ * regional attribute of the point is the ordinal of the polygon.
+ * Triangles outside all land polygons get attribute 0.
+ */
+// ----------------------------------------------------------------------
+
+void triangulate(const vector<Polygon> &thePolygons, Triangulator &theTriangulator)
+{
+  // New nodes get consecutive ordinals, hence the points can be
+  // passed on immediately and the ordinals of the vertices kept
+  // for the constraints
+
+  Nodes nodes;
+  vector<vector<unsigned long> > ordinals(thePolygons.size());
+  for (vector<Polygon>::size_type i = 0; i < thePolygons.size(); i++)
+  {
+    const Polygon::DataType &data = thePolygons[i].data();
+    ordinals[i].reserve(data.size());
+    for (const Point &pt : data)
+    {
+      const unsigned long ordinal = nodes.add(pt, i + 1);
+      if (ordinal > theTriangulator.points())
+        static_cast<void>(theTriangulator.addPoint(pt.x(), pt.y()));
+      ordinals[i].push_back(ordinal);
+    }
+  }
+
+  cout << "Counted " << theTriangulator.points() << " nodes" << endl;
+
+  for (vector<Polygon>::size_type i = 0; i < thePolygons.size(); i++)
+  {
+    const vector<unsigned long> &poly = ordinals[i];
+    for (vector<unsigned long>::size_type j = 1; j < poly.size(); j++)
+      if (poly[j - 1] != poly[j])
+        theTriangulator.addConstraint(poly[j - 1] - 1, poly[j] - 1);
+  }
+
+  // Lakes are not seeded, their triangles get attribute 0 like the sea
+
+  const vector<long> parents = Containment::parents(thePolygons);
+  const vector<int> depths = Containment::depths(parents);
+  const vector<Point> insidepoints = Containment::insidePoints(thePolygons, parents);
+  for (vector<Polygon>::size_type i = 0; i < thePolygons.size(); i++)
+    if (depths[i] % 2 == 0)
+      theTriangulator.addRegion(insidepoints[i].x(), insidepoints[i].y(), i + 1);
+
+  cout << "Triangulating" << endl;
+  theTriangulator.triangulate();
+  cout << "Created " << theTriangulator.size() << " triangles" << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program without exception handling
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, const char *argv[])
+{
+  if (argc != 6)
+  {
+    cerr << "Usage: shapeamalgamate [inputarealimit] [lengthlimit] [arealimit] [input] [output]"
+         << endl;
+    return 1;
+  }
+
+  const double inputarealimit = atof(argv[1]);
+  const double lengthlimit = atof(argv[2]);
+  const double arealimit = atof(argv[3]);
+  const string inname = argv[4];
+  const string outname = argv[5];
+
+  cout << "Reading shapefile " << inname << endl;
+  Imagine::NFmiGeoShape geo(inname, Imagine::kFmiGeoShapeEsri);
+
+  cout << "Collecting polygons large enough" << endl;
+  const vector<Polygon> inpolygons = collect_polygons(geo.Path(), inputarealimit);
+  cout << "Found " << inpolygons.size() << " large enough polygons" << endl;
+
+  Triangulator triangulator;
+  triangulate(inpolygons, triangulator);
+
+  // Accept all triangles inside the polygons and the ones
+  // outside with short enough sides
+
+  cout << "Filtering triangles" << endl;
+
+  vector<double> x(triangulator.points());
+  vector<double> y(triangulator.points());
+  for (Triangulator::size_type i = 0; i < triangulator.points(); i++)
+  {
+    x[i] = triangulator.x(i);
+    y[i] = triangulator.y(i);
+  }
+
+  vector<size_t> corners(3 * triangulator.size());
+  vector<double> regions(triangulator.size());
+  for (Triangulator::size_type i = 0; i < triangulator.size(); i++)
+  {
+    for (int c = 0; c < 3; c++)
+      corners[3 * i + c] = triangulator.corner(i, c);
+    regions[i] = triangulator.attribute(i);
+  }
+
+  const vector<Amalgamation::NodePair> boundary =
+      Amalgamation::boundary(x, y, corners, regions, lengthlimit);
+
+  cout << "Building polygons from " << boundary.size() << " edges" << endl;
+  vector<Polygon> outpolygons;
+  for (const Polygon &poly : Amalgamation::rings(x, y, boundary))
+    if (arealimit <= 0 || poly.geoarea() >= arealimit)
+      outpolygons.push_back(poly);
+  cout << "Found " << outpolygons.size() << " large enough polygons" << endl;
+
+  Imagine::NFmiEsriShape shape;
+  for (const Polygon &poly : outpolygons)
+  {
+    Imagine::NFmiEsriPolygon *p = new Imagine::NFmiEsriPolygon();
+    for (const Point &pt : poly.data())
+      p->Add(Imagine::NFmiEsriPoint(pt.x(), pt.y()));
+    shape.Add(p);
+  }
+
+  cout << "Writing " << outname << endl;
+  if (!shape.Write(outname))
+    throw runtime_error("Error while saving the shapefiles");
+
+  cout << "Done" << endl;
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program
+ */
+// ----------------------------------------------------------------------
+
+int main(int argc, const char *argv[])
+{
+  try
+  {
+    return domain(argc, argv);
+  }
+  catch (std::exception &e)
+  {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  catch (...)
+  {
+    cerr << "Error: Caught an unknown exception" << endl;
+    return 1;
+  }
+}
+
+// ======================================================================
@@ -0,0 +1,187 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of shapecache for preprocessing shapefiles
+ */
+// ======================================================================
+/*!
+ * \page shapecache shapecache
+ *
+ * shapecache converts a shapefile into a memory mapped binary cache
+ * (.shpc), which the other shapetools can read much faster than the
+ * original shapefile. The cache contains the geometry in native byte
+ * order with separate x and y arrays, a packed R-tree of the element
+ * bounding boxes and the attributes stored column by column.
+ *
+ * Usage:
+ * \code
+ * shapecache [options] inputshape cachefile
+ * \endcode
+ *
+ * The available options are
+ *
+ *   - -h           print the help information
+ *   - -v           verbose mode
+ *   - -q [quantum] quantize the coordinates to multiples of the quantum
+ *
+ * Quantized coordinates are stored as varint coded differences of
+ * consecutive points, which typically makes the cache several times
+ * smaller at the cost of decoding the coordinates when they are read.
+ * The coordinate error is at most the quantum.
+ *
+ * The cache remembers the shapefile it was made from, and is rebuilt
+ * automatically when the shapefile is modified. Only 2D shapes can be
+ * cached.
+ */
+// ======================================================================
+
+#include "ShapeCache.h"
+#include <newbase/NFmiCmdLine.h>
+#include <newbase/NFmiStringTools.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Options holder
+ */
+// ----------------------------------------------------------------------
+
+struct Options
+{
+  string inputfile;
+  string outputfile;
+  bool verbose;
+  double quantum;
+
+  Options() : inputfile(), outputfile(), verbose(false), quantum(0) {}
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Global instance of the parsed command line options
+ */
+// ----------------------------------------------------------------------
+
+Options options;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Print usage
+ */
+// ----------------------------------------------------------------------
+
+void usage()
+{
+  cout << "Usage: shapecache [options] inputshape cachefile" << endl
+       << endl
+       << "shapecache converts a shapefile into a memory mapped cache (.shpc)." << endl
+       << endl
+       << "The available options are:" << endl
+       << endl
+       << "\t-h\t\tprint this help information" << endl
+       << "\t-v\t\tverbose mode" << endl
+       << "\t-q [quantum]\tquantize the coordinates" << endl
+       << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the command line
+ *
+ * \return False, if execution is to be stopped
+ */
+// ----------------------------------------------------------------------
+
+bool parse_command_line(int argc, const char *argv[])
+{
+  NFmiCmdLine cmdline(argc, argv, "hvq!");
+
+  if (cmdline.Status().IsError())
+    throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
+
+  if (cmdline.isOption('h'))
+  {
+    usage();
+    return false;
+  }
+
+  if (cmdline.NumberofParameters() != 2)
+    throw runtime_error("Incorrect number of command line parameters");
+
+  options.inputfile = cmdline.Parameter(1);
+  options.outputfile = cmdline.Parameter(2);
+
+  if (!ShapeCache::isCache(options.outputfile))
+    throw runtime_error("The name of the cache file must end with .shpc");
+
+  if (cmdline.isOption('v'))
+    options.verbose = true;
+
+  if (cmdline.isOption('q'))
+  {
+    options.quantum = NFmiStringTools::Convert<double>(cmdline.OptionValue('q'));
+    if (options.quantum <= 0)
+      throw runtime_error("The quantum must be positive");
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program without exception handling
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, const char *argv[])
+{
+  if (!parse_command_line(argc, argv))
+    return 0;
+
+  if (options.verbose)
+    cout << "Writing '" << options.outputfile << "'" << endl;
+
+  ShapeCache::write(options.inputfile, options.outputfile, options.quantum);
+
+  if (options.verbose)
+  {
+    const ShapeCache::Reader reader(options.outputfile);
+    cout << "Cached " << reader.size() << " elements";
+    if (reader.quantized())
+      cout << " quantized to " << reader.quantum();
+    cout << endl;
+  }
+
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program
+ */
+// ----------------------------------------------------------------------
+
+int main(int argc, const char *argv[])
+{
+  try
+  {
+    return domain(argc, argv);
+  }
+  catch (std::exception &e)
+  {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  catch (...)
+  {
+    cerr << "Error: Caught an unknown exception" << endl;
+    return 1;
+  }
+}
+
+// ======================================================================
@@ -22,8 +22,7 @@
                                  // 'puretuista' STL-template nimist)
 #endif
 
-#include <imagine/NFmiGeoShape.h>
-#include <imagine/NFmiPath.h>
+#include "ShpFile.h"
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
@@ -45,22 +44,48 @@ int main(int argc, char *argv[])
   int linenum = 0;
   try
   {
-    Imagine::NFmiGeoShape geo(shapefile, Imagine::kFmiGeoShapeEsri);
-    Imagine::NFmiPath path = geo.Path();
+    // The records are read directly from the memory mapped file.
+    // Each part of a polyline or polygon starts a new shape,
+    // other shape types have no lines to dump.
 
-    const Imagine::NFmiPathData::const_iterator begin = path.Elements().begin();
-    const Imagine::NFmiPathData::const_iterator end = path.Elements().end();
+    const ShpFile::MappedReader reader(shapefile);
 
-    for (Imagine::NFmiPathData::const_iterator it = begin; it != end; ++it)
+    cout << std::setiosflags(std::ios::fixed);
+
+    for (std::size_t i = 0; i < reader.size(); i++)
     {
-      if ((*it).Oper() == Imagine::kFmiMoveTo)
+      const ShpFile::Record record = reader.record(i);
+
+      switch (record.type())
+      {
+        case 3:
+        case 5:
+        case 13:
+        case 15:
+        case 23:
+        case 25:
+          break;
+        default:
+          continue;
+      }
+
+      for (int part = 0; part < record.numParts(); part++)
       {
+        const int first = record.part(part);
+        const int last =
+            (part + 1 < record.numParts() ? record.part(part + 1) : record.numPoints());
+        if (first >= last)
+          continue;
+
         shapenum++;
         linenum = 0;
+        for (int j = first; j < last; j++)
+        {
+          linenum++;
+          cout << shapenum << '\t' << linenum << '\t' << record.x(j) << '\t' << record.y(j)
+               << endl;
+        }
       }
-      linenum++;
-      cout << shapenum << '\t' << linenum << '\t' << std::setiosflags(std::ios::fixed) << (*it).X()
-           << '\t' << (*it).Y() << endl;
     }
   }
   catch (exception &e)
@@ -10,21 +10,61 @@
  * shapefilter takes as input an ESRI shapefile and outputs
  * a new ESRI shapefile based on the command line options.
  *
+ * Field and bounding box filters may be combined, and are applied
+ * in a single pass which reads one record and its attributes at a
+ * time and writes the accepted ones immediately. Hence arbitrarily
+ * large shapefiles can be filtered in constant memory.
+ *
+ * With option -c the accepted elements are also clipped to the
+ * bounding box, polygons with the Weiler-Atherton algorithm so that
+ * split polygons become separate rings, and polylines segment by
+ * segment. The records are clipped in parallel in batches of limited
+ * size.
+ *
+ * With option -d duplicate elements are removed, only the first
+ * occurrence is kept. Elements are duplicates if their canonical
+ * geometries are equal, ignoring the starting vertex and orientation
+ * of rings and the order of parts. By default the coordinates must be
+ * exactly equal. With option -q the coordinates are first rounded to
+ * integer multiples of the given quantum, so that coordinate noise
+ * below the quantum is ignored. Option -a additionally requires
+ * the attributes to be equal. Candidates are found by hash values
+ * computed in parallel and verified by comparing with the earlier
+ * record.
+ *
+ * The input may also be a shape cache (.shpc) made with shapecache.
+ * The elements are then reassembled into shapefile records from the
+ * cached tables, and the bounding box filter uses the R-tree of the
+ * cache instead of testing every element.
+ *
  */
 // ======================================================================
 
-#include <imagine/NFmiCounter.h>
+#include "Clipping.h"
+#include "EdgeCounter.h"
+#include "GeometryHash.h"
+#include "ShapeCache.h"
+#include "ShapeLoader.h"
+#include "ShpFile.h"
 #include <imagine/NFmiEdge.h>
 #include <imagine/NFmiEdgeTree.h>
 #include <imagine/NFmiEsriPoint.h>
 #include <imagine/NFmiEsriPolyLine.h>
 #include <imagine/NFmiEsriPolygon.h>
 #include <imagine/NFmiEsriShape.h>
-#include <imagine/NFmiEsriTools.h>
 #include <imagine/NFmiPath.h>
 #include <newbase/NFmiCmdLine.h>
 #include <newbase/NFmiSettings.h>
+#include <newbase/NFmiStringTools.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 using namespace Imagine;
@@ -42,6 +82,10 @@ struct OptionsList
   string filter_field;
   string filter_boundingbox;
   bool verbose;
+  bool clip;
+  bool dedup;
+  bool dedup_attributes;
+  double dedup_quantum;
   bool filter_odd_count;
   bool filter_even_count;
 };
@@ -49,6 +93,12 @@ struct OptionsList
 //! Global instance of command line options
 static OptionsList options;
 
+//! Maximum number of accepted records buffered before writing
+const std::size_t batch_size = 4096;
+
+//! Hash values of kept records and the record numbers having them
+typedef unordered_map<uint64_t, vector<std::size_t>> SeenRecords;
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Print usage information
@@ -64,6 +114,14 @@ void usage()
        << "   -o\tKeep only odd numbered egdes (coastlines etc)" << endl
        << "   -f [name=value]\tKeep only elements with required field value" << endl
        << "   -b [x1,y1,x2,y2]\tBounding box for elements to be kept" << endl
+       << "   -c\tClip the elements to the bounding box" << endl
+       << "   -d\tRemove elements with equal geometry" << endl
+       << "   -q [quantum]\tWith -d compare coordinates rounded to the quantum (default 0: exact)"
+       << endl
+       << "   -a\tWith -d require also the attributes to be equal" << endl
+       << endl
+       << "The -f, -b and -d options may be used together." << endl
+       << "The input may also be a shape cache (.shpc)." << endl
        << endl;
 }
 
@@ -78,6 +136,10 @@ void parse_command_line(int argc, const char *argv[])
   // Establish the defaults
 
   options.verbose = false;
+  options.clip = false;
+  options.dedup = false;
+  options.dedup_attributes = false;
+  options.dedup_quantum = 0;
   options.input_shape = "";
   options.output_shape = "";
   options.filter_boundingbox = "";
@@ -87,7 +149,7 @@ void parse_command_line(int argc, const char *argv[])
 
   // Parse
 
-  NFmiCmdLine cmdline(argc, argv, "oehvf!b!");
+  NFmiCmdLine cmdline(argc, argv, "oehvcdaf!b!q!");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -104,37 +166,60 @@ void parse_command_line(int argc, const char *argv[])
   options.input_shape = cmdline.Parameter(1);
   options.output_shape = cmdline.Parameter(2);
 
-  unsigned int filtercount = 0;
+  unsigned int edgefilters = 0;
 
   if (cmdline.isOption('v'))
     options.verbose = true;
 
   if (cmdline.isOption('o'))
   {
-    ++filtercount;
+    ++edgefilters;
     options.filter_odd_count = true;
   }
 
   if (cmdline.isOption('e'))
   {
-    ++filtercount;
+    ++edgefilters;
     options.filter_even_count = true;
   }
 
   if (cmdline.isOption('f'))
-  {
-    ++filtercount;
     options.filter_field = cmdline.OptionValue('f');
-  }
 
   if (cmdline.isOption('b'))
-  {
-    ++filtercount;
     options.filter_boundingbox = cmdline.OptionValue('b');
+
+  if (cmdline.isOption('c'))
+  {
+    if (options.filter_boundingbox.empty())
+      throw runtime_error("Option -c requires a bounding box given with -b");
+    options.clip = true;
   }
 
-  if (filtercount > 1)
-    throw runtime_error("Only one filtering method allowed at a time");
+  if (cmdline.isOption('d'))
+    options.dedup = true;
+
+  if (cmdline.isOption('a'))
+  {
+    if (!options.dedup)
+      throw runtime_error("Option -a requires option -d");
+    options.dedup_attributes = true;
+  }
+
+  if (cmdline.isOption('q'))
+  {
+    if (!options.dedup)
+      throw runtime_error("Option -q requires option -d");
+    options.dedup_quantum = NFmiStringTools::Convert<double>(cmdline.OptionValue('q'));
+    if (options.dedup_quantum < 0)
+      throw runtime_error("The quantum must not be negative");
+  }
+
+  const bool recordfilters =
+      (!options.filter_field.empty() || !options.filter_boundingbox.empty() || options.dedup);
+
+  if (edgefilters > 1 || (edgefilters > 0 && recordfilters))
+    throw runtime_error("Edge counting cannot be combined with other filtering methods");
 
   if (options.input_shape == options.output_shape)
     throw runtime_error("Input and output names are equal");
@@ -142,23 +227,59 @@ void parse_command_line(int argc, const char *argv[])
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Count the edges in the given shape
+ * \brief Collect the segments of the parts of a polyline or polygon
  */
 // ----------------------------------------------------------------------
 
-void count_edges(const NFmiEsriShape &theShape, NFmiCounter<NFmiEdge> &theCounts)
+template <typename T>
+void collect_segments(const T &theElement, EdgeCounter::Buffer &theBuffer)
 {
-  if (options.verbose)
-    cout << "Counting edges in shape..." << endl;
+  for (int part = 0; part < theElement.NumParts(); part++)
+  {
+    int i1, i2;
+    i1 = theElement.Parts()[part];  // start of part
+    if (part + 1 == theElement.NumParts())
+      i2 = theElement.NumPoints() - 1;  // end of part
+    else
+      i2 = theElement.Parts()[part + 1] - 1;  // end of part
+
+    if (i2 >= i1)
+    {
+      double x1 = theElement.Points()[i1].X();
+      double y1 = theElement.Points()[i1].Y();
 
-  NFmiEsriShape::const_iterator it = theShape.Elements().begin();
+      for (int i = i1 + 1; i <= i2; i++)
+      {
+        double x2 = theElement.Points()[i].X();
+        double y2 = theElement.Points()[i].Y();
+        theBuffer.add(x1, y1, x2, y2);
+        x1 = x2;
+        y1 = y2;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect the segments of a range of elements
+ */
+// ----------------------------------------------------------------------
 
-  for (; it != theShape.Elements().end(); ++it)
+void collect_elements(const NFmiEsriShape &theShape,
+                      std::size_t theBegin,
+                      std::size_t theEnd,
+                      EdgeCounter::Buffer &theBuffer)
+{
+  const NFmiEsriShape::elements_type &elements = theShape.Elements();
+
+  for (std::size_t i = theBegin; i < theEnd; i++)
   {
-    if (*it == nullptr)
+    const NFmiEsriElement *elem = elements[i];
+    if (elem == nullptr)
       continue;
 
-    switch ((*it)->Type())
+    switch (elem->Type())
     {
       case kFmiEsriNull:
       case kFmiEsriPoint:
@@ -172,69 +293,51 @@ void count_edges(const NFmiEsriShape &theShape, NFmiCounter<NFmiEdge> &theCounts
       case kFmiEsriPolyLine:
       case kFmiEsriPolyLineM:
       case kFmiEsriPolyLineZ:
-      {
-        const NFmiEsriPolyLine *elem = static_cast<const NFmiEsriPolyLine *>(*it);
-        for (int part = 0; part < elem->NumParts(); part++)
-        {
-          int i1, i2;
-          i1 = elem->Parts()[part];  // start of part
-          if (part + 1 == elem->NumParts())
-            i2 = elem->NumPoints() - 1;  // end of part
-          else
-            i2 = elem->Parts()[part + 1] - 1;  // end of part
-
-          if (i2 >= i1)
-          {
-            double x1 = elem->Points()[i1].X();
-            double y1 = elem->Points()[i1].Y();
-
-            for (int i = i1 + 1; i <= i2; i++)
-            {
-              double x2 = elem->Points()[i].X();
-              double y2 = elem->Points()[i].Y();
-              theCounts.Add(NFmiEdge(x1, y1, x2, y2, true, false));
-              x1 = x2;
-              y1 = y2;
-            }
-          }
-        }
+        collect_segments(*static_cast<const NFmiEsriPolyLine *>(elem), theBuffer);
         break;
-      }
       case kFmiEsriPolygon:
       case kFmiEsriPolygonM:
       case kFmiEsriPolygonZ:
-      {
-        const NFmiEsriPolygon *elem = static_cast<const NFmiEsriPolygon *>(*it);
-        for (int part = 0; part < elem->NumParts(); part++)
-        {
-          int i1, i2;
-          i1 = elem->Parts()[part];  // start of part
-          if (part + 1 == elem->NumParts())
-            i2 = elem->NumPoints() - 1;  // end of part
-          else
-            i2 = elem->Parts()[part + 1] - 1;  // end of part
-
-          if (i2 >= i1)
-          {
-            double x1 = elem->Points()[i1].X();
-            double y1 = elem->Points()[i1].Y();
-
-            for (int i = i1 + 1; i <= i2; i++)
-            {
-              double x2 = elem->Points()[i].X();
-              double y2 = elem->Points()[i].Y();
-              theCounts.Add(NFmiEdge(x1, y1, x2, y2, true, false));
-              x1 = x2;
-              y1 = y2;
-            }
-          }
-        }
+        collect_segments(*static_cast<const NFmiEsriPolygon *>(elem), theBuffer);
         break;
-      }
     }
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count the edges in the given shape
+ *
+ * The elements are split into chunks whose segments are collected
+ * in parallel, after which the segments are counted in parallel
+ * by shards.
+ */
+// ----------------------------------------------------------------------
+
+vector<EdgeCounter::Count> count_edges(const NFmiEsriShape &theShape)
+{
+  if (options.verbose)
+    cout << "Counting edges in shape..." << endl;
+
+  const std::size_t n = theShape.Elements().size();
+  const std::size_t nthreads =
+      max<std::size_t>(1, min<std::size_t>(thread::hardware_concurrency(), n));
+  const std::size_t chunk = (n + nthreads - 1) / nthreads;
+
+  vector<EdgeCounter::Buffer> buffers(nthreads);
+  vector<thread> threads;
+  for (std::size_t t = 0; t < nthreads; t++)
+    threads.push_back(thread(collect_elements,
+                             std::cref(theShape),
+                             min(n, t * chunk),
+                             min(n, (t + 1) * chunk),
+                             std::ref(buffers[t])));
+  for (std::size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  return EdgeCounter::count(buffers);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Insert the given path into the given shape as polylines
@@ -317,16 +420,15 @@ const NFmiEsriShape *filter_even_count(const NFmiEsriShape &theShape)
 
   // Count the edges
 
-  NFmiCounter<NFmiEdge> counts;
-  count_edges(theShape, counts);
+  const vector<EdgeCounter::Count> counts = count_edges(theShape);
 
   // Build a path from even numbered edges
 
   NFmiEdgeTree tree;
-  for (NFmiCounter<NFmiEdge>::const_iterator it = counts.begin(); it != counts.end(); ++it)
+  for (vector<EdgeCounter::Count>::const_iterator it = counts.begin(); it != counts.end(); ++it)
   {
     if (it->second % 2 == 0)
-      tree.Add(it->first);
+      tree.Add(NFmiEdge(it->first.x1, it->first.y1, it->first.x2, it->first.y2, true, false));
   }
 
   if (options.verbose)
@@ -354,16 +456,15 @@ const NFmiEsriShape *filter_odd_count(const NFmiEsriShape &theShape)
 
   // Count the edges
 
-  NFmiCounter<NFmiEdge> counts;
-  count_edges(theShape, counts);
+  const vector<EdgeCounter::Count> counts = count_edges(theShape);
 
   // Build a path from odd numbered edges
 
   NFmiEdgeTree tree;
-  for (NFmiCounter<NFmiEdge>::const_iterator it = counts.begin(); it != counts.end(); ++it)
+  for (vector<EdgeCounter::Count>::const_iterator it = counts.begin(); it != counts.end(); ++it)
   {
     if (it->second % 2 != 0)
-      tree.Add(it->first);
+      tree.Add(NFmiEdge(it->first.x1, it->first.y1, it->first.x2, it->first.y2, true, false));
   }
 
   if (options.verbose)
@@ -387,108 +488,419 @@ const NFmiEsriShape *filter_odd_count(const NFmiEsriShape &theShape)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Filter the shape based on a field value
+ * \brief Parse and validate the bounding box option
  */
 // ----------------------------------------------------------------------
 
-const NFmiEsriShape *filter_field(const NFmiEsriShape &theShape)
+ShpFile::Box parse_boundingbox()
 {
-  if (options.verbose)
-    cout << "Filtering based on field value..." << endl;
+  const vector<double> values = NFmiStringTools::Split<vector<double>>(options.filter_boundingbox);
+  if (values.size() != 4)
+    throw runtime_error("Bounding box must consist of 4 values");
+
+  ShpFile::Box box;
+  box.xmin = values[0];
+  box.ymin = values[1];
+  box.xmax = values[2];
+  box.ymax = values[3];
 
-  return NFmiEsriTools::filter(theShape, options.filter_field);
+  // Check bounding box validity
+
+  if (box.xmin >= box.xmax || box.ymin >= box.ymax)
+    throw runtime_error("Bounding box is empty");
+
+  if (box.xmin < -180 || box.xmin > 180 || box.xmax < -180 || box.xmax > 180 || box.ymin < -90 ||
+      box.ymin > 90 || box.ymax < -90 || box.ymax > 90)
+    throw runtime_error("The bounding box exceeds geographic coordinate limits");
+
+  return box;
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Filter the shape based on a bounding box
+ * \brief Test whether a .dbf field value equals the desired value
+ *
+ * Numeric fields are compared numerically so that the padding and
+ * number formatting in the file do not matter, other fields are
+ * compared as trimmed strings.
  */
 // ----------------------------------------------------------------------
 
-const NFmiEsriShape *filter_boundingbox(const NFmiEsriShape &theShape)
+bool field_matches(const char *theRow, const ShpFile::DbfField &theField, const string &theValue)
 {
-  if (options.verbose)
-    cout << "Filtering based on bounding box..." << endl;
+  const string value = ShpFile::dbfValue(theRow, theField);
 
-  // Parse the bounding box
+  if (theField.type == 'N' || theField.type == 'F')
+  {
+    char *end1;
+    char *end2;
+    const double value1 = strtod(value.c_str(), &end1);
+    const double value2 = strtod(theValue.c_str(), &end2);
+    if (!value.empty() && !theValue.empty() && *end1 == '\0' && *end2 == '\0')
+      return (value1 == value2);
+  }
 
-  const vector<double> values = NFmiStringTools::Split<vector<double>>(options.filter_boundingbox);
-  if (values.size() != 4)
-    throw runtime_error("Bounding box must consist of 4 values");
+  return (value == theValue);
+}
 
-  const double x1 = values[0];
-  const double y1 = values[1];
-  const double x2 = values[2];
-  const double y2 = values[3];
+// ----------------------------------------------------------------------
+/*!
+ * \brief Call the function for indices 0...n-1 in parallel
+ */
+// ----------------------------------------------------------------------
 
-  // Check bounding box validity
+template <typename F>
+void parallel_for(std::size_t theCount, F theFunction)
+{
+  const std::size_t nthreads =
+      max<std::size_t>(1, min<std::size_t>(thread::hardware_concurrency(), theCount));
 
-  if (x1 >= x2 || y1 >= y2)
-    throw runtime_error("Bounding box is empty");
+  atomic<std::size_t> next_index(0);
 
-  if (x1 < -180 || x1 > 180 || x2 < -180 || x2 > 180 || y1 < -90 || y1 > 90 || y2 < -90 || y2 > 90)
-    throw runtime_error("The bounding box exceeds geographic coordinate limits");
+  const auto worker = [&]()
+  {
+    while (true)
+    {
+      const std::size_t i = next_index++;
+      if (i >= theCount)
+        break;
+      theFunction(i);
+    }
+  };
+
+  vector<thread> threads;
+  for (std::size_t t = 1; t < nthreads; t++)
+    threads.push_back(thread(worker));
+  worker();
+  for (std::size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+}
 
-  // Start the result shape
+// ----------------------------------------------------------------------
+/*!
+ * \brief The records and attribute rows of a shapefile or a shape cache
+ *
+ * The records and rows of a shapefile are views to the mapped files,
+ * those of a cache are reassembled into the given buffers. Each
+ * thread must hence use buffers of its own.
+ */
+// ----------------------------------------------------------------------
 
-  NFmiEsriShape *shape = new NFmiEsriShape(theShape.Type());
+class Input
+{
+ public:
+  Input(const string &theName)
+  {
+    if (ShapeCache::isCache(theName))
+      itsCache.reset(new ShapeCache::Reader(theName));
+    else
+    {
+      itsReader.reset(new ShpFile::MappedReader(theName));
+      itsDbf.reset(new ShpFile::MappedDbf(theName));
+      if (itsDbf->size() != itsReader->size())
+        throw runtime_error("The number of records in the .shp and .dbf files of '" + theName +
+                            "' differ");
+    }
+  }
 
-  // Copy the attribute type information
-  for (NFmiEsriShape::attributes_type::const_iterator ait = theShape.Attributes().begin();
-       ait != theShape.Attributes().end();
-       ++ait)
+  std::size_t size() const { return itsCache ? itsCache->size() : itsReader->size(); }
+  int shapeType() const { return itsCache ? itsCache->shapeType() : itsReader->shapeType(); }
+  string header() const { return itsCache ? itsCache->header() : itsReader->header(); }
+  string dbfHeader() const { return itsCache ? itsCache->dbfHeader() : itsDbf->header(); }
+
+  const vector<ShpFile::DbfField> &fields() const
+  {
+    return itsCache ? itsCache->fields() : itsDbf->fields();
+  }
+
+  int field(const string &theName) const
   {
-    shape->Add(new NFmiEsriAttributeName(**ait));
+    return itsCache ? itsCache->field(theName) : itsDbf->field(theName);
   }
 
-  // Copy the elements which overlap the bounding box
+  std::size_t rowLength() const { return itsCache ? itsCache->rowLength() : itsDbf->rowLength(); }
 
-  for (NFmiEsriShape::const_iterator it = theShape.Elements().begin();
-       it != theShape.Elements().end();
-       ++it)
+  int type(std::size_t theRecord) const
   {
-    // Skip empty elements
-    if (*it == 0)
-      continue;
+    return itsCache ? itsCache->type(theRecord) : itsReader->record(theRecord).type();
+  }
+
+  ShpFile::Box box(std::size_t theRecord) const
+  {
+    return itsCache ? itsCache->box(theRecord) : itsReader->record(theRecord).box();
+  }
+
+  // Returns false if there is no spatial index to query
+
+  bool query(const ShpFile::Box &theBox, vector<std::size_t> &theRecords) const
+  {
+    if (!itsCache)
+      return false;
+    itsCache->query(theBox, theRecords);
+    sort(theRecords.begin(), theRecords.end());
+    return true;
+  }
+
+  ShpFile::Record record(std::size_t theRecord, string &theBuffer) const
+  {
+    if (!itsCache)
+      return itsReader->record(theRecord);
+    theBuffer = itsCache->contents(theRecord);
+    return ShpFile::Record(theBuffer.data(), theBuffer.size());
+  }
+
+  const char *row(std::size_t theRow, string &theBuffer) const
+  {
+    if (!itsCache)
+      return itsDbf->row(theRow);
+    itsCache->row(theRow, theBuffer);
+    return theBuffer.data();
+  }
+
+ private:
+  Input();
+  Input(const Input &theInput);
+  Input &operator=(const Input &theInput);
+
+  unique_ptr<ShpFile::MappedReader> itsReader;
+  unique_ptr<ShpFile::MappedDbf> itsDbf;
+  unique_ptr<ShapeCache::Reader> itsCache;
+
+};  // class Input
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Clip a batch of records to the bounding box in parallel
+ *
+ * Records with nothing left inside the box become empty, records
+ * not to be kept are skipped.
+ */
+// ----------------------------------------------------------------------
 
-    // Establish bounding box of the element
-    NFmiEsriBox box;
-    (*it)->Update(box);
+void clip_batch(const Input &theInput,
+                const vector<std::size_t> &theBatch,
+                const vector<char> &theKeep,
+                const ShpFile::Box &theBox,
+                vector<string> &theClipped)
+{
+  theClipped.assign(theBatch.size(), string());
+  parallel_for(theBatch.size(),
+               [&](std::size_t i)
+               {
+                 string buffer;
+                 if (theKeep[i])
+                   theClipped[i] = Clipping::clip(theInput.record(theBatch[i], buffer), theBox);
+               });
+}
 
-    // Establish whether element is outside the desired box
-    bool outside = false;
-    outside |= (box.Xmin() > x2);
-    outside |= (box.Xmax() < x1);
-    outside |= (box.Ymin() > y2);
-    outside |= (box.Ymax() < y1);
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mark the records of a batch which duplicate earlier ones
+ *
+ * The canonical geometries are computed in parallel. Each record is
+ * then compared in order with the kept records having the same hash
+ * value.
+ *
+ * \return The number of duplicates found
+ */
+// ----------------------------------------------------------------------
 
-    // If elements overlaps bbox, add it to the result
-    if (!outside)
+std::size_t dedup_batch(const Input &theInput,
+                        const vector<std::size_t> &theBatch,
+                        vector<char> &theKeep,
+                        SeenRecords &theSeen)
+{
+  vector<GeometryHash::Canonical> canonicals(theBatch.size());
+  vector<uint64_t> hashes(theBatch.size());
+
+  parallel_for(theBatch.size(),
+               [&](std::size_t i)
+               {
+                 string buffer;
+                 canonicals[i] = GeometryHash::canonical(theInput.record(theBatch[i], buffer),
+                                                         options.dedup_quantum);
+                 hashes[i] = GeometryHash::hash(canonicals[i]);
+               });
+
+  // The deletion flags are not compared
+  const std::size_t rowlength = theInput.rowLength() - 1;
+
+  std::size_t duplicates = 0;
+  string buffer1;
+  string buffer2;
+
+  for (std::size_t i = 0; i < theBatch.size(); i++)
+  {
+    vector<std::size_t> &candidates = theSeen[hashes[i]];
+
+    bool duplicate = false;
+    for (std::size_t j = 0; j < candidates.size() && !duplicate; j++)
+    {
+      if (options.dedup_attributes && memcmp(theInput.row(candidates[j], buffer1) + 1,
+                                             theInput.row(theBatch[i], buffer2) + 1,
+                                             rowlength) != 0)
+        continue;
+
+      duplicate = (GeometryHash::canonical(theInput.record(candidates[j], buffer1),
+                                           options.dedup_quantum) == canonicals[i]);
+    }
+
+    if (duplicate)
     {
-      NFmiEsriElement *tmp = (*it)->Clone();
-      shape->Add(tmp);
+      theKeep[i] = false;
+      ++duplicates;
     }
+    else
+      candidates.push_back(theBatch[i]);
   }
 
-  return shape;
+  return duplicates;
 }
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Filter the shape
+ * \brief Filter records and attributes one at a time
+ *
+ * The input files are memory mapped, and records and attribute rows
+ * are accessed as views to the mapped bytes. The bounding box test
+ * touches only the box at the start of each record, the rest of the
+ * record and its attribute row are accessed only for records which
+ * pass it. Accepted records and rows are copied verbatim to the
+ * output, hence the memory use does not depend on the size of the
+ * shapefile. Null records are dropped.
+ *
+ * For a shape cache only the elements found from the R-tree are
+ * tested against the bounding box.
+ *
+ * The accepted records are collected into batches of limited size,
+ * so that they can be deduplicated and clipped in parallel when
+ * requested.
+ */
+// ----------------------------------------------------------------------
+
+void filter_stream()
+{
+  if (options.verbose)
+    cout << "Filtering records of '" + options.input_shape + "'" << endl;
+
+  const bool usebox = !options.filter_boundingbox.empty();
+  const bool usefield = !options.filter_field.empty();
+
+  ShpFile::Box bbox;
+  if (usebox)
+    bbox = parse_boundingbox();
+
+  const Input input(options.input_shape);
+
+  // Resolve the field once instead of for every record
+
+  int field = -1;
+  string value;
+  if (usefield)
+  {
+    const string::size_type pos = options.filter_field.find('=');
+    if (pos == string::npos)
+      throw runtime_error("Field filter must be of the form name=value");
+    const string name = options.filter_field.substr(0, pos);
+    value = options.filter_field.substr(pos + 1);
+    field = input.field(name);
+    if (field < 0)
+      throw runtime_error("Field '" + name + "' does not exist in '" + options.input_shape + "'");
+  }
+
+  // Clipping drops Z and M values
+
+  string header = input.header();
+  if (options.clip)
+    ShpFile::putLittleInt(&header[32], Clipping::clippedType(input.shapeType()));
+
+  ShpFile::Writer writer(options.output_shape, header);
+  ShpFile::DbfWriter dbfwriter(options.output_shape, input.dbfHeader());
+
+  vector<std::size_t> batch;
+  vector<char> keep;
+  vector<string> clipped;
+  SeenRecords seen;
+  std::size_t duplicates = 0;
+  string recordbuffer;
+  string rowbuffer;
+
+  const auto flush = [&]()
+  {
+    keep.assign(batch.size(), true);
+    if (options.dedup)
+      duplicates += dedup_batch(input, batch, keep, seen);
+    if (options.clip)
+      clip_batch(input, batch, keep, bbox, clipped);
+
+    for (std::size_t j = 0; j < batch.size(); j++)
+    {
+      if (!keep[j])
+        continue;
+      if (options.clip)
+      {
+        if (clipped[j].empty())
+          continue;
+        writer.write(clipped[j]);
+      }
+      else
+      {
+        const ShpFile::Record record = input.record(batch[j], recordbuffer);
+        writer.write(record.data(), record.size());
+      }
+      dbfwriter.write(input.row(batch[j], rowbuffer));
+    }
+    batch.clear();
+  };
+
+  // The candidates from a spatial index, if there is one
+
+  vector<std::size_t> candidates;
+  const bool indexed = (usebox && input.query(bbox, candidates));
+  const std::size_t count = (indexed ? candidates.size() : input.size());
+
+  for (std::size_t k = 0; k < count; k++)
+  {
+    const std::size_t i = (indexed ? candidates[k] : k);
+
+    if (input.type(i) == 0)
+      continue;
+
+    if (usebox && !input.box(i).overlaps(bbox))
+      continue;
+
+    if (usefield && !field_matches(input.row(i, rowbuffer), input.fields()[field], value))
+      continue;
+
+    batch.push_back(i);
+    if (batch.size() >= batch_size)
+      flush();
+  }
+  flush();
+
+  writer.close();
+  dbfwriter.close();
+
+  if (options.verbose)
+  {
+    if (options.dedup)
+      cout << "Removed " << duplicates << " duplicate records" << endl;
+    cout << "Kept " << writer.size() << " of " << input.size() << " records" << endl;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Filter the shape based on edge counts
  */
 // ----------------------------------------------------------------------
 
 const NFmiEsriShape *filter_shape(const NFmiEsriShape &theShape)
 {
-  if (!options.filter_field.empty())
-    return filter_field(theShape);
   if (options.filter_even_count)
     return filter_even_count(theShape);
   if (options.filter_odd_count)
     return filter_odd_count(theShape);
-  if (!options.filter_boundingbox.empty())
-    return filter_boundingbox(theShape);
 
   return &theShape;
 }
@@ -509,14 +921,21 @@ int domain(int argc, const char *argv[])
 
   parse_command_line(argc, argv);
 
+  // Record filters do not need the full shape in memory
+
+  if (!options.filter_even_count && !options.filter_odd_count)
+  {
+    filter_stream();
+    return 0;
+  }
+
   // Read the shapefile
 
   if (options.verbose)
     cout << "Reading input shapefile '" + options.input_shape + "'" << endl;
 
-  NFmiEsriShape inputshape;
-  if (!inputshape.Read(options.input_shape, true))
-    throw runtime_error("Failed to read shape '" + options.input_shape + "'");
+  const unique_ptr<NFmiEsriShape> inputptr = ShapeLoader::read(options.input_shape, true);
+  const NFmiEsriShape &inputshape = *inputptr;
 
   // Process the shapefile
 
@@ -15,14 +15,26 @@
  * The program was originally created for finding the road closest
  * to the given coordinate.
  *
+ * A .shpc shape cache made with shapecache can be given instead of
+ * a shapefile. Enclosing polygons are then searched with the R-tree
+ * of the cache.
+ *
+ * FlatGeobuf (.fgb) and GeoPackage (.gpkg) files are read through OGR.
+ * The search is then pushed down to OGR: only the features within the
+ * bounding box of the search radius, or containing the point in case
+ * of polygons, and satisfying the search condition are read. With a
+ * spatially indexed file the rest of the data is never decoded.
+ *
  */
 // ======================================================================
 
+#include "AttributeTable.h"
+#include "EsriView.h"
+#include "OgrReader.h"
+#include "ShapeCache.h"
+#include "ShpFile.h"
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
-#include <imagine/NFmiEsriPoint.h>
-#include <imagine/NFmiEsriPolyLine.h>
-#include <imagine/NFmiEsriPolygon.h>
 #include <imagine/NFmiEsriShape.h>
 #include <newbase/NFmiArea.h>
 #include <newbase/NFmiAreaFactory.h>
@@ -270,66 +282,99 @@ void parse_condition(string &theVariable, string &theComparison, string &theValu
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Test the search condition
+ * \brief A search condition with the attribute column resolved
  */
 // ----------------------------------------------------------------------
 
-bool condition_satisfied(const NFmiEsriElement &theElement,
-                         const std::string &theVariable,
-                         const std::string &theComparison,
-                         const std::string &theValue)
+struct Condition
 {
-  if (theComparison.empty())
+  int column;         //!< attribute column, -1 if there is no condition
+  string comparison;  //!< the comparison operator
+  string value;       //!< the value to compare with
+  double number;      //!< the value for numeric attributes
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the search condition and resolve its attribute column
+ */
+// ----------------------------------------------------------------------
+
+Condition resolve_condition(const AttributeTable &theTable)
+{
+  Condition cond;
+  cond.column = -1;
+  cond.number = 0;
+
+  string variable;
+  parse_condition(variable, cond.comparison, cond.value);
+
+  if (cond.comparison.empty())
+    return cond;
+
+  cond.column = theTable.requireColumn(variable);
+
+  const NFmiEsriAttributeType atype = theTable.type(cond.column);
+  if (atype == kFmiEsriInteger || atype == kFmiEsriDouble)
+    cond.number = boost::lexical_cast<double>(cond.value);
+
+  return cond;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compare two values with the given comparison operator
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+bool compare(const T &theLeft, const string &theComparison, const T &theRight)
+{
+  if (theComparison == "=" || theComparison == "==")
+    return (theLeft == theRight);
+  else if (theComparison == "<>")
+    return (theLeft != theRight);
+  else if (theComparison == "<")
+    return (theLeft < theRight);
+  else if (theComparison == ">")
+    return (theLeft > theRight);
+  else if (theComparison == "<=")
+    return (theLeft <= theRight);
+  else if (theComparison == ">=")
+    return (theLeft >= theRight);
+
+  // Should never reach this point
+  assert(false);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test the search condition for the given element
+ */
+// ----------------------------------------------------------------------
+
+bool condition_satisfied(AttributeTable &theTable,
+                         const Condition &theCondition,
+                         std::size_t theRow)
+{
+  if (theCondition.column < 0)
     return true;
 
-  NFmiEsriAttributeType atype = theElement.GetType(theVariable);
+  const int col = theCondition.column;
 
-  if (atype == kFmiEsriString)
-  {
-    if (theComparison == "=" || theComparison == "==")
-      return (theElement.GetString(theVariable) == theValue);
-    else if (theComparison == "<>")
-      return (theElement.GetString(theVariable) != theValue);
-    else if (theComparison == "<")
-      return (theElement.GetString(theVariable) < theValue);
-    else if (theComparison == ">")
-      return (theElement.GetString(theVariable) > theValue);
-    else if (theComparison == "<=")
-      return (theElement.GetString(theVariable) <= theValue);
-    else if (theComparison == ">=")
-      return (theElement.GetString(theVariable) >= theValue);
-  }
-  else if (atype == kFmiEsriInteger)
+  switch (theTable.type(col))
   {
-    double value = boost::lexical_cast<double>(theValue);
-    if (theComparison == "=" || theComparison == "==")
-      return (theElement.GetInteger(theVariable) == value);
-    else if (theComparison == "<>")
-      return (theElement.GetInteger(theVariable) != value);
-    else if (theComparison == "<")
-      return (theElement.GetInteger(theVariable) < value);
-    else if (theComparison == ">")
-      return (theElement.GetInteger(theVariable) > value);
-    else if (theComparison == "<=")
-      return (theElement.GetInteger(theVariable) <= value);
-    else if (theComparison == ">=")
-      return (theElement.GetInteger(theVariable) >= value);
-  }
-  else if (atype == kFmiEsriDouble)
-  {
-    double value = boost::lexical_cast<double>(theValue);
-    if (theComparison == "=" || theComparison == "==")
-      return (theElement.GetDouble(theVariable) == value);
-    else if (theComparison == "<>")
-      return (theElement.GetDouble(theVariable) != value);
-    else if (theComparison == "<")
-      return (theElement.GetDouble(theVariable) < value);
-    else if (theComparison == ">")
-      return (theElement.GetDouble(theVariable) > value);
-    else if (theComparison == "<=")
-      return (theElement.GetDouble(theVariable) <= value);
-    else if (theComparison == ">=")
-      return (theElement.GetDouble(theVariable) >= value);
+    case kFmiEsriString:
+      return compare(theTable.strings(col)[theRow], theCondition.comparison, theCondition.value);
+    case kFmiEsriInteger:
+      return compare(static_cast<double>(theTable.integers(col)[theRow]),
+                     theCondition.comparison,
+                     theCondition.number);
+    case kFmiEsriDouble:
+      return compare(theTable.doubles(col)[theRow], theCondition.comparison, theCondition.number);
+    case kFmiEsriDate:
+      break;
   }
 
   // Should never reach this point
@@ -357,11 +402,9 @@ void establish_projection()
  */
 // ----------------------------------------------------------------------
 
-void establish_attribute(const NFmiEsriShape &theShape)
+void establish_attribute(const AttributeTable &theTable)
 {
-  const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
-
-  if (attributes.size() == 0)
+  if (theTable.columns() == 0)
     throw runtime_error("shapefile does not contain any attributes");
 
   // If no attribute option was given, we accept it as long as
@@ -369,23 +412,20 @@ void establish_attribute(const NFmiEsriShape &theShape)
 
   if (options.attributes.empty())
   {
-    if (attributes.size() > 1)
+    if (theTable.columns() > 1)
     {
       ostringstream out;
       out << "shapefile contains multiple attributes, choose one: ";
-      int pos = 0;
-      for (NFmiEsriShape::attributes_type::const_iterator at = attributes.begin();
-           at != attributes.end();
-           ++at, ++pos)
+      for (size_t pos = 0; pos < theTable.columns(); ++pos)
       {
         if (pos > 0)
           out << ",";
-        out << (*at)->Name();
+        out << theTable.name(pos);
       }
 
       throw runtime_error(out.str());
     }
-    options.attributes = (*attributes.begin())->Name();
+    options.attributes = theTable.name(0);
   }
 }
 
@@ -395,22 +435,19 @@ void establish_attribute(const NFmiEsriShape &theShape)
  */
 // ----------------------------------------------------------------------
 
-NFmiEsriElementType establish_type(const NFmiEsriShape &theShape)
+template <typename Reader>
+NFmiEsriElementType establish_type(const Reader &theReader)
 {
-  if (theShape.Elements().size() == 0)
+  if (theReader.size() == 0)
     throw runtime_error("The shape is empty!");
 
   NFmiEsriElementType type = kFmiEsriNull;
   bool found_one = false;
   bool multiple_types = false;
 
-  NFmiEsriShape::const_iterator it = theShape.Elements().begin();
-  for (; it != theShape.Elements().end(); ++it)
+  for (size_t i = 0; i < theReader.size(); i++)
   {
-    if (*it == nullptr)
-      continue;
-
-    switch ((*it)->Type())
+    switch (theReader.record(i).type())
     {
       case kFmiEsriNull:
         break;
@@ -589,22 +626,17 @@ float world_line_distance(
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Establish the attribute type of the given attribute
+ * \brief Resolve the columns of the attributes to be printed
  */
 // ----------------------------------------------------------------------
 
-NFmiEsriAttributeType establish_attribute_type(const NFmiEsriShape &theShape, const string &theName)
+vector<int> attribute_columns(const AttributeTable &theTable)
 {
-  const Imagine::NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
-
-  for (Imagine::NFmiEsriShape::attributes_type::const_iterator ait = attributes.begin();
-       ait != attributes.end();
-       ++ait)
-  {
-    if ((*ait)->Name() == theName)
-      return (*ait)->Type();
-  }
-  throw runtime_error("No attribute named '" + theName + "' in the shape");
+  vector<int> columns;
+  const vector<string> attribs = NFmiStringTools::Split(options.attributes, ",");
+  for (unsigned int i = 0; i < attribs.size(); i++)
+    columns.push_back(theTable.requireColumn(attribs[i]));
+  return columns;
 }
 
 // ----------------------------------------------------------------------
@@ -613,28 +645,27 @@ NFmiEsriAttributeType establish_attribute_type(const NFmiEsriShape &theShape, co
  */
 // ----------------------------------------------------------------------
 
-void print_attributes(const NFmiEsriElement &theElement)
+void print_attributes(AttributeTable &theTable, const vector<int> &theColumns, std::size_t theRow)
 {
-  vector<string> attribs = NFmiStringTools::Split(options.attributes, ",");
-
-  for (unsigned int i = 0; i < attribs.size(); i++)
+  for (unsigned int i = 0; i < theColumns.size(); i++)
   {
     if (i > 0)
       cout << options.delimiter;
 
-    switch (theElement.GetType(attribs[i]))
+    const int col = theColumns[i];
+    switch (theTable.type(col))
     {
       case kFmiEsriString:
-        cout << theElement.GetString(attribs[i]);
+        cout << theTable.strings(col)[theRow];
         break;
       case kFmiEsriInteger:
-        cout << theElement.GetInteger(attribs[i]);
+        cout << theTable.integers(col)[theRow];
         break;
       case kFmiEsriDouble:
-        cout << theElement.GetDouble(attribs[i]);
+        cout << theTable.doubles(col)[theRow];
         break;
       case kFmiEsriDate:
-        cout << theElement.GetDate(attribs[i]).ToStr(kYYYYMMDD);
+        cout << theTable.dates(col)[theRow].ToStr(kYYYYMMDD);
         break;
     }
   }
@@ -642,77 +673,53 @@ void print_attributes(const NFmiEsriElement &theElement)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Remove indices which would contain duplicates
+ * \brief Keep only the first element with each value of the given column
  */
 // ----------------------------------------------------------------------
 
-void filter_out_duplicates(const NFmiEsriShape &theShape, multimap<float, int> &theData)
+template <typename T>
+void filter_unique(const vector<T> &theValues, multimap<float, int> &theData)
 {
-  if (options.uniqueattribute.empty())
-    return;
-
   multimap<float, int> newdata;
+  set<T> unique_values;
 
-  set<string> unique_strings;
-  set<int> unique_ints;
-  set<double> unique_doubles;
-  set<NFmiMetTime> unique_dates;
+  for (multimap<float, int>::const_iterator it = theData.begin(); it != theData.end(); ++it)
+  {
+    if (unique_values.insert(theValues[it->second]).second)
+      newdata.insert(*it);
+  }
 
-  NFmiEsriAttributeType atype = establish_attribute_type(theShape, options.uniqueattribute);
+  theData.swap(newdata);
+}
 
-  const NFmiEsriShape::elements_type &elements = theShape.Elements();
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove indices which would contain duplicates
+ */
+// ----------------------------------------------------------------------
 
-  for (multimap<float, int>::const_iterator it = theData.begin(); it != theData.end(); ++it)
-  {
-    int pos = it->second;
-    const NFmiEsriElement *elem = static_cast<const NFmiEsriElement *>(elements[pos]);
+void filter_out_duplicates(AttributeTable &theTable, multimap<float, int> &theData)
+{
+  if (options.uniqueattribute.empty())
+    return;
 
-    switch (atype)
-    {
-      case kFmiEsriString:
-      {
-        string value = elem->GetString(options.uniqueattribute);
-        if (unique_strings.find(value) == unique_strings.end())
-        {
-          newdata.insert(*it);
-          unique_strings.insert(value);
-        }
-        break;
-      }
-      case kFmiEsriInteger:
-      {
-        int value = elem->GetInteger(options.uniqueattribute);
-        if (unique_ints.find(value) == unique_ints.end())
-        {
-          newdata.insert(*it);
-          unique_ints.insert(value);
-        }
-        break;
-      }
-      case kFmiEsriDouble:
-      {
-        double value = elem->GetDouble(options.uniqueattribute);
-        if (unique_doubles.find(value) == unique_doubles.end())
-        {
-          newdata.insert(*it);
-          unique_doubles.insert(value);
-        }
-        break;
-      }
-      case kFmiEsriDate:
-      {
-        NFmiMetTime value = elem->GetDate(options.uniqueattribute);
-        if (unique_dates.find(value) == unique_dates.end())
-        {
-          newdata.insert(*it);
-          unique_dates.insert(value);
-        }
-        break;
-      }
-    }
-  }
+  const int col = theTable.requireColumn(options.uniqueattribute);
 
-  theData = newdata;
+  switch (theTable.type(col))
+  {
+    case kFmiEsriString:
+      filter_unique(theTable.strings(col), theData);
+      break;
+    case kFmiEsriInteger:
+      filter_unique(theTable.integers(col), theData);
+      break;
+    case kFmiEsriDouble:
+      filter_unique(theTable.doubles(col), theData);
+      break;
+    case kFmiEsriDate:
+      filter_unique(theTable.dates(col), theData);
+      break;
+  }
 }
 
 // ----------------------------------------------------------------------
@@ -729,7 +736,9 @@ void filter_out_duplicates(const NFmiEsriShape &theShape, multimap<float, int> &
  */
 // ----------------------------------------------------------------------
 
-void find_nearest_points(const NFmiEsriShape &theShape,
+template <typename Reader>
+void find_nearest_points(const Reader &theReader,
+                         AttributeTable &theTable,
                          const NFmiPoint &theLatLon,
                          const std::string &theName = "")
 {
@@ -747,29 +756,27 @@ void find_nearest_points(const NFmiEsriShape &theShape,
 
   // Search conditions
 
-  string cond_variable, cond_comparison, cond_value;
-  parse_condition(cond_variable, cond_comparison, cond_value);
+  const Condition condition = resolve_condition(theTable);
+  const vector<int> columns = attribute_columns(theTable);
 
   // Sort nearest elements
 
-  const NFmiEsriShape::elements_type &elements = theShape.Elements();
-
-  for (NFmiEsriShape::elements_type::size_type i = 0; i < elements.size(); i++)
+  for (size_t i = 0; i < theReader.size(); i++)
   {
-    if (elements[i] == 0)  // null element?
-      continue;
+    const auto elem = theReader.record(i);
 
-    const NFmiEsriPoint *elem = static_cast<const NFmiEsriPoint *>(elements[i]);
+    if (elem.numPoints() == 0)  // null element?
+      continue;
 
     float dist;
     if (options.projection == "latlon")
-      dist = latlon_point_distance(elem->X(), elem->Y(), theLatLon.X(), theLatLon.Y());
+      dist = latlon_point_distance(elem.x(0), elem.y(0), theLatLon.X(), theLatLon.Y());
     else
-      dist = world_point_distance(elem->X(), elem->Y(), worldxy.X(), worldxy.Y());
+      dist = world_point_distance(elem.x(0), elem.y(0), worldxy.X(), worldxy.Y());
 
     if (dist <= options.searchradius)
     {
-      if (condition_satisfied(*elem, cond_variable, cond_comparison, cond_value))
+      if (condition_satisfied(theTable, condition, i))
       {
         distance_map.insert(DistanceMap::value_type(dist, i));
       }
@@ -779,7 +786,7 @@ void find_nearest_points(const NFmiEsriShape &theShape,
   // Print the results. Note that we print only the shortest distance for
   // each unique attribute, if so requested.
 
-  filter_out_duplicates(theShape, distance_map);
+  filter_out_duplicates(theTable, distance_map);
 
   // Print the results
 
@@ -790,10 +797,10 @@ void find_nearest_points(const NFmiEsriShape &theShape,
       break;
 
     int pos = it->second;
-    const NFmiEsriPoint *elem = static_cast<const NFmiEsriPoint *>(elements[pos]);
+    const auto elem = theReader.record(pos);
 
-    double x = elem->X();
-    double y = elem->Y();
+    double x = elem.x(0);
+    double y = elem.y(0);
 
     if (options.projection != "latlon")
     {
@@ -808,7 +815,7 @@ void find_nearest_points(const NFmiEsriShape &theShape,
     cout << ++num << options.delimiter << it->first << options.delimiter << x << options.delimiter
          << y << options.delimiter;
 
-    print_attributes(*elem);
+    print_attributes(theTable, columns, pos);
     cout << endl;
   }
 }
@@ -819,7 +826,9 @@ void find_nearest_points(const NFmiEsriShape &theShape,
  */
 // ----------------------------------------------------------------------
 
-void find_nearest_lines(const NFmiEsriShape &theShape,
+template <typename Reader>
+void find_nearest_lines(const Reader &theReader,
+                        AttributeTable &theTable,
                         const NFmiPoint &theLatLon,
                         const std::string &theName = "")
 {
@@ -837,30 +846,28 @@ void find_nearest_lines(const NFmiEsriShape &theShape,
 
   // Search conditions
 
-  string cond_variable, cond_comparison, cond_value;
-  parse_condition(cond_variable, cond_comparison, cond_value);
+  const Condition condition = resolve_condition(theTable);
+  const vector<int> columns = attribute_columns(theTable);
 
   // Sort nearest elements
 
-  const NFmiEsriShape::elements_type &elements = theShape.Elements();
-
-  for (NFmiEsriShape::elements_type::size_type i = 0; i < elements.size(); i++)
+  for (size_t i = 0; i < theReader.size(); i++)
   {
-    if (elements[i] == 0)  // null element?
-      continue;
+    const auto elem = theReader.record(i);
 
-    const NFmiEsriPolyLine *elem = static_cast<const NFmiEsriPolyLine *>(elements[i]);
+    if (elem.type() == kFmiEsriNull)  // null element?
+      continue;
 
     float mindist = -1;
 
-    for (int part = 0; part < elem->NumParts(); part++)
+    for (int part = 0; part < elem.numParts(); part++)
     {
       int i1, i2;
-      i1 = elem->Parts()[part];  // start of part
-      if (part + 1 == elem->NumParts())
-        i2 = elem->NumPoints() - 1;  // end of part
+      i1 = elem.part(part);  // start of part
+      if (part + 1 == elem.numParts())
+        i2 = elem.numPoints() - 1;  // end of part
       else
-        i2 = elem->Parts()[part + 1] - 1;  // end of part
+        i2 = elem.part(part + 1) - 1;  // end of part
 
       if (i2 >= i1)
       {
@@ -870,17 +877,17 @@ void find_nearest_lines(const NFmiEsriShape &theShape,
           if (options.projection == "latlon")
             dist = latlon_line_distance(theLatLon.X(),
                                         theLatLon.Y(),
-                                        elem->Points()[ii - 1].X(),
-                                        elem->Points()[ii - 1].Y(),
-                                        elem->Points()[ii].X(),
-                                        elem->Points()[ii].Y());
+                                        elem.x(ii - 1),
+                                        elem.y(ii - 1),
+                                        elem.x(ii),
+                                        elem.y(ii));
           else
             dist = world_line_distance(worldxy.X(),
                                        worldxy.Y(),
-                                       elem->Points()[ii - 1].X(),
-                                       elem->Points()[ii - 1].Y(),
-                                       elem->Points()[ii].X(),
-                                       elem->Points()[ii].Y());
+                                       elem.x(ii - 1),
+                                       elem.y(ii - 1),
+                                       elem.x(ii),
+                                       elem.y(ii));
           if (mindist < 0 || dist < mindist)
             mindist = dist;
         }
@@ -889,7 +896,7 @@ void find_nearest_lines(const NFmiEsriShape &theShape,
 
     if (mindist <= options.searchradius)
     {
-      if (condition_satisfied(*elem, cond_variable, cond_comparison, cond_value))
+      if (condition_satisfied(theTable, condition, i))
       {
         distance_map.insert(DistanceMap::value_type(mindist, i));
       }
@@ -899,7 +906,7 @@ void find_nearest_lines(const NFmiEsriShape &theShape,
   // Print the results. Note that we print only the shortest distance for
   // each unique attribute, if so requested.
 
-  filter_out_duplicates(theShape, distance_map);
+  filter_out_duplicates(theTable, distance_map);
 
   unsigned int num = 0;
   for (DistanceMap::const_iterator it = distance_map.begin(); it != distance_map.end(); ++it)
@@ -908,13 +915,12 @@ void find_nearest_lines(const NFmiEsriShape &theShape,
       break;
 
     int pos = it->second;
-    const NFmiEsriElement *elem = static_cast<const NFmiEsriElement *>(elements[pos]);
 
     if (!theName.empty())
       cout << theName << options.delimiter;
 
     cout << ++num << options.delimiter << it->first << options.delimiter;
-    print_attributes(*elem);
+    print_attributes(theTable, columns, pos);
     cout << endl;
   }
 }
@@ -927,28 +933,29 @@ void find_nearest_lines(const NFmiEsriShape &theShape,
  */
 // ----------------------------------------------------------------------
 
-bool is_inside(const NFmiEsriPolygon &thePoly, double theX, double theY)
+template <typename Record>
+bool is_inside(const Record &thePoly, double theX, double theY)
 {
   int counter = 0;
 
-  for (int part = 0; part < thePoly.NumParts(); part++)
+  for (int part = 0; part < thePoly.numParts(); part++)
   {
-    int i1 = thePoly.Parts()[part];  // start of part
+    int i1 = thePoly.part(part);  // start of part
     int i2;
-    if (part + 1 == thePoly.NumParts())
-      i2 = thePoly.NumPoints() - 1;  // end of part
+    if (part + 1 == thePoly.numParts())
+      i2 = thePoly.numPoints() - 1;  // end of part
     else
-      i2 = thePoly.Parts()[part + 1] - 1;  // end of part
+      i2 = thePoly.part(part + 1) - 1;  // end of part
 
     if (i2 >= i1)
     {
-      double x1 = thePoly.Points()[i1].X();
-      double y1 = thePoly.Points()[i1].Y();
+      double x1 = thePoly.x(i1);
+      double y1 = thePoly.y(i1);
 
       for (int i = i1 + 1; i <= i2; i++)
       {
-        double x2 = thePoly.Points()[i].X();
-        double y2 = thePoly.Points()[i].Y();
+        double x2 = thePoly.x(i);
+        double y2 = thePoly.y(i);
         if (theY > std::min(y1, y2) && theY <= std::max(y1, y2) && theX <= std::max(x1, x2) &&
             y1 != y2)
         {
@@ -965,13 +972,80 @@ bool is_inside(const NFmiEsriPolygon &thePoly, double theX, double theY)
   return (counter % 2 != 0);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mark all elements as candidates, in file order
+ */
+// ----------------------------------------------------------------------
+
+void all_candidates(size_t theSize, vector<size_t> &theCandidates)
+{
+  theCandidates.resize(theSize);
+  for (size_t i = 0; i < theCandidates.size(); i++)
+    theCandidates[i] = i;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The polygons of a shapefile possibly enclosing a point
+ *
+ * All polygons are candidates, in file order.
+ */
+// ----------------------------------------------------------------------
+
+void enclosing_candidates(const ShpFile::MappedReader &theReader,
+                          double /* theX */,
+                          double /* theY */,
+                          vector<size_t> &theCandidates)
+{
+  all_candidates(theReader.size(), theCandidates);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The polygons read through OGR possibly enclosing a point
+ *
+ * OGR has already filtered the polygons spatially, all of them are
+ * candidates.
+ */
+// ----------------------------------------------------------------------
+
+void enclosing_candidates(const EsriView::Reader &theReader,
+                          double /* theX */,
+                          double /* theY */,
+                          vector<size_t> &theCandidates)
+{
+  all_candidates(theReader.size(), theCandidates);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The polygons of a shape cache possibly enclosing a point
+ *
+ * The polygons whose bounding boxes contain the point are found with
+ * the R-tree of the cache, in file order.
+ */
+// ----------------------------------------------------------------------
+
+void enclosing_candidates(const ShapeCache::Reader &theReader,
+                          double theX,
+                          double theY,
+                          vector<size_t> &theCandidates)
+{
+  ShpFile::Box box;
+  box.update(theX, theY);
+  theReader.query(box, theCandidates);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Find polygon surrounding point from polygon shapefile
  */
 // ----------------------------------------------------------------------
 
-void find_enclosing_polygons(const NFmiEsriShape &theShape,
+template <typename Reader>
+void find_enclosing_polygons(const Reader &theReader,
+                             AttributeTable &theTable,
                              const NFmiPoint &theLatLon,
                              const std::string &theName = "")
 {
@@ -984,45 +1058,38 @@ void find_enclosing_polygons(const NFmiEsriShape &theShape,
 
   // Search conditions
 
-  string cond_variable, cond_comparison, cond_value;
-  parse_condition(cond_variable, cond_comparison, cond_value);
+  const Condition condition = resolve_condition(theTable);
+  const vector<int> columns = attribute_columns(theTable);
 
   // Find the first match
 
-  const NFmiEsriShape::elements_type &elements = theShape.Elements();
-
-  NFmiEsriShape::elements_type::size_type i;
-  for (i = 0; i < elements.size(); i++)
-  {
-    if (elements[i] == 0)  // null element?
-      continue;
+  const double x = (options.projection == "latlon" ? theLatLon.X() : worldxy.X());
+  const double y = (options.projection == "latlon" ? theLatLon.Y() : worldxy.Y());
 
-    const NFmiEsriPolygon *elem = static_cast<const NFmiEsriPolygon *>(elements[i]);
+  vector<size_t> candidates;
+  enclosing_candidates(theReader, x, y, candidates);
 
-    bool enclosed = false;
+  size_t k;
+  for (k = 0; k < candidates.size(); k++)
+  {
+    const size_t i = candidates[k];
+    const auto elem = theReader.record(i);
 
-    if (condition_satisfied(*elem, cond_variable, cond_comparison, cond_value))
-    {
-      if (options.projection == "latlon")
-        enclosed = is_inside(*elem, theLatLon.X(), theLatLon.Y());
-      else
-        enclosed = is_inside(*elem, worldxy.X(), worldxy.Y());
-    }
+    if (elem.type() == kFmiEsriNull)  // null element?
+      continue;
 
-    if (enclosed)
+    if (condition_satisfied(theTable, condition, i) && is_inside(elem, x, y))
       break;
   }
 
   // Print the results.
 
-  if (i < elements.size())
+  if (k < candidates.size())
   {
-    const NFmiEsriPolygon *elem = static_cast<const NFmiEsriPolygon *>(elements[i]);
-
     if (!theName.empty())
       cout << theName << options.delimiter;
 
-    print_attributes(*elem);
+    print_attributes(theTable, columns, candidates[k]);
     cout << endl;
   }
   else
@@ -1044,24 +1111,39 @@ void find_enclosing_polygons(const NFmiEsriShape &theShape,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief main progran
+ * \brief Search for the given point based on the shape type
  */
 // ----------------------------------------------------------------------
 
-int domain(int argc, char *argv[])
+template <typename Reader>
+void find(const Reader &theReader,
+          AttributeTable &theTable,
+          NFmiEsriElementType theType,
+          const NFmiPoint &theLatLon,
+          const std::string &theName = "")
 {
-  if (!parse_options(argc, argv))
-    return 0;
-
-  // Read the shape
+  if (theType == kFmiEsriPoint)
+    find_nearest_points(theReader, theTable, theLatLon, theName);
+  else if (theType == kFmiEsriPolyLine)
+    find_nearest_lines(theReader, theTable, theLatLon, theName);
+  else if (theType == kFmiEsriPolygon)
+    find_enclosing_polygons(theReader, theTable, theLatLon, theName);
+  else
+    throw runtime_error("Internal error while deciding shape type");
+}
 
-  NFmiEsriShape shape;
-  if (!shape.Read(options.shapefile, true))
-    throw runtime_error("Failed to read '" + options.shapefile + "'");
+// ----------------------------------------------------------------------
+/*!
+ * \brief Search the mapped shapefile or shape cache
+ */
+// ----------------------------------------------------------------------
 
+template <typename Reader>
+void search(const Reader &theReader, AttributeTable &theTable)
+{
   // Validate search attribute
 
-  establish_attribute(shape);
+  establish_attribute(theTable);
 
   // Establish projection for distance calculations
 
@@ -1073,41 +1155,157 @@ int domain(int argc, char *argv[])
   // Polylines: find nearest polyline
   // Points: find nearest point
 
-  NFmiEsriElementType type = establish_type(shape);
+  NFmiEsriElementType type = establish_type(theReader);
 
   if (options.coordinatefile.empty())
   {
     NFmiPoint latlon(options.longitude, options.latitude);
-
-    if (type == kFmiEsriPoint)
-      find_nearest_points(shape, latlon);
-    else if (type == kFmiEsriPolyLine)
-      find_nearest_lines(shape, latlon);
-    else if (type == kFmiEsriPolygon)
-      find_enclosing_polygons(shape, latlon);
-    else
-      throw runtime_error("Internal error while deciding shape type");
+    find(theReader, theTable, type, latlon);
   }
   else
   {
     LocationList places = read_locationlist(options.coordinatefile);
 
     for (LocationList::const_iterator it = places.begin(); it != places.end(); ++it)
+      find(theReader, theTable, type, it->second, it->first);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The bounding box of the features possibly matching a point
+ *
+ * For points and lines the box covers the search radius, for polygons
+ * only the point itself. The box is in the coordinates of the data,
+ * which are projected if a projection was given.
+ */
+// ----------------------------------------------------------------------
+
+ShpFile::Box search_box(const NFmiPoint &theLatLon, NFmiEsriElementType theType)
+{
+  const double radius = (theType == kFmiEsriPolygon ? 0 : options.searchradius);  // km
+
+  ShpFile::Box box;
+
+  if (options.projection != "latlon")
+  {
+    const NFmiPoint xy = projection->LatLonToWorldXY(theLatLon);
+    const double r = max(1000 * radius, 0.001);
+    box.update(xy.X() - r, xy.Y() - r);
+    box.update(xy.X() + r, xy.Y() + r);
+    return box;
+  }
+
+  // A degree of latitude is at least 111 km. The longitude range is
+  // widened by the latitude furthest from the equator, and covers all
+  // longitudes if the box would wrap around.
+
+  const double dlat = max(radius / 111.0, 1e-6);
+  const double lat1 = max(-90.0, theLatLon.Y() - dlat);
+  const double lat2 = min(90.0, theLatLon.Y() + dlat);
+  const double coslat = cos(FmiRad(max(fabs(lat1), fabs(lat2))));
+
+  double lon1 = -180;
+  double lon2 = 180;
+  if (coslat > 0 && dlat < 180 * coslat)
+  {
+    const double dlon = dlat / coslat;
+    if (theLatLon.X() - dlon >= -180 && theLatLon.X() + dlon <= 180)
     {
-      string name = it->first;
-      NFmiPoint latlon = it->second;
-
-      if (type == kFmiEsriPoint)
-        find_nearest_points(shape, latlon, name);
-      else if (type == kFmiEsriPolyLine)
-        find_nearest_lines(shape, latlon, name);
-      else if (type == kFmiEsriPolygon)
-        find_enclosing_polygons(shape, latlon, name);
-      else
-        throw runtime_error("Internal error while deciding shape type");
+      lon1 = theLatLon.X() - dlon;
+      lon2 = theLatLon.X() + dlon;
     }
   }
 
+  box.update(lon1, lat1);
+  box.update(lon2, lat2);
+  return box;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Search a layer read through OGR
+ *
+ * The features near each search point are read separately with the
+ * bounding box and the search condition as OGR filters. The condition
+ * is tested again for the features read.
+ */
+// ----------------------------------------------------------------------
+
+void search_layer()
+{
+  OgrReader::Layer layer(options.shapefile);
+
+  string variable, comparison, value;
+  parse_condition(variable, comparison, value);
+  const string filter =
+      (comparison.empty() ? string() : layer.filterExpression(variable, comparison, value));
+
+  establish_projection();
+
+  NFmiEsriElementType type = layer.shapeType();
+  if (type == kFmiEsriMultiPoint)
+    type = kFmiEsriPoint;
+
+  const auto search_point = [&](const NFmiPoint &theLatLon, const string &theName)
+  {
+    const ShpFile::Box box = search_box(theLatLon, type);
+    const unique_ptr<NFmiEsriShape> shape = layer.read(&box, filter);
+    const EsriView::Reader reader(*shape);
+    AttributeTable table(*shape);
+    establish_attribute(table);
+    find(reader, table, type, theLatLon, theName);
+  };
+
+  if (options.coordinatefile.empty())
+    search_point(NFmiPoint(options.longitude, options.latitude), "");
+  else
+  {
+    LocationList places = read_locationlist(options.coordinatefile);
+
+    for (LocationList::const_iterator it = places.begin(); it != places.end(); ++it)
+      search_point(it->second, it->first);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief main progran
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, char *argv[])
+{
+  if (!parse_options(argc, argv))
+    return 0;
+
+  // Attribute values are looked up by column instead of by name
+
+  if (OgrReader::isOgrSource(options.shapefile))
+    search_layer();
+  else if (ShapeCache::isCache(options.shapefile))
+  {
+    // The cache is rebuilt first if the shapefile has changed
+
+    const ShapeCache::Reader reader(options.shapefile);
+    AttributeTable table(reader);
+    search(reader, table);
+  }
+  else
+  {
+    // Map the shape, records and attributes are decoded only when accessed
+
+    const ShpFile::MappedReader reader(options.shapefile);
+    const ShpFile::MappedDbf dbf(options.shapefile);
+
+    if (dbf.size() != reader.size())
+      throw runtime_error("The number of records in the .shp and .dbf files of '" +
+                          options.shapefile + "' differ");
+
+    AttributeTable table(dbf);
+    search(reader, table);
+  }
+
   return 1;
 }
 
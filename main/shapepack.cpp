@@ -59,6 +59,9 @@
  */
 // ======================================================================
 
+#include "AttributeTable.h"
+#include "ShapeLoader.h"
+
 #include <imagine/NFmiEsriPolygon.h>
 #include <imagine/NFmiEsriShape.h>
 #include <imagine/NFmiFillMap.h>
@@ -66,15 +69,16 @@
 
 #include <macgyver/WorldTimeZones.h>
 
-#include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
 
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 extern "C"
 {
@@ -216,68 +220,23 @@ bool parse_options(int argc, char *argv[])
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Get attribute value as string
- */
-// ----------------------------------------------------------------------
-
-string get_attribute_value(const NFmiEsriElement &theElement, const NFmiEsriAttributeName &theName)
-{
-  string name = theName.Name();
-  switch (theName.Type())
-  {
-    case kFmiEsriString:
-      return theElement.GetString(name);
-    case kFmiEsriInteger:
-      return boost::lexical_cast<string>(theElement.GetInteger(name));
-    case kFmiEsriDouble:
-      return boost::lexical_cast<string>(theElement.GetDouble(name));
-    default:
-      throw runtime_error("Unknown attribute value type");
-  }
-}
-
-// ----------------------------------------------------------------------
-/*!
- * \brief Find the given attribute name
- */
-// ----------------------------------------------------------------------
-
-NFmiEsriShape::attributes_type::const_iterator find_attribute(
-    const NFmiEsriShape::attributes_type &theAttributes, const std::string &theName)
-{
-  NFmiEsriShape::attributes_type::const_iterator it = theAttributes.begin();
-  for (; it != theAttributes.end(); ++it)
-  {
-    if ((*it)->Name() == theName)
-      break;
-  }
-  if (it == theAttributes.end())
-    throw runtime_error("No attribute named '" + theName + "' in the shape");
-  return it;
-}
-
-// ----------------------------------------------------------------------
-/*!
- * \brief Find all unique attribute values for the given attribute
+ * \brief Find all unique attribute values
+ *
+ * \param theShape The shape
+ * \param theAttributeValues The attribute values of the elements as text
  */
 // ----------------------------------------------------------------------
 
-set<string> find_unique_attributes(const NFmiEsriShape &theShape, const string &theAttribute)
+set<string> find_unique_attributes(const NFmiEsriShape &theShape,
+                                   const vector<string> &theAttributeValues)
 {
-  const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
-
-  NFmiEsriShape::attributes_type::const_iterator at = find_attribute(attributes, theAttribute);
-
   set<string> values;
 
-  for (NFmiEsriShape::const_iterator it = theShape.Elements().begin();
-       it != theShape.Elements().end();
-       ++it)
+  const NFmiEsriShape::elements_type &elements = theShape.Elements();
+  for (NFmiEsriShape::elements_type::size_type i = 0; i < elements.size(); i++)
   {
-    if (*it == nullptr)
-      continue;
-    string value = get_attribute_value(**it, **at);
-    values.insert(value);
+    if (elements[i] != nullptr)
+      values.insert(theAttributeValues[i]);
   }
 
   return values;
@@ -387,6 +346,7 @@ void polygon_to_fillmap(NFmiFillMap &theMap, const NFmiEsriElement *theElement)
 
 void render_image(NFmiImage &theImage,
                   const NFmiEsriShape &theShape,
+                  const vector<string> &theAttributeValues,
                   const map<string, int> &theValues)
 {
   if (options.verbose)
@@ -395,24 +355,17 @@ void render_image(NFmiImage &theImage,
          << " size image, this may take a while" << endl;
   }
 
-  // Attribute information
-
-  const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
-
-  NFmiEsriShape::attributes_type::const_iterator at = find_attribute(attributes, options.attribute);
+  const NFmiEsriShape::elements_type &elements = theShape.Elements();
 
-  for (NFmiEsriShape::const_iterator it = theShape.Elements().begin();
-       it != theShape.Elements().end();
-       ++it)
+  for (NFmiEsriShape::elements_type::size_type i = 0; i < elements.size(); i++)
   {
-    if (*it == nullptr)
+    if (elements[i] == nullptr)
       continue;
 
-    const string value = get_attribute_value(**it, **at);
-    NFmiColorTools::Color color = theValues.find(value)->second;
+    NFmiColorTools::Color color = theValues.find(theAttributeValues[i])->second;
 
     NFmiFillMap fillmap;
-    polygon_to_fillmap(fillmap, *it);
+    polygon_to_fillmap(fillmap, elements[i]);
     fillmap.Fill(theImage, color, NFmiColorTools::kFmiColorCopy);
   }
 }
@@ -480,7 +433,10 @@ bool is_inside(const NFmiEsriPolygon &thePoly, double theX, double theY)
  */
 // ----------------------------------------------------------------------
 
-string find_enclosing_polygon(const NFmiEsriShape &theShape, float theLon, float theLat)
+string find_enclosing_polygon(const NFmiEsriShape &theShape,
+                              const vector<string> &theAttributeValues,
+                              float theLon,
+                              float theLat)
 {
   // Find the first match
 
@@ -503,14 +459,7 @@ string find_enclosing_polygon(const NFmiEsriShape &theShape, float theLon, float
   // Print the results.
 
   if (i < elements.size())
-  {
-    const NFmiEsriPolygon *elem = static_cast<const NFmiEsriPolygon *>(elements[i]);
-    const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
-    NFmiEsriShape::attributes_type::const_iterator at =
-        find_attribute(attributes, options.attribute);
-    const string value = get_attribute_value(*elem, **at);
-    return value;
-  }
+    return theAttributeValues[i];
   else
     return "";
 }
@@ -575,6 +524,7 @@ inline int find_nearest_zone(const NFmiImage &theImage, int i, int j)
 
 void refine_image(NFmiImage &theImage,
                   const NFmiEsriShape &theShape,
+                  const vector<string> &theAttributeValues,
                   const map<string, int> &theValues)
 {
   int checks = 0;
@@ -603,7 +553,7 @@ void refine_image(NFmiImage &theImage,
       {
         ++checks;
 
-        string tz = find_enclosing_polygon(theShape, lonpixel(i), latpixel(j));
+        string tz = find_enclosing_polygon(theShape, theAttributeValues, lonpixel(i), latpixel(j));
 
         if (!tz.empty())
         {
@@ -795,9 +745,8 @@ int domain(int argc, char *argv[])
 
   // Read the shape
 
-  NFmiEsriShape shape;
-  if (!shape.Read(options.shapefile, true))
-    throw runtime_error("Failed to read '" + options.shapefile + "'");
+  const unique_ptr<NFmiEsriShape> shapeptr = ShapeLoader::read(options.shapefile, true);
+  const NFmiEsriShape &shape = *shapeptr;
 
   const NFmiEsriShape::attributes_type &attributes = shape.Attributes();
 
@@ -836,7 +785,12 @@ int domain(int argc, char *argv[])
 
   // Unique attributes
 
-  set<string> uniques = find_unique_attributes(shape, options.attribute);
+  // Attribute values are looked up once per element instead of once per use
+
+  AttributeTable table(shape);
+  const vector<string> &values = table.texts(table.requireColumn(options.attribute));
+
+  set<string> uniques = find_unique_attributes(shape, values);
 
   if (options.verbose)
     print_uniques(uniques);
@@ -858,10 +812,10 @@ int domain(int argc, char *argv[])
   if (zones)
     render_shapepack(img, *zones, attmap);
 
-  render_image(img, shape, attmap);
+  render_image(img, shape, values, attmap);
 
   if (options.accurate)
-    refine_image(img, shape, attmap);
+    refine_image(img, shape, values, attmap);
 
   if (!options.pngfile.empty())
     img.WritePng(options.pngfile);
@@ -31,12 +31,38 @@
  * 10)</dd>
  * <dt>-D [distance]</dt>
  * <dd>The required minimum distance from the border (default 0)</dd>
+ * <dt>-r [fieldname]</dt>
+ * <dd>Rank mode: instead of selecting the points for a single minimum
+ * distance, output all candidates with a rank stored into the given
+ * new numeric field. The points ranked at least D are at least D
+ * apart, and are also included for all smaller distances. They may
+ * however be fewer than the points selected with -d D, since the
+ * greedy selection is not monotone in the distance. Option -d then
+ * gives the largest rank.</dd>
+ * <dt>-s [d1,d2,...]</dt>
+ * <dd>In rank mode store a level instead of the rank. The points are
+ * selected for the largest distance first, and then for each smaller
+ * distance in turn keeping the points already selected. Points with
+ * level N or higher are then a selection for the Nth smallest
+ * distance. Points which are not selected for any of the distances
+ * are omitted.</dd>
  * </dl>
  *
+ * For example
+ * \code
+ * shapepoints -p $AREA -r LEVEL -s 10,20,40,80 -n places myplaces
+ * \endcode
+ * replaces four separate runs with -d 10, -d 20, -d 40 and -d 80 with
+ * nested selections, the points for distance 40 being those with
+ * LEVEL>=3. Since the points of the larger distances are kept, the
+ * selections may differ from the ones of separate runs.
+ *
  */
 // ======================================================================
 
+#include "AttributeTable.h"
 #include "PointSelector.h"
+#include "ShapeLoader.h"
 #include <memory>
 #include <imagine/NFmiEsriPoint.h>
 #include <imagine/NFmiEsriShape.h>
@@ -44,8 +70,10 @@
 #include <newbase/NFmiAreaFactory.h>
 #include <newbase/NFmiCmdLine.h>
 #include <newbase/NFmiSettings.h>
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace Imagine;
@@ -71,11 +99,14 @@ void usage()
        << "\t-p [desc]\tProjection description" << endl
        << "\t-f [name]\tData field used for sorting the points (TYPE)" << endl
        << "\t-n\t\tNegate the field value to obtain ascending sort" << endl
+       << "\t-r [name]\tStore the nested selection rank of all points into field" << endl
+       << "\t-s [d1,d2...]\tStore the level of nested selections instead (requires -r)" << endl
        << endl
        << "Typical usage:" << endl
        << endl
        << "\tAREA=stereographic,25:6,51.3,49,70.2:400,-1" << endl
        << "\tshapepoints -p $AREA -d 20 -n ESRI/europe/places myplaces" << endl
+       << "\tshapepoints -p $AREA -r LEVEL -s 10,20,40 -n ESRI/europe/places myplaces" << endl
        << endl;
 }
 
@@ -93,6 +124,8 @@ struct Options
   double minborderdistance;
   string projection;
   string fieldname;
+  string rankfield;
+  vector<double> scales;
   string inputshape;
   string outputshape;
 
@@ -103,6 +136,8 @@ struct Options
         minborderdistance(0),
         projection(),
         fieldname("TYPE"),
+        rankfield(),
+        scales(),
         inputshape(),
         outputshape()
   {
@@ -125,7 +160,7 @@ bool parse_command_line(int argc, const char *argv[])
 {
   using namespace NFmiStringTools;
 
-  NFmiCmdLine cmdline(argc, argv, "vhnd!D!f!p!");
+  NFmiCmdLine cmdline(argc, argv, "vhnd!D!f!p!r!s!");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -154,12 +189,29 @@ bool parse_command_line(int argc, const char *argv[])
     options.fieldname = cmdline.OptionValue('f');
   if (cmdline.isOption('n'))
     options.negate = true;
+  if (cmdline.isOption('r'))
+    options.rankfield = cmdline.OptionValue('r');
+  if (cmdline.isOption('s'))
+    options.scales = Split<vector<double>>(cmdline.OptionValue('s'));
 
   // Final checks
 
   if (options.projection.empty())
     throw runtime_error("Must specify some projection with option -p");
 
+  if (!options.scales.empty())
+  {
+    if (options.rankfield.empty())
+      throw runtime_error("Option -s requires option -r");
+
+    sort(options.scales.begin(), options.scales.end());
+    options.scales.erase(unique(options.scales.begin(), options.scales.end()),
+                         options.scales.end());
+    if (options.scales.front() <= 0)
+      throw runtime_error("The distances given with -s must be positive");
+
+  }
+
   return true;
 }
 
@@ -176,20 +228,36 @@ void select_points(PointSelector &theSelector, const NFmiEsriShape &theShape)
 {
   // Establish the correct attribute
 
-  const NFmiEsriAttributeName *name = theShape.AttributeName(options.fieldname);
-  if (name == 0)
+  AttributeTable table(theShape);
+  const int column = table.column(options.fieldname);
+  if (column < 0)
     throw runtime_error("The input shape does not have a field named '" + options.fieldname + "'");
 
-  const NFmiEsriAttributeType atype = name->Type();
+  const NFmiEsriAttributeType atype = table.type(column);
 
   if (atype != kFmiEsriInteger && atype != kFmiEsriDouble)
     throw runtime_error("The input shape field named '" + options.fieldname + "' is not numeric");
 
+  // Extract the field values once, converting integers to doubles
+
+  vector<double> fieldvalues;
+  if (atype == kFmiEsriInteger)
+  {
+    const vector<int> &integers = table.integers(column);
+    fieldvalues.assign(integers.begin(), integers.end());
+  }
+  else
+    fieldvalues = table.doubles(column);
+
   // Start processing the points
 
   const NFmiEsriShape::elements_type &elements = theShape.Elements();
 
-  int candidates = 0;
+  vector<int> ids;
+  vector<double> values;
+  vector<double> lons;
+  vector<double> lats;
+
   for (NFmiEsriShape::elements_type::size_type i = 0; i < elements.size(); i++)
   {
     // Ignore empty elements
@@ -201,16 +269,16 @@ void select_points(PointSelector &theSelector, const NFmiEsriShape &theShape)
       continue;
 
     const NFmiEsriPoint *elem = static_cast<const NFmiEsriPoint *>(elements[i]);
-    const int id = i;
-    const double lon = elem->X();
-    const double lat = elem->Y();
-    const double value = (atype == kFmiEsriInteger ? elements[i]->GetInteger(options.fieldname)
-                                                   : elements[i]->GetDouble(options.fieldname));
-
-    if (theSelector.add(id, value, lon, lat))
-      ++candidates;
+    ids.push_back(i);
+    lons.push_back(elem->X());
+    lats.push_back(elem->Y());
+    values.push_back(fieldvalues[i]);
   }
 
+  // Project all the points at once
+
+  const PointSelector::size_type candidates = theSelector.add(ids, values, lons, lats);
+
   if (options.verbose)
   {
     cout << "Accepted " << candidates << " candidates out of " << elements.size()
@@ -263,6 +331,79 @@ void create_shape(const PointSelector &theSelector, const NFmiEsriShape &theShap
   shape.Write(options.outputshape);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create output shape with ranks from input shape and selector
+ *
+ * \param theSelector The selector
+ * \param theShape The input shape
+ */
+// ----------------------------------------------------------------------
+
+void create_ranked_shape(const PointSelector &theSelector, const NFmiEsriShape &theShape)
+{
+  if (theShape.AttributeName(options.rankfield) != 0)
+    throw runtime_error("The input shape already has a field named '" + options.rankfield + "'");
+
+  // The output shape
+
+  NFmiEsriShape shape(theShape.Type());
+
+  // Copy the attribute type information and add the rank field
+
+  for (NFmiEsriShape::attributes_type::const_iterator ait = theShape.Attributes().begin();
+       ait != theShape.Attributes().end();
+       ++ait)
+  {
+    shape.Add(new NFmiEsriAttributeName(**ait));
+  }
+
+  const bool levels = !options.scales.empty();
+
+  NFmiEsriAttributeName *rankname =
+      (levels ? new NFmiEsriAttributeName(options.rankfield, kFmiEsriInteger, 4, 0)
+              : new NFmiEsriAttributeName(options.rankfield, kFmiEsriDouble, 12, 2));
+  shape.Add(rankname);
+
+  // Then copy the ranked elements in the order of importance
+
+  const NFmiEsriShape::elements_type &elements = theShape.Elements();
+
+  int count = 0;
+  if (levels)
+  {
+    const PointSelector::LevelList ranks = theSelector.levels(options.scales);
+    for (PointSelector::LevelList::const_iterator it = ranks.begin(); it != ranks.end(); ++it)
+    {
+      NFmiEsriElement *tmp = elements[it->first]->Clone();
+      tmp->Add(NFmiEsriAttribute(it->second, rankname));
+      shape.Add(tmp);
+      ++count;
+    }
+  }
+  else
+  {
+    const PointSelector::RankList ranks = theSelector.ranks();
+    for (PointSelector::RankList::const_iterator it = ranks.begin(); it != ranks.end(); ++it)
+    {
+      NFmiEsriElement *tmp = elements[it->first]->Clone();
+      tmp->Add(NFmiEsriAttribute(it->second, rankname));
+      shape.Add(tmp);
+      ++count;
+    }
+  }
+
+  if (options.verbose)
+    cout << "Ranked " << count << " points" << endl;
+
+  // And finally save the shape
+
+  if (options.verbose)
+    cout << "Saving shapefile '" << options.outputshape << "'" << endl;
+
+  shape.Write(options.outputshape);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief The main algorithm
@@ -276,6 +417,12 @@ void create_shape(const PointSelector &theSelector, const NFmiEsriShape &theShap
  *    -# If the next point is too close to one chosen earlier, discard it
  *    -# Add the point to the set of accepted points
  *  -# Save the accepted points as a shapefile
+ *
+ * In rank mode all candidates are saved along with a rank. Points
+ * ranked at least D are at least D apart, but they may be fewer than
+ * the points accepted above for distance D, since the selection is not
+ * monotone in the distance. With option -s a level is saved instead,
+ * and points not selected for any of the distances are left out.
  */
 // ----------------------------------------------------------------------
 
@@ -295,9 +442,8 @@ int domain(int argc, const char *argv[])
   if (options.verbose)
     cout << "Reading shapefile '" << options.inputshape << "'" << endl;
 
-  NFmiEsriShape inputshape;
-  if (!inputshape.Read(options.inputshape, true))
-    throw runtime_error("Failed to read shape '" + options.inputshape + "'");
+  const unique_ptr<NFmiEsriShape> inputptr = ShapeLoader::read(options.inputshape, true);
+  const NFmiEsriShape &inputshape = *inputptr;
 
   if (inputshape.Type() != kFmiEsriPoint)
     throw runtime_error("Input shape must contain plain point data");
@@ -318,7 +464,10 @@ int domain(int argc, const char *argv[])
 
   // Create output shape from selected points and save it
 
-  create_shape(selector, inputshape);
+  if (options.rankfield.empty())
+    create_shape(selector, inputshape);
+  else
+    create_ranked_shape(selector, inputshape);
 
   return 0;
 }
@@ -21,6 +21,9 @@
  *   - -h              Tulostaa kyttohjeet
  *   - -i <inputproj>  Input-datan projektio
  *   - -o <outputproj> Output-datan projektio
+ *   - -s              Virtaava tila: tietueet luetaan, projisoidaan ja
+ *                     kirjoitetaan .shx-indeksin avulla er kerrallaan,
+ *                     jolloin muistin tarve ei riipu tiedoston koosta
  *
  * Projektio mritelln newbasen NFmiAreaFactory tykalun speksien
  * mukaisesti. Koordinaatteja ksitelln maailmankoordinaatiston
@@ -32,9 +35,16 @@
  * \code
  * shapeproject -i ykj tiet_ykj tiet_latlon
  * \endcode
+ *
+ * Projektiosuunta ratkaistaan kerran ohjelman alussa, ja pisteet
+ * projisoidaan rinnakkain useassa sikeess.
  */
 // ======================================================================
 
+#include "ProjectionTools.h"
+#include "ShapeLoader.h"
+#include "ShpFile.h"
+#include <imagine/NFmiEsriBox.h>
 #include <imagine/NFmiEsriPoint.h>
 #include <imagine/NFmiEsriProjector.h>
 #include <imagine/NFmiEsriShape.h>
@@ -42,9 +52,13 @@
 #include <newbase/NFmiAreaFactory.h>
 #include <newbase/NFmiCmdLine.h>
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace Imagine;
@@ -61,8 +75,16 @@ struct Options
   string outputprojection;
   string inputfile;
   string outputfile;
-
-  Options() : inputprojection("latlon"), outputprojection("latlon"), inputfile(), outputfile() {}
+  bool streaming;
+
+  Options()
+      : inputprojection("latlon"),
+        outputprojection("latlon"),
+        inputfile(),
+        outputfile(),
+        streaming(false)
+  {
+  }
 };
 
 // ----------------------------------------------------------------------
@@ -90,6 +112,7 @@ void usage()
        << "\t-h\t\tprint this help information" << endl
        << "\t-i [proj]\tthe input projection (default: latlon)" << endl
        << "\t-o [proj]\tthe output projection (default: latlon)" << endl
+       << "\t-s\t\tstream the records in constant memory" << endl
        << endl;
 }
 
@@ -103,7 +126,7 @@ void usage()
 
 bool parse_command_line(int argc, const char *argv[])
 {
-  NFmiCmdLine cmdline(argc, argv, "hi!o!");
+  NFmiCmdLine cmdline(argc, argv, "hi!o!s");
 
   if (cmdline.Status().IsError())
     throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
@@ -132,6 +155,9 @@ bool parse_command_line(int argc, const char *argv[])
   if (cmdline.isOption('o'))
     options.outputprojection = cmdline.OptionValue('o');
 
+  if (cmdline.isOption('s'))
+    options.streaming = true;
+
   // validity checks
 
   if (options.inputprojection == options.outputprojection)
@@ -140,6 +166,31 @@ bool parse_command_line(int argc, const char *argv[])
   return true;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief The possible projection paths
+ *
+ * The path is resolved once from the options so that the projection
+ * of each individual point does not need to compare strings.
+ */
+// ----------------------------------------------------------------------
+
+enum ProjectionPath
+{
+  kFromLatLon,  //!< latlon to world XY
+  kToLatLon,    //!< world XY to latlon
+  kReproject    //!< world XY to latlon to world XY
+};
+
+ProjectionPath resolve_path()
+{
+  if (options.inputprojection == "latlon")
+    return kFromLatLon;
+  if (options.outputprojection == "latlon")
+    return kToLatLon;
+  return kReproject;
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Class for reprojecting ESRI data
@@ -151,32 +202,37 @@ class MyProjector : public NFmiEsriProjector
  private:
   const NFmiArea &itsInputArea;
   const NFmiArea &itsOutputArea;
+  const ProjectionPath itsPath;
 
  public:
-  MyProjector(const NFmiArea &theInputArea, const NFmiArea &theOutputArea)
-      : itsInputArea(theInputArea), itsOutputArea(theOutputArea)
+  MyProjector(const NFmiArea &theInputArea,
+              const NFmiArea &theOutputArea,
+              ProjectionPath thePath)
+      : itsInputArea(theInputArea), itsOutputArea(theOutputArea), itsPath(thePath)
   {
   }
 
   virtual NFmiEsriPoint operator()(const NFmiEsriPoint &thePoint) const
   {
     const NFmiPoint p(thePoint.X(), thePoint.Y());
-    if (options.inputprojection == "latlon")
-    {
-      const NFmiPoint q = itsOutputArea.LatLonToWorldXY(p);
-      return NFmiEsriPoint(q.X(), q.Y());
-    }
-    else if (options.outputprojection == "latlon")
+    switch (itsPath)
     {
-      const NFmiPoint latlon = itsInputArea.WorldXYToLatLon(p);
-      return NFmiEsriPoint(latlon.X(), latlon.Y());
-    }
-    else
-    {
-      const NFmiPoint latlon = itsInputArea.WorldXYToLatLon(p);
-      const NFmiPoint q = itsOutputArea.LatLonToWorldXY(latlon);
-      return NFmiEsriPoint(q.X(), q.Y());
+      case kFromLatLon:
+      {
+        const NFmiPoint q = itsOutputArea.LatLonToWorldXY(p);
+        return NFmiEsriPoint(q.X(), q.Y());
+      }
+      case kToLatLon:
+      {
+        const NFmiPoint latlon = itsInputArea.WorldXYToLatLon(p);
+        return NFmiEsriPoint(latlon.X(), latlon.Y());
+      }
+      case kReproject:
+        break;
     }
+    const NFmiPoint latlon = itsInputArea.WorldXYToLatLon(p);
+    const NFmiPoint q = itsOutputArea.LatLonToWorldXY(latlon);
+    return NFmiEsriPoint(q.X(), q.Y());
   }
 
   virtual void SetBox(const NFmiEsriBox &theBox) const
@@ -187,32 +243,225 @@ class MyProjector : public NFmiEsriProjector
 
 // ----------------------------------------------------------------------
 /*!
- * \brief The main program without error trapping
+ * \brief Project the given range of elements in a single thread
+ *
+ * The bounding box of the projected elements is collected too, since
+ * the box of the shape is not updated by projecting single elements.
  */
 // ----------------------------------------------------------------------
 
-int domain(int argc, const char *argv[])
+void project_elements(NFmiEsriShape::elements_type &theElements,
+                      std::size_t theBegin,
+                      std::size_t theEnd,
+                      const MyProjector &theProjector,
+                      ShpFile::Box &theBox)
 {
-  // Parse the command line options
-  if (!parse_command_line(argc, argv))
-    return 0;
+  for (std::size_t i = theBegin; i < theEnd; i++)
+    if (theElements[i] != nullptr)
+    {
+      theElements[i]->Project(theProjector);
+      NFmiEsriBox box;
+      theElements[i]->Update(box);
+      if (box.IsValid())
+      {
+        theBox.update(box.Xmin(), box.Ymin());
+        theBox.update(box.Xmax(), box.Ymax());
+      }
+    }
+}
 
-  // Create the projections
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read, project and write the shape in memory
+ *
+ * The elements are projected in parallel in contiguous chunks.
+ */
+// ----------------------------------------------------------------------
 
-  NFmiAreaFactory::return_type inarea = NFmiAreaFactory::Create(options.inputprojection);
-  NFmiAreaFactory::return_type outarea = NFmiAreaFactory::Create(options.outputprojection);
+void project_in_memory(ProjectionPath thePath)
+{
   // Read the shape data
 
-  NFmiEsriShape shape;
-  if (!shape.Read(options.inputfile))
-    throw runtime_error("Failed to read shape '" + options.inputfile + "'");
+  const unique_ptr<NFmiEsriShape> shapeptr = ShapeLoader::read(options.inputfile);
+  NFmiEsriShape &shape = *shapeptr;
 
   // Project it
-  MyProjector projector(*inarea, *outarea);
-  shape.Project(projector);
 
-  // And save the results
+  NFmiEsriShape::elements_type &elements = shape.Elements();
+
+  const std::size_t nthreads =
+      max(1u, min(thread::hardware_concurrency(), static_cast<unsigned int>(elements.size())));
+  const std::size_t chunk = (elements.size() + nthreads - 1) / max<std::size_t>(1, nthreads);
+
+  // Each thread needs areas of its own, they are created before
+  // starting the threads since area creation is not thread safe
+
+  vector<NFmiAreaFactory::return_type> areas;
+  vector<shared_ptr<MyProjector>> projectors;
+  for (std::size_t pos = 0; pos < elements.size(); pos += chunk)
+  {
+    areas.push_back(NFmiAreaFactory::Create(options.inputprojection));
+    areas.push_back(NFmiAreaFactory::Create(options.outputprojection));
+    projectors.push_back(shared_ptr<MyProjector>(
+        new MyProjector(*areas[areas.size() - 2], *areas[areas.size() - 1], thePath)));
+  }
+
+  vector<ShpFile::Box> boxes(projectors.size());
+  vector<thread> threads;
+  for (std::size_t pos = 0, t = 0; pos < elements.size(); pos += chunk, t++)
+    threads.push_back(thread(project_elements,
+                             std::ref(elements),
+                             pos,
+                             min(pos + chunk, elements.size()),
+                             std::cref(*projectors[t]),
+                             std::ref(boxes[t])));
+  for (std::size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  ShpFile::Box box;
+  for (std::size_t i = 0; i < boxes.size(); i++)
+    box.update(boxes[i]);
+
+  // And save the results. The box of the shape is still the one of
+  // the input, hence the headers are given the projected box.
+
   shape.Write(options.outputfile);
+  ShpFile::setBox(options.outputfile, box);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Project coordinate arrays in place
+ */
+// ----------------------------------------------------------------------
+
+void project_coordinates(const NFmiArea &theInputArea,
+                         const NFmiArea &theOutputArea,
+                         ProjectionPath thePath,
+                         vector<double> &theX,
+                         vector<double> &theY)
+{
+  double *x = theX.data();
+  double *y = theY.data();
+  const std::size_t n = theX.size();
+
+  switch (thePath)
+  {
+    case kFromLatLon:
+      ProjectionTools::latLonToWorldXY(theOutputArea, x, y, x, y, n);
+      break;
+    case kToLatLon:
+      ProjectionTools::worldXYToLatLon(theInputArea, x, y, x, y, n);
+      break;
+    case kReproject:
+      ProjectionTools::worldXYToLatLon(theInputArea, x, y, x, y, n);
+      ProjectionTools::latLonToWorldXY(theOutputArea, x, y, x, y, n);
+      break;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read, project and write the shape one batch of records at a time
+ *
+ * The records are located via the .shx index. The coordinates of a
+ * batch of records are projected with a single call, after which
+ * they are written back into the raw records along with updated
+ * bounding boxes. The attributes are unaffected and hence the .dbf
+ * file is simply copied.
+ */
+// ----------------------------------------------------------------------
+
+void project_streaming(ProjectionPath thePath)
+{
+  // Number of points to collect for a single batch projection
+  const std::size_t batch_points = 1000000;
+
+  NFmiAreaFactory::return_type inarea = NFmiAreaFactory::Create(options.inputprojection);
+  NFmiAreaFactory::return_type outarea = NFmiAreaFactory::Create(options.outputprojection);
+
+  ShpFile::Reader reader(options.inputfile);
+  ShpFile::Writer writer(options.outputfile, reader.header());
+
+  vector<string> records;
+  vector<double> x, y;
+
+  for (std::size_t next = 0; next < reader.size();)
+  {
+    // Collect a batch of records and their coordinates
+
+    std::size_t count = 0;
+    x.clear();
+    y.clear();
+    for (; next < reader.size() && x.size() < batch_points; ++next, ++count)
+    {
+      if (count >= records.size())
+        records.resize(count + 1);
+      reader.read(next, records[count]);
+
+      const ShpFile::Record record(records[count].data(), records[count].size());
+      for (int i = 0; i < record.numPoints(); i++)
+      {
+        x.push_back(record.x(i));
+        y.push_back(record.y(i));
+      }
+    }
+
+    project_coordinates(*inarea, *outarea, thePath, x, y);
+
+    // Write back the projected coordinates
+
+    std::size_t pos = 0;
+    for (std::size_t r = 0; r < count; r++)
+    {
+      string &contents = records[r];
+      const ShpFile::Record record(contents.data(), contents.size());
+      char *points = &contents[0] + record.pointsOffset();
+
+      ShpFile::Box box;
+      for (int i = 0; i < record.numPoints(); i++, pos++)
+      {
+        ShpFile::putLittleDouble(points + 16 * i, x[pos]);
+        ShpFile::putLittleDouble(points + 16 * i + 8, y[pos]);
+        box.update(x[pos], y[pos]);
+      }
+
+      if (record.hasBox() && !box.empty())
+      {
+        char *b = &contents[0] + record.boxOffset();
+        ShpFile::putLittleDouble(b, box.xmin);
+        ShpFile::putLittleDouble(b + 8, box.ymin);
+        ShpFile::putLittleDouble(b + 16, box.xmax);
+        ShpFile::putLittleDouble(b + 24, box.ymax);
+      }
+
+      writer.write(contents);
+    }
+  }
+
+  writer.close();
+
+  ShpFile::copyDbf(options.inputfile, options.outputfile);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The main program without error trapping
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, const char *argv[])
+{
+  // Parse the command line options
+  if (!parse_command_line(argc, argv))
+    return 0;
+
+  const ProjectionPath path = resolve_path();
+
+  if (options.streaming)
+    project_streaming(path);
+  else
+    project_in_memory(path);
 
   return 0;
 }
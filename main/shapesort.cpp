@@ -0,0 +1,373 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of shapesort for spatially ordering shapefiles
+ */
+// ======================================================================
+/*!
+ * \page shapesort shapesort
+ *
+ * shapesort rewrites a shapefile so that the elements are in the order
+ * of the Hilbert curve through the centers of their bounding boxes.
+ * Elements near each other are then also near each other in the file,
+ * and spatially local operations such as bounding box filtering,
+ * rendering a small area or searching for nearby points touch only
+ * a few contiguous ranges of the file.
+ *
+ * Usage:
+ * \code
+ * shapesort [options] inputshape outputshape
+ * \endcode
+ *
+ * The available options are
+ *
+ *   - -h           print the help information
+ *   - -v           verbose mode
+ *   - -t [level]   add the Hilbert tile number at the given level 1-16
+ *   - -n [name]    the name of the tile number field, default TILE
+ *
+ * At level n the bounding box of the shapefile is divided into
+ * 2^n x 2^n tiles numbered along the Hilbert curve, hence elements
+ * with equal tile numbers are stored consecutively in the output.
+ *
+ * Only the sort keys are held in memory, the records and attribute
+ * rows are copied in the sorted order from the memory mapped input.
+ * Null elements are moved to the end.
+ */
+// ======================================================================
+
+#include "ShpFile.h"
+#include <newbase/NFmiCmdLine.h>
+#include <newbase/NFmiStringTools.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Options holder
+ */
+// ----------------------------------------------------------------------
+
+struct Options
+{
+  string inputfile;
+  string outputfile;
+  bool verbose;
+  int tilelevel;
+  string tilefield;
+
+  Options() : inputfile(), outputfile(), verbose(false), tilelevel(0), tilefield("TILE") {}
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Global instance of the parsed command line options
+ */
+// ----------------------------------------------------------------------
+
+Options options;
+
+//! Width of the tile number field
+const int tile_field_width = 10;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Print usage
+ */
+// ----------------------------------------------------------------------
+
+void usage()
+{
+  cout << "Usage: shapesort [options] inputshape outputshape" << endl
+       << endl
+       << "shapesort sorts the elements of a shapefile along the Hilbert curve." << endl
+       << endl
+       << "The available options are:" << endl
+       << endl
+       << "\t-h\t\tprint this help information" << endl
+       << "\t-v\t\tverbose mode" << endl
+       << "\t-t [level]\tadd the Hilbert tile number at the given level 1-16" << endl
+       << "\t-n [name]\tthe name of the tile number field (default: TILE)" << endl
+       << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the command line
+ *
+ * \return False, if execution is to be stopped
+ */
+// ----------------------------------------------------------------------
+
+bool parse_command_line(int argc, const char *argv[])
+{
+  NFmiCmdLine cmdline(argc, argv, "hvt!n!");
+
+  if (cmdline.Status().IsError())
+    throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
+
+  if (cmdline.isOption('h'))
+  {
+    usage();
+    return false;
+  }
+
+  if (cmdline.NumberofParameters() != 2)
+    throw runtime_error("Incorrect number of command line parameters");
+
+  options.inputfile = cmdline.Parameter(1);
+  options.outputfile = cmdline.Parameter(2);
+
+  if (cmdline.isOption('v'))
+    options.verbose = true;
+
+  if (cmdline.isOption('t'))
+  {
+    options.tilelevel = NFmiStringTools::Convert<int>(cmdline.OptionValue('t'));
+    if (options.tilelevel < 1 || options.tilelevel > 16)
+      throw runtime_error("The tile level must be in the range 1-16");
+  }
+
+  if (cmdline.isOption('n'))
+    options.tilefield = cmdline.OptionValue('n');
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Strip a possible .shp suffix from a shapefile name
+ */
+// ----------------------------------------------------------------------
+
+string strip_suffix(const string &theName)
+{
+  if (theName.size() > 4 && theName.substr(theName.size() - 4) == ".shp")
+    return theName.substr(0, theName.size() - 4);
+  return theName;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The distance of a point along the Hilbert curve
+ *
+ * The curve fills a grid of 2^32 x 2^32 cells. Each step of the loop
+ * selects the quadrant of the point at the next finer level and
+ * rotates the coordinates so that the curve within the quadrant has
+ * the same orientation as the whole curve.
+ */
+// ----------------------------------------------------------------------
+
+uint64_t hilbert_key(uint32_t theX, uint32_t theY)
+{
+  uint64_t key = 0;
+  for (uint32_t s = 1u << 31; s > 0; s >>= 1)
+  {
+    const uint32_t rx = ((theX & s) != 0 ? 1 : 0);
+    const uint32_t ry = ((theY & s) != 0 ? 1 : 0);
+    key += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    if (ry == 0)
+    {
+      // Only the bits below s matter from here on
+      if (rx == 1)
+      {
+        theX = ~theX;
+        theY = ~theY;
+      }
+      swap(theX, theY);
+    }
+  }
+  return key;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map a coordinate to the Hilbert grid
+ */
+// ----------------------------------------------------------------------
+
+uint32_t grid_coordinate(double theValue, double theMin, double theMax)
+{
+  if (!(theMax > theMin))
+    return 0;
+  const double scale = numeric_limits<uint32_t>::max() / (theMax - theMin);
+  const double value = (theValue - theMin) * scale;
+  if (!(value > 0))
+    return 0;
+  if (value >= numeric_limits<uint32_t>::max())
+    return numeric_limits<uint32_t>::max();
+  return static_cast<uint32_t>(value);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The sort key of an element
+ *
+ * Null elements are flagged separately, since every 64-bit value is a
+ * possible Hilbert key. They sort after all other elements, and ties
+ * are broken by the original order to keep the sort stable.
+ */
+// ----------------------------------------------------------------------
+
+struct SortKey
+{
+  bool null;
+  uint64_t key;
+  size_t index;
+
+  bool operator<(const SortKey &theOther) const
+  {
+    if (null != theOther.null)
+      return theOther.null;
+    if (key != theOther.key)
+      return key < theOther.key;
+    return index < theOther.index;
+  }
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program without exception handling
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, const char *argv[])
+{
+  if (!parse_command_line(argc, argv))
+    return 0;
+
+  // The output would truncate the mapped input
+
+  if (strip_suffix(options.inputfile) == strip_suffix(options.outputfile))
+    throw runtime_error("The input and output shapefiles must be different");
+
+  const ShpFile::MappedReader reader(options.inputfile);
+  const ShpFile::MappedDbf dbf(options.inputfile);
+
+  if (dbf.size() != reader.size())
+    throw runtime_error("The number of records in the .shp and .dbf files of '" +
+                        options.inputfile + "' differ");
+
+  // The extent of the data, the header may be out of date
+
+  vector<ShpFile::Box> boxes(reader.size());
+  ShpFile::Box extent;
+  for (size_t i = 0; i < reader.size(); i++)
+  {
+    const ShpFile::Record record = reader.record(i);
+    if (record.type() != 0)
+    {
+      boxes[i] = record.box();
+      if (!boxes[i].empty())
+        extent.update(boxes[i]);
+    }
+  }
+
+  // Sort by the Hilbert keys of the box centers, null elements last
+
+  vector<SortKey> keys(reader.size());
+  for (size_t i = 0; i < reader.size(); i++)
+  {
+    keys[i].null = boxes[i].empty();
+    keys[i].key = 0;
+    keys[i].index = i;
+    if (!keys[i].null)
+    {
+      const double x = 0.5 * (boxes[i].xmin + boxes[i].xmax);
+      const double y = 0.5 * (boxes[i].ymin + boxes[i].ymax);
+      keys[i].key = hilbert_key(grid_coordinate(x, extent.xmin, extent.xmax),
+                                grid_coordinate(y, extent.ymin, extent.ymax));
+    }
+  }
+  vector<ShpFile::Box>().swap(boxes);
+
+  sort(keys.begin(), keys.end());
+
+  // Write the records and rows in the sorted order
+
+  if (options.verbose)
+    cout << "Writing '" << options.outputfile << "'" << endl;
+
+  const bool tiles = (options.tilelevel > 0);
+
+  string dbfheader = dbf.header();
+  if (tiles)
+    dbfheader = ShpFile::addDbfField(dbfheader, options.tilefield, 'N', tile_field_width);
+
+  ShpFile::Writer writer(options.outputfile, reader.header());
+  ShpFile::DbfWriter dbfwriter(options.outputfile, dbfheader);
+
+  const int tileshift = 2 * (32 - options.tilelevel);
+
+  string row;
+  for (size_t k = 0; k < keys.size(); k++)
+  {
+    const size_t i = keys[k].index;
+    const ShpFile::Record record = reader.record(i);
+    writer.write(record.data(), record.size());
+
+    if (!tiles)
+      dbfwriter.write(dbf.row(i));
+    else
+    {
+      row.assign(dbf.row(i), dbf.rowLength());
+      if (keys[k].null)
+        row.append(tile_field_width, ' ');
+      else
+      {
+        char value[tile_field_width + 1];
+        snprintf(value,
+                 sizeof(value),
+                 "%*llu",
+                 tile_field_width,
+                 static_cast<unsigned long long>(keys[k].key >> tileshift));
+        row += value;
+      }
+      dbfwriter.write(row);
+    }
+  }
+
+  writer.close();
+  dbfwriter.close();
+
+  if (options.verbose)
+    cout << "Sorted " << writer.size() << " elements" << endl;
+
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program
+ */
+// ----------------------------------------------------------------------
+
+int main(int argc, const char *argv[])
+{
+  try
+  {
+    return domain(argc, argv);
+  }
+  catch (std::exception &e)
+  {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  catch (...)
+  {
+    cerr << "Error: Caught an unknown exception" << endl;
+    return 1;
+  }
+}
+
+// ======================================================================
@@ -0,0 +1,430 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of shapetopo for building shared arc topologies
+ */
+// ======================================================================
+/*!
+ * \page shapetopo shapetopo
+ *
+ * shapetopo decomposes a polygon shapefile into unique arcs, each
+ * shared boundary being stored only once along with the elements on
+ * its both sides, and saves the result into a binary topology file.
+ * Borders, coastlines and dissolved polygons can then be extracted
+ * from the topology file repeatedly without recounting the edges.
+ *
+ * Usage:
+ * \code
+ * shapetopo [options] build <inputshape> <topofile>
+ * shapetopo [options] borders <topofile> <outputshape>
+ * shapetopo [options] coastlines <topofile> <outputshape>
+ * shapetopo [options] dissolve <topofile> <field> <inputshape> <outputshape>
+ * \endcode
+ *
+ * The borders are the arcs shared by two elements, the coastlines
+ * the arcs belonging to a single element. Both are written as
+ * polylines with the record numbers of the elements on the left and
+ * right sides as attributes LEFT and RIGHT. Dissolving merges the
+ * polygons with equal values of the given field, the attributes are
+ * read from the original shapefile.
+ *
+ * The available options are
+ *
+ *   - -h             print the help information
+ *   - -s [tolerance] simplify the arcs before the extraction
+ *
+ * Since shared boundaries are simplified only once, neighbouring
+ * polygons remain consistent.
+ */
+// ======================================================================
+
+#include "Polygon.h"
+#include "ShapeLoader.h"
+#include "ShpFile.h"
+#include "Topology.h"
+#include <imagine/NFmiEsriAttribute.h>
+#include <imagine/NFmiEsriPoint.h>
+#include <imagine/NFmiEsriPolyLine.h>
+#include <imagine/NFmiEsriPolygon.h>
+#include <imagine/NFmiEsriShape.h>
+#include <newbase/NFmiCmdLine.h>
+#include <newbase/NFmiStringTools.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Imagine;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Options holder
+ */
+// ----------------------------------------------------------------------
+
+struct Options
+{
+  vector<string> parameters;
+  double tolerance;
+
+  Options() : parameters(), tolerance(0) {}
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Global instance of the parsed command line options
+ */
+// ----------------------------------------------------------------------
+
+Options options;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Print usage
+ */
+// ----------------------------------------------------------------------
+
+void usage()
+{
+  cout << "Usage: shapetopo [options] build <inputshape> <topofile>" << endl
+       << "       shapetopo [options] borders <topofile> <outputshape>" << endl
+       << "       shapetopo [options] coastlines <topofile> <outputshape>" << endl
+       << "       shapetopo [options] dissolve <topofile> <field> <inputshape> <outputshape>"
+       << endl
+       << endl
+       << "shapetopo builds and uses shared arc topologies of polygon shapefiles." << endl
+       << endl
+       << "The available options are:" << endl
+       << endl
+       << "\t-h\t\tprint this help information" << endl
+       << "\t-s [tolerance]\tsimplify the arcs before extraction" << endl
+       << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the command line
+ *
+ * \return False, if execution is to be stopped
+ */
+// ----------------------------------------------------------------------
+
+bool parse_command_line(int argc, const char *argv[])
+{
+  NFmiCmdLine cmdline(argc, argv, "hs!");
+
+  if (cmdline.Status().IsError())
+    throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
+
+  if (cmdline.isOption('h'))
+  {
+    usage();
+    return false;
+  }
+
+  for (int i = 1; i <= cmdline.NumberofParameters(); i++)
+    options.parameters.push_back(cmdline.Parameter(i));
+
+  if (options.parameters.empty())
+    throw runtime_error("No command given");
+
+  const string &command = options.parameters[0];
+  const size_t expected = (command == "dissolve" ? 5 : 3);
+  if (command != "build" && command != "borders" && command != "coastlines" &&
+      command != "dissolve")
+    throw runtime_error("Unknown command '" + command + "'");
+  if (options.parameters.size() != expected)
+    throw runtime_error("Incorrect number of command line parameters for '" + command + "'");
+
+  if (cmdline.isOption('s'))
+  {
+    options.tolerance = NFmiStringTools::Convert<double>(cmdline.OptionValue('s'));
+    if (options.tolerance < 0)
+      throw runtime_error("Simplification tolerance must be nonnegative");
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the topology of a shapefile and save it
+ */
+// ----------------------------------------------------------------------
+
+void build(const string &theShape, const string &theTopology)
+{
+  ShpFile::Reader reader(theShape);
+
+  vector<Polygon> rings;
+  vector<long> elements;
+  string contents;
+
+  for (size_t i = 0; i < reader.size(); i++)
+  {
+    reader.read(i, contents);
+    const ShpFile::Record record(contents.data(), contents.size());
+    if (record.type() == 0)
+      continue;
+    if (record.type() != 5 && record.type() != 15 && record.type() != 25)
+      throw runtime_error("Shapefile '" + theShape + "' does not contain polygons");
+
+    for (int part = 0; part < record.numParts(); part++)
+    {
+      const int first = max(0, record.part(part));
+      const int last =
+          (part + 1 < record.numParts() ? record.part(part + 1) : record.numPoints());
+      Polygon ring;
+      for (int p = first; p < last && p < record.numPoints(); p++)
+        ring.add(Point(record.x(p), record.y(p)));
+      rings.push_back(ring);
+      elements.push_back(i);
+    }
+  }
+
+  Topology topology;
+  topology.build(rings, elements, reader.size());
+
+  size_t shared = 0;
+  for (size_t a = 0; a < topology.arcs(); a++)
+    if (topology.left(a) >= 0)
+      ++shared;
+
+  cout << "Built " << topology.arcs() << " arcs of which " << shared << " are shared from "
+       << rings.size() << " rings in " << reader.size() << " records" << endl;
+  if (topology.sharedTooMany() > 0)
+    cout << "Warning: " << topology.sharedTooMany()
+         << " segments are shared by more than two rings" << endl;
+
+  topology.write(theTopology);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Load a topology and simplify it if so requested
+ */
+// ----------------------------------------------------------------------
+
+void load(const string &theFile, Topology &theTopology)
+{
+  theTopology.read(theFile);
+  if (options.tolerance > 0)
+    theTopology.simplify(options.tolerance);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract borders or coastlines
+ */
+// ----------------------------------------------------------------------
+
+void extract_arcs(const string &theTopology, const string &theOutput, bool theBorders)
+{
+  Topology topology;
+  load(theTopology, topology);
+
+  NFmiEsriShape shape(kFmiEsriPolyLine);
+  NFmiEsriAttributeName *leftname = new NFmiEsriAttributeName("LEFT", kFmiEsriInteger, 10, 0);
+  NFmiEsriAttributeName *rightname = new NFmiEsriAttributeName("RIGHT", kFmiEsriInteger, 10, 0);
+  shape.Add(leftname);
+  shape.Add(rightname);
+
+  size_t count = 0;
+  for (size_t a = 0; a < topology.arcs(); a++)
+  {
+    const bool shared = (topology.left(a) >= 0);
+    if (shared != theBorders)
+      continue;
+
+    // A ring touching itself is not a border
+    if (theBorders && topology.left(a) == topology.right(a))
+      continue;
+
+    NFmiEsriPolyLine *line = new NFmiEsriPolyLine;
+    line->Add(NFmiEsriAttribute(static_cast<int>(topology.left(a)), leftname));
+    line->Add(NFmiEsriAttribute(static_cast<int>(topology.right(a)), rightname));
+    for (size_t i = topology.arcBegin(a); i < topology.arcEnd(a); i++)
+      line->Add(NFmiEsriPoint(topology.x(i), topology.y(i)));
+    shape.Add(line);
+    ++count;
+  }
+
+  cout << "Writing " << count << (theBorders ? " borders" : " coastlines") << " to " << theOutput
+       << endl;
+  if (!shape.Write(theOutput))
+    throw runtime_error("Failed to write shape '" + theOutput + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value of a field as a string for grouping
+ */
+// ----------------------------------------------------------------------
+
+string field_value(const NFmiEsriElement &theElement,
+                   const string &theField,
+                   NFmiEsriAttributeType theType)
+{
+  switch (theType)
+  {
+    case kFmiEsriString:
+      return theElement.GetString(theField);
+    case kFmiEsriInteger:
+      return NFmiStringTools::Convert(theElement.GetInteger(theField));
+    case kFmiEsriDouble:
+      return NFmiStringTools::Convert(theElement.GetDouble(theField));
+    default:
+      throw runtime_error("Field '" + theField + "' is of an unsupported type for dissolving");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Dissolve polygons with equal field values
+ */
+// ----------------------------------------------------------------------
+
+void dissolve(const string &theTopology,
+              const string &theField,
+              const string &theInput,
+              const string &theOutput)
+{
+  Topology topology;
+  load(theTopology, topology);
+
+  const unique_ptr<NFmiEsriShape> inputptr = ShapeLoader::read(theInput, true);
+  const NFmiEsriShape &input = *inputptr;
+
+  const NFmiEsriShape::elements_type &elements = input.Elements();
+  if (elements.size() != topology.elements())
+    throw runtime_error("Shape '" + theInput + "' does not match the topology");
+
+  const NFmiEsriAttributeName *field = input.AttributeName(theField);
+  if (field == nullptr)
+    throw runtime_error("Shape '" + theInput + "' has no field '" + theField + "'");
+  const NFmiEsriAttributeType type = field->Type();
+
+  // Number the distinct field values in the order of appearance
+
+  map<string, long> groupnumbers;
+  vector<const NFmiEsriElement *> representatives;
+  vector<long> groups(elements.size(), -1);
+  for (size_t i = 0; i < elements.size(); i++)
+  {
+    if (elements[i] == nullptr)
+      continue;
+    const string value = field_value(*elements[i], theField, type);
+    const long number = static_cast<long>(representatives.size());
+    const pair<map<string, long>::iterator, bool> ret =
+        groupnumbers.insert(make_pair(value, number));
+    if (ret.second)
+      representatives.push_back(elements[i]);
+    groups[i] = ret.first->second;
+  }
+
+  vector<long> ringgroups;
+  const vector<Polygon> rings = topology.dissolve(groups, ringgroups);
+
+  // One polygon per group with all its rings as parts
+
+  NFmiEsriShape shape(kFmiEsriPolygon);
+  NFmiEsriAttributeName *attribute = new NFmiEsriAttributeName(*field);
+  shape.Add(attribute);
+
+  vector<NFmiEsriPolygon *> polygons(representatives.size(), nullptr);
+  for (size_t r = 0; r < rings.size(); r++)
+  {
+    const long g = ringgroups[r];
+    NFmiEsriPolygon *&polygon = polygons[g];
+    if (polygon == nullptr)
+    {
+      polygon = new NFmiEsriPolygon;
+      const NFmiEsriElement &rep = *representatives[g];
+      if (type == kFmiEsriString)
+        polygon->Add(NFmiEsriAttribute(rep.GetString(theField), attribute));
+      else if (type == kFmiEsriInteger)
+        polygon->Add(NFmiEsriAttribute(rep.GetInteger(theField), attribute));
+      else
+        polygon->Add(NFmiEsriAttribute(rep.GetDouble(theField), attribute));
+    }
+
+    const Polygon::DataType &pts = rings[r].data();
+    for (size_t i = 0; i < pts.size(); i++)
+    {
+      if (i == 0)
+        polygon->AddPart(NFmiEsriPoint(pts[i].x(), pts[i].y()));
+      else
+        polygon->Add(NFmiEsriPoint(pts[i].x(), pts[i].y()));
+    }
+  }
+
+  size_t count = 0;
+  for (NFmiEsriPolygon *polygon : polygons)
+    if (polygon != nullptr)
+    {
+      shape.Add(polygon);
+      ++count;
+    }
+
+  cout << "Writing " << count << " dissolved polygons with " << rings.size() << " rings to "
+       << theOutput << endl;
+  if (!shape.Write(theOutput))
+    throw runtime_error("Failed to write shape '" + theOutput + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The main program without error trapping
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, const char *argv[])
+{
+  if (!parse_command_line(argc, argv))
+    return 0;
+
+  const vector<string> &params = options.parameters;
+  const string &command = params[0];
+
+  if (command == "build")
+    build(params[1], params[2]);
+  else if (command == "borders")
+    extract_arcs(params[1], params[2], true);
+  else if (command == "coastlines")
+    extract_arcs(params[1], params[2], false);
+  else
+    dissolve(params[1], params[2], params[3], params[4]);
+
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program
+ */
+// ----------------------------------------------------------------------
+
+int main(int argc, const char *argv[])
+{
+  try
+  {
+    return domain(argc, argv);
+  }
+  catch (std::exception &e)
+  {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  catch (...)
+  {
+    cerr << "Error: Caught an unknown exception" << endl;
+    return 1;
+  }
+}
+
+// ======================================================================
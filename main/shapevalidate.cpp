@@ -0,0 +1,405 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of shapevalidate for checking polygon shapefiles
+ */
+// ======================================================================
+/*!
+ * \page shapevalidate shapevalidate
+ *
+ * shapevalidate checks the rings of a polygon shapefile before they
+ * are used for triangulation or other processing relying on valid
+ * geometry.
+ *
+ * Usage:
+ * \code
+ * shapevalidate [options] inputshape
+ * \endcode
+ *
+ * The available options are
+ *
+ *   - -a               check intersections between different records too
+ *   - -h               print the help information
+ *   - -q               print only the summary
+ *   - -r [outputshape] write a repaired copy of the shapefile
+ *
+ * The problems reported are rings with too few points, unclosed rings,
+ * duplicate consecutive vertices, and segments crossing, touching or
+ * overlapping other segments of the same ring or of any other ring of
+ * the same record. Rings may touch each other at common vertices. The
+ * rings of different records are tested against each other only if
+ * option -a is given, since neighbouring polygons such as the
+ * municipalities of a country share their borders. A summary of the
+ * ring orientations is printed too, in shapefiles the outer rings
+ * should be clockwise and the holes counter-clockwise.
+ *
+ * The repair removes duplicate consecutive vertices, closes unclosed
+ * rings and drops rings with less than 3 distinct points. Records
+ * without any remaining rings are written as null shapes so that the
+ * attributes stay in sync. Intersections are not repaired. Only 2D
+ * polygons are repaired, other records are copied as is.
+ *
+ * The exit status is 1 if any problems were found in the input,
+ * hence the program can be used as the first stage of batch jobs.
+ */
+// ======================================================================
+
+#include "Point.h"
+#include "Polygon.h"
+#include "ShpFile.h"
+#include "Validation.h"
+#include <newbase/NFmiCmdLine.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Options holder
+ */
+// ----------------------------------------------------------------------
+
+struct Options
+{
+  string inputfile;
+  string outputfile;
+  bool allrecords;
+  bool quiet;
+  bool repair;
+
+  Options() : inputfile(), outputfile(), allrecords(false), quiet(false), repair(false) {}
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Global instance of the parsed command line options
+ */
+// ----------------------------------------------------------------------
+
+Options options;
+
+//! The origin of a ring in the shapefile
+struct RingOrigin
+{
+  size_t record;
+  int part;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Print usage
+ */
+// ----------------------------------------------------------------------
+
+void usage()
+{
+  cout << "Usage: shapevalidate [options] inputshape" << endl
+       << endl
+       << "shapevalidate checks the rings of polygon shapefiles." << endl
+       << endl
+       << "The available options are:" << endl
+       << endl
+       << "\t-a\t\tcheck intersections between different records too" << endl
+       << "\t-h\t\tprint this help information" << endl
+       << "\t-q\t\tprint only the summary" << endl
+       << "\t-r [shape]\twrite a repaired shapefile" << endl
+       << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the command line
+ *
+ * \return False, if execution is to be stopped
+ */
+// ----------------------------------------------------------------------
+
+bool parse_command_line(int argc, const char *argv[])
+{
+  NFmiCmdLine cmdline(argc, argv, "ahqr!");
+
+  if (cmdline.Status().IsError())
+    throw runtime_error(cmdline.Status().ErrorLog().CharPtr());
+
+  if (cmdline.isOption('h'))
+  {
+    usage();
+    return false;
+  }
+
+  if (cmdline.NumberofParameters() != 1)
+    throw runtime_error("Incorrect number of command line parameters");
+
+  options.inputfile = cmdline.Parameter(1);
+
+  if (cmdline.isOption('a'))
+    options.allrecords = true;
+
+  if (cmdline.isOption('q'))
+    options.quiet = true;
+
+  if (cmdline.isOption('r'))
+  {
+    options.repair = true;
+    options.outputfile = cmdline.OptionValue('r');
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the shape type is a polygon type
+ */
+// ----------------------------------------------------------------------
+
+bool is_polygon(int theType)
+{
+  return (theType == 5 || theType == 15 || theType == 25);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract the rings of a polygon record
+ */
+// ----------------------------------------------------------------------
+
+void extract_rings(const ShpFile::Record &theRecord,
+                   size_t theIndex,
+                   vector<Polygon> &theRings,
+                   vector<RingOrigin> &theOrigins)
+{
+  for (int part = 0; part < theRecord.numParts(); part++)
+  {
+    const int first = theRecord.part(part);
+    const int last =
+        (part + 1 < theRecord.numParts() ? theRecord.part(part + 1) : theRecord.numPoints());
+
+    Polygon ring;
+    for (int i = max(0, first); i < last && i < theRecord.numPoints(); i++)
+      ring.add(Point(theRecord.x(i), theRecord.y(i)));
+
+    RingOrigin origin;
+    origin.record = theIndex;
+    origin.part = part;
+    theRings.push_back(ring);
+    theOrigins.push_back(origin);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a 2D polygon record from rings
+ *
+ * A null shape is returned if there are no rings.
+ */
+// ----------------------------------------------------------------------
+
+string build_polygon(const vector<Polygon> &theRings)
+{
+  size_t npoints = 0;
+  for (const Polygon &ring : theRings)
+    npoints += ring.data().size();
+
+  if (theRings.empty())
+  {
+    string contents(4, '\0');
+    ShpFile::putLittleInt(&contents[0], 0);
+    return contents;
+  }
+
+  const size_t partsoffset = 44;
+  const size_t pointsoffset = partsoffset + 4 * theRings.size();
+  string contents(pointsoffset + 16 * npoints, '\0');
+  char *data = &contents[0];
+
+  ShpFile::putLittleInt(data, 5);
+  ShpFile::putLittleInt(data + 36, static_cast<int>(theRings.size()));
+  ShpFile::putLittleInt(data + 40, static_cast<int>(npoints));
+
+  ShpFile::Box box;
+  size_t pos = 0;
+  for (size_t r = 0; r < theRings.size(); r++)
+  {
+    ShpFile::putLittleInt(data + partsoffset + 4 * r, static_cast<int>(pos));
+    for (const Point &pt : theRings[r].data())
+    {
+      ShpFile::putLittleDouble(data + pointsoffset + 16 * pos, pt.x());
+      ShpFile::putLittleDouble(data + pointsoffset + 16 * pos + 8, pt.y());
+      box.update(pt.x(), pt.y());
+      ++pos;
+    }
+  }
+
+  ShpFile::putLittleDouble(data + 4, box.xmin);
+  ShpFile::putLittleDouble(data + 12, box.ymin);
+  ShpFile::putLittleDouble(data + 20, box.xmax);
+  ShpFile::putLittleDouble(data + 28, box.ymax);
+
+  return contents;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the repaired shapefile
+ */
+// ----------------------------------------------------------------------
+
+void write_repaired(ShpFile::Reader &theReader,
+                    const vector<Polygon> &theRings,
+                    const vector<RingOrigin> &theOrigins)
+{
+  ShpFile::Writer writer(options.outputfile, theReader.header());
+
+  size_t next = 0;  // next ring to process
+  size_t repaired = 0;
+  size_t dropped = 0;
+  string contents;
+
+  for (size_t i = 0; i < theReader.size(); i++)
+  {
+    theReader.read(i, contents);
+    const ShpFile::Record record(contents.data(), contents.size());
+
+    if (record.type() != 5)
+    {
+      while (next < theRings.size() && theOrigins[next].record == i)
+        ++next;
+      writer.write(contents);
+      continue;
+    }
+
+    vector<Polygon> rings;
+    for (; next < theRings.size() && theOrigins[next].record == i; ++next)
+    {
+      const Polygon ring = Validation::repair(theRings[next]);
+      if (ring.empty())
+        ++dropped;
+      else
+      {
+        if (ring.data() != theRings[next].data())
+          ++repaired;
+        rings.push_back(ring);
+      }
+    }
+
+    writer.write(build_polygon(rings));
+  }
+
+  writer.close();
+  ShpFile::copyDbf(options.inputfile, options.outputfile);
+
+  cout << "Repaired " << repaired << " rings and dropped " << dropped << " rings" << endl;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The main program without error trapping
+ */
+// ----------------------------------------------------------------------
+
+int domain(int argc, const char *argv[])
+{
+  if (!parse_command_line(argc, argv))
+    return 0;
+
+  ShpFile::Reader reader(options.inputfile);
+
+  // Collect the rings of all polygon records
+
+  vector<Polygon> rings;
+  vector<RingOrigin> origins;
+
+  string contents;
+  for (size_t i = 0; i < reader.size(); i++)
+  {
+    reader.read(i, contents);
+    const ShpFile::Record record(contents.data(), contents.size());
+    if (is_polygon(record.type()))
+      extract_rings(record, i, rings, origins);
+  }
+
+  // Validate them, by default the rings of each record separately
+
+  vector<size_t> groups;
+  for (const RingOrigin &origin : origins)
+    groups.push_back(options.allrecords ? 0 : origin.record);
+
+  const vector<Validation::Problem> problems = Validation::validate(rings, groups);
+
+  if (!options.quiet)
+  {
+    for (const Validation::Problem &problem : problems)
+    {
+      const RingOrigin &origin = origins[problem.ring];
+      cout << "Record " << origin.record << " part " << origin.part << " vertex "
+           << problem.vertex << ": " << Validation::describe(problem.type);
+
+      if (problem.type == Validation::kCrossing || problem.type == Validation::kTouching ||
+          problem.type == Validation::kOverlap)
+      {
+        const RingOrigin &other = origins[problem.otherRing];
+        cout << " with record " << other.record << " part " << other.part << " vertex "
+             << problem.otherVertex;
+      }
+      cout << " at " << problem.where.x() << "," << problem.where.y() << endl;
+    }
+  }
+
+  // Summary
+
+  size_t clockwise = 0;
+  size_t counterclockwise = 0;
+  size_t degenerate = 0;
+  for (const Polygon &ring : rings)
+  {
+    const int orientation = Validation::orientation(ring);
+    if (orientation < 0)
+      ++clockwise;
+    else if (orientation > 0)
+      ++counterclockwise;
+    else
+      ++degenerate;
+  }
+
+  cout << "Checked " << rings.size() << " rings in " << reader.size() << " records: "
+       << clockwise << " clockwise, " << counterclockwise << " counter-clockwise, "
+       << degenerate << " degenerate" << endl;
+  cout << "Found " << problems.size() << " problems" << endl;
+
+  if (options.repair)
+    write_repaired(reader, rings, origins);
+
+  return (problems.empty() ? 0 : 1);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main program
+ */
+// ----------------------------------------------------------------------
+
+int main(int argc, const char *argv[])
+{
+  try
+  {
+    return domain(argc, argv);
+  }
+  catch (std::exception &e)
+  {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  catch (...)
+  {
+    cerr << "Error: Caught an unknown exception" << endl;
+    return 1;
+  }
+}
+
+// ======================================================================
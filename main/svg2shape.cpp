@@ -4,9 +4,13 @@
  * \brief A program to convert files generated by shape2svg back to shapes
  *
  * Command line: svg2shape -o foobar -f AREA *.svg
+ *
+ * With -F fgb or -F gpkg the output is written through OGR as
+ * FlatGeobuf or GeoPackage, both of which include a spatial index.
  */
 // ======================================================================
 
+#include "OgrWriter.h"
 #include <imagine/NFmiEsriPolygon.h>
 #include <imagine/NFmiEsriShape.h>
 #include <newbase/NFmiSvgPath.h>
@@ -33,9 +37,10 @@ struct Options
   std::vector<std::string> infiles;
   std::string shapename;  // -o --shape
   std::string fieldname;  // -f --field
+  std::string format;     // -F --format
 };
 
-Options::Options() : infiles(), shapename("out"), fieldname("NAME") {}
+Options::Options() : infiles(), shapename("out"), fieldname("NAME"), format("shape") {}
 
 Options options;
 
@@ -60,7 +65,8 @@ bool parse_options(int argc, char *argv[])
                                                                          po::value(
                                                                              &options.shapename),
                                                                          "field name for the paths "
-                                                                         "('NAME')");
+                                                                         "('NAME')")(
+      "format,F", po::value(&options.format), "output format: shape, fgb or gpkg ('shape')");
 
   po::positional_options_description p;
   p.add("infiles", -1);
@@ -88,6 +94,8 @@ bool parse_options(int argc, char *argv[])
   if (options.infiles.empty())
     throw std::runtime_error("No input files given");
 
+  OgrWriter::checkFormat(options.format);
+
   return true;
 }
 
@@ -192,7 +200,10 @@ void make_shape(const std::map<std::string, NFmiSvgPath> &paths)
     shape.Add(polygon);
   }
 
-  shape.Write(options.shapename);
+  if (OgrWriter::isOgrFormat(options.format))
+    OgrWriter::write(shape, options.shapename, options.format);
+  else
+    shape.Write(options.shapename);
 }
 
 // ----------------------------------------------------------------------
@@ -16,16 +16,20 @@
  * The program will generate shape.shp and shape.dbf. The
  * last one is empty.
  *
+ * The PSLG files may be in text or binary form.
+ *
  */
 // ======================================================================
 
+#include "Amalgamation.h"
 #include "Point.h"
 #include "Polygon.h"
-#include <imagine/NFmiEdgeTree.h>
+#include "Pslg.h"
 #include <imagine/NFmiEsriPolygon.h>
 #include <imagine/NFmiEsriShape.h>
-#include <fstream>
+#include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -45,137 +49,61 @@ int main(int argc, char *argv[])
   string inname = argv[2];
   string shapename = argv[3];
 
-  // Read in the nodes
+  // Read in the nodes and the edges
 
-  vector<Point> nodes;
+  Pslg::NodeData nodes;
+  Pslg::PolyData poly;
+  try
   {
-    string filename = inname + ".node";
-    ifstream in(filename.c_str());
-    if (!in)
-    {
-      cerr << "Error: Could not open " << filename << " for reading" << endl;
-      return 1;
-    }
-    // First row: number_of_nodes dimension number_of_attributes
-    // number_of_boundary_markers
-
-    long number_of_nodes, dummy;
-    in >> number_of_nodes >> dummy >> dummy >> dummy;
-    nodes.reserve(number_of_nodes);
-    for (long i = 1; i <= number_of_nodes && !in.fail(); i++)
-    {
-      long node;
-      double x, y;
-      in >> node >> x >> y;
-      nodes[i] = Point(x, y);
-    }
-    if (in.fail())
-    {
-      cerr << "Error: Error reading " << filename << endl;
-      return 1;
-    }
-    in.close();
+    Pslg::read(inname + ".node", nodes);
+    Pslg::read(inname + ".poly", poly);
+  }
+  catch (std::exception &e)
+  {
+    cerr << e.what() << endl;
+    return 1;
   }
 
-  // Read the edges
-
-  Imagine::NFmiEdgeTree edges;
+  if (poly.nodes.size() != 0)
   {
-    string filename = inname + ".poly";
-    ifstream in(filename.c_str());
-    if (!in)
-    {
-      cerr << "Error: Could not open " << filename << " for reading" << endl;
-      return 1;
-    }
-    // First row: number_of_nodes dimension number_of_attributes
-    // number_of_boundary_markers
-    long number_of_nodes, dummy;
-    in >> number_of_nodes >> dummy >> dummy >> dummy;
-    if (number_of_nodes != 0)
-    {
-      cerr << "Error: .poly file also containing nodes is not supported" << endl;
-      return 1;
-    }
-    // Second row: number_of_edges number_of_boundary_markers
-    long number_of_edges;
-    in >> number_of_edges >> dummy;
-    for (long i = 1; i <= number_of_edges && !in.fail(); i++)
-    {
-      long edge, idx1, idx2;
-      in >> edge >> idx1 >> idx2;
-      cout << edge << '\t' << idx1 << '\t' << idx2 << endl;
-
-      if (edge != i)
-      {
-        cerr << "Error: Edges must be numbered sequentially starting from 1 in "
-                "file "
-             << filename << endl;
-        return 1;
-      }
-      Imagine::NFmiEdge tmp(
-          nodes[idx1].x(), nodes[idx1].y(), nodes[idx2].x(), nodes[idx2].y(), true, false);
-      if (edge == 85)
-        cout << "Edge 85!" << endl;
-      edges.Add(tmp);
-    }
+    cerr << "Error: .poly file also containing nodes is not supported" << endl;
+    return 1;
+  }
 
-    if (in.fail())
+  vector<Amalgamation::NodePair> edges;
+  edges.reserve(poly.size());
+  for (size_t i = 0; i < poly.size(); i++)
+  {
+    const long idx1 = poly.idx1[i] - nodes.first;
+    const long idx2 = poly.idx2[i] - nodes.first;
+    if (idx1 < 0 || idx2 < 0 || idx1 >= static_cast<long>(nodes.size()) ||
+        idx2 >= static_cast<long>(nodes.size()))
     {
-      cerr << "Error: Error reading " << filename << endl;
+      cerr << "Error: Edge " << i + 1 << " refers to a nonexistent node" << endl;
       return 1;
     }
-    in.close();
+    edges.push_back(Amalgamation::NodePair(idx1, idx2));
   }
 
-  // Build a path from the edges
+  // Edges occurring twice cancel each other, the rest are chained into rings
 
-  Imagine::NFmiPath path = edges.Path();
+  Amalgamation::cancelPairs(edges);
+  const vector<Polygon> rings = Amalgamation::rings(nodes.x, nodes.y, edges);
 
-  // Convert individual closed segments into polygons
-  // As soon as a polygon becomes closed, we output
-  // it as an ESRI shape
+  // Output the large enough rings as ESRI shapes
 
   {
     Imagine::NFmiEsriShape shape;
-    Polygon poly;
-
-    const Imagine::NFmiPathData::const_iterator begin = path.Elements().begin();
-    const Imagine::NFmiPathData::const_iterator end = path.Elements().end();
 
-    for (Imagine::NFmiPathData::const_iterator iter = begin; iter != end;)
+    for (const Polygon &ring : rings)
     {
-      bool doflush = false;
-      // Huom! Jostain syyst g++ knt vrin (iter++==end), pakko tehd nin
-      if ((*iter).Oper() == Imagine::kFmiMoveTo)
-        doflush = true;
-      else if (++iter == end)
-      {
-        --iter;
-        poly.add(Point((*iter).X(), (*iter).Y()));
-        doflush = true;
-      }
-      else
-        --iter;
-
-      if (doflush && !poly.empty())
-      {
-        if (arealimit <= 0 || poly.geoarea() >= arealimit)
-        {
-          // Convert to NFmiEsriPolygon
-          Imagine::NFmiEsriPolygon *p = new Imagine::NFmiEsriPolygon();
-          Polygon::DataType::const_iterator b = poly.data().begin();
-          Polygon::DataType::const_iterator e = poly.data().end();
-          for (Polygon::DataType::const_iterator it = b; it != e; ++it)
-            p->Add(Imagine::NFmiEsriPoint(it->x(), it->y()));
-          // And add to output
-          shape.Add(p);
-        }
-        poly.clear();
-      }
-
-      poly.add(Point((*iter).X(), (*iter).Y()));
-      ++iter;
+      if (arealimit > 0 && ring.geoarea() < arealimit)
+        continue;
+
+      Imagine::NFmiEsriPolygon *p = new Imagine::NFmiEsriPolygon();
+      for (const Point &pt : ring.data())
+        p->Add(Imagine::NFmiEsriPoint(pt.x(), pt.y()));
+      shape.Add(p);
     }
 
     if (!shape.Write(shapename))
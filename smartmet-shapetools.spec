@@ -32,6 +32,7 @@ Requires: smartmet-library-imagine >= 24.8.7
 Requires: smartmet-library-newbase >= 24.8.7
 Requires: smartmet-library-macgyver >= 24.8.7
 Requires: smartmet-library-gis >= 24.8.7
+Requires: gdal38-libs
 Requires: %{smartmet_boost}-iostreams
 Requires: %{smartmet_boost}-filesystem
 Requires: %{smartmet_boost}-program-options
@@ -55,12 +56,17 @@ Provides: shape2ps
 Provides: shape2svg
 Provides: shape2triangle
 Provides: shape2xml
+Provides: shapeamalgamate
+Provides: shapecache
 Provides: shapedump
 Provides: shapefilter
 Provides: shapefind
 Provides: shapepack
 Provides: shapepoints
 Provides: shapeproject
+Provides: shapesort
+Provides: shapetopo
+Provides: shapevalidate
 Provides: svg2shape
 Provides: triangle2shape
 
@@ -99,11 +105,16 @@ rm -rf $RPM_BUILD_ROOT
 /usr/bin/triangle2shape
 /usr/bin/shape2triangle
 /usr/bin/amalgamate
+/usr/bin/shapeamalgamate
 /usr/bin/etopo2shape
 /usr/bin/lights2shape
 /usr/bin/shapepack
 /usr/bin/shapepick
 /usr/bin/shapefind
+/usr/bin/shapevalidate
+/usr/bin/shapetopo
+/usr/bin/shapecache
+/usr/bin/shapesort
 /usr/bin/svg2shape
 
 %changelog
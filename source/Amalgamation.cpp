@@ -0,0 +1,496 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace Amalgamation
+ */
+// ======================================================================
+
+#include "Amalgamation.h"
+#include "Point.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+namespace
+{
+//! Number of tiles per thread for load balancing
+const size_t tiles_per_thread = 4;
+
+//! Hash function for node index pairs
+struct NodePairHash
+{
+  size_t operator()(const Amalgamation::NodePair &thePair) const
+  {
+    return hash<size_t>()(thePair.first * 0x9E3779B97F4A7C15ULL ^ thePair.second);
+  }
+};
+
+//! Node coordinates prepared for the haversine formula
+struct GeoNodes
+{
+  vector<double> lon;     //!< longitude in radians
+  vector<double> lat;     //!< latitude in radians
+  vector<double> coslat;  //!< cosine of the latitude
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Prepare the nodes for the haversine formula
+ */
+// ----------------------------------------------------------------------
+
+void prepare_nodes(const vector<double> &theX, const vector<double> &theY, GeoNodes &theNodes)
+{
+  const double kpi = 3.14159265358979323848 / 180;
+  const size_t n = theX.size();
+  theNodes.lon.resize(n);
+  theNodes.lat.resize(n);
+  theNodes.coslat.resize(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    theNodes.lon[i] = kpi * theX[i];
+    theNodes.lat[i] = kpi * theY[i];
+    theNodes.coslat[i] = cos(theNodes.lat[i]);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Haversine distances for a batch of edges
+ *
+ * The arithmetic is the same as in Point::geodistance, hence
+ * the results are identical.
+ */
+// ----------------------------------------------------------------------
+
+void edge_lengths(const GeoNodes &theNodes,
+                  const vector<Amalgamation::NodePair> &theEdges,
+                  vector<double> &theLengths)
+{
+  const double R = 6371.220;
+  const double *lon = theNodes.lon.data();
+  const double *lat = theNodes.lat.data();
+  const double *coslat = theNodes.coslat.data();
+
+  theLengths.resize(theEdges.size());
+  for (size_t i = 0; i < theEdges.size(); i++)
+  {
+    const size_t a = theEdges[i].first;
+    const size_t b = theEdges[i].second;
+    const double sindx = sin((lon[b] - lon[a]) / 2);
+    const double sindy = sin((lat[b] - lat[a]) / 2);
+    const double h = sindy * sindy + coslat[a] * coslat[b] * sindx * sindx;
+    theLengths[i] = R * (2 * asin(min(1.0, sqrt(h))));
+  }
+}
+
+//! Shared state of the tile workers
+struct Job
+{
+  const GeoNodes *nodes;
+  const vector<size_t> *corners;
+  const vector<double> *regions;
+  double lengthlimit;
+  const vector<size_t> *tilestart;  //!< start of each tile in order
+  const vector<size_t> *order;      //!< triangle indices sorted by tile
+  vector<vector<Amalgamation::NodePair>> *results;
+  vector<char> *accepted;
+  atomic<size_t> next_tile;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Filter tiles until there are none left
+ */
+// ----------------------------------------------------------------------
+
+void process_tiles(Job &theJob)
+{
+  const vector<size_t> &corners = *theJob.corners;
+  const vector<double> &regions = *theJob.regions;
+  const vector<size_t> &order = *theJob.order;
+  const size_t ntiles = theJob.tilestart->size() - 1;
+
+  vector<pair<Amalgamation::NodePair, size_t>> slots;
+  vector<Amalgamation::NodePair> unique_edges;
+  vector<size_t> edgeids;
+  vector<double> lengths;
+
+  while (true)
+  {
+    const size_t tile = theJob.next_tile++;
+    if (tile >= ntiles)
+      break;
+
+    const size_t begin = (*theJob.tilestart)[tile];
+    const size_t end = (*theJob.tilestart)[tile + 1];
+
+    // Number the unique edges of the triangles outside the polygons,
+    // since the interior edges are shared by two triangles
+
+    slots.clear();
+    for (size_t k = begin; k < end; k++)
+    {
+      const size_t i = order[k];
+      if (regions[i] != 0)
+        continue;
+      for (int c = 0; c < 3; c++)
+      {
+        const size_t a = corners[3 * i + c];
+        const size_t b = corners[3 * i + (c == 2 ? 0 : c + 1)];
+        slots.push_back(make_pair(a < b ? make_pair(a, b) : make_pair(b, a), 3 * (k - begin) + c));
+      }
+    }
+    sort(slots.begin(), slots.end());
+
+    unique_edges.clear();
+    edgeids.resize(3 * (end - begin));
+    for (const pair<Amalgamation::NodePair, size_t> &slot : slots)
+    {
+      if (unique_edges.empty() || unique_edges.back() != slot.first)
+        unique_edges.push_back(slot.first);
+      edgeids[slot.second] = unique_edges.size() - 1;
+    }
+
+    edge_lengths(*theJob.nodes, unique_edges, lengths);
+
+    // Accept the triangles and collect their edges
+
+    vector<Amalgamation::NodePair> &edges = (*theJob.results)[tile];
+
+    for (size_t k = begin; k < end; k++)
+    {
+      const size_t i = order[k];
+
+      if (regions[i] == 0)
+      {
+        const size_t *ids = &edgeids[3 * (k - begin)];
+        if (lengths[ids[0]] > theJob.lengthlimit || lengths[ids[1]] > theJob.lengthlimit ||
+            lengths[ids[2]] > theJob.lengthlimit)
+          continue;
+      }
+
+      if (theJob.accepted != nullptr)
+        (*theJob.accepted)[i] = 1;
+
+      for (int c = 0; c < 3; c++)
+        edges.push_back(
+            make_pair(corners[3 * i + c], corners[3 * i + (c == 2 ? 0 : c + 1)]));
+    }
+
+    Amalgamation::cancelPairs(edges);
+  }
+}
+
+}  // namespace
+
+namespace Amalgamation
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Keep the edges which occur an odd number of times
+ *
+ * An edge and its reverse are considered equal, the surviving edge
+ * keeps the direction and position of its first occurrence.
+ */
+// ----------------------------------------------------------------------
+
+void cancelPairs(vector<NodePair> &theEdges)
+{
+  // count and first position of each undirected edge
+  typedef unordered_map<NodePair, pair<size_t, size_t>, NodePairHash> Counts;
+  Counts counts(2 * theEdges.size());
+
+  for (size_t i = 0; i < theEdges.size(); i++)
+  {
+    const NodePair &e = theEdges[i];
+    const NodePair key = (e.first < e.second ? e : make_pair(e.second, e.first));
+    ++counts.emplace(key, make_pair(0, i)).first->second.first;
+  }
+
+  size_t out = 0;
+  for (size_t i = 0; i < theEdges.size(); i++)
+  {
+    const NodePair &e = theEdges[i];
+    const NodePair key = (e.first < e.second ? e : make_pair(e.second, e.first));
+    const pair<size_t, size_t> &count = counts.find(key)->second;
+    if (count.first % 2 == 1 && count.second == i)
+      theEdges[out++] = e;
+  }
+  theEdges.resize(out);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Chain directed edges into closed rings
+ *
+ * If the edges are not consistently directed, their directions
+ * are ignored.
+ *
+ * \param theX The x-coordinates of the nodes
+ * \param theY The y-coordinates of the nodes
+ * \param theEdges The directed edges
+ * \return The rings, each closed with a copy of its first point
+ */
+// ----------------------------------------------------------------------
+
+vector<Polygon> rings(const vector<double> &theX,
+                      const vector<double> &theY,
+                      const vector<NodePair> &theEdges)
+{
+  const size_t n = theX.size();
+
+  // The edges are followed in their own direction if each node has
+  // as many incoming edges as outgoing ones, otherwise in both directions
+
+  vector<long> balance(n, 0);
+  for (const NodePair &e : theEdges)
+  {
+    if (e.first >= n || e.second >= n)
+      throw runtime_error("Amalgamation: edge refers to a nonexistent node");
+    ++balance[e.first];
+    --balance[e.second];
+  }
+  const bool directed = (count(balance.begin(), balance.end(), 0) == static_cast<long>(n));
+
+  // Outgoing edges of each node in a compressed adjacency array
+
+  vector<size_t> start(n + 1, 0);
+  for (const NodePair &e : theEdges)
+  {
+    ++start[e.first + 1];
+    if (!directed)
+      ++start[e.second + 1];
+  }
+  for (size_t i = 0; i < n; i++)
+    start[i + 1] += start[i];
+
+  vector<size_t> targets(start[n]);
+  vector<size_t> edgeids(start[n]);
+  vector<size_t> cursor(start.begin(), start.end() - 1);
+  for (size_t i = 0; i < theEdges.size(); i++)
+  {
+    const NodePair &e = theEdges[i];
+    edgeids[cursor[e.first]] = i;
+    targets[cursor[e.first]++] = e.second;
+    if (!directed)
+    {
+      edgeids[cursor[e.second]] = i;
+      targets[cursor[e.second]++] = e.first;
+    }
+  }
+
+  // cursor[i] is now the next possibly unused outgoing edge of node i
+  for (size_t i = 0; i < n; i++)
+    cursor[i] = start[i];
+
+  vector<char> used(theEdges.size(), 0);
+
+  const size_t unvisited = static_cast<size_t>(-1);
+  vector<size_t> position(n, unvisited);  // position of node in the current trail
+  vector<size_t> trail;
+
+  vector<Polygon> result;
+
+  for (size_t first = 0; first < n; first++)
+  {
+    while (true)
+    {
+      while (cursor[first] < start[first + 1] && used[edgeids[cursor[first]]])
+        ++cursor[first];
+      if (cursor[first] == start[first + 1])
+        break;
+
+      trail.assign(1, first);
+      position[first] = 0;
+
+      while (!trail.empty())
+      {
+        const size_t cur = trail.back();
+        while (cursor[cur] < start[cur + 1] && used[edgeids[cursor[cur]]])
+          ++cursor[cur];
+        if (cursor[cur] == start[cur + 1])
+        {
+          // Dead end, only possible if the edges do not form closed rings
+          for (size_t node : trail)
+            position[node] = unvisited;
+          trail.clear();
+          break;
+        }
+
+        used[edgeids[cursor[cur]]] = 1;
+        const size_t next = targets[cursor[cur]++];
+        if (position[next] == unvisited)
+        {
+          position[next] = trail.size();
+          trail.push_back(next);
+          continue;
+        }
+
+        // Returned to a node of the trail, the part after it is a ring
+
+        const size_t pos = position[next];
+        Polygon poly;
+        for (size_t i = pos; i < trail.size(); i++)
+          poly.add(Point(theX[trail[i]], theY[trail[i]]));
+        poly.add(Point(theX[next], theY[next]));
+        result.push_back(poly);
+
+        for (size_t i = pos + 1; i < trail.size(); i++)
+          position[trail[i]] = unvisited;
+        trail.resize(pos + 1);
+
+        if (pos == 0)
+        {
+          position[next] = unvisited;
+          trail.clear();
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Filter the triangles and return the boundary edges
+ *
+ * \param theX The x-coordinates of the nodes
+ * \param theY The y-coordinates of the nodes
+ * \param theCorners Three node indices per triangle, starting from 0
+ * \param theRegions The regional attribute of each triangle
+ * \param theLengthLimit The maximum edge length in kilometers
+ * \param theThreads The number of threads, 0 for all cores
+ * \param theAccepted If given, will be set to 1 for accepted triangles
+ * \return The directed boundary edges
+ */
+// ----------------------------------------------------------------------
+
+vector<NodePair> boundary(const vector<double> &theX,
+                          const vector<double> &theY,
+                          const vector<size_t> &theCorners,
+                          const vector<double> &theRegions,
+                          double theLengthLimit,
+                          unsigned int theThreads,
+                          vector<char> *theAccepted)
+{
+  const size_t n = theRegions.size();
+  if (theCorners.size() != 3 * n || theY.size() != theX.size())
+    throw runtime_error("Amalgamation: inconsistent triangle data");
+
+  for (size_t c : theCorners)
+    if (c >= theX.size())
+      throw runtime_error("Amalgamation: triangle refers to a nonexistent node");
+
+  if (theAccepted != nullptr)
+    theAccepted->assign(n, 0);
+
+  vector<NodePair> result;
+  if (n == 0)
+    return result;
+
+  const size_t nthreads = (theThreads > 0 ? theThreads : max(1u, thread::hardware_concurrency()));
+
+  // Establish the tile grid from the bounding box of the nodes
+
+  const size_t side =
+      static_cast<size_t>(ceil(sqrt(static_cast<double>(nthreads * tiles_per_thread))));
+  const size_t ntiles = (nthreads == 1 ? 1 : side * side);
+
+  double xmin = theX[0], xmax = theX[0], ymin = theY[0], ymax = theY[0];
+  for (size_t i = 1; i < theX.size(); i++)
+  {
+    xmin = min(xmin, theX[i]);
+    xmax = max(xmax, theX[i]);
+    ymin = min(ymin, theY[i]);
+    ymax = max(ymax, theY[i]);
+  }
+
+  const double xscale = (xmax > xmin ? side / (xmax - xmin) : 0);
+  const double yscale = (ymax > ymin ? side / (ymax - ymin) : 0);
+
+  // Bucket the triangles by tile with a counting sort
+
+  vector<size_t> tiles(n, 0);
+  if (ntiles > 1)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      const size_t a = theCorners[3 * i], b = theCorners[3 * i + 1], c = theCorners[3 * i + 2];
+      const double cx = (theX[a] + theX[b] + theX[c]) / 3;
+      const double cy = (theY[a] + theY[b] + theY[c]) / 3;
+      const size_t tx = min(side - 1, static_cast<size_t>((cx - xmin) * xscale));
+      const size_t ty = min(side - 1, static_cast<size_t>((cy - ymin) * yscale));
+      tiles[i] = ty * side + tx;
+    }
+  }
+
+  vector<size_t> tilestart(ntiles + 1, 0);
+  for (size_t i = 0; i < n; i++)
+    ++tilestart[tiles[i] + 1];
+  for (size_t t = 0; t < ntiles; t++)
+    tilestart[t + 1] += tilestart[t];
+
+  vector<size_t> order(n);
+  {
+    vector<size_t> pos(tilestart.begin(), tilestart.end() - 1);
+    for (size_t i = 0; i < n; i++)
+      order[pos[tiles[i]]++] = i;
+  }
+
+  // Filter the tiles in parallel
+
+  vector<vector<NodePair>> results(ntiles);
+
+  GeoNodes nodes;
+  prepare_nodes(theX, theY, nodes);
+
+  Job job;
+  job.nodes = &nodes;
+  job.corners = &theCorners;
+  job.regions = &theRegions;
+  job.lengthlimit = theLengthLimit;
+  job.tilestart = &tilestart;
+  job.order = &order;
+  job.results = &results;
+  job.accepted = theAccepted;
+  job.next_tile = 0;
+
+  if (nthreads <= 1)
+    process_tiles(job);
+  else
+  {
+    vector<thread> threads;
+    for (size_t t = 0; t < nthreads; t++)
+      threads.push_back(thread(process_tiles, std::ref(job)));
+    for (size_t t = 0; t < threads.size(); t++)
+      threads[t].join();
+  }
+
+  // Merge the tiles in tile order, cancelling edges across the seams
+
+  size_t total = 0;
+  for (size_t t = 0; t < ntiles; t++)
+    total += results[t].size();
+
+  result.reserve(total);
+  for (size_t t = 0; t < ntiles; t++)
+  {
+    result.insert(result.end(), results[t].begin(), results[t].end());
+    vector<NodePair>().swap(results[t]);
+  }
+
+  cancelPairs(result);
+  return result;
+}
+
+}  // namespace Amalgamation
+
+// ======================================================================
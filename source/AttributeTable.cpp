@@ -0,0 +1,356 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of class AttributeTable
+ */
+// ======================================================================
+
+#include "AttributeTable.h"
+#include "ShapeLoader.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+using namespace Imagine;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct the table, no values are extracted yet
+ */
+// ----------------------------------------------------------------------
+
+AttributeTable::AttributeTable(const NFmiEsriShape &theShape)
+    : itsShape(&theShape),
+      itsDbf(nullptr),
+      itsCache(nullptr),
+      itsRows(theShape.Elements().size()),
+      itsNames(),
+      itsTypes(),
+      itsColumns()
+{
+  const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
+  for (NFmiEsriShape::attributes_type::const_iterator it = attributes.begin();
+       it != attributes.end();
+       ++it)
+  {
+    itsNames.push_back((*it)->Name());
+    itsTypes.push_back((*it)->Type());
+  }
+  itsColumns.resize(itsNames.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct the table on a mapped .dbf file
+ */
+// ----------------------------------------------------------------------
+
+AttributeTable::AttributeTable(const ShpFile::MappedDbf &theDbf)
+    : itsShape(nullptr),
+      itsDbf(&theDbf),
+      itsCache(nullptr),
+      itsRows(theDbf.size()),
+      itsNames(),
+      itsTypes(),
+      itsColumns()
+{
+  const vector<ShpFile::DbfField> &fields = theDbf.fields();
+  for (size_t i = 0; i < fields.size(); i++)
+  {
+    itsNames.push_back(fields[i].name);
+    itsTypes.push_back(ShapeLoader::attributeType(fields[i]));
+  }
+  itsColumns.resize(itsNames.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct the table on the attribute columns of a shape cache
+ */
+// ----------------------------------------------------------------------
+
+AttributeTable::AttributeTable(const ShapeCache::Reader &theCache)
+    : itsShape(nullptr),
+      itsDbf(nullptr),
+      itsCache(&theCache),
+      itsRows(theCache.size()),
+      itsNames(),
+      itsTypes(),
+      itsColumns()
+{
+  const vector<ShpFile::DbfField> &fields = theCache.fields();
+  for (size_t i = 0; i < fields.size(); i++)
+  {
+    itsNames.push_back(fields[i].name);
+    itsTypes.push_back(ShapeLoader::attributeType(fields[i]));
+  }
+  itsColumns.resize(itsNames.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The index of the named column, or -1 if there is none
+ */
+// ----------------------------------------------------------------------
+
+int AttributeTable::column(const string &theName) const
+{
+  for (size_t i = 0; i < itsNames.size(); i++)
+    if (itsNames[i] == theName)
+      return static_cast<int>(i);
+  return -1;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The index of the named column, throwing if there is none
+ */
+// ----------------------------------------------------------------------
+
+int AttributeTable::requireColumn(const string &theName) const
+{
+  const int col = column(theName);
+  if (col < 0)
+    throw runtime_error("No attribute named '" + theName + "' in the shape");
+  return col;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The name of a column
+ */
+// ----------------------------------------------------------------------
+
+const string &AttributeTable::name(int theColumn) const
+{
+  return itsNames.at(theColumn);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The type of a column
+ */
+// ----------------------------------------------------------------------
+
+NFmiEsriAttributeType AttributeTable::type(int theColumn) const
+{
+  return itsTypes.at(theColumn);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Throw unless the column has the given type
+ */
+// ----------------------------------------------------------------------
+
+void AttributeTable::check(int theColumn, NFmiEsriAttributeType theType) const
+{
+  if (type(theColumn) != theType)
+    throw runtime_error("Attribute '" + name(theColumn) + "' is not of the requested type");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract the values of a column
+ */
+// ----------------------------------------------------------------------
+
+void AttributeTable::load(int theColumn)
+{
+  Column &col = itsColumns.at(theColumn);
+  if (col.loaded)
+    return;
+
+  if (itsShape != nullptr)
+    loadShape(theColumn, col);
+  else
+    loadRows(theColumn, col);
+
+  col.loaded = true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract the values of a column from the elements
+ *
+ * The name lookups are done here once per element.
+ */
+// ----------------------------------------------------------------------
+
+void AttributeTable::loadShape(int theColumn, Column &theValues) const
+{
+  const string &attrname = name(theColumn);
+  const NFmiEsriShape::elements_type &elements = itsShape->Elements();
+  const size_t n = elements.size();
+
+  switch (type(theColumn))
+  {
+    case kFmiEsriString:
+      theValues.strings.resize(n);
+      for (size_t i = 0; i < n; i++)
+        if (elements[i] != nullptr)
+          theValues.strings[i] = elements[i]->GetString(attrname);
+      break;
+    case kFmiEsriInteger:
+      theValues.integers.resize(n, 0);
+      for (size_t i = 0; i < n; i++)
+        if (elements[i] != nullptr)
+          theValues.integers[i] = elements[i]->GetInteger(attrname);
+      break;
+    case kFmiEsriDouble:
+      theValues.doubles.resize(n, 0);
+      for (size_t i = 0; i < n; i++)
+        if (elements[i] != nullptr)
+          theValues.doubles[i] = elements[i]->GetDouble(attrname);
+      break;
+    case kFmiEsriDate:
+    {
+      theValues.dates.reserve(n);
+      for (size_t i = 0; i < n; i++)
+        theValues.dates.push_back(elements[i] != nullptr ? elements[i]->GetDate(attrname)
+                                                         : NFmiMetTime());
+      break;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The text of a value in the mapped .dbf file or cache
+ */
+// ----------------------------------------------------------------------
+
+string AttributeTable::rowValue(size_t theRow, int theColumn) const
+{
+  if (itsCache != nullptr)
+    return itsCache->value(theRow, theColumn);
+  return ShpFile::dbfValue(itsDbf->row(theRow), itsDbf->fields().at(theColumn));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the values of a column from the mapped rows
+ */
+// ----------------------------------------------------------------------
+
+void AttributeTable::loadRows(int theColumn, Column &theValues) const
+{
+  const size_t n = itsRows;
+
+  switch (type(theColumn))
+  {
+    case kFmiEsriString:
+      theValues.strings.resize(n);
+      for (size_t i = 0; i < n; i++)
+        theValues.strings[i] = rowValue(i, theColumn);
+      break;
+    case kFmiEsriInteger:
+      theValues.integers.resize(n, 0);
+      for (size_t i = 0; i < n; i++)
+        theValues.integers[i] = atoi(rowValue(i, theColumn).c_str());
+      break;
+    case kFmiEsriDouble:
+      theValues.doubles.resize(n, 0);
+      for (size_t i = 0; i < n; i++)
+        theValues.doubles[i] = atof(rowValue(i, theColumn).c_str());
+      break;
+    case kFmiEsriDate:
+      theValues.dates.reserve(n);
+      for (size_t i = 0; i < n; i++)
+        theValues.dates.push_back(ShapeLoader::parseDate(rowValue(i, theColumn)));
+      break;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The values of a string column
+ */
+// ----------------------------------------------------------------------
+
+const vector<string> &AttributeTable::strings(int theColumn)
+{
+  check(theColumn, kFmiEsriString);
+  load(theColumn);
+  return itsColumns[theColumn].strings;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The values of an integer column
+ */
+// ----------------------------------------------------------------------
+
+const vector<int> &AttributeTable::integers(int theColumn)
+{
+  check(theColumn, kFmiEsriInteger);
+  load(theColumn);
+  return itsColumns[theColumn].integers;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The values of a double column
+ */
+// ----------------------------------------------------------------------
+
+const vector<double> &AttributeTable::doubles(int theColumn)
+{
+  check(theColumn, kFmiEsriDouble);
+  load(theColumn);
+  return itsColumns[theColumn].doubles;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The values of a date column
+ */
+// ----------------------------------------------------------------------
+
+const vector<NFmiMetTime> &AttributeTable::dates(int theColumn)
+{
+  check(theColumn, kFmiEsriDate);
+  load(theColumn);
+  return itsColumns[theColumn].dates;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The values of a string, integer or double column as text
+ */
+// ----------------------------------------------------------------------
+
+const vector<string> &AttributeTable::texts(int theColumn)
+{
+  Column &col = itsColumns.at(theColumn);
+  if (col.textsLoaded)
+    return col.texts;
+
+  load(theColumn);
+
+  switch (type(theColumn))
+  {
+    case kFmiEsriString:
+      col.texts = col.strings;
+      break;
+    case kFmiEsriInteger:
+      col.texts.reserve(col.integers.size());
+      for (size_t i = 0; i < col.integers.size(); i++)
+        col.texts.push_back(boost::lexical_cast<string>(col.integers[i]));
+      break;
+    case kFmiEsriDouble:
+      col.texts.reserve(col.doubles.size());
+      for (size_t i = 0; i < col.doubles.size(); i++)
+        col.texts.push_back(boost::lexical_cast<string>(col.doubles[i]));
+      break;
+    default:
+      throw runtime_error("Unknown attribute value type");
+  }
+
+  col.textsLoaded = true;
+  return col.texts;
+}
+
+// ======================================================================
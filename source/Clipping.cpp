@@ -0,0 +1,594 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace Clipping
+ */
+// ======================================================================
+
+#include "Clipping.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Update the Liang-Barsky parameter range for one edge
+ *
+ * \return False if the segment is completely outside the edge
+ */
+// ----------------------------------------------------------------------
+
+bool clip_parameter(double theP, double theQ, double &theT0, double &theT1)
+{
+  if (theP == 0)
+    return (theQ >= 0);
+
+  const double r = theQ / theP;
+  if (theP < 0)
+  {
+    if (r > theT1)
+      return false;
+    if (r > theT0)
+      theT0 = r;
+  }
+  else
+  {
+    if (r < theT0)
+      return false;
+    if (r < theT1)
+      theT1 = r;
+  }
+  return true;
+}
+
+//! A piece of a ring inside the clipping rectangle
+struct Run
+{
+  Clipping::Part points;
+  double entry;  //!< perimeter position of the first point
+  double exit;   //!< perimeter position of the last point
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Snap a point to the nearest rectangle edge
+ *
+ * \return The clockwise perimeter position of the point, measured
+ *         from the bottom left corner
+ */
+// ----------------------------------------------------------------------
+
+double perimeter_position(Point &thePoint, const ShpFile::Box &theBox)
+{
+  const double x = min(max(thePoint.x(), theBox.xmin), theBox.xmax);
+  const double y = min(max(thePoint.y(), theBox.ymin), theBox.ymax);
+  const double w = theBox.xmax - theBox.xmin;
+  const double h = theBox.ymax - theBox.ymin;
+
+  const double dleft = x - theBox.xmin;
+  const double dtop = theBox.ymax - y;
+  const double dright = theBox.xmax - x;
+  const double dbottom = y - theBox.ymin;
+  const double d = min(min(dleft, dtop), min(dright, dbottom));
+
+  if (d == dleft)
+  {
+    thePoint = Point(theBox.xmin, y);
+    return dbottom;
+  }
+  if (d == dtop)
+  {
+    thePoint = Point(x, theBox.ymax);
+    return h + dleft;
+  }
+  if (d == dright)
+  {
+    thePoint = Point(theBox.xmax, y);
+    return h + w + dtop;
+  }
+  thePoint = Point(x, theBox.ymin);
+  return 2 * h + w + dright;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Even-odd test of a point against a set of rings
+ */
+// ----------------------------------------------------------------------
+
+bool inside_rings(double theX, double theY, const vector<Clipping::Part> &theRings)
+{
+  bool inside = false;
+  for (const Clipping::Part &ring : theRings)
+  {
+    for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+    {
+      const Point &p = ring[i];
+      const Point &q = ring[j];
+      if ((p.y() > theY) != (q.y() > theY) &&
+          theX < p.x() + (theY - p.y()) * (q.x() - p.x()) / (q.y() - p.y()))
+        inside = !inside;
+    }
+  }
+  return inside;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Twice the signed area of a closed ring
+ */
+// ----------------------------------------------------------------------
+
+double signed_area2(const Clipping::Part &theRing)
+{
+  double sum = 0;
+  for (size_t i = 1; i < theRing.size(); i++)
+    sum += theRing[i - 1].x() * theRing[i].y() - theRing[i].x() * theRing[i - 1].y();
+  return sum;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a point unless it duplicates the previous one
+ */
+// ----------------------------------------------------------------------
+
+void append(Clipping::Part &thePart, const Point &thePoint)
+{
+  if (thePart.empty() || !(thePart.back() == thePoint))
+    thePart.push_back(thePoint);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract the parts of a record as point vectors
+ */
+// ----------------------------------------------------------------------
+
+vector<Clipping::Part> record_parts(const ShpFile::Record &theRecord)
+{
+  vector<Clipping::Part> parts(theRecord.numParts());
+  for (int p = 0; p < theRecord.numParts(); p++)
+  {
+    const int i1 = theRecord.part(p);
+    const int i2 = (p + 1 < theRecord.numParts() ? theRecord.part(p + 1) : theRecord.numPoints());
+    if (i1 < 0 || i2 > theRecord.numPoints() || i1 > i2)
+      throw runtime_error("Invalid part indices in shapefile record");
+    parts[p].reserve(i2 - i1);
+    for (int i = i1; i < i2; i++)
+      parts[p].push_back(Point(theRecord.x(i), theRecord.y(i)));
+  }
+  return parts;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a 2D polyline or polygon record
+ */
+// ----------------------------------------------------------------------
+
+string build_record(int theType, const vector<Clipping::Part> &theParts)
+{
+  size_t npoints = 0;
+  for (const Clipping::Part &part : theParts)
+    npoints += part.size();
+
+  const size_t partsoffset = 44;
+  const size_t pointsoffset = partsoffset + 4 * theParts.size();
+  string contents(pointsoffset + 16 * npoints, '\0');
+  char *data = &contents[0];
+
+  ShpFile::putLittleInt(data, theType);
+  ShpFile::putLittleInt(data + 36, static_cast<int>(theParts.size()));
+  ShpFile::putLittleInt(data + 40, static_cast<int>(npoints));
+
+  ShpFile::Box box;
+  size_t pos = 0;
+  for (size_t p = 0; p < theParts.size(); p++)
+  {
+    ShpFile::putLittleInt(data + partsoffset + 4 * p, static_cast<int>(pos));
+    for (const Point &pt : theParts[p])
+    {
+      ShpFile::putLittleDouble(data + pointsoffset + 16 * pos, pt.x());
+      ShpFile::putLittleDouble(data + pointsoffset + 16 * pos + 8, pt.y());
+      box.update(pt.x(), pt.y());
+      ++pos;
+    }
+  }
+
+  ShpFile::putLittleDouble(data + 4, box.xmin);
+  ShpFile::putLittleDouble(data + 12, box.ymin);
+  ShpFile::putLittleDouble(data + 20, box.xmax);
+  ShpFile::putLittleDouble(data + 28, box.ymax);
+
+  return contents;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a 2D multipoint record
+ */
+// ----------------------------------------------------------------------
+
+string build_multipoint(const Clipping::Part &thePoints)
+{
+  string contents(40 + 16 * thePoints.size(), '\0');
+  char *data = &contents[0];
+
+  ShpFile::putLittleInt(data, 8);
+  ShpFile::putLittleInt(data + 36, static_cast<int>(thePoints.size()));
+
+  ShpFile::Box box;
+  for (size_t i = 0; i < thePoints.size(); i++)
+  {
+    ShpFile::putLittleDouble(data + 40 + 16 * i, thePoints[i].x());
+    ShpFile::putLittleDouble(data + 48 + 16 * i, thePoints[i].y());
+    box.update(thePoints[i].x(), thePoints[i].y());
+  }
+
+  ShpFile::putLittleDouble(data + 4, box.xmin);
+  ShpFile::putLittleDouble(data + 12, box.ymin);
+  ShpFile::putLittleDouble(data + 20, box.xmax);
+  ShpFile::putLittleDouble(data + 28, box.ymax);
+
+  return contents;
+}
+
+}  // namespace
+
+namespace Clipping
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Clip the rings of a polygon to a rectangle
+ *
+ * The rings may be given either closed or open. The resulting rings
+ * are closed and appended to the given rings.
+ */
+// ----------------------------------------------------------------------
+
+void clipRings(const vector<Part> &theRings, const ShpFile::Box &theBox, vector<Part> &theResult)
+{
+  const double w = theBox.xmax - theBox.xmin;
+  const double h = theBox.ymax - theBox.ymin;
+  if (!(w > 0 && h > 0))
+    return;
+  const double perimeter = 2 * (w + h);
+
+  // Rings completely inside are kept as is, the others are cut into
+  // runs entering and leaving the rectangle
+
+  vector<Part> output;
+  vector<Run> runs;
+
+  for (const Part &ring : theRings)
+  {
+    Part input(ring);
+    if (input.size() > 1 && input.front() == input.back())
+      input.pop_back();
+    const size_t n = input.size();
+    if (n < 3)
+      continue;
+
+    vector<double> t0(n, 0);
+    vector<double> t1(n, 1);
+    vector<char> visible(n);
+    size_t start = n;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      const Point &p = input[i];
+      const Point &q = input[(i + 1) % n];
+      const double dx = q.x() - p.x();
+      const double dy = q.y() - p.y();
+      visible[i] = (clip_parameter(-dx, p.x() - theBox.xmin, t0[i], t1[i]) &&
+                    clip_parameter(dx, theBox.xmax - p.x(), t0[i], t1[i]) &&
+                    clip_parameter(-dy, p.y() - theBox.ymin, t0[i], t1[i]) &&
+                    clip_parameter(dy, theBox.ymax - p.y(), t0[i], t1[i]));
+      if (start == n && (!visible[i] || t1[i] < 1))
+        start = i;
+    }
+
+    if (start == n)
+    {
+      input.push_back(input.front());
+      output.push_back(input);
+      continue;
+    }
+
+    // Starting after a segment which leaves the rectangle or is not
+    // visible at all, each run begins with an entry and ends with an exit
+
+    Run run;
+    bool open = false;
+    for (size_t k = 1; k <= n; k++)
+    {
+      const size_t i = (start + k) % n;
+      if (!visible[i])
+        continue;
+
+      const Point &p = input[i];
+      const Point &q = input[(i + 1) % n];
+      const double dx = q.x() - p.x();
+      const double dy = q.y() - p.y();
+
+      if (!open)
+      {
+        run.points.clear();
+        open = true;
+      }
+      append(run.points, t0[i] > 0 ? Point(p.x() + t0[i] * dx, p.y() + t0[i] * dy) : p);
+      append(run.points, t1[i] < 1 ? Point(p.x() + t1[i] * dx, p.y() + t1[i] * dy) : q);
+
+      if (t1[i] < 1)
+      {
+        // A run merely touching the rectangle is dropped
+        if (run.points.size() >= 2)
+        {
+          run.entry = perimeter_position(run.points.front(), theBox);
+          run.exit = perimeter_position(run.points.back(), theBox);
+          runs.push_back(run);
+        }
+        open = false;
+      }
+    }
+  }
+
+  // Without runs the rectangle is either completely inside or outside
+
+  if (runs.empty())
+  {
+    if (inside_rings(theBox.xmin, theBox.ymin, theRings))
+    {
+      Part box;
+      box.push_back(Point(theBox.xmin, theBox.ymin));
+      box.push_back(Point(theBox.xmin, theBox.ymax));
+      box.push_back(Point(theBox.xmax, theBox.ymax));
+      box.push_back(Point(theBox.xmax, theBox.ymin));
+      box.push_back(Point(theBox.xmin, theBox.ymin));
+      output.push_back(box);
+    }
+  }
+
+  // Shapefile outer rings are clockwise with the interior on the right.
+  // After leaving the rectangle the boundary hence continues clockwise
+  // along the rectangle up to the nearest entry.
+
+  const double corners[4] = {0, h, h + w, 2 * h + w};
+  const Point cornerpoints[4] = {Point(theBox.xmin, theBox.ymin),
+                                 Point(theBox.xmin, theBox.ymax),
+                                 Point(theBox.xmax, theBox.ymax),
+                                 Point(theBox.xmax, theBox.ymin)};
+
+  vector<char> used(runs.size(), 0);
+  for (size_t first = 0; first < runs.size(); first++)
+  {
+    if (used[first])
+      continue;
+
+    Part result;
+    size_t current = first;
+    while (true)
+    {
+      used[current] = 1;
+      for (const Point &pt : runs[current].points)
+        append(result, pt);
+
+      const double exit = runs[current].exit;
+      size_t next = runs.size();
+      double best = perimeter;
+      for (size_t j = 0; j < runs.size(); j++)
+      {
+        double d = runs[j].entry - exit;
+        if (d < 0)
+          d += perimeter;
+        if (d < best && (j == first || !used[j]))
+        {
+          best = d;
+          next = j;
+        }
+      }
+      if (next == runs.size())
+        break;
+
+      // Add the corners passed on the way to the next entry
+
+      vector<pair<double, int> > passed;
+      for (int c = 0; c < 4; c++)
+      {
+        double d = corners[c] - exit;
+        if (d < 0)
+          d += perimeter;
+        if (d > 0 && d < best)
+          passed.push_back(make_pair(d, c));
+      }
+      sort(passed.begin(), passed.end());
+      for (const pair<double, int> &corner : passed)
+        append(result, cornerpoints[corner.second]);
+
+      if (next == first)
+        break;
+      current = next;
+    }
+    output.push_back(result);
+  }
+
+  // Remove degenerate rings
+
+  for (Part &ring : output)
+  {
+    while (ring.size() > 1 && ring.front() == ring.back())
+      ring.pop_back();
+    if (ring.size() < 3)
+      continue;
+    ring.push_back(ring.front());
+    if (signed_area2(ring) != 0)
+      theResult.push_back(ring);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Clip a polyline to a rectangle
+ *
+ * The visible pieces are appended to the given parts.
+ */
+// ----------------------------------------------------------------------
+
+void clipLine(const Part &theLine, const ShpFile::Box &theBox, vector<Part> &theParts)
+{
+  Part current;
+
+  for (size_t i = 1; i < theLine.size(); i++)
+  {
+    const Point &p = theLine[i - 1];
+    const Point &q = theLine[i];
+    const double dx = q.x() - p.x();
+    const double dy = q.y() - p.y();
+
+    double t0 = 0;
+    double t1 = 1;
+    const bool visible = (clip_parameter(-dx, p.x() - theBox.xmin, t0, t1) &&
+                          clip_parameter(dx, theBox.xmax - p.x(), t0, t1) &&
+                          clip_parameter(-dy, p.y() - theBox.ymin, t0, t1) &&
+                          clip_parameter(dy, theBox.ymax - p.y(), t0, t1));
+
+    if (!visible)
+    {
+      if (current.size() >= 2)
+        theParts.push_back(current);
+      current.clear();
+      continue;
+    }
+
+    const Point a = (t0 > 0 ? Point(p.x() + t0 * dx, p.y() + t0 * dy) : p);
+    const Point b = (t1 < 1 ? Point(p.x() + t1 * dx, p.y() + t1 * dy) : q);
+
+    // A segment entering the rectangle starts a new part
+
+    if (t0 > 0 && !current.empty())
+    {
+      if (current.size() >= 2)
+        theParts.push_back(current);
+      current.clear();
+    }
+
+    append(current, a);
+    append(current, b);
+
+    // A segment leaving the rectangle ends the part
+
+    if (t1 < 1)
+    {
+      if (current.size() >= 2)
+        theParts.push_back(current);
+      current.clear();
+    }
+  }
+
+  if (current.size() >= 2)
+    theParts.push_back(current);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type of clipped records of the given type
+ */
+// ----------------------------------------------------------------------
+
+int clippedType(int theType)
+{
+  switch (theType)
+  {
+    case 3:   // polyline
+    case 13:  // polylinez
+    case 23:  // polylinem
+      return 3;
+    case 5:   // polygon
+    case 15:  // polygonz
+    case 25:  // polygonm
+      return 5;
+    case 8:   // multipoint
+    case 18:  // multipointz
+    case 28:  // multipointm
+      return 8;
+    default:
+      return theType;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Clip the geometry of a record to a rectangle
+ *
+ * Points are kept as is if they are inside the rectangle, and
+ * multipatches if their bounding box overlaps it.
+ *
+ * \param theRecord The record to clip
+ * \param theBox The clipping rectangle
+ * \return The clipped record contents, or an empty string if nothing remains
+ */
+// ----------------------------------------------------------------------
+
+string clip(const ShpFile::Record &theRecord, const ShpFile::Box &theBox)
+{
+  switch (theRecord.type())
+  {
+    case 1:   // point
+    case 11:  // pointz
+    case 21:  // pointm
+    case 31:  // multipatch
+    {
+      if (!theRecord.box().overlaps(theBox))
+        return "";
+      return string(theRecord.data(), theRecord.size());
+    }
+    case 8:   // multipoint
+    case 18:  // multipointz
+    case 28:  // multipointm
+    {
+      Part points;
+      for (int i = 0; i < theRecord.numPoints(); i++)
+      {
+        const Point pt(theRecord.x(i), theRecord.y(i));
+        if (pt.x() >= theBox.xmin && pt.x() <= theBox.xmax && pt.y() >= theBox.ymin &&
+            pt.y() <= theBox.ymax)
+          points.push_back(pt);
+      }
+      if (points.empty())
+        return "";
+      return build_multipoint(points);
+    }
+    case 3:   // polyline
+    case 13:  // polylinez
+    case 23:  // polylinem
+    {
+      vector<Part> parts;
+      for (const Part &part : record_parts(theRecord))
+        clipLine(part, theBox, parts);
+      if (parts.empty())
+        return "";
+      return build_record(3, parts);
+    }
+    case 5:   // polygon
+    case 15:  // polygonz
+    case 25:  // polygonm
+    {
+      vector<Part> rings;
+      clipRings(record_parts(theRecord), theBox, rings);
+      if (rings.empty())
+        return "";
+      return build_record(5, rings);
+    }
+    default:
+      return "";
+  }
+}
+
+}  // namespace Clipping
+
+// ======================================================================
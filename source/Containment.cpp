@@ -0,0 +1,566 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace Containment
+ */
+// ======================================================================
+
+#include "Containment.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace
+{
+//! Maximum number of children in an R-tree node
+const size_t rtree_fanout = 16;
+
+//! The scanlines used for finding interior points, as fractions of the height
+const double scanlines[] = {0.5, 0.25, 0.75, 0.375, 0.625, 0.125, 0.875};
+
+//! A bounding box
+struct Box
+{
+  double xmin;
+  double ymin;
+  double xmax;
+  double ymax;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Calculate the bounding box of a ring
+ */
+// ----------------------------------------------------------------------
+
+Box bounding_box(const Polygon::DataType &thePoints)
+{
+  Box box = {0, 0, 0, 0};
+  if (thePoints.empty())
+    return box;
+
+  box.xmin = box.xmax = thePoints[0].x();
+  box.ymin = box.ymax = thePoints[0].y();
+  for (const Point &pt : thePoints)
+  {
+    box.xmin = min(box.xmin, pt.x());
+    box.xmax = max(box.xmax, pt.x());
+    box.ymin = min(box.ymin, pt.y());
+    box.ymax = max(box.ymax, pt.y());
+  }
+  return box;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A ring prepared for scanline queries
+ *
+ * The edges are bucketed into horizontal bands, an edge spanning
+ * several bands is listed in each of them. A horizontal scanline
+ * needs to examine only the edges of one band.
+ */
+// ----------------------------------------------------------------------
+
+class PreparedRing
+{
+ public:
+  PreparedRing() : itsPoints(nullptr), itsYmin(0), itsYmax(0), itsHeight(1) {}
+
+  void prepare(const Polygon::DataType &thePoints);
+  bool prepared() const { return itsPoints != nullptr; }
+  void crossings(double theY, vector<double> &theCrossings) const;
+  bool isInside(double theX, double theY) const;
+
+ private:
+  size_t band(double theY) const;
+
+  const Polygon::DataType *itsPoints;
+  double itsYmin;
+  double itsYmax;
+  double itsHeight;
+  vector<size_t> itsStart;  // band b has edges itsStart[b]...itsStart[b+1]-1
+  vector<size_t> itsEdges;  // edge k joins points k and k+1 (cyclically)
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The band of the given y-coordinate
+ */
+// ----------------------------------------------------------------------
+
+size_t PreparedRing::band(double theY) const
+{
+  const size_t nbands = itsStart.size() - 1;
+  const double pos = floor((theY - itsYmin) / itsHeight);
+  if (pos <= 0)
+    return 0;
+  return min(nbands - 1, static_cast<size_t>(pos));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Bucket the edges of a ring into bands
+ */
+// ----------------------------------------------------------------------
+
+void PreparedRing::prepare(const Polygon::DataType &thePoints)
+{
+  itsPoints = &thePoints;
+  const size_t n = thePoints.size();
+
+  const Box box = bounding_box(thePoints);
+  itsYmin = box.ymin;
+  itsYmax = box.ymax;
+
+  const size_t nbands = max(static_cast<size_t>(1), static_cast<size_t>(sqrt(double(n))));
+  itsHeight = (itsYmax > itsYmin ? (itsYmax - itsYmin) / nbands : 1);
+
+  // Counting sort of the edges into the bands
+
+  itsStart.assign(nbands + 1, 0);
+  for (size_t k = 0; k < n; k++)
+  {
+    const double y1 = thePoints[k].y();
+    const double y2 = thePoints[k + 1 == n ? 0 : k + 1].y();
+    const size_t b1 = band(min(y1, y2));
+    const size_t b2 = band(max(y1, y2));
+    for (size_t b = b1; b <= b2; b++)
+      ++itsStart[b + 1];
+  }
+  for (size_t b = 0; b < nbands; b++)
+    itsStart[b + 1] += itsStart[b];
+
+  itsEdges.resize(itsStart[nbands]);
+  vector<size_t> pos(itsStart.begin(), itsStart.end() - 1);
+  for (size_t k = 0; k < n; k++)
+  {
+    const double y1 = thePoints[k].y();
+    const double y2 = thePoints[k + 1 == n ? 0 : k + 1].y();
+    const size_t b1 = band(min(y1, y2));
+    const size_t b2 = band(max(y1, y2));
+    for (size_t b = b1; b <= b2; b++)
+      itsEdges[pos[b]++] = k;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append the x-coordinates where the ring crosses a scanline
+ *
+ * An edge crosses the scanline if exactly one of its endpoints is
+ * at or below it, hence vertices on the scanline are counted once.
+ */
+// ----------------------------------------------------------------------
+
+void PreparedRing::crossings(double theY, vector<double> &theCrossings) const
+{
+  if (theY < itsYmin || theY > itsYmax)
+    return;
+
+  const Polygon::DataType &pts = *itsPoints;
+  const size_t n = pts.size();
+  const size_t b = band(theY);
+
+  for (size_t i = itsStart[b]; i < itsStart[b + 1]; i++)
+  {
+    const size_t k = itsEdges[i];
+    const Point &p1 = pts[k];
+    const Point &p2 = pts[k + 1 == n ? 0 : k + 1];
+    if ((p1.y() <= theY) != (p2.y() <= theY))
+      theCrossings.push_back(p1.x() + (theY - p1.y()) * (p2.x() - p1.x()) / (p2.y() - p1.y()));
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a point is inside the ring
+ */
+// ----------------------------------------------------------------------
+
+bool PreparedRing::isInside(double theX, double theY) const
+{
+  vector<double> xs;
+  crossings(theY, xs);
+  bool inside = false;
+  for (double x : xs)
+    if (x > theX)
+      inside = !inside;
+  return inside;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A packed R-tree of bounding boxes
+ *
+ * The leaves are ordered with the Sort-Tile-Recursive method, the
+ * upper levels group consecutive nodes of the level below.
+ */
+// ----------------------------------------------------------------------
+
+class RTree
+{
+ public:
+  RTree(const vector<Box> &theBoxes);
+  void query(double theX, double theY, vector<size_t> &theItems) const;
+
+ private:
+  struct Node
+  {
+    Box box;
+    size_t first;  // first child in the level below, or in itsItems
+    size_t last;   // one past the last child
+  };
+
+  void query(size_t theLevel, size_t theNode, double theX, double theY, vector<size_t> &theItems)
+      const;
+
+  const vector<Box> &itsBoxes;
+  vector<size_t> itsItems;
+  vector<vector<Node> > itsLevels;  // leaves first
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the R-tree
+ */
+// ----------------------------------------------------------------------
+
+RTree::RTree(const vector<Box> &theBoxes) : itsBoxes(theBoxes), itsItems(theBoxes.size())
+{
+  const size_t n = theBoxes.size();
+  if (n == 0)
+    return;
+
+  for (size_t i = 0; i < n; i++)
+    itsItems[i] = i;
+
+  // Sort-Tile-Recursive ordering of the items
+
+  const size_t leaves = (n + rtree_fanout - 1) / rtree_fanout;
+  const size_t slices = static_cast<size_t>(ceil(sqrt(double(leaves))));
+  const size_t slicesize = slices * rtree_fanout;
+
+  sort(itsItems.begin(),
+       itsItems.end(),
+       [&theBoxes](size_t a, size_t b)
+       { return theBoxes[a].xmin + theBoxes[a].xmax < theBoxes[b].xmin + theBoxes[b].xmax; });
+
+  for (size_t start = 0; start < n; start += slicesize)
+  {
+    const size_t stop = min(n, start + slicesize);
+    sort(itsItems.begin() + start,
+         itsItems.begin() + stop,
+         [&theBoxes](size_t a, size_t b)
+         { return theBoxes[a].ymin + theBoxes[a].ymax < theBoxes[b].ymin + theBoxes[b].ymax; });
+  }
+
+  // The leaf level
+
+  itsLevels.push_back(vector<Node>());
+  for (size_t start = 0; start < n; start += rtree_fanout)
+  {
+    Node node;
+    node.first = start;
+    node.last = min(n, start + rtree_fanout);
+    node.box = theBoxes[itsItems[start]];
+    for (size_t i = node.first + 1; i < node.last; i++)
+    {
+      const Box &b = theBoxes[itsItems[i]];
+      node.box.xmin = min(node.box.xmin, b.xmin);
+      node.box.ymin = min(node.box.ymin, b.ymin);
+      node.box.xmax = max(node.box.xmax, b.xmax);
+      node.box.ymax = max(node.box.ymax, b.ymax);
+    }
+    itsLevels.back().push_back(node);
+  }
+
+  // The upper levels until a single root
+
+  while (itsLevels.back().size() > 1)
+  {
+    const vector<Node> &below = itsLevels.back();
+    vector<Node> level;
+    for (size_t start = 0; start < below.size(); start += rtree_fanout)
+    {
+      Node node;
+      node.first = start;
+      node.last = min(below.size(), start + rtree_fanout);
+      node.box = below[start].box;
+      for (size_t i = node.first + 1; i < node.last; i++)
+      {
+        const Box &b = below[i].box;
+        node.box.xmin = min(node.box.xmin, b.xmin);
+        node.box.ymin = min(node.box.ymin, b.ymin);
+        node.box.xmax = max(node.box.xmax, b.xmax);
+        node.box.ymax = max(node.box.ymax, b.ymax);
+      }
+      level.push_back(node);
+    }
+    itsLevels.push_back(level);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the items whose bounding boxes contain the given point
+ */
+// ----------------------------------------------------------------------
+
+void RTree::query(double theX, double theY, vector<size_t> &theItems) const
+{
+  theItems.clear();
+  if (!itsLevels.empty())
+    query(itsLevels.size() - 1, 0, theX, theY, theItems);
+}
+
+void RTree::query(
+    size_t theLevel, size_t theNode, double theX, double theY, vector<size_t> &theItems) const
+{
+  const Node &node = itsLevels[theLevel][theNode];
+  if (theX < node.box.xmin || theX > node.box.xmax || theY < node.box.ymin ||
+      theY > node.box.ymax)
+    return;
+
+  if (theLevel > 0)
+  {
+    for (size_t i = node.first; i < node.last; i++)
+      query(theLevel - 1, i, theX, theY, theItems);
+    return;
+  }
+
+  for (size_t i = node.first; i < node.last; i++)
+  {
+    const size_t item = itsItems[i];
+    const Box &b = itsBoxes[item];
+    if (theX >= b.xmin && theX <= b.xmax && theY >= b.ymin && theY <= b.ymax)
+      theItems.push_back(item);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a ring has an interior
+ */
+// ----------------------------------------------------------------------
+
+bool proper_ring(const Polygon &thePolygon)
+{
+  return thePolygon.data().size() >= 3 && thePolygon.area() > 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a point inside a ring but outside its children
+ *
+ * Each scanline is intersected with the ring and its children, the
+ * crossings pair up into interior spans. The midpoint of the widest
+ * span over all the scanlines is returned. If none is found, the
+ * point is searched from the ring alone as a last resort.
+ */
+// ----------------------------------------------------------------------
+
+Point inside_point(size_t theRing,
+                   const vector<size_t> &theChildren,
+                   const vector<Polygon> &thePolygons,
+                   const vector<PreparedRing> &theRings,
+                   const vector<Box> &theBoxes)
+{
+  const Box &box = theBoxes[theRing];
+
+  // A scanline through a vertex might graze a child without crossing
+  // it, hence the scanlines are placed between distinct vertex heights
+
+  vector<double> heights;
+  for (const Point &pt : thePolygons[theRing].data())
+    heights.push_back(pt.y());
+  for (size_t child : theChildren)
+    for (const Point &pt : thePolygons[child].data())
+      heights.push_back(pt.y());
+  sort(heights.begin(), heights.end());
+  heights.erase(unique(heights.begin(), heights.end()), heights.end());
+
+  double bestwidth = 0;
+  Point best(0, 0);
+  vector<double> xs;
+
+  for (double fraction : scanlines)
+  {
+    const double target = box.ymin + fraction * (box.ymax - box.ymin);
+    const vector<double>::const_iterator pos =
+        upper_bound(heights.begin(), heights.end(), target);
+    if (pos == heights.begin() || pos == heights.end())
+      continue;
+    const double y = 0.5 * (*(pos - 1) + *pos);
+
+    xs.clear();
+    theRings[theRing].crossings(y, xs);
+    for (size_t child : theChildren)
+      if (y >= theBoxes[child].ymin && y <= theBoxes[child].ymax)
+        theRings[child].crossings(y, xs);
+
+    sort(xs.begin(), xs.end());
+    for (size_t k = 0; k + 1 < xs.size(); k += 2)
+    {
+      const double width = xs[k + 1] - xs[k];
+      if (width > bestwidth)
+      {
+        bestwidth = width;
+        best = Point(0.5 * (xs[k] + xs[k + 1]), y);
+      }
+    }
+  }
+
+  if (bestwidth > 0)
+    return best;
+  if (proper_ring(thePolygons[theRing]))
+    return thePolygons[theRing].someInsidePoint();
+  if (!thePolygons[theRing].empty())
+    return thePolygons[theRing].data().front();
+  return best;
+}
+
+}  // namespace
+
+namespace Containment
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the smallest enclosing ring of each ring
+ *
+ * The rings may touch each other but not cross. A ring not enclosed
+ * by any other ring has parent -1, as do rings without an interior. Of
+ * identical rings the first one is taken to enclose the others.
+ */
+// ----------------------------------------------------------------------
+
+vector<long> parents(const vector<Polygon> &thePolygons)
+{
+  const size_t n = thePolygons.size();
+
+  // The rings are closed before the prepared rings take their addresses
+
+  vector<double> areas(n);
+  vector<Box> boxes(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    thePolygons[i].close();
+    areas[i] = thePolygons[i].area();
+    boxes[i] = bounding_box(thePolygons[i].data());
+  }
+
+  const RTree tree(boxes);
+
+  // The rings are prepared only when they are candidate parents
+
+  vector<PreparedRing> rings(n);
+  vector<size_t> candidates;
+  const vector<size_t> nochildren;
+
+  vector<long> result(n, -1);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!proper_ring(thePolygons[i]))
+      continue;
+
+    if (!rings[i].prepared())
+      rings[i].prepare(thePolygons[i].data());
+    const Point probe = inside_point(i, nochildren, thePolygons, rings, boxes);
+
+    tree.query(probe.x(), probe.y(), candidates);
+
+    long best = -1;
+    for (size_t j : candidates)
+    {
+      if (j == i)
+        continue;
+      if (areas[j] < areas[i] || (areas[j] == areas[i] && j > i))
+        continue;
+      if (best >= 0 && areas[j] >= areas[best])
+        continue;
+      if (!rings[j].prepared())
+        rings[j].prepare(thePolygons[j].data());
+      if (rings[j].isInside(probe.x(), probe.y()))
+        best = j;
+    }
+    result[i] = best;
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Calculate the nesting depths of the rings
+ *
+ * The outermost rings have depth 0.
+ */
+// ----------------------------------------------------------------------
+
+vector<int> depths(const vector<long> &theParents)
+{
+  const size_t n = theParents.size();
+  vector<int> result(n, -1);
+  vector<size_t> chain;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    // Climb to the first ring with a known depth, then descend back
+
+    size_t k = i;
+    chain.clear();
+    while (result[k] < 0 && theParents[k] >= 0)
+    {
+      chain.push_back(k);
+      k = theParents[k];
+    }
+    if (result[k] < 0)
+      result[k] = 0;
+
+    int depth = result[k];
+    while (!chain.empty())
+    {
+      result[chain.back()] = ++depth;
+      chain.pop_back();
+    }
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a point inside each ring but outside its children
+ */
+// ----------------------------------------------------------------------
+
+vector<Point> insidePoints(const vector<Polygon> &thePolygons, const vector<long> &theParents)
+{
+  const size_t n = thePolygons.size();
+
+  vector<Box> boxes(n);
+  vector<PreparedRing> rings(n);
+  vector<vector<size_t> > children(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    // Closing may reallocate the points, hence it must precede prepare
+    thePolygons[i].close();
+    boxes[i] = bounding_box(thePolygons[i].data());
+    rings[i].prepare(thePolygons[i].data());
+    if (theParents[i] >= 0)
+      children[theParents[i]].push_back(i);
+  }
+
+  vector<Point> result;
+  result.reserve(n);
+  for (size_t i = 0; i < n; i++)
+    result.push_back(inside_point(i, children[i], thePolygons, rings, boxes));
+
+  return result;
+}
+
+}  // namespace Containment
+
+// ======================================================================
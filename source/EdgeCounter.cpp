@@ -0,0 +1,228 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace EdgeCounter
+ */
+// ======================================================================
+
+#include "EdgeCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+//! Number of bits needed to select a shard
+const int shard_bits = 6;
+
+static_assert((static_cast<size_t>(1) << shard_bits) == EdgeCounter::shard_count,
+              "shard_bits and shard_count disagree");
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The bit pattern of a coordinate
+ *
+ * Negative zero is mapped to zero so that it compares equal.
+ */
+// ----------------------------------------------------------------------
+
+uint64_t bits(double theValue)
+{
+  const double value = theValue + 0.0;
+  uint64_t result;
+  memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mix a 64-bit value (the splitmix64 finalizer)
+ */
+// ----------------------------------------------------------------------
+
+uint64_t mix(uint64_t theValue)
+{
+  theValue ^= theValue >> 30;
+  theValue *= 0xBF58476D1CE4E5B9ULL;
+  theValue ^= theValue >> 27;
+  theValue *= 0x94D049BB133111EBULL;
+  theValue ^= theValue >> 31;
+  return theValue;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Hash value of a canonical edge
+ */
+// ----------------------------------------------------------------------
+
+uint64_t hash_edge(const EdgeCounter::Edge &theEdge)
+{
+  uint64_t h = mix(bits(theEdge.x1));
+  h = mix(h ^ bits(theEdge.y1));
+  h = mix(h ^ bits(theEdge.x2));
+  h = mix(h ^ bits(theEdge.y2));
+  return h;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether two canonical edges are identical
+ */
+// ----------------------------------------------------------------------
+
+bool same_edge(const EdgeCounter::Edge &theA, const EdgeCounter::Edge &theB)
+{
+  return (bits(theA.x1) == bits(theB.x1) && bits(theA.y1) == bits(theB.y1) &&
+          bits(theA.x2) == bits(theB.x2) && bits(theA.y2) == bits(theB.y2));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count the edges of a single shard
+ *
+ * The table uses linear probing and is at most half full. A zero
+ * count marks an empty slot.
+ */
+// ----------------------------------------------------------------------
+
+void count_shard(const vector<EdgeCounter::Buffer> &theBuffers,
+                 size_t theShard,
+                 vector<EdgeCounter::Count> &theResult)
+{
+  size_t total = 0;
+  for (const EdgeCounter::Buffer &buffer : theBuffers)
+    total += buffer.shard(theShard).size();
+
+  theResult.clear();
+  if (total == 0)
+    return;
+
+  size_t capacity = 16;
+  while (capacity < 2 * total)
+    capacity *= 2;
+  const size_t mask = capacity - 1;
+
+  vector<EdgeCounter::Count> table(capacity, EdgeCounter::Count(EdgeCounter::Edge(), 0));
+  size_t used = 0;
+
+  for (const EdgeCounter::Buffer &buffer : theBuffers)
+    for (const EdgeCounter::Edge &edge : buffer.shard(theShard))
+    {
+      // The low bits select the slot, the high bits select the shard
+      size_t slot = hash_edge(edge) & mask;
+      while (true)
+      {
+        EdgeCounter::Count &entry = table[slot];
+        if (entry.second == 0)
+        {
+          entry.first = edge;
+          entry.second = 1;
+          ++used;
+          break;
+        }
+        if (same_edge(entry.first, edge))
+        {
+          ++entry.second;
+          break;
+        }
+        slot = (slot + 1) & mask;
+      }
+    }
+
+  theResult.reserve(used);
+  for (const EdgeCounter::Count &entry : table)
+    if (entry.second > 0)
+      theResult.push_back(entry);
+}
+
+}  // namespace
+
+namespace EdgeCounter
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a segment to the buffer
+ *
+ * The endpoints are ordered lexicographically by their coordinates.
+ */
+// ----------------------------------------------------------------------
+
+void Buffer::add(double theX1, double theY1, double theX2, double theY2)
+{
+  Edge edge;
+  if (theX1 < theX2 || (theX1 == theX2 && theY1 <= theY2))
+  {
+    edge.x1 = theX1 + 0.0;
+    edge.y1 = theY1 + 0.0;
+    edge.x2 = theX2 + 0.0;
+    edge.y2 = theY2 + 0.0;
+  }
+  else
+  {
+    edge.x1 = theX2 + 0.0;
+    edge.y1 = theY2 + 0.0;
+    edge.x2 = theX1 + 0.0;
+    edge.y2 = theY1 + 0.0;
+  }
+
+  itsShards[hash_edge(edge) >> (64 - shard_bits)].push_back(edge);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count the segments in the buffers
+ *
+ * The shards are counted in parallel, by default using all cores.
+ * The result lists each distinct segment once along with the number
+ * of its occurrences.
+ */
+// ----------------------------------------------------------------------
+
+vector<Count> count(const vector<Buffer> &theBuffers, unsigned int theThreads)
+{
+  if (theThreads == 0)
+    theThreads = max(1u, thread::hardware_concurrency());
+  theThreads = min(theThreads, static_cast<unsigned int>(shard_count));
+
+  vector<vector<Count> > results(shard_count);
+  atomic<size_t> next_shard(0);
+
+  const auto worker = [&]()
+  {
+    while (true)
+    {
+      const size_t shard = next_shard++;
+      if (shard >= shard_count)
+        break;
+      count_shard(theBuffers, shard, results[shard]);
+    }
+  };
+
+  vector<thread> threads;
+  for (unsigned int t = 1; t < theThreads; t++)
+    threads.push_back(thread(worker));
+  worker();
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  size_t total = 0;
+  for (const vector<Count> &result : results)
+    total += result.size();
+
+  vector<Count> counts;
+  counts.reserve(total);
+  for (const vector<Count> &result : results)
+    counts.insert(counts.end(), result.begin(), result.end());
+
+  return counts;
+}
+
+}  // namespace EdgeCounter
+
+// ======================================================================
@@ -0,0 +1,116 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace EsriView
+ */
+// ======================================================================
+
+#include "EsriView.h"
+
+#include <imagine/NFmiEsriMultiPoint.h>
+#include <imagine/NFmiEsriPolyLine.h>
+#include <imagine/NFmiEsriPolygon.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Imagine;
+
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract the parts and points of a polyline or polygon
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void get_parts(const T &theElement,
+               int &theNumParts,
+               int &theNumPoints,
+               const int *&theParts,
+               const NFmiEsriPoint *&thePoints)
+{
+  const vector<int> &parts = theElement.Parts();
+  const vector<NFmiEsriPoint> &points = theElement.Points();
+
+  theNumPoints = static_cast<int>(points.size());
+  thePoints = (points.empty() ? nullptr : points.data());
+
+  if (!parts.empty())
+  {
+    theNumParts = static_cast<int>(parts.size());
+    theParts = parts.data();
+  }
+  else
+  {
+    theNumParts = (points.empty() ? 0 : 1);
+    theParts = nullptr;
+  }
+}
+
+}  // namespace
+
+namespace EsriView
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct a view to an element
+ *
+ * \param theElement The element, null elements have no points
+ */
+// ----------------------------------------------------------------------
+
+Record::Record(const NFmiEsriElement *theElement)
+    : itsType(kFmiEsriNull),
+      itsNumParts(0),
+      itsNumPoints(0),
+      itsParts(nullptr),
+      itsPoints(nullptr),
+      itsX(0),
+      itsY(0)
+{
+  if (theElement == nullptr)
+    return;
+
+  itsType = theElement->Type();
+
+  switch (itsType)
+  {
+    case kFmiEsriNull:
+      break;
+    case kFmiEsriPoint:
+      itsNumPoints = 1;
+      itsX = theElement->X();
+      itsY = theElement->Y();
+      break;
+    case kFmiEsriMultiPoint:
+    {
+      const vector<NFmiEsriPoint> &points =
+          static_cast<const NFmiEsriMultiPoint *>(theElement)->Points();
+      itsNumPoints = static_cast<int>(points.size());
+      itsPoints = (points.empty() ? nullptr : points.data());
+      break;
+    }
+    case kFmiEsriPolyLine:
+      get_parts(*static_cast<const NFmiEsriPolyLine *>(theElement),
+                itsNumParts,
+                itsNumPoints,
+                itsParts,
+                itsPoints);
+      break;
+    case kFmiEsriPolygon:
+      get_parts(*static_cast<const NFmiEsriPolygon *>(theElement),
+                itsNumParts,
+                itsNumPoints,
+                itsParts,
+                itsPoints);
+      break;
+    default:
+      throw runtime_error("Only 2D shapes can be viewed as records");
+  }
+}
+
+}  // namespace EsriView
+
+// ======================================================================
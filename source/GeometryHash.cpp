@@ -0,0 +1,290 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace GeometryHash
+ */
+// ======================================================================
+
+#include "GeometryHash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+//! A quantized vertex
+typedef pair<int64_t, int64_t> Vertex;
+
+//! A quantized part
+typedef vector<Vertex> Part;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mix a 64-bit value (the splitmix64 finalizer)
+ */
+// ----------------------------------------------------------------------
+
+uint64_t mix(uint64_t theValue)
+{
+  theValue ^= theValue >> 30;
+  theValue *= 0xBF58476D1CE4E5B9ULL;
+  theValue ^= theValue >> 27;
+  theValue *= 0x94D049BB133111EBULL;
+  theValue ^= theValue >> 31;
+  return theValue;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Quantize a coordinate
+ *
+ * A zero quantum keeps the exact value as its bit pattern, with
+ * negative zero mapped to zero.
+ */
+// ----------------------------------------------------------------------
+
+int64_t quantize(double theValue, double theQuantum)
+{
+  if (theQuantum == 0)
+  {
+    const double value = theValue + 0.0;
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+  return llround(theValue / theQuantum);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Quantize a point of a record
+ */
+// ----------------------------------------------------------------------
+
+Vertex quantize(const ShpFile::Record &theRecord, int theIndex, double theQuantum)
+{
+  return Vertex(quantize(theRecord.x(theIndex), theQuantum),
+                quantize(theRecord.y(theIndex), theQuantum));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type ignoring the Z and M variants
+ */
+// ----------------------------------------------------------------------
+
+int base_type(int theType)
+{
+  return (theType == 31 ? theType : theType % 10);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract the quantized parts of a record
+ *
+ * Repeated vertices are removed, and the closing vertex of rings.
+ */
+// ----------------------------------------------------------------------
+
+vector<Part> quantized_parts(const ShpFile::Record &theRecord, double theQuantum, bool theRings)
+{
+  vector<Part> parts;
+  for (int p = 0; p < theRecord.numParts(); p++)
+  {
+    const int i1 = theRecord.part(p);
+    const int i2 = (p + 1 < theRecord.numParts() ? theRecord.part(p + 1) : theRecord.numPoints());
+    if (i1 < 0 || i2 > theRecord.numPoints() || i1 > i2)
+      throw runtime_error("Invalid part indices in shapefile record");
+
+    Part part;
+    part.reserve(i2 - i1);
+    for (int i = i1; i < i2; i++)
+    {
+      const Vertex v = quantize(theRecord, i, theQuantum);
+      if (part.empty() || part.back() != v)
+        part.push_back(v);
+    }
+
+    if (theRings)
+      while (part.size() > 1 && part.front() == part.back())
+        part.pop_back();
+
+    if (!part.empty())
+      parts.push_back(part);
+  }
+  return parts;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Normalize the start and direction of a ring
+ */
+// ----------------------------------------------------------------------
+
+Part normalize_ring(const Part &theRing)
+{
+  const size_t n = theRing.size();
+  const size_t start = min_element(theRing.begin(), theRing.end()) - theRing.begin();
+
+  Part forward(n);
+  Part backward(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    forward[i] = theRing[(start + i) % n];
+    backward[i] = theRing[(start + n - i) % n];
+  }
+
+  // With repeated minimal vertices the rotation is ambiguous, hence
+  // all candidate rotations are tried
+
+  for (size_t s = start + 1; s < n; s++)
+  {
+    if (theRing[s] != theRing[start])
+      continue;
+    Part f(n);
+    Part b(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      f[i] = theRing[(s + i) % n];
+      b[i] = theRing[(s + n - i) % n];
+    }
+    forward = min(forward, f);
+    backward = min(backward, b);
+  }
+
+  return min(forward, backward);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Normalize the direction of a polyline part
+ */
+// ----------------------------------------------------------------------
+
+Part normalize_line(const Part &theLine)
+{
+  Part reversed(theLine.rbegin(), theLine.rend());
+  return min(theLine, reversed);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append sorted parts to the canonical form
+ */
+// ----------------------------------------------------------------------
+
+void append_parts(vector<Part> &theParts, GeometryHash::Canonical &theCanonical)
+{
+  sort(theParts.begin(), theParts.end());
+  theCanonical.push_back(static_cast<int64_t>(theParts.size()));
+  for (const Part &part : theParts)
+  {
+    theCanonical.push_back(static_cast<int64_t>(part.size()));
+    for (const Vertex &v : part)
+    {
+      theCanonical.push_back(v.first);
+      theCanonical.push_back(v.second);
+    }
+  }
+}
+
+}  // namespace
+
+namespace GeometryHash
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief The canonical form of the geometry of a record
+ *
+ * \param theRecord The record
+ * \param theQuantum The quantization step for the coordinates, or zero
+ *                   for exact coordinates
+ */
+// ----------------------------------------------------------------------
+
+Canonical canonical(const ShpFile::Record &theRecord, double theQuantum)
+{
+  if (theQuantum < 0)
+    throw runtime_error("Geometry hash quantum must not be negative");
+
+  Canonical result;
+  result.push_back(base_type(theRecord.type()));
+
+  switch (theRecord.type())
+  {
+    case 0:  // null
+      break;
+    case 3:   // polyline
+    case 13:  // polylinez
+    case 23:  // polylinem
+    {
+      vector<Part> parts = quantized_parts(theRecord, theQuantum, false);
+      for (Part &part : parts)
+        part = normalize_line(part);
+      append_parts(parts, result);
+      break;
+    }
+    case 5:   // polygon
+    case 15:  // polygonz
+    case 25:  // polygonm
+    {
+      vector<Part> parts = quantized_parts(theRecord, theQuantum, true);
+      for (Part &part : parts)
+        part = normalize_ring(part);
+      append_parts(parts, result);
+      break;
+    }
+    case 31:  // multipatch
+    {
+      // The parts may be triangle strips and fans, whose vertex
+      // order is significant
+      vector<Part> parts = quantized_parts(theRecord, theQuantum, false);
+      result.push_back(static_cast<int64_t>(parts.size()));
+      for (const Part &part : parts)
+      {
+        result.push_back(static_cast<int64_t>(part.size()));
+        for (const Vertex &v : part)
+        {
+          result.push_back(v.first);
+          result.push_back(v.second);
+        }
+      }
+      break;
+    }
+    default:  // points and multipoints
+    {
+      Part points;
+      for (int i = 0; i < theRecord.numPoints(); i++)
+        points.push_back(quantize(theRecord, i, theQuantum));
+      sort(points.begin(), points.end());
+      vector<Part> parts(1, points);
+      append_parts(parts, result);
+      break;
+    }
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The hash value of a canonical form
+ */
+// ----------------------------------------------------------------------
+
+uint64_t hash(const Canonical &theCanonical)
+{
+  uint64_t h = mix(theCanonical.size());
+  for (int64_t value : theCanonical)
+    h = mix(h ^ static_cast<uint64_t>(value));
+  return h;
+}
+
+}  // namespace GeometryHash
+
+// ======================================================================
@@ -0,0 +1,71 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of class MappedFile
+ */
+// ======================================================================
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor unmaps the file
+ */
+// ----------------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+  if (itsData != nullptr && itsSize > 0)
+    munmap(const_cast<char *>(itsData), itsSize);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map the given file into memory
+ *
+ * An empty file is valid, in which case data() returns a null pointer.
+ *
+ * \param theName The name of the file
+ */
+// ----------------------------------------------------------------------
+
+MappedFile::MappedFile(const string &theName) : itsName(theName), itsData(nullptr), itsSize(0)
+{
+  const int fd = open(theName.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("Could not open " + theName + " for reading");
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    throw runtime_error("Could not stat " + theName);
+  }
+
+  itsSize = st.st_size;
+
+  if (itsSize > 0)
+  {
+    void *ptr = mmap(nullptr, itsSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+      close(fd);
+      throw runtime_error("Could not memory map " + theName);
+    }
+    itsData = static_cast<const char *>(ptr);
+  }
+
+  // The mapping remains valid after the descriptor is closed
+  close(fd);
+}
+
+// ======================================================================
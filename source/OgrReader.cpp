@@ -0,0 +1,429 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace OgrReader
+ */
+// ======================================================================
+
+#include "OgrReader.h"
+
+#include <imagine/NFmiEsriMultiPoint.h>
+#include <imagine/NFmiEsriPoint.h>
+#include <imagine/NFmiEsriPolyLine.h>
+#include <imagine/NFmiEsriPolygon.h>
+#include <cpl_string.h>
+#include <gdal_priv.h>
+#include <ogrsf_frmts.h>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Imagine;
+
+namespace
+{
+//! Deletes a feature when going out of scope
+struct FeatureDeleter
+{
+  void operator()(OGRFeature *theFeature) const { OGRFeature::DestroyFeature(theFeature); }
+};
+
+typedef unique_ptr<OGRFeature, FeatureDeleter> FeaturePtr;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a name ends with the given suffix
+ */
+// ----------------------------------------------------------------------
+
+bool has_suffix(const string &theName, const string &theSuffix)
+{
+  return (theName.size() > theSuffix.size() &&
+          theName.compare(theName.size() - theSuffix.size(), theSuffix.size(), theSuffix) == 0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type corresponding to an OGR geometry type
+ */
+// ----------------------------------------------------------------------
+
+NFmiEsriElementType shape_type(OGRwkbGeometryType theType)
+{
+  switch (wkbFlatten(theType))
+  {
+    case wkbPoint:
+      return kFmiEsriPoint;
+    case wkbMultiPoint:
+      return kFmiEsriMultiPoint;
+    case wkbLineString:
+    case wkbMultiLineString:
+      return kFmiEsriPolyLine;
+    case wkbPolygon:
+    case wkbMultiPolygon:
+      return kFmiEsriPolygon;
+    default:
+      return kFmiEsriNull;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The attribute type corresponding to an OGR field type
+ *
+ * Types with no counterpart are read as strings. The integer
+ * attributes have only 32 bits, hence 64-bit integers are read as
+ * doubles, which are exact up to 2^53.
+ */
+// ----------------------------------------------------------------------
+
+NFmiEsriAttributeType attribute_type(OGRFieldType theType)
+{
+  switch (theType)
+  {
+    case OFTInteger:
+      return kFmiEsriInteger;
+    case OFTInteger64:
+    case OFTReal:
+      return kFmiEsriDouble;
+    case OFTDate:
+    case OFTDateTime:
+      return kFmiEsriDate;
+    default:
+      return kFmiEsriString;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a line or a ring as a new part
+ *
+ * \param theElement The polyline or polygon to append to
+ * \param theLine The line or ring
+ * \param theReverse True if the points are to be appended in reverse
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void add_part(T &theElement, const OGRLineString &theLine, bool theReverse)
+{
+  const int n = theLine.getNumPoints();
+  for (int k = 0; k < n; k++)
+  {
+    const int i = (theReverse ? n - 1 - k : k);
+    const NFmiEsriPoint point(theLine.getX(i), theLine.getY(i));
+    if (k == 0)
+      theElement.AddPart(point);
+    else
+      theElement.Add(point);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append the rings of a polygon
+ *
+ * Exterior rings are clockwise and holes counter-clockwise in
+ * shapefiles, OGR formats may use either orientation.
+ */
+// ----------------------------------------------------------------------
+
+void add_polygon(NFmiEsriPolygon &theElement, const OGRPolygon &thePolygon)
+{
+  const OGRLinearRing *exterior = thePolygon.getExteriorRing();
+  if (exterior == nullptr)
+    return;
+  add_part(theElement, *exterior, !exterior->isClockwise());
+
+  for (int i = 0; i < thePolygon.getNumInteriorRings(); i++)
+  {
+    const OGRLinearRing *hole = thePolygon.getInteriorRing(i);
+    add_part(theElement, *hole, hole->isClockwise() != 0);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Convert an OGR geometry into an element
+ */
+// ----------------------------------------------------------------------
+
+NFmiEsriElement *make_element(const OGRGeometry &theGeometry, int theNumber)
+{
+  switch (wkbFlatten(theGeometry.getGeometryType()))
+  {
+    case wkbPoint:
+    {
+      const OGRPoint *point = theGeometry.toPoint();
+      return new NFmiEsriPoint(point->getX(), point->getY(), theNumber);
+    }
+    case wkbMultiPoint:
+    {
+      const OGRMultiPoint *points = theGeometry.toMultiPoint();
+      unique_ptr<NFmiEsriMultiPoint> elem(new NFmiEsriMultiPoint(theNumber));
+      for (int i = 0; i < points->getNumGeometries(); i++)
+      {
+        const OGRPoint *point = points->getGeometryRef(i)->toPoint();
+        elem->Add(NFmiEsriPoint(point->getX(), point->getY()));
+      }
+      return elem.release();
+    }
+    case wkbLineString:
+    {
+      unique_ptr<NFmiEsriPolyLine> elem(new NFmiEsriPolyLine(theNumber));
+      add_part(*elem, *theGeometry.toLineString(), false);
+      return elem.release();
+    }
+    case wkbMultiLineString:
+    {
+      const OGRMultiLineString *lines = theGeometry.toMultiLineString();
+      unique_ptr<NFmiEsriPolyLine> elem(new NFmiEsriPolyLine(theNumber));
+      for (int i = 0; i < lines->getNumGeometries(); i++)
+        add_part(*elem, *lines->getGeometryRef(i)->toLineString(), false);
+      return elem.release();
+    }
+    case wkbPolygon:
+    {
+      unique_ptr<NFmiEsriPolygon> elem(new NFmiEsriPolygon(theNumber));
+      add_polygon(*elem, *theGeometry.toPolygon());
+      return elem.release();
+    }
+    case wkbMultiPolygon:
+    {
+      const OGRMultiPolygon *polygons = theGeometry.toMultiPolygon();
+      unique_ptr<NFmiEsriPolygon> elem(new NFmiEsriPolygon(theNumber));
+      for (int i = 0; i < polygons->getNumGeometries(); i++)
+        add_polygon(*elem, *polygons->getGeometryRef(i)->toPolygon());
+      return elem.release();
+    }
+    default:
+      throw runtime_error("Only points, lines and polygons can be read through OGR");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Quote a string for an OGR SQL expression
+ */
+// ----------------------------------------------------------------------
+
+string quote(const string &theValue, char theQuote)
+{
+  string ret(1, theQuote);
+  for (char ch : theValue)
+  {
+    if (ch == theQuote)
+      ret += theQuote;
+    ret += ch;
+  }
+  ret += theQuote;
+  return ret;
+}
+
+}  // namespace
+
+namespace OgrReader
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the file is to be read through OGR
+ *
+ * FlatGeobuf (.fgb) and GeoPackage (.gpkg) files are recognized.
+ */
+// ----------------------------------------------------------------------
+
+bool isOgrSource(const string &theName)
+{
+  return (has_suffix(theName, ".fgb") || has_suffix(theName, ".gpkg"));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor
+ */
+// ----------------------------------------------------------------------
+
+Layer::~Layer()
+{
+  GDALClose(itsDataset);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open the first layer of the data source
+ *
+ * If the layer does not declare a single geometry type, the type of
+ * the first feature is used.
+ */
+// ----------------------------------------------------------------------
+
+Layer::Layer(const string &theName)
+    : itsName(theName), itsDataset(nullptr), itsLayer(nullptr), itsType(kFmiEsriNull)
+{
+  GDALAllRegister();
+
+  itsDataset = GDALDataset::Open(theName.c_str(), GDAL_OF_VECTOR | GDAL_OF_READONLY);
+  if (itsDataset == nullptr)
+    throw runtime_error("Failed to open '" + theName + "': " + CPLGetLastErrorMsg());
+
+  if (itsDataset->GetLayerCount() < 1)
+  {
+    GDALClose(itsDataset);
+    throw runtime_error("'" + theName + "' contains no layers");
+  }
+
+  itsLayer = itsDataset->GetLayer(0);
+  itsType = shape_type(itsLayer->GetGeomType());
+
+  if (itsType == kFmiEsriNull)
+  {
+    const FeaturePtr feature(itsLayer->GetNextFeature());
+    if (feature && feature->GetGeometryRef() != nullptr)
+      itsType = shape_type(feature->GetGeometryRef()->getGeometryType());
+    itsLayer->ResetReading();
+  }
+
+  if (itsType == kFmiEsriNull)
+  {
+    GDALClose(itsDataset);
+    throw runtime_error("Failed to establish the geometry type of '" + theName + "'");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build an OGR SQL comparison for the attribute filter
+ *
+ * The value is quoted unless the field is numeric, in which case it
+ * must be a number.
+ *
+ * \param theField The field name
+ * \param theComparison One of =, ==, <>, <, >, <= and >=
+ * \param theValue The value to compare with
+ */
+// ----------------------------------------------------------------------
+
+string Layer::filterExpression(const string &theField,
+                               const string &theComparison,
+                               const string &theValue) const
+{
+  const string comparison = (theComparison == "==" ? "=" : theComparison);
+  if (comparison != "=" && comparison != "<>" && comparison != "<" && comparison != ">" &&
+      comparison != "<=" && comparison != ">=")
+    throw runtime_error("Unknown comparison '" + theComparison + "'");
+
+  OGRFeatureDefn *defn = itsLayer->GetLayerDefn();
+  const int index = defn->GetFieldIndex(theField.c_str());
+  if (index < 0)
+    throw runtime_error("Field '" + theField + "' does not exist in '" + itsName + "'");
+
+  string value;
+  const NFmiEsriAttributeType type = attribute_type(defn->GetFieldDefn(index)->GetType());
+  if (type == kFmiEsriInteger || type == kFmiEsriDouble)
+  {
+    char *end;
+    strtod(theValue.c_str(), &end);
+    if (theValue.empty() || *end != '\0')
+      throw runtime_error("Field '" + theField + "' can only be compared with numbers");
+    value = theValue;
+  }
+  else
+    value = quote(theValue, '\'');
+
+  return quote(theField, '"') + ' ' + comparison + ' ' + value;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the features passing the filters
+ *
+ * \param theBox Only features intersecting the box are read if set
+ * \param theFilter An OGR SQL attribute filter, or empty
+ * \return The matching features in layer order
+ */
+// ----------------------------------------------------------------------
+
+unique_ptr<NFmiEsriShape> Layer::read(const ShpFile::Box *theBox, const string &theFilter)
+{
+  if (theBox != nullptr)
+    itsLayer->SetSpatialFilterRect(theBox->xmin, theBox->ymin, theBox->xmax, theBox->ymax);
+  else
+    itsLayer->SetSpatialFilter(nullptr);
+
+  if (itsLayer->SetAttributeFilter(theFilter.empty() ? nullptr : theFilter.c_str()) != OGRERR_NONE)
+    throw runtime_error("Invalid filter '" + theFilter + "' for '" + itsName +
+                        "': " + CPLGetLastErrorMsg());
+
+  unique_ptr<NFmiEsriShape> shape(new NFmiEsriShape(itsType));
+
+  // The attributes
+
+  OGRFeatureDefn *defn = itsLayer->GetLayerDefn();
+  const int nfields = defn->GetFieldCount();
+
+  vector<NFmiEsriAttributeName *> names;
+  vector<NFmiEsriAttributeType> types;
+  for (int i = 0; i < nfields; i++)
+  {
+    const OGRFieldDefn *field = defn->GetFieldDefn(i);
+    const NFmiEsriAttributeType type = attribute_type(field->GetType());
+    NFmiEsriAttributeName *name = new NFmiEsriAttributeName(
+        field->GetNameRef(), type, field->GetWidth(), field->GetPrecision());
+    shape->Add(name);
+    names.push_back(name);
+    types.push_back(type);
+  }
+
+  // The features
+
+  itsLayer->ResetReading();
+
+  int number = 0;
+  for (FeaturePtr feature(itsLayer->GetNextFeature()); feature;
+       feature.reset(itsLayer->GetNextFeature()))
+  {
+    const OGRGeometry *geom = feature->GetGeometryRef();
+    if (geom == nullptr)
+      continue;
+
+    NFmiEsriElement *elem = make_element(*geom, number++);
+    shape->Add(elem);
+
+    for (int i = 0; i < nfields; i++)
+    {
+      switch (types[i])
+      {
+        case kFmiEsriString:
+          elem->Add(NFmiEsriAttribute(string(feature->GetFieldAsString(i)), names[i]));
+          break;
+        case kFmiEsriInteger:
+          elem->Add(NFmiEsriAttribute(feature->GetFieldAsInteger(i), names[i]));
+          break;
+        case kFmiEsriDouble:
+          elem->Add(NFmiEsriAttribute(feature->GetFieldAsDouble(i), names[i]));
+          break;
+        case kFmiEsriDate:
+        {
+          int year = 0, month = 0, day = 0, hour = 0, minute = 0, tz = 0;
+          float second = 0;
+          NFmiMetTime date;
+          if (feature->IsFieldSetAndNotNull(i) &&
+              feature->GetFieldAsDateTime(
+                  i, &year, &month, &day, &hour, &minute, &second, &tz) != 0)
+            date = NFmiMetTime(static_cast<short>(year),
+                               static_cast<short>(month),
+                               static_cast<short>(day));
+          elem->Add(NFmiEsriAttribute(date, names[i]));
+          break;
+        }
+      }
+    }
+  }
+
+  return shape;
+}
+
+}  // namespace OgrReader
+
+// ======================================================================
@@ -0,0 +1,458 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace OgrWriter
+ */
+// ======================================================================
+
+#include "OgrWriter.h"
+
+#include <imagine/NFmiEsriMultiPoint.h>
+#include <imagine/NFmiEsriPoint.h>
+#include <imagine/NFmiEsriPolyLine.h>
+#include <imagine/NFmiEsriPolygon.h>
+#include <cpl_string.h>
+#include <gdal_priv.h>
+#include <ogrsf_frmts.h>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Imagine;
+
+namespace
+{
+//! An output format
+struct Format
+{
+  const char *name;
+  const char *driver;
+  const char *suffix;
+};
+
+//! The supported output formats
+const Format formats[] = {{"fgb", "FlatGeobuf", ".fgb"}, {"gpkg", "GPKG", ".gpkg"}};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find an output format by name
+ *
+ * \return Null if the format is not written through OGR or is unknown
+ */
+// ----------------------------------------------------------------------
+
+const Format *find_format(const string &theFormat)
+{
+  for (const Format &format : formats)
+    if (theFormat == format.name)
+      return &format;
+  return nullptr;
+}
+
+//! Closes a dataset when going out of scope
+struct DatasetCloser
+{
+  void operator()(GDALDataset *theDataset) const { GDALClose(theDataset); }
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The OGR geometry type of the layer for a shape type
+ */
+// ----------------------------------------------------------------------
+
+OGRwkbGeometryType layer_type(NFmiEsriElementType theType)
+{
+  switch (theType)
+  {
+    case kFmiEsriNull:
+      return wkbNone;
+    case kFmiEsriPoint:
+      return wkbPoint;
+    case kFmiEsriMultiPoint:
+      return wkbMultiPoint;
+    case kFmiEsriPolyLine:
+      return wkbMultiLineString;
+    case kFmiEsriPolygon:
+      return wkbMultiPolygon;
+    default:
+      throw runtime_error("Only 2D shapes can be written through OGR");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a linestring from points i1...i2-1
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void set_points(T &theLine, const vector<NFmiEsriPoint> &thePoints, int i1, int i2)
+{
+  vector<double> x;
+  vector<double> y;
+  x.reserve(i2 - i1);
+  y.reserve(i2 - i1);
+  for (int i = i1; i < i2; i++)
+  {
+    x.push_back(thePoints[i].X());
+    y.push_back(thePoints[i].Y());
+  }
+  theLine.setPoints(i2 - i1, x.data(), y.data());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The start indices of the parts
+ *
+ * Points added without starting a part form a single part.
+ */
+// ----------------------------------------------------------------------
+
+vector<int> part_starts(const vector<int> &theParts, int theNumPoints)
+{
+  if (theParts.empty() && theNumPoints > 0)
+    return vector<int>(1, 0);
+  return theParts;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The end index of a part
+ */
+// ----------------------------------------------------------------------
+
+int part_end(const vector<int> &theParts, size_t thePart, int theNumPoints)
+{
+  return (thePart + 1 < theParts.size() ? theParts[thePart + 1] : theNumPoints);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Convert a polyline into a multilinestring
+ */
+// ----------------------------------------------------------------------
+
+OGRGeometry *make_polyline(const NFmiEsriPolyLine &theLine)
+{
+  const vector<int> parts = part_starts(theLine.Parts(), theLine.NumPoints());
+  unique_ptr<OGRMultiLineString> geom(new OGRMultiLineString);
+  for (size_t p = 0; p < parts.size(); p++)
+  {
+    OGRLineString *line = new OGRLineString;
+    set_points(*line, theLine.Points(), parts[p], part_end(parts, p, theLine.NumPoints()));
+    geom->addGeometryDirectly(line);
+  }
+  return geom.release();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Convert a polygon into a multipolygon
+ *
+ * Each ring is first made into a polygon of its own, and OGR then
+ * assigns the counter-clockwise rings as holes to the clockwise ones
+ * containing them.
+ */
+// ----------------------------------------------------------------------
+
+OGRGeometry *make_polygon(const NFmiEsriPolygon &thePolygon)
+{
+  const vector<int> parts = part_starts(thePolygon.Parts(), thePolygon.NumPoints());
+
+  vector<OGRGeometry *> rings;
+  for (size_t p = 0; p < parts.size(); p++)
+  {
+    OGRLinearRing *ring = new OGRLinearRing;
+    set_points(*ring, thePolygon.Points(), parts[p], part_end(parts, p, thePolygon.NumPoints()));
+    OGRPolygon *polygon = new OGRPolygon;
+    polygon->addRingDirectly(ring);
+    rings.push_back(polygon);
+  }
+
+  OGRGeometry *geom = nullptr;
+  if (rings.empty())
+    geom = new OGRMultiPolygon;
+  else if (rings.size() == 1)
+    geom = rings[0];
+  else
+  {
+    const char *options[] = {"METHOD=ONLY_CCW", nullptr};
+    int valid = 0;
+    geom = OGRGeometryFactory::organizePolygons(
+        rings.data(), static_cast<int>(rings.size()), &valid, options);
+  }
+
+  return OGRGeometryFactory::forceToMultiPolygon(geom);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Convert an element into an OGR geometry
+ *
+ * \return Null for null elements
+ */
+// ----------------------------------------------------------------------
+
+OGRGeometry *make_geometry(const NFmiEsriElement &theElement)
+{
+  switch (theElement.Type())
+  {
+    case kFmiEsriNull:
+      return nullptr;
+    case kFmiEsriPoint:
+      return new OGRPoint(theElement.X(), theElement.Y());
+    case kFmiEsriMultiPoint:
+    {
+      const NFmiEsriMultiPoint &points = static_cast<const NFmiEsriMultiPoint &>(theElement);
+      unique_ptr<OGRMultiPoint> geom(new OGRMultiPoint);
+      for (const NFmiEsriPoint &point : points.Points())
+        geom->addGeometryDirectly(new OGRPoint(point.X(), point.Y()));
+      return geom.release();
+    }
+    case kFmiEsriPolyLine:
+      return make_polyline(static_cast<const NFmiEsriPolyLine &>(theElement));
+    case kFmiEsriPolygon:
+      return make_polygon(static_cast<const NFmiEsriPolygon &>(theElement));
+    default:
+      throw runtime_error("Only 2D shapes can be written through OGR");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create the attribute fields of the layer
+ */
+// ----------------------------------------------------------------------
+
+void create_fields(OGRLayer &theLayer, const NFmiEsriShape &theShape)
+{
+  const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
+  for (NFmiEsriShape::attributes_type::const_iterator it = attributes.begin();
+       it != attributes.end();
+       ++it)
+  {
+    const NFmiEsriAttributeName &attribute = **it;
+
+    OGRFieldType type = OFTString;
+    switch (attribute.Type())
+    {
+      case kFmiEsriString:
+        type = OFTString;
+        break;
+      case kFmiEsriInteger:
+        type = OFTInteger;
+        break;
+      case kFmiEsriDouble:
+        type = OFTReal;
+        break;
+      case kFmiEsriDate:
+        type = OFTDate;
+        break;
+    }
+
+    OGRFieldDefn field(attribute.Name().c_str(), type);
+    if (type != OFTDate)
+      field.SetWidth(attribute.Length());
+    if (type == OFTReal)
+      field.SetPrecision(attribute.Decimals());
+
+    if (theLayer.CreateField(&field) != OGRERR_NONE)
+      throw runtime_error("Failed to create field '" + attribute.Name() +
+                          "': " + CPLGetLastErrorMsg());
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Copy the attributes of an element into a feature
+ */
+// ----------------------------------------------------------------------
+
+void set_fields(OGRFeature &theFeature,
+                const NFmiEsriElement &theElement,
+                const NFmiEsriShape &theShape)
+{
+  int index = 0;
+  const NFmiEsriShape::attributes_type &attributes = theShape.Attributes();
+  for (NFmiEsriShape::attributes_type::const_iterator it = attributes.begin();
+       it != attributes.end();
+       ++it, ++index)
+  {
+    const string &name = (*it)->Name();
+    switch ((*it)->Type())
+    {
+      case kFmiEsriString:
+        theFeature.SetField(index, theElement.GetString(name).c_str());
+        break;
+      case kFmiEsriInteger:
+        theFeature.SetField(index, theElement.GetInteger(name));
+        break;
+      case kFmiEsriDouble:
+        theFeature.SetField(index, theElement.GetDouble(name));
+        break;
+      case kFmiEsriDate:
+      {
+        const NFmiMetTime date = theElement.GetDate(name);
+        theFeature.SetField(index, date.GetYear(), date.GetMonth(), date.GetDay());
+        break;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the layer and the features into a new dataset
+ */
+// ----------------------------------------------------------------------
+
+void write_layer(GDALDataset &theDataset,
+                 const NFmiEsriShape &theShape,
+                 const string &theLayerName,
+                 const string &theFileName)
+{
+  CPLStringList options;
+  options.SetNameValue("SPATIAL_INDEX", "YES");
+
+  OGRLayer *layer = theDataset.CreateLayer(
+      theLayerName.c_str(), nullptr, layer_type(theShape.Type()), options.List());
+  if (layer == nullptr)
+    throw runtime_error("Failed to create layer in '" + theFileName + "': " + CPLGetLastErrorMsg());
+
+  create_fields(*layer, theShape);
+
+  const bool transaction = (theDataset.StartTransaction() == OGRERR_NONE);
+
+  const NFmiEsriShape::elements_type &elements = theShape.Elements();
+  for (NFmiEsriShape::const_iterator it = elements.begin(); it != elements.end(); ++it)
+  {
+    OGRFeature feature(layer->GetLayerDefn());
+    if (*it != nullptr)
+    {
+      OGRGeometry *geom = make_geometry(**it);
+      if (geom != nullptr)
+        feature.SetGeometryDirectly(geom);
+      set_fields(feature, **it, theShape);
+    }
+
+    if (layer->CreateFeature(&feature) != OGRERR_NONE)
+      throw runtime_error("Failed to write a feature to '" + theFileName +
+                          "': " + CPLGetLastErrorMsg());
+  }
+
+  if (transaction && theDataset.CommitTransaction() != OGRERR_NONE)
+    throw runtime_error("Failed to commit features to '" + theFileName +
+                        "': " + CPLGetLastErrorMsg());
+}
+
+}  // namespace
+
+namespace OgrWriter
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Verify that the output format is known
+ *
+ * \param theFormat The format name: shape, fgb or gpkg
+ */
+// ----------------------------------------------------------------------
+
+void checkFormat(const string &theFormat)
+{
+  if (theFormat != "shape" && find_format(theFormat) == nullptr)
+    throw runtime_error("Unknown output format '" + theFormat + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the output format is written through OGR
+ *
+ * \param theFormat The format name: shape, fgb or gpkg
+ * \return False for shapefiles, which are written by the caller
+ * \throws runtime_error for unknown formats
+ */
+// ----------------------------------------------------------------------
+
+bool isOgrFormat(const string &theFormat)
+{
+  checkFormat(theFormat);
+  return (find_format(theFormat) != nullptr);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the shape through OGR
+ *
+ * The suffix of the format is appended to the name unless already
+ * present. An existing file is replaced. The features are written in
+ * a single transaction if the format supports transactions. On errors
+ * the partially written file is removed.
+ *
+ * \param theShape The shape to write
+ * \param theName The output file name, with or without the suffix
+ * \param theFormat The format name: fgb or gpkg
+ */
+// ----------------------------------------------------------------------
+
+void write(const NFmiEsriShape &theShape, const string &theName, const string &theFormat)
+{
+  const Format *format = find_format(theFormat);
+  if (format == nullptr)
+    throw runtime_error("Format '" + theFormat + "' is not written through OGR");
+
+  const string suffix = format->suffix;
+  string filename = theName;
+  string layername = theName;
+  if (filename.size() > suffix.size() &&
+      filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0)
+    layername.resize(filename.size() - suffix.size());
+  else
+    filename += suffix;
+
+  const string::size_type pos = layername.rfind('/');
+  if (pos != string::npos)
+    layername = layername.substr(pos + 1);
+
+  GDALAllRegister();
+
+  GDALDriver *driver = GetGDALDriverManager()->GetDriverByName(format->driver);
+  if (driver == nullptr)
+    throw runtime_error(string("GDAL driver ") + format->driver + " is not available");
+
+  // Neither driver overwrites existing files
+
+  remove(filename.c_str());
+
+  unique_ptr<GDALDataset, DatasetCloser> dataset(
+      driver->Create(filename.c_str(), 0, 0, 0, GDT_Unknown, nullptr));
+  if (!dataset)
+    throw runtime_error("Failed to create '" + filename + "': " + CPLGetLastErrorMsg());
+
+  // A partially written file is removed
+
+  try
+  {
+    write_layer(*dataset, theShape, layername, filename);
+  }
+  catch (...)
+  {
+    dataset.reset();
+    remove(filename.c_str());
+    throw;
+  }
+
+  // FlatGeobuf writes the features and the index only when closed
+
+  if (GDALClose(dataset.release()) != CE_None)
+  {
+    remove(filename.c_str());
+    throw runtime_error("Failed to write '" + filename + "': " + CPLGetLastErrorMsg());
+  }
+}
+
+}  // namespace OgrWriter
+
+// ======================================================================
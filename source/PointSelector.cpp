@@ -42,14 +42,41 @@
  * close to Helsinki. Whether or not the points would be removed
  * would depend on the details of the projection.
  *
+ * Instead of a single selection one may also request the ranks of
+ * all the candidates, limited from above by the minimum distance
+ * setting. The points whose rank is at least D are at least D apart,
+ * and a point included for distance D is included for all smaller
+ * distances too:
+ * \code
+ * selector.minDistance(80);
+ * PointSelector::RankList ranks = selector.ranks();
+ * \endcode
+ * The greedy selection is not monotone in the distance, hence the
+ * points ranked at least D may be fewer than the ones selected with
+ * minDistance(D). A point suppressed by a neighbour is not restored
+ * at larger distances even if the neighbour no longer survives.
+ *
+ * For a fixed set of distances the levels are both nested and
+ * complete. The points are selected greedily for the largest
+ * distance, and then for each smaller distance in turn keeping the
+ * points selected so far. The points of level N or higher are then
+ * a selection for the Nth smallest distance:
+ * \code
+ * PointSelector::LevelList levels = selector.levels({10, 20, 40, 80});
+ * \endcode
+ *
  */
 // ======================================================================
 
 #include "PointSelector.h"
+#include "ProjectionTools.h"
 #include <newbase/NFmiArea.h>
 #include <newbase/NFmiNearTree.h>
+#include <cmath>
 #include <map>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -68,6 +95,22 @@ struct PointData
   PointData(int theID, double theX, double theY) : id(theID), x(theX), y(theY) {}
 };
 
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Hash key for a grid cell used in ranking the points
+ */
+// ----------------------------------------------------------------------
+
+unsigned long long cell_key(long long theI, long long theJ)
+{
+  return (static_cast<unsigned long long>(theI) << 32) ^
+         (static_cast<unsigned long long>(theJ) & 0xFFFFFFFFULL);
+}
+
+}  // namespace
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Implementation hiding pimple
@@ -95,10 +138,17 @@ class PointSelector::Pimple
  public:
   Pimple(const NFmiArea &theArea, bool theNegateFlag);
   bool add(int theID, double theValue, double theLon, double theLat);
+  bool addXY(int theID, double theValue, double theX, double theY);
+  size_type add(const vector<int> &theIDs,
+                const vector<double> &theValues,
+                const vector<double> &theLons,
+                const vector<double> &theLats);
   bool empty() const;
   size_type size() const;
   const_iterator begin() const;
   const_iterator end() const;
+  RankList ranks() const;
+  LevelList levels(const vector<double> &theDistances) const;
 
 };  // class PointSelector::Pimple
 
@@ -190,7 +240,24 @@ bool PointSelector::Pimple::add(int theID, double theValue, double theLon, doubl
 {
   // Convert to image points
   NFmiPoint xy = itsArea.ToXY(NFmiPoint(theLon, theLat));
-  if (xy.X() < itsX1 || xy.X() > itsX2 || xy.Y() < itsY1 || xy.Y() > itsY2)
+  return addXY(theID, theValue, xy.X(), xy.Y());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new candidate point in image coordinates
+ *
+ * \param theID The unique ID of the point
+ * \param theValue The value used for sorting the points
+ * \param theX The image x-coordinate
+ * \param theY The image y-coordinate
+ * \return True, if the point was accepted as a candidate
+ */
+// ----------------------------------------------------------------------
+
+bool PointSelector::Pimple::addXY(int theID, double theValue, double theX, double theY)
+{
+  if (theX < itsX1 || theX > itsX2 || theY < itsY1 || theY > itsY2)
     return false;
 
   // Invalidate the results
@@ -200,7 +267,7 @@ bool PointSelector::Pimple::add(int theID, double theValue, double theLon, doubl
 
   // Add the point to the candidates
 
-  PointData pd(theID, xy.X(), xy.Y());
+  PointData pd(theID, theX, theY);
   if (itsNegateFlag)
     itsCandidates.insert(make_pair(-theValue, pd));
   else
@@ -209,6 +276,37 @@ bool PointSelector::Pimple::add(int theID, double theValue, double theLon, doubl
   return true;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add new candidate points projecting them all at once
+ *
+ * \param theIDs The unique IDs of the points
+ * \param theValues The values used for sorting the points
+ * \param theLons The longitudes
+ * \param theLats The latitudes
+ * \return The number of points accepted as candidates
+ */
+// ----------------------------------------------------------------------
+
+PointSelector::size_type PointSelector::Pimple::add(const vector<int> &theIDs,
+                                                    const vector<double> &theValues,
+                                                    const vector<double> &theLons,
+                                                    const vector<double> &theLats)
+{
+  const size_t n = theIDs.size();
+  if (theValues.size() != n || theLons.size() != n || theLats.size() != n)
+    throw runtime_error("PointSelector::add input vectors must be of equal size");
+
+  vector<double> x(n), y(n);
+  ProjectionTools::toXY(itsArea, theLons.data(), theLats.data(), x.data(), y.data(), n);
+
+  size_type count = 0;
+  for (size_t i = 0; i < n; i++)
+    if (addXY(theIDs[i], theValues[i], x[i], y[i]))
+      ++count;
+  return count;
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Reduce the results
@@ -246,6 +344,131 @@ void PointSelector::Pimple::reduce() const
   itsReduced = true;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rank all the candidates
+ *
+ * The rank r(i) of candidate i is the smallest distance to an earlier
+ * candidate j for which the distance is less than r(j). Points not
+ * suppressed by any earlier point get the maximum distance. Two points
+ * ranked at least D cannot then be closer than D to each other.
+ *
+ * Since only distances below the maximum matter, the accepted points
+ * are stored into a grid whose cell size equals the maximum distance
+ * and only the 3x3 neighbouring cells need to be searched.
+ */
+// ----------------------------------------------------------------------
+
+PointSelector::RankList PointSelector::Pimple::ranks() const
+{
+  RankList results;
+
+  const double maxdist = itsMinDistance;
+
+  if (maxdist <= 0)
+  {
+    for (Candidates::const_iterator it = itsCandidates.begin(); it != itsCandidates.end(); ++it)
+      results.push_back(make_pair(it->second.id, 0.0));
+    return results;
+  }
+
+  // The points which may still suppress later candidates and their ranks
+
+  vector<const PointData *> points;
+  vector<double> pointranks;
+  unordered_map<unsigned long long, vector<size_t>> grid;
+
+  for (Candidates::const_iterator it = itsCandidates.begin(); it != itsCandidates.end(); ++it)
+  {
+    const PointData &pd = it->second;
+    const long long i = static_cast<long long>(floor(pd.x / maxdist));
+    const long long j = static_cast<long long>(floor(pd.y / maxdist));
+
+    double rank = maxdist;
+    for (long long ii = i - 1; ii <= i + 1; ii++)
+      for (long long jj = j - 1; jj <= j + 1; jj++)
+      {
+        const auto cell = grid.find(cell_key(ii, jj));
+        if (cell == grid.end())
+          continue;
+        for (size_t k : cell->second)
+        {
+          const double dx = pd.x - points[k]->x;
+          const double dy = pd.y - points[k]->y;
+          const double dist = sqrt(dx * dx + dy * dy);
+          if (dist < pointranks[k] && dist < rank)
+            rank = dist;
+        }
+      }
+
+    results.push_back(make_pair(pd.id, rank));
+
+    // A point with zero rank cannot suppress anything
+
+    if (rank > 0)
+    {
+      grid[cell_key(i, j)].push_back(points.size());
+      points.push_back(&pd);
+      pointranks.push_back(rank);
+    }
+  }
+
+  return results;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select the candidates at several distances
+ *
+ * The greedy selection is run for each distance starting from the
+ * largest one, keeping the points selected at the larger distances.
+ */
+// ----------------------------------------------------------------------
+
+PointSelector::LevelList PointSelector::Pimple::levels(const vector<double> &theDistances) const
+{
+  for (size_t s = 0; s < theDistances.size(); s++)
+  {
+    if (theDistances[s] <= 0)
+      throw runtime_error("PointSelector::levels distances must be positive");
+    if (s > 0 && theDistances[s] <= theDistances[s - 1])
+      throw runtime_error("PointSelector::levels distances must be in ascending order");
+  }
+
+  vector<const PointData *> points;
+  for (Candidates::const_iterator it = itsCandidates.begin(); it != itsCandidates.end(); ++it)
+    points.push_back(&it->second);
+
+  vector<int> pointlevels(points.size(), 0);
+
+  // The points selected so far at any of the distances
+
+  NFmiNearTree<NFmiPoint> ntree;
+  NFmiPoint nearest;
+
+  for (size_t s = theDistances.size(); s > 0; s--)
+  {
+    for (size_t k = 0; k < points.size(); k++)
+    {
+      if (pointlevels[k] > 0)
+        continue;
+      const NFmiPoint xy(points[k]->x, points[k]->y);
+      if (!ntree.NearestPoint(nearest, xy, theDistances[s - 1]))
+      {
+        pointlevels[k] = static_cast<int>(s);
+        ntree.Insert(xy);
+      }
+    }
+  }
+
+  LevelList results;
+  for (size_t k = 0; k < points.size(); k++)
+    if (pointlevels[k] > 0)
+      results.push_back(make_pair(points[k]->id, pointlevels[k]));
+
+  return results;
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Destructor
@@ -326,6 +549,29 @@ bool PointSelector::add(int theID, double theValue, double theLon, double theLat
   return itsPimple->add(theID, theValue, theLon, theLat);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add new candidate points to be processed later
+ *
+ * All the points are projected in a single batch, which is much
+ * faster than adding the points one at a time.
+ *
+ * \param theIDs The unique IDs for the points
+ * \param theValues The values for sorting
+ * \param theLons The longitudes
+ * \param theLats The latitudes
+ * \return The number of points within the bounding box
+ */
+// ----------------------------------------------------------------------
+
+PointSelector::size_type PointSelector::add(const std::vector<int> &theIDs,
+                                            const std::vector<double> &theValues,
+                                            const std::vector<double> &theLons,
+                                            const std::vector<double> &theLats)
+{
+  return itsPimple->add(theIDs, theValues, theLons, theLats);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Test if the number of selected points is zero
@@ -374,4 +620,39 @@ PointSelector::const_iterator PointSelector::end() const
   return itsPimple->end();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rank all the candidate points
+ *
+ * The minimum distance acts as the upper limit for the ranks.
+ * The points ranked at least D are at least D apart.
+ *
+ * \return The candidate IDs in descending order of importance
+ *         paired with their ranks
+ */
+// ----------------------------------------------------------------------
+
+PointSelector::RankList PointSelector::ranks() const
+{
+  return itsPimple->ranks();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select the candidate points at several distances
+ *
+ * The points of level N or higher are a selection for the Nth
+ * distance. Points not selected at any of the distances are omitted.
+ *
+ * \param theDistances Positive distances in ascending order
+ * \return The selected IDs in descending order of importance
+ *         paired with their levels
+ */
+// ----------------------------------------------------------------------
+
+PointSelector::LevelList PointSelector::levels(const std::vector<double> &theDistances) const
+{
+  return itsPimple->levels(theDistances);
+}
+
 // ======================================================================
@@ -0,0 +1,204 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace ProjectionTools
+ */
+// ======================================================================
+/*!
+ * \namespace ProjectionTools
+ *
+ * Bulk coordinate transformations for arrays of points. The input
+ * and output arrays may be the same, in which case the coordinates
+ * are transformed in place.
+ *
+ * Large arrays are split into contiguous spans which are processed
+ * in separate threads. Since the coordinate transformations inside
+ * an area are not safe for concurrent use, each thread works with
+ * its own clone of the area.
+ */
+// ======================================================================
+
+#include "ProjectionTools.h"
+#include <newbase/NFmiArea.h>
+#include <newbase/NFmiPoint.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+//! Minimum number of points per thread worth the thread startup cost
+const size_t min_points_per_thread = 20000;
+
+//! The supported transformations
+enum Direction
+{
+  kToXY,
+  kToLatLon,
+  kLatLonToWorldXY,
+  kWorldXYToLatLon
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Transform a contiguous span of points in a single thread
+ */
+// ----------------------------------------------------------------------
+
+void transform_span(const NFmiArea &theArea,
+                    Direction theDirection,
+                    const double *theX1,
+                    const double *theY1,
+                    double *theX2,
+                    double *theY2,
+                    size_t theCount)
+{
+  for (size_t i = 0; i < theCount; i++)
+  {
+    const NFmiPoint p(theX1[i], theY1[i]);
+    NFmiPoint q;
+    switch (theDirection)
+    {
+      case kToXY:
+        q = theArea.ToXY(p);
+        break;
+      case kToLatLon:
+        q = theArea.ToLatLon(p);
+        break;
+      case kLatLonToWorldXY:
+        q = theArea.LatLonToWorldXY(p);
+        break;
+      case kWorldXYToLatLon:
+        q = theArea.WorldXYToLatLon(p);
+        break;
+    }
+    theX2[i] = q.X();
+    theY2[i] = q.Y();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Transform all the points, splitting large spans into threads
+ */
+// ----------------------------------------------------------------------
+
+void transform(const NFmiArea &theArea,
+               Direction theDirection,
+               const double *theX1,
+               const double *theY1,
+               double *theX2,
+               double *theY2,
+               size_t theCount)
+{
+  const size_t maxthreads = max(1u, thread::hardware_concurrency());
+  const size_t nthreads = min(maxthreads, theCount / min_points_per_thread);
+
+  if (nthreads <= 1)
+  {
+    transform_span(theArea, theDirection, theX1, theY1, theX2, theY2, theCount);
+    return;
+  }
+
+  // Clone the areas before starting any threads
+
+  vector<shared_ptr<NFmiArea>> areas;
+  for (size_t t = 0; t < nthreads; t++)
+    areas.push_back(shared_ptr<NFmiArea>(theArea.Clone()));
+
+  const size_t chunk = (theCount + nthreads - 1) / nthreads;
+
+  vector<thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+  {
+    const size_t pos = t * chunk;
+    const size_t count = min(chunk, theCount - pos);
+    threads.push_back(thread(transform_span,
+                             std::cref(*areas[t]),
+                             theDirection,
+                             theX1 + pos,
+                             theY1 + pos,
+                             theX2 + pos,
+                             theY2 + pos,
+                             count));
+  }
+
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+}
+
+}  // namespace
+
+namespace ProjectionTools
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Project latlon coordinates to XY coordinates
+ */
+// ----------------------------------------------------------------------
+
+void toXY(const NFmiArea &theArea,
+          const double *theLons,
+          const double *theLats,
+          double *theX,
+          double *theY,
+          size_t theCount)
+{
+  transform(theArea, kToXY, theLons, theLats, theX, theY, theCount);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Project XY coordinates to latlon coordinates
+ */
+// ----------------------------------------------------------------------
+
+void toLatLon(const NFmiArea &theArea,
+              const double *theX,
+              const double *theY,
+              double *theLons,
+              double *theLats,
+              size_t theCount)
+{
+  transform(theArea, kToLatLon, theX, theY, theLons, theLats, theCount);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Project latlon coordinates to world XY coordinates
+ */
+// ----------------------------------------------------------------------
+
+void latLonToWorldXY(const NFmiArea &theArea,
+                     const double *theLons,
+                     const double *theLats,
+                     double *theX,
+                     double *theY,
+                     size_t theCount)
+{
+  transform(theArea, kLatLonToWorldXY, theLons, theLats, theX, theY, theCount);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Project world XY coordinates to latlon coordinates
+ */
+// ----------------------------------------------------------------------
+
+void worldXYToLatLon(const NFmiArea &theArea,
+                     const double *theX,
+                     const double *theY,
+                     double *theLons,
+                     double *theLats,
+                     size_t theCount)
+{
+  transform(theArea, kWorldXYToLatLon, theX, theY, theLons, theLats, theCount);
+}
+
+}  // namespace ProjectionTools
+
+// ======================================================================
@@ -0,0 +1,830 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace Pslg
+ */
+// ======================================================================
+
+#include "Pslg.h"
+#include "MappedFile.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+//! Size of the output buffer before it is flushed to disk
+const size_t output_buffer_size = 4 * 1024 * 1024;
+
+//! Magic header for binary files, the last character is the file type
+const char binary_magic[] = "PSLGBIN";
+
+//! Byte order marker for binary files
+const uint32_t byte_order_marker = 0x01020304;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Tokenizer for memory mapped text files
+ *
+ * Whitespace and comments starting with '#' separate the tokens.
+ */
+// ----------------------------------------------------------------------
+
+class Tokenizer
+{
+ public:
+  Tokenizer(const MappedFile &theFile)
+      : itsName(theFile.name()), itsPtr(theFile.data()), itsEnd(theFile.data() + theFile.size())
+  {
+  }
+
+  long getLong()
+  {
+    skip();
+    long value = 0;
+    const from_chars_result result = from_chars(itsPtr, itsEnd, value);
+    if (result.ec != errc())
+      throw runtime_error("Error: Error reading an integer from " + itsName);
+    itsPtr = result.ptr;
+    return value;
+  }
+
+  double getDouble()
+  {
+    skip();
+    double value = 0;
+    const from_chars_result result = from_chars(itsPtr, itsEnd, value);
+    if (result.ec != errc())
+      throw runtime_error("Error: Error reading a number from " + itsName);
+    itsPtr = result.ptr;
+    return value;
+  }
+
+  //! True if there are no more tokens on the current line
+  bool endOfLine()
+  {
+    while (itsPtr < itsEnd && (*itsPtr == ' ' || *itsPtr == '\t' || *itsPtr == '\r'))
+      ++itsPtr;
+    return (itsPtr >= itsEnd || *itsPtr == '\n' || *itsPtr == '#');
+  }
+
+  //! True if there are no more tokens in the file
+  bool eof()
+  {
+    skip();
+    return (itsPtr >= itsEnd);
+  }
+
+ private:
+  void skip()
+  {
+    while (itsPtr < itsEnd)
+    {
+      const char ch = *itsPtr;
+      if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+        ++itsPtr;
+      else if (ch == '#')
+      {
+        while (itsPtr < itsEnd && *itsPtr != '\n')
+          ++itsPtr;
+      }
+      else
+        break;
+    }
+  }
+
+  const string &itsName;
+  const char *itsPtr;
+  const char *itsEnd;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Buffered output
+ */
+// ----------------------------------------------------------------------
+
+class Output
+{
+ public:
+  ~Output()
+  {
+    try
+    {
+      close();
+    }
+    catch (...)
+    {
+    }
+  }
+
+  Output(const string &theFile) : itsName(theFile), itsOut(theFile.c_str(), ios::out | ios::binary)
+  {
+    if (!itsOut)
+      throw runtime_error("Error: Could not open " + theFile + " for writing");
+    itsBuffer.reserve(output_buffer_size + 64);
+  }
+
+  void put(long theValue)
+  {
+    char tmp[32];
+    const to_chars_result result = to_chars(tmp, tmp + sizeof(tmp), theValue);
+    itsBuffer.append(tmp, result.ptr);
+    check();
+  }
+
+  void put(double theValue)
+  {
+    char tmp[64];
+    const to_chars_result result = to_chars(tmp, tmp + sizeof(tmp), theValue);
+    itsBuffer.append(tmp, result.ptr);
+    check();
+  }
+
+  void put(char theChar) { itsBuffer += theChar; }
+
+  void put(const char *theString) { itsBuffer += theString; }
+
+  template <typename T>
+  void raw(const T &theValue)
+  {
+    itsBuffer.append(reinterpret_cast<const char *>(&theValue), sizeof(T));
+    check();
+  }
+
+  template <typename T>
+  void raw(const vector<T> &theValues)
+  {
+    raw(static_cast<uint64_t>(theValues.size()));
+    if (!theValues.empty())
+      itsBuffer.append(reinterpret_cast<const char *>(theValues.data()),
+                       theValues.size() * sizeof(T));
+    check();
+  }
+
+  void close()
+  {
+    flush();
+    if (itsOut.is_open())
+    {
+      itsOut.close();
+      if (itsOut.fail())
+        throw runtime_error("Error: Failed to write " + itsName);
+    }
+  }
+
+ private:
+  void check()
+  {
+    if (itsBuffer.size() >= output_buffer_size)
+      flush();
+  }
+
+  void flush()
+  {
+    if (!itsBuffer.empty())
+    {
+      itsOut.write(itsBuffer.data(), itsBuffer.size());
+      itsBuffer.clear();
+    }
+  }
+
+  string itsName;
+  ofstream itsOut;
+  string itsBuffer;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reader for binary files
+ */
+// ----------------------------------------------------------------------
+
+class BinaryInput
+{
+ public:
+  BinaryInput(const MappedFile &theFile, char theType)
+      : itsName(theFile.name()), itsPtr(theFile.data()), itsEnd(theFile.data() + theFile.size())
+  {
+    need(8);
+    if (itsPtr[7] != theType)
+      throw runtime_error("Error: " + itsName + " is a binary PSLG file of the wrong type");
+    itsPtr += 8;
+    if (get<uint32_t>() != byte_order_marker)
+      throw runtime_error("Error: " + itsName + " has the wrong byte order");
+  }
+
+  template <typename T>
+  T get()
+  {
+    need(sizeof(T));
+    T value;
+    memcpy(&value, itsPtr, sizeof(T));
+    itsPtr += sizeof(T);
+    return value;
+  }
+
+  template <typename T>
+  void get(vector<T> &theValues)
+  {
+    const uint64_t n = get<uint64_t>();
+    if (n > static_cast<size_t>(itsEnd - itsPtr) / sizeof(T))
+      throw runtime_error("Error: " + itsName + " is truncated");
+    theValues.resize(n);
+    if (n > 0)
+      memcpy(theValues.data(), itsPtr, n * sizeof(T));
+    itsPtr += n * sizeof(T);
+  }
+
+ private:
+  void need(size_t theSize) const
+  {
+    if (static_cast<size_t>(itsEnd - itsPtr) < theSize)
+      throw runtime_error("Error: " + itsName + " is truncated");
+  }
+
+  const string &itsName;
+  const char *itsPtr;
+  const char *itsEnd;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the mapped file is in binary form
+ */
+// ----------------------------------------------------------------------
+
+bool is_binary(const MappedFile &theFile)
+{
+  return (theFile.size() >= 8 && memcmp(theFile.data(), binary_magic, 7) == 0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start a binary file of the given type
+ */
+// ----------------------------------------------------------------------
+
+void write_binary_header(Output &theOutput, char theType)
+{
+  theOutput.put(binary_magic);
+  theOutput.put(theType);
+  theOutput.raw(byte_order_marker);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a table holds theCount rows of theWidth values
+ *
+ * Division is used instead of multiplication, since the width read
+ * from a file may be arbitrarily large.
+ */
+// ----------------------------------------------------------------------
+
+bool has_rows(size_t theSize, size_t theCount, size_t theWidth)
+{
+  if (theWidth == 0)
+    return (theSize == 0);
+  return (theSize % theWidth == 0 && theSize / theWidth == theCount);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Validate node data after reading and before writing
+ */
+// ----------------------------------------------------------------------
+
+void check(const Pslg::NodeData &theData)
+{
+  const size_t n = theData.size();
+  if (theData.y.size() != n || !has_rows(theData.attr.size(), n, theData.attributes) ||
+      theData.marker.size() != (theData.markers ? n : 0))
+    throw runtime_error("Error: Inconsistent PSLG node data");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Validate polygon data after reading and before writing
+ */
+// ----------------------------------------------------------------------
+
+void check(const Pslg::PolyData &theData)
+{
+  check(theData.nodes);
+
+  const size_t n = theData.size();
+  const size_t holes = theData.holex.size();
+  const size_t regions = theData.regionx.size();
+
+  if (theData.idx2.size() != n || theData.marker.size() != (theData.markers ? n : 0) ||
+      theData.holey.size() != holes || theData.regiony.size() != regions ||
+      theData.regionattr.size() != regions ||
+      theData.maxarea.size() != (theData.maxareas ? regions : 0))
+    throw runtime_error("Error: Inconsistent PSLG polygon data");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Validate triangle data after reading and before writing
+ */
+// ----------------------------------------------------------------------
+
+void check(const Pslg::EleData &theData)
+{
+  if (theData.corners == 0 || theData.idx.size() % theData.corners != 0 ||
+      !has_rows(theData.attr.size(), theData.size(), theData.attributes))
+    throw runtime_error("Error: Inconsistent PSLG triangle data");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the nodes from text
+ *
+ * Parsing starts from the header line with the number of nodes.
+ */
+// ----------------------------------------------------------------------
+
+void parse_nodes(Tokenizer &theInput, Pslg::NodeData &theData)
+{
+  const long n = theInput.getLong();
+  const long dimension = theInput.getLong();
+  const long attributes = theInput.getLong();
+  const long markers = theInput.getLong();
+
+  if (n < 0 || attributes < 0)
+    throw runtime_error("Error: Negative counts in PSLG node header");
+  if (dimension != 2)
+    throw runtime_error("Error: Only 2-dimensional PSLG data is supported");
+
+  theData.attributes = attributes;
+  theData.markers = (markers != 0);
+  theData.x.resize(n);
+  theData.y.resize(n);
+  theData.attr.resize(n * attributes);
+  theData.marker.resize(theData.markers ? n : 0);
+
+  for (long i = 0; i < n; i++)
+  {
+    const long number = theInput.getLong();
+    if (i == 0)
+      theData.first = number;
+    theData.x[i] = theInput.getDouble();
+    theData.y[i] = theInput.getDouble();
+    for (long a = 0; a < attributes; a++)
+      theData.attr[i * attributes + a] = theInput.getDouble();
+    if (theData.markers)
+      theData.marker[i] = theInput.getLong();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Format the nodes as text
+ */
+// ----------------------------------------------------------------------
+
+void format_nodes(Output &theOutput, const Pslg::NodeData &theData)
+{
+  const size_t n = theData.size();
+
+  // #points dimension #attributes #boundarymarkers
+  theOutput.put(static_cast<long>(n));
+  theOutput.put(" 2 ");
+  theOutput.put(static_cast<long>(theData.attributes));
+  theOutput.put(theData.markers ? " 1\n" : " 0\n");
+
+  for (size_t i = 0; i < n; i++)
+  {
+    theOutput.put(static_cast<long>(theData.first + i));
+    theOutput.put('\t');
+    theOutput.put(theData.x[i]);
+    theOutput.put('\t');
+    theOutput.put(theData.y[i]);
+    for (size_t a = 0; a < theData.attributes; a++)
+    {
+      theOutput.put('\t');
+      theOutput.put(theData.attr[i * theData.attributes + a]);
+    }
+    if (theData.markers)
+    {
+      theOutput.put('\t');
+      theOutput.put(theData.marker[i]);
+    }
+    theOutput.put('\n');
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read binary nodes
+ */
+// ----------------------------------------------------------------------
+
+void get_nodes(BinaryInput &theInput, Pslg::NodeData &theData)
+{
+  theData.first = theInput.get<int64_t>();
+  theData.attributes = theInput.get<uint64_t>();
+  theData.markers = (theInput.get<uint32_t>() != 0);
+  theInput.get(theData.x);
+  theInput.get(theData.y);
+  theInput.get(theData.attr);
+  theInput.get(theData.marker);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write binary nodes
+ */
+// ----------------------------------------------------------------------
+
+void put_nodes(Output &theOutput, const Pslg::NodeData &theData)
+{
+  theOutput.raw(static_cast<int64_t>(theData.first));
+  theOutput.raw(static_cast<uint64_t>(theData.attributes));
+  theOutput.raw(static_cast<uint32_t>(theData.markers ? 1 : 0));
+  theOutput.raw(theData.x);
+  theOutput.raw(theData.y);
+  theOutput.raw(theData.attr);
+  theOutput.raw(theData.marker);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse a .poly file from text
+ */
+// ----------------------------------------------------------------------
+
+void parse_poly(Tokenizer &theInput, Pslg::PolyData &theData, const string &theFile)
+{
+  // First the optional nodes
+
+  parse_nodes(theInput, theData.nodes);
+
+  // Then the edges: #edges #boundarymarkers
+
+  const long n = theInput.getLong();
+  if (n < 0)
+    throw runtime_error("Error: Negative number of edges in " + theFile);
+
+  theData.markers = (theInput.getLong() != 0);
+  theData.idx1.resize(n);
+  theData.idx2.resize(n);
+  theData.marker.resize(theData.markers ? n : 0);
+
+  for (long i = 0; i < n; i++)
+  {
+    static_cast<void>(theInput.getLong());
+    theData.idx1[i] = theInput.getLong();
+    theData.idx2[i] = theInput.getLong();
+    if (theData.markers)
+      theData.marker[i] = theInput.getLong();
+  }
+
+  // Then the holes
+
+  const long holes = theInput.getLong();
+  if (holes < 0)
+    throw runtime_error("Error: Negative number of holes in " + theFile);
+
+  theData.holex.resize(holes);
+  theData.holey.resize(holes);
+  for (long i = 0; i < holes; i++)
+  {
+    static_cast<void>(theInput.getLong());
+    theData.holex[i] = theInput.getDouble();
+    theData.holey[i] = theInput.getDouble();
+  }
+
+  // And the optional regional attributes
+
+  if (theInput.eof())
+    return;
+
+  const long regions = theInput.getLong();
+  if (regions < 0)
+    throw runtime_error("Error: Negative number of regions in " + theFile);
+
+  theData.regionx.resize(regions);
+  theData.regiony.resize(regions);
+  theData.regionattr.resize(regions);
+  for (long i = 0; i < regions; i++)
+  {
+    static_cast<void>(theInput.getLong());
+    theData.regionx[i] = theInput.getDouble();
+    theData.regiony[i] = theInput.getDouble();
+    theData.regionattr[i] = theInput.getDouble();
+    if (!theInput.endOfLine())
+    {
+      if (!theData.maxareas)
+      {
+        theData.maxareas = true;
+        theData.maxarea.resize(regions, -1);
+      }
+      theData.maxarea[i] = theInput.getDouble();
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse a .ele file from text
+ */
+// ----------------------------------------------------------------------
+
+void parse_ele(Tokenizer &theInput, Pslg::EleData &theData, const string &theFile)
+{
+  // First row: #triangles #nodespertriangle #attributes
+
+  const long n = theInput.getLong();
+  const long corners = theInput.getLong();
+  const long attributes = theInput.getLong();
+
+  if (n < 0 || corners <= 0 || attributes < 0)
+    throw runtime_error("Error: Invalid header in " + theFile);
+
+  theData.corners = corners;
+  theData.attributes = attributes;
+  theData.idx.resize(n * corners);
+  theData.attr.resize(n * attributes);
+
+  for (long i = 0; i < n; i++)
+  {
+    const long number = theInput.getLong();
+    if (i == 0)
+      theData.first = number;
+    for (long c = 0; c < corners; c++)
+      theData.idx[i * corners + c] = theInput.getLong();
+    for (long a = 0; a < attributes; a++)
+      theData.attr[i * attributes + a] = theInput.getDouble();
+  }
+}
+
+}  // namespace
+
+namespace Pslg
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read a .node file
+ */
+// ----------------------------------------------------------------------
+
+void read(const string &theFile, NodeData &theData)
+{
+  const MappedFile file(theFile);
+
+  theData = NodeData();
+
+  if (is_binary(file))
+  {
+    BinaryInput input(file, 'N');
+    get_nodes(input, theData);
+  }
+  else
+  {
+    Tokenizer input(file);
+    parse_nodes(input, theData);
+  }
+  check(theData);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read a .poly file
+ */
+// ----------------------------------------------------------------------
+
+void read(const string &theFile, PolyData &theData)
+{
+  const MappedFile file(theFile);
+
+  theData = PolyData();
+
+  if (is_binary(file))
+  {
+    BinaryInput input(file, 'P');
+    get_nodes(input, theData.nodes);
+    theData.markers = (input.get<uint32_t>() != 0);
+    input.get(theData.idx1);
+    input.get(theData.idx2);
+    input.get(theData.marker);
+    input.get(theData.holex);
+    input.get(theData.holey);
+    theData.maxareas = (input.get<uint32_t>() != 0);
+    input.get(theData.regionx);
+    input.get(theData.regiony);
+    input.get(theData.regionattr);
+    input.get(theData.maxarea);
+  }
+  else
+  {
+    Tokenizer input(file);
+    parse_poly(input, theData, theFile);
+  }
+  check(theData);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read a .ele file
+ */
+// ----------------------------------------------------------------------
+
+void read(const string &theFile, EleData &theData)
+{
+  const MappedFile file(theFile);
+
+  theData = EleData();
+
+  if (is_binary(file))
+  {
+    BinaryInput input(file, 'E');
+    theData.first = input.get<int64_t>();
+    theData.corners = input.get<uint64_t>();
+    theData.attributes = input.get<uint64_t>();
+    input.get(theData.idx);
+    input.get(theData.attr);
+  }
+  else
+  {
+    Tokenizer input(file);
+    parse_ele(input, theData, theFile);
+  }
+  check(theData);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a .node file
+ */
+// ----------------------------------------------------------------------
+
+void write(const string &theFile, const NodeData &theData, bool theBinaryFlag)
+{
+  check(theData);
+
+  Output output(theFile);
+  if (theBinaryFlag)
+  {
+    write_binary_header(output, 'N');
+    put_nodes(output, theData);
+  }
+  else
+    format_nodes(output, theData);
+  output.close();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a .poly file
+ *
+ * The regional attributes section is written only if there are regions.
+ */
+// ----------------------------------------------------------------------
+
+void write(const string &theFile, const PolyData &theData, bool theBinaryFlag)
+{
+  check(theData);
+
+  const size_t n = theData.size();
+  const size_t holes = theData.holex.size();
+  const size_t regions = theData.regionx.size();
+
+  Output output(theFile);
+
+  if (theBinaryFlag)
+  {
+    write_binary_header(output, 'P');
+    put_nodes(output, theData.nodes);
+    output.raw(static_cast<uint32_t>(theData.markers ? 1 : 0));
+    output.raw(theData.idx1);
+    output.raw(theData.idx2);
+    output.raw(theData.marker);
+    output.raw(theData.holex);
+    output.raw(theData.holey);
+    output.raw(static_cast<uint32_t>(theData.maxareas ? 1 : 0));
+    output.raw(theData.regionx);
+    output.raw(theData.regiony);
+    output.raw(theData.regionattr);
+    output.raw(theData.maxarea);
+    output.close();
+    return;
+  }
+
+  format_nodes(output, theData.nodes);
+
+  output.put(static_cast<long>(n));
+  output.put(theData.markers ? " 1\n" : " 0\n");
+  for (size_t i = 0; i < n; i++)
+  {
+    output.put(static_cast<long>(i + 1));
+    output.put('\t');
+    output.put(theData.idx1[i]);
+    output.put('\t');
+    output.put(theData.idx2[i]);
+    if (theData.markers)
+    {
+      output.put('\t');
+      output.put(theData.marker[i]);
+    }
+    output.put('\n');
+  }
+
+  output.put(static_cast<long>(holes));
+  output.put('\n');
+  for (size_t i = 0; i < holes; i++)
+  {
+    output.put(static_cast<long>(i + 1));
+    output.put('\t');
+    output.put(theData.holex[i]);
+    output.put('\t');
+    output.put(theData.holey[i]);
+    output.put('\n');
+  }
+
+  if (regions > 0)
+  {
+    output.put(static_cast<long>(regions));
+    output.put('\n');
+    for (size_t i = 0; i < regions; i++)
+    {
+      output.put(static_cast<long>(i + 1));
+      output.put('\t');
+      output.put(theData.regionx[i]);
+      output.put('\t');
+      output.put(theData.regiony[i]);
+      output.put('\t');
+      output.put(theData.regionattr[i]);
+      if (theData.maxareas)
+      {
+        output.put('\t');
+        output.put(theData.maxarea[i]);
+      }
+      output.put('\n');
+    }
+  }
+
+  output.close();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a .ele file
+ */
+// ----------------------------------------------------------------------
+
+void write(const string &theFile, const EleData &theData, bool theBinaryFlag)
+{
+  check(theData);
+
+  Output output(theFile);
+
+  if (theBinaryFlag)
+  {
+    write_binary_header(output, 'E');
+    output.raw(static_cast<int64_t>(theData.first));
+    output.raw(static_cast<uint64_t>(theData.corners));
+    output.raw(static_cast<uint64_t>(theData.attributes));
+    output.raw(theData.idx);
+    output.raw(theData.attr);
+    output.close();
+    return;
+  }
+
+  const size_t n = theData.size();
+
+  // #triangles #nodespertriangle #attributes
+  output.put(static_cast<long>(n));
+  output.put(' ');
+  output.put(static_cast<long>(theData.corners));
+  output.put(' ');
+  output.put(static_cast<long>(theData.attributes));
+  output.put('\n');
+
+  for (size_t i = 0; i < n; i++)
+  {
+    output.put(static_cast<long>(theData.first + i));
+    for (size_t c = 0; c < theData.corners; c++)
+    {
+      output.put('\t');
+      output.put(theData.idx[i * theData.corners + c]);
+    }
+    for (size_t a = 0; a < theData.attributes; a++)
+    {
+      output.put('\t');
+      output.put(theData.attr[i * theData.attributes + a]);
+    }
+    output.put('\n');
+  }
+
+  output.close();
+}
+
+}  // namespace Pslg
+
+// ======================================================================
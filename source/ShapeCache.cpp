@@ -0,0 +1,1092 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace ShapeCache
+ */
+// ======================================================================
+
+#include "ShapeCache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+//! Version of the cache format
+const uint32_t cache_version = 1;
+
+//! Marker for detecting caches made on machines with a different byte order
+const uint32_t cache_byteorder = 0x01020304;
+
+//! Number of children in an R-tree node
+const size_t tree_node_size = 16;
+
+//! Number of coordinates buffered while writing
+const size_t write_buffer_size = 65536;
+
+//! The sections of a cache file
+enum Section
+{
+  kSource,        // source shapefile name
+  kTypes,         // int32 shape type per element
+  kElementParts,  // uint64 first part of each element, plus the total
+  kElementPoints, // uint64 first point of each element, plus the total
+  kParts,         // int32 part offsets relative to the first point of the element
+  kBoxes,         // 4 doubles per element
+  kCoordinates,   // all x-coordinates followed by all y-coordinates, or varint bytes
+  kElementBytes,  // uint64 first varint byte of each element, plus the total
+  kTreeItems,     // uint64 elements in R-tree order
+  kTreeLevels,    // uint64 number of nodes on each level, leaves first
+  kTreeNodes,     // 4 doubles per node, leaves first
+  kDbfHeader,     // the .dbf header
+  kAttributes,    // deletion flags and field values, column by column
+  kEnd
+};
+
+//! The fixed header at the start of a cache file
+struct Header
+{
+  char magic[4];
+  uint32_t byteorder;
+  uint32_t version;
+  int32_t shapetype;
+  uint64_t elements;
+  uint64_t parts;
+  uint64_t points;
+  uint64_t treesize;
+  uint64_t treelevels;
+  double box[4];
+  double quantum;
+  double xorigin;
+  double yorigin;
+  int64_t shptime;  // nanoseconds
+  int64_t dbftime;  // nanoseconds
+  uint64_t shpsize;
+  uint64_t dbfsize;
+  uint64_t sections[kEnd + 1];
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a shape type can be cached
+ */
+// ----------------------------------------------------------------------
+
+bool is_cacheable(int theType)
+{
+  return (theType == 1 || theType == 3 || theType == 5 || theType == 8);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Strip a possible .shp suffix from a shapefile name
+ */
+// ----------------------------------------------------------------------
+
+string strip_suffix(const string &theName)
+{
+  if (theName.size() > 4 && theName.substr(theName.size() - 4) == ".shp")
+    return theName.substr(0, theName.size() - 4);
+  return theName;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The modification time in nanoseconds and size of a file
+ *
+ * \return False if the file does not exist
+ */
+// ----------------------------------------------------------------------
+
+bool file_stamp(const string &theName, int64_t &theTime, uint64_t &theSize)
+{
+  struct stat st;
+  if (stat(theName.c_str(), &st) != 0)
+    return false;
+  theTime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  theSize = st.st_size;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create a new file with a unique name
+ *
+ * \param thePrefix The start of the name, a random suffix is appended
+ * \return The name of the created empty file
+ */
+// ----------------------------------------------------------------------
+
+string unique_file(const string &thePrefix)
+{
+  string name = thePrefix + "XXXXXX";
+  const int fd = mkstemp(&name[0]);
+  if (fd < 0)
+    throw runtime_error("Failed to create a temporary file '" + name + "'");
+
+  // mkstemp makes the file readable by the owner only
+  fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  close(fd);
+  return name;
+}
+
+//! A file removed on destruction unless released
+class TemporaryFile
+{
+ public:
+  explicit TemporaryFile(const string &theName) : itsName(theName), itsReleased(false) {}
+  ~TemporaryFile()
+  {
+    if (!itsReleased)
+      remove(itsName.c_str());
+  }
+  const string &name() const { return itsName; }
+  void release() { itsReleased = true; }
+
+ private:
+  TemporaryFile(const TemporaryFile &theFile);
+  TemporaryFile &operator=(const TemporaryFile &theFile);
+
+  string itsName;
+  bool itsReleased;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The absolute name of a shapefile without the .shp suffix
+ */
+// ----------------------------------------------------------------------
+
+string absolute_name(const string &theShape)
+{
+  const string name = strip_suffix(theShape);
+  char buffer[PATH_MAX];
+  if (realpath((name + ".shp").c_str(), buffer) == nullptr)
+    throw runtime_error("Failed to resolve the path of '" + name + ".shp'");
+  return strip_suffix(buffer);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a zigzag coded varint
+ */
+// ----------------------------------------------------------------------
+
+void put_varint(string &theBuffer, int64_t theValue)
+{
+  uint64_t value = (static_cast<uint64_t>(theValue) << 1) ^ static_cast<uint64_t>(theValue >> 63);
+  while (value >= 0x80)
+  {
+    theBuffer += static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  theBuffer += static_cast<char>(value);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a zigzag coded varint
+ */
+// ----------------------------------------------------------------------
+
+int64_t get_varint(const unsigned char *&thePtr, const unsigned char *theEnd)
+{
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    if (thePtr >= theEnd)
+      throw runtime_error("Truncated coordinates in shape cache");
+    const unsigned char byte = *thePtr++;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+  throw runtime_error("Invalid coordinates in shape cache");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pad the output to a multiple of 8 bytes and start a section
+ */
+// ----------------------------------------------------------------------
+
+void begin_section(ofstream &theOutput, Header &theHeader, Section theSection)
+{
+  const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  const uint64_t pos = static_cast<uint64_t>(theOutput.tellp());
+  theOutput.write(zeros, (8 - pos % 8) % 8);
+  theHeader.sections[theSection] = static_cast<uint64_t>(theOutput.tellp());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a vector as raw bytes
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void write_vector(ofstream &theOutput, const vector<T> &theValues)
+{
+  if (!theValues.empty())
+    theOutput.write(reinterpret_cast<const char *>(&theValues[0]), theValues.size() * sizeof(T));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a bounding box to a vector of doubles
+ */
+// ----------------------------------------------------------------------
+
+void push_box(vector<double> &theBoxes, const ShpFile::Box &theBox)
+{
+  theBoxes.push_back(theBox.xmin);
+  theBoxes.push_back(theBox.ymin);
+  theBoxes.push_back(theBox.xmax);
+  theBoxes.push_back(theBox.ymax);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract a bounding box from a vector of doubles
+ */
+// ----------------------------------------------------------------------
+
+ShpFile::Box get_box(const double *theBoxes, size_t theIndex)
+{
+  ShpFile::Box box;
+  box.xmin = theBoxes[4 * theIndex];
+  box.ymin = theBoxes[4 * theIndex + 1];
+  box.xmax = theBoxes[4 * theIndex + 2];
+  box.ymax = theBoxes[4 * theIndex + 3];
+  return box;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a packed R-tree with the sort-tile-recursive method
+ *
+ * The elements are sorted into vertical slices by the x-coordinate
+ * of their centers and each slice by the y-coordinate, after which
+ * consecutive elements are packed into full leaf nodes. The upper
+ * levels are packed from consecutive nodes of the level below.
+ */
+// ----------------------------------------------------------------------
+
+void build_tree(const vector<double> &theBoxes,
+                vector<uint64_t> &theItems,
+                vector<uint64_t> &theLevels,
+                vector<double> &theNodes)
+{
+  const size_t n = theBoxes.size() / 4;
+  for (size_t i = 0; i < n; i++)
+    if (!get_box(&theBoxes[0], i).empty())
+      theItems.push_back(i);
+
+  if (theItems.empty())
+    return;
+
+  const auto cx = [&](uint64_t i) { return theBoxes[4 * i] + theBoxes[4 * i + 2]; };
+  const auto cy = [&](uint64_t i) { return theBoxes[4 * i + 1] + theBoxes[4 * i + 3]; };
+
+  const size_t leaves = (theItems.size() + tree_node_size - 1) / tree_node_size;
+  const size_t slices = static_cast<size_t>(ceil(sqrt(static_cast<double>(leaves))));
+  const size_t slicesize = slices * tree_node_size;
+
+  sort(theItems.begin(),
+       theItems.end(),
+       [&](uint64_t a, uint64_t b) { return cx(a) < cx(b); });
+
+  for (size_t pos = 0; pos < theItems.size(); pos += slicesize)
+    sort(theItems.begin() + pos,
+         theItems.begin() + min(theItems.size(), pos + slicesize),
+         [&](uint64_t a, uint64_t b) { return cy(a) < cy(b); });
+
+  // The leaves
+
+  for (size_t pos = 0; pos < theItems.size(); pos += tree_node_size)
+  {
+    ShpFile::Box box;
+    for (size_t j = pos; j < min(theItems.size(), pos + tree_node_size); j++)
+      box.update(get_box(&theBoxes[0], theItems[j]));
+    push_box(theNodes, box);
+  }
+  theLevels.push_back(leaves);
+
+  // The upper levels up to a single root
+
+  size_t first = 0;
+  while (theLevels.back() > 1)
+  {
+    const size_t count = theLevels.back();
+    for (size_t pos = 0; pos < count; pos += tree_node_size)
+    {
+      ShpFile::Box box;
+      for (size_t j = pos; j < min(count, pos + tree_node_size); j++)
+        box.update(get_box(&theNodes[0], first + j));
+      push_box(theNodes, box);
+    }
+    first += count;
+    theLevels.push_back((count + tree_node_size - 1) / tree_node_size);
+  }
+}
+
+}  // namespace
+
+namespace ShapeCache
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the given file name refers to a cache
+ */
+// ----------------------------------------------------------------------
+
+bool isCache(const string &theName)
+{
+  return (theName.size() > 5 && theName.substr(theName.size() - 5) == ".shpc");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create a cache from a shapefile
+ *
+ * The cache is first written to a temporary file which is then
+ * renamed, so that readers never see a partial cache.
+ *
+ * \param theShape The shapefile name with or without the .shp suffix
+ * \param theCache The name of the cache file
+ * \param theQuantum The quantization step of the coordinates, or 0
+ *                   for storing the coordinates as doubles
+ */
+// ----------------------------------------------------------------------
+
+void write(const string &theShape, const string &theCache, double theQuantum)
+{
+  if (theQuantum < 0)
+    throw runtime_error("The quantization step of a shape cache cannot be negative");
+
+  const ShpFile::MappedReader reader(theShape);
+  const ShpFile::MappedDbf dbf(theShape);
+
+  const size_t n = reader.size();
+  if (dbf.size() != n)
+    throw runtime_error("The number of records in the .shp and .dbf files of '" + theShape +
+                        "' differ");
+
+  const int shapetype = reader.shapeType();
+  if (!is_cacheable(shapetype))
+    throw runtime_error("Only point, multipoint, polyline and polygon shapes can be cached");
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "SHPC", 4);
+  header.byteorder = cache_byteorder;
+  header.version = cache_version;
+  header.shapetype = shapetype;
+  header.elements = n;
+  header.quantum = theQuantum;
+
+  const string source = absolute_name(theShape);
+  if (!file_stamp(source + ".shp", header.shptime, header.shpsize) ||
+      !file_stamp(source + ".dbf", header.dbftime, header.dbfsize))
+    throw runtime_error("Failed to stat the files of '" + source + "'");
+
+  // The element tables
+
+  vector<int32_t> types;
+  vector<uint64_t> elementparts;
+  vector<uint64_t> elementpoints;
+  vector<int32_t> parts;
+  vector<double> boxes;
+  ShpFile::Box total;
+
+  types.reserve(n);
+  elementparts.reserve(n + 1);
+  elementpoints.reserve(n + 1);
+  boxes.reserve(4 * n);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const ShpFile::Record record = reader.record(i);
+    if (record.type() != 0 && record.type() != shapetype)
+      throw runtime_error("Shapes with mixed element types cannot be cached");
+
+    types.push_back(record.type());
+    elementparts.push_back(parts.size());
+    elementpoints.push_back(header.points);
+    for (int k = 0; k < record.numParts(); k++)
+      parts.push_back(record.part(k));
+    header.points += record.numPoints();
+
+    const ShpFile::Box box = record.box();
+    push_box(boxes, box);
+    total.update(box);
+  }
+  elementparts.push_back(parts.size());
+  elementpoints.push_back(header.points);
+  header.parts = parts.size();
+
+  header.box[0] = total.xmin;
+  header.box[1] = total.ymin;
+  header.box[2] = total.xmax;
+  header.box[3] = total.ymax;
+
+  if (theQuantum > 0 && !total.empty())
+  {
+    header.xorigin = total.xmin;
+    header.yorigin = total.ymin;
+  }
+
+  vector<uint64_t> treeitems;
+  vector<uint64_t> treelevels;
+  vector<double> treenodes;
+  build_tree(boxes, treeitems, treelevels, treenodes);
+  header.treesize = treeitems.size();
+  header.treelevels = treelevels.size();
+
+  // Write the sections
+
+  // A uniquely named file renamed over the cache once complete keeps
+  // concurrent readers and writers from seeing partial caches
+
+  TemporaryFile tmpfile(unique_file(theCache + "."));
+  const string &tmpname = tmpfile.name();
+  ofstream out(tmpname.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out)
+    throw runtime_error("Failed to open '" + tmpname + "' for writing");
+
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  begin_section(out, header, kSource);
+  out.write(source.data(), source.size());
+
+  begin_section(out, header, kTypes);
+  write_vector(out, types);
+
+  begin_section(out, header, kElementParts);
+  write_vector(out, elementparts);
+
+  begin_section(out, header, kElementPoints);
+  write_vector(out, elementpoints);
+
+  begin_section(out, header, kParts);
+  write_vector(out, parts);
+
+  begin_section(out, header, kBoxes);
+  write_vector(out, boxes);
+
+  begin_section(out, header, kCoordinates);
+
+  vector<uint64_t> elementbytes;
+  if (theQuantum > 0)
+  {
+    // Delta coding restarts at each element for random access
+
+    uint64_t bytes = 0;
+    string buffer;
+    for (size_t i = 0; i < n; i++)
+    {
+      elementbytes.push_back(bytes);
+      const ShpFile::Record record = reader.record(i);
+      buffer.clear();
+      int64_t lastx = 0;
+      int64_t lasty = 0;
+      for (int j = 0; j < record.numPoints(); j++)
+      {
+        const int64_t qx = llround((record.x(j) - header.xorigin) / theQuantum);
+        const int64_t qy = llround((record.y(j) - header.yorigin) / theQuantum);
+        put_varint(buffer, qx - lastx);
+        put_varint(buffer, qy - lasty);
+        lastx = qx;
+        lasty = qy;
+      }
+      out.write(buffer.data(), buffer.size());
+      bytes += buffer.size();
+    }
+    elementbytes.push_back(bytes);
+  }
+  else
+  {
+    vector<double> buffer;
+    for (int axis = 0; axis < 2; axis++)
+    {
+      for (size_t i = 0; i < n; i++)
+      {
+        const ShpFile::Record record = reader.record(i);
+        for (int j = 0; j < record.numPoints(); j++)
+        {
+          buffer.push_back(axis == 0 ? record.x(j) : record.y(j));
+          if (buffer.size() >= write_buffer_size)
+          {
+            write_vector(out, buffer);
+            buffer.clear();
+          }
+        }
+      }
+      write_vector(out, buffer);
+      buffer.clear();
+    }
+  }
+
+  begin_section(out, header, kElementBytes);
+  write_vector(out, elementbytes);
+
+  begin_section(out, header, kTreeItems);
+  write_vector(out, treeitems);
+
+  begin_section(out, header, kTreeLevels);
+  write_vector(out, treelevels);
+
+  begin_section(out, header, kTreeNodes);
+  write_vector(out, treenodes);
+
+  begin_section(out, header, kDbfHeader);
+  const string dbfheader = dbf.header();
+  out.write(dbfheader.data(), dbfheader.size());
+
+  // The deletion flags are stored as the first column
+
+  begin_section(out, header, kAttributes);
+  for (size_t i = 0; i < n; i++)
+    out.write(dbf.row(i), 1);
+
+  const vector<ShpFile::DbfField> &fields = dbf.fields();
+  for (size_t k = 0; k < fields.size(); k++)
+    for (size_t i = 0; i < n; i++)
+      out.write(dbf.row(i) + fields[k].offset, fields[k].length);
+
+  begin_section(out, header, kEnd);
+
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+
+  if (out.fail())
+    throw runtime_error("Failed to write '" + tmpname + "'");
+
+  if (rename(tmpname.c_str(), theCache.c_str()) != 0)
+    throw runtime_error("Failed to rename '" + tmpname + "' to '" + theCache + "'");
+  tmpfile.release();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief An empty record
+ */
+// ----------------------------------------------------------------------
+
+Record::Record()
+    : itsType(0),
+      itsBox(),
+      itsNumParts(0),
+      itsNumPoints(0),
+      itsParts(nullptr),
+      itsX(nullptr),
+      itsY(nullptr),
+      itsDecoded()
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map a cache, rebuilding it first if it is outdated
+ *
+ * \param theName The name of the cache file
+ */
+// ----------------------------------------------------------------------
+
+Reader::Reader(const string &theName)
+    : itsName(theName),
+      itsFile(),
+      itsType(0),
+      itsSize(0),
+      itsPartCount(0),
+      itsPointCount(0),
+      itsTreeSize(0),
+      itsTreeLevelCount(0),
+      itsBox(),
+      itsQuantum(0),
+      itsXOrigin(0),
+      itsYOrigin(0),
+      itsSource(),
+      itsShpTime(0),
+      itsDbfTime(0),
+      itsShpSize(0),
+      itsDbfSize(0),
+      itsTypes(nullptr),
+      itsElementParts(nullptr),
+      itsElementPoints(nullptr),
+      itsParts(nullptr),
+      itsBoxes(nullptr),
+      itsElementBytes(nullptr),
+      itsCoordinates(nullptr),
+      itsTreeItems(nullptr),
+      itsTreeLevels(nullptr),
+      itsTreeNodes(nullptr),
+      itsAttributes(nullptr),
+      itsDbfHeader(),
+      itsFields(),
+      itsRowLength(0),
+      itsCells(),
+      itsColumns()
+{
+  open(itsName);
+
+  if (outdated())
+  {
+    itsFile.reset();
+    try
+    {
+      write(itsSource, itsName, itsQuantum);
+      open(itsName);
+    }
+    catch (...)
+    {
+      // The cache cannot be rewritten, say in a read-only directory.
+      // A private cache is then built from the shapefile, the mapping
+      // remains valid after the file is removed.
+
+      const char *tmpdir = getenv("TMPDIR");
+      const TemporaryFile tmpfile(unique_file(string(tmpdir ? tmpdir : "/tmp") + "/shapecache."));
+      write(itsSource, tmpfile.name(), itsQuantum);
+      open(tmpfile.name());
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map the cache and validate the header
+ *
+ * \param theFile The file to map, normally the cache itself
+ */
+// ----------------------------------------------------------------------
+
+void Reader::open(const string &theFile)
+{
+  itsFile.reset(new MappedFile(theFile));
+
+  Header header;
+  if (itsFile->size() < sizeof(header))
+    throw runtime_error("'" + itsName + "' is not a shape cache");
+  memcpy(&header, itsFile->data(), sizeof(header));
+
+  if (memcmp(header.magic, "SHPC", 4) != 0)
+    throw runtime_error("'" + itsName + "' is not a shape cache");
+  if (header.byteorder != cache_byteorder)
+    throw runtime_error("'" + itsName + "' was made on a machine with a different byte order");
+  if (header.version != cache_version)
+    throw runtime_error("'" + itsName + "' is of an unsupported cache version");
+  if (!is_cacheable(header.shapetype))
+    throw runtime_error("'" + itsName + "' contains an unsupported shape type");
+
+  for (int s = 0; s < kEnd; s++)
+    if (header.sections[s] % 8 != 0 || header.sections[s] > header.sections[s + 1])
+      throw runtime_error("'" + itsName + "' has an invalid section table");
+  if (header.sections[0] < sizeof(header) || header.sections[kEnd] > itsFile->size())
+    throw runtime_error("'" + itsName + "' is truncated");
+
+  itsType = header.shapetype;
+  itsSize = header.elements;
+  itsPartCount = header.parts;
+  itsPointCount = header.points;
+  itsTreeSize = header.treesize;
+  itsTreeLevelCount = header.treelevels;
+  itsBox.xmin = header.box[0];
+  itsBox.ymin = header.box[1];
+  itsBox.xmax = header.box[2];
+  itsBox.ymax = header.box[3];
+  itsQuantum = header.quantum;
+  itsXOrigin = header.xorigin;
+  itsYOrigin = header.yorigin;
+  itsShpTime = header.shptime;
+  itsDbfTime = header.dbftime;
+  itsShpSize = header.shpsize;
+  itsDbfSize = header.dbfsize;
+
+  const char *data = itsFile->data();
+  const auto length = [&](Section s) { return header.sections[s + 1] - header.sections[s]; };
+
+  itsSource.assign(data + header.sections[kSource], length(kSource));
+  itsSource.resize(strnlen(itsSource.c_str(), itsSource.size()));
+
+  itsTypes = reinterpret_cast<const int32_t *>(data + header.sections[kTypes]);
+  itsElementParts = reinterpret_cast<const uint64_t *>(data + header.sections[kElementParts]);
+  itsElementPoints = reinterpret_cast<const uint64_t *>(data + header.sections[kElementPoints]);
+  itsParts = reinterpret_cast<const int32_t *>(data + header.sections[kParts]);
+  itsBoxes = reinterpret_cast<const double *>(data + header.sections[kBoxes]);
+  itsCoordinates = data + header.sections[kCoordinates];
+  itsElementBytes = reinterpret_cast<const uint64_t *>(data + header.sections[kElementBytes]);
+  itsTreeItems = reinterpret_cast<const uint64_t *>(data + header.sections[kTreeItems]);
+  itsTreeLevels = reinterpret_cast<const uint64_t *>(data + header.sections[kTreeLevels]);
+  itsTreeNodes = reinterpret_cast<const double *>(data + header.sections[kTreeNodes]);
+  itsAttributes = data + header.sections[kAttributes];
+
+  // Check the table sizes
+
+  const uint64_t n = itsSize;
+  bool ok = (length(kTypes) >= 4 * n && length(kElementParts) >= 8 * (n + 1) &&
+             length(kElementPoints) >= 8 * (n + 1) && length(kParts) >= 4 * itsPartCount &&
+             length(kBoxes) >= 32 * n && length(kTreeItems) >= 8 * itsTreeSize &&
+             length(kTreeLevels) >= 8 * itsTreeLevelCount);
+
+  if (ok && quantized())
+    ok = (length(kElementBytes) >= 8 * (n + 1) &&
+          itsElementBytes[n] <= length(kCoordinates));
+  else if (ok)
+    ok = (length(kCoordinates) >= 16 * itsPointCount);
+
+  if (ok)
+  {
+    uint64_t nodes = 0;
+    for (size_t level = 0; level < itsTreeLevelCount; level++)
+      nodes += itsTreeLevels[level];
+    ok = (length(kTreeNodes) >= 32 * nodes);
+  }
+
+  if (!ok)
+    throw runtime_error("'" + itsName + "' has inconsistent table sizes");
+
+  // The attributes
+
+  itsDbfHeader.assign(data + header.sections[kDbfHeader], length(kDbfHeader));
+  itsFields = ShpFile::dbfFields(itsDbfHeader);
+
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(itsDbfHeader.data());
+  itsRowLength = p[10] | (static_cast<size_t>(p[11]) << 8);
+
+  itsCells.clear();
+  itsColumns.clear();
+  uint64_t offset = n;
+  for (size_t k = 0; k < itsFields.size(); k++)
+  {
+    itsCells.push_back(itsFields[k]);
+    itsCells.back().offset = 0;
+    itsColumns.push_back(itsAttributes + offset);
+    offset += n * itsFields[k].length;
+  }
+
+  if (offset > length(kAttributes))
+    throw runtime_error("'" + itsName + "' has truncated attributes");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the source shapefile has changed
+ *
+ * A cache whose source no longer exists is used as is.
+ */
+// ----------------------------------------------------------------------
+
+bool Reader::outdated() const
+{
+  int64_t shptime, dbftime;
+  uint64_t shpsize, dbfsize;
+
+  if (!file_stamp(itsSource + ".shp", shptime, shpsize) ||
+      !file_stamp(itsSource + ".dbf", dbftime, dbfsize))
+    return false;
+
+  return (shptime != itsShpTime || dbftime != itsDbfTime || shpsize != itsShpSize ||
+          dbfsize != itsDbfSize);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type of an element
+ */
+// ----------------------------------------------------------------------
+
+int Reader::type(size_t theRecord) const
+{
+  if (theRecord >= itsSize)
+    throw runtime_error("Record number out of range for '" + itsName + "'");
+  return itsTypes[theRecord];
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The bounding box of an element
+ */
+// ----------------------------------------------------------------------
+
+ShpFile::Box Reader::box(size_t theRecord) const
+{
+  if (theRecord >= itsSize)
+    throw runtime_error("Record number out of range for '" + itsName + "'");
+  return get_box(itsBoxes, theRecord);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A view to the geometry of an element
+ *
+ * For plain caches the view refers directly to the mapped tables.
+ * For quantized caches the coordinates are decoded into the view.
+ */
+// ----------------------------------------------------------------------
+
+Record Reader::record(size_t theRecord) const
+{
+  if (theRecord >= itsSize)
+    throw runtime_error("Record number out of range for '" + itsName + "'");
+
+  const uint64_t p1 = itsElementParts[theRecord];
+  const uint64_t p2 = itsElementParts[theRecord + 1];
+  const uint64_t q1 = itsElementPoints[theRecord];
+  const uint64_t q2 = itsElementPoints[theRecord + 1];
+
+  if (p1 > p2 || p2 > itsPartCount || q1 > q2 || q2 > itsPointCount || q2 - q1 > INT_MAX)
+    throw runtime_error("Invalid element tables in '" + itsName + "'");
+
+  Record record;
+  record.itsType = itsTypes[theRecord];
+  record.itsNumParts = static_cast<int>(p2 - p1);
+  record.itsNumPoints = static_cast<int>(q2 - q1);
+  record.itsParts = itsParts + p1;
+
+  if (record.itsType != 0 && record.itsType != itsType)
+    throw runtime_error("Invalid element type in '" + itsName + "'");
+
+  for (int k = 0; k < record.itsNumParts; k++)
+    if (record.itsParts[k] < 0 || record.itsParts[k] > record.itsNumPoints)
+      throw runtime_error("Part offset out of range in '" + itsName + "'");
+
+  if (!quantized())
+  {
+    const double *x = reinterpret_cast<const double *>(itsCoordinates);
+    record.itsX = x + q1;
+    record.itsY = x + itsPointCount + q1;
+    record.itsBox = get_box(itsBoxes, theRecord);
+    return record;
+  }
+
+  const unsigned char *ptr =
+      reinterpret_cast<const unsigned char *>(itsCoordinates + itsElementBytes[theRecord]);
+  const unsigned char *end =
+      reinterpret_cast<const unsigned char *>(itsCoordinates + itsElementBytes[theRecord + 1]);
+  if (ptr > end)
+    throw runtime_error("Invalid coordinate offsets in '" + itsName + "'");
+
+  const size_t np = record.itsNumPoints;
+  shared_ptr<vector<double> > decoded(new vector<double>(2 * np));
+  int64_t qx = 0;
+  int64_t qy = 0;
+  for (size_t j = 0; j < np; j++)
+  {
+    qx += get_varint(ptr, end);
+    qy += get_varint(ptr, end);
+    const double x = itsXOrigin + static_cast<double>(qx) * itsQuantum;
+    const double y = itsYOrigin + static_cast<double>(qy) * itsQuantum;
+    (*decoded)[j] = x;
+    (*decoded)[np + j] = y;
+    record.itsBox.update(x, y);
+  }
+
+  record.itsX = decoded->data();
+  record.itsY = decoded->data() + np;
+  record.itsDecoded = decoded;
+  return record;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the elements whose bounding boxes overlap the given box
+ *
+ * The records are returned in increasing order.
+ */
+// ----------------------------------------------------------------------
+
+void Reader::query(const ShpFile::Box &theBox, vector<size_t> &theRecords) const
+{
+  theRecords.clear();
+  if (itsTreeLevelCount == 0)
+    return;
+
+  // Node offsets of the levels, leaves first
+
+  vector<size_t> first(itsTreeLevelCount, 0);
+  for (size_t level = 1; level < itsTreeLevelCount; level++)
+    first[level] = first[level - 1] + itsTreeLevels[level - 1];
+
+  vector<pair<size_t, size_t> > stack;
+  const size_t root = itsTreeLevelCount - 1;
+  for (size_t node = 0; node < itsTreeLevels[root]; node++)
+    stack.push_back(make_pair(root, node));
+
+  while (!stack.empty())
+  {
+    const size_t level = stack.back().first;
+    const size_t node = stack.back().second;
+    stack.pop_back();
+
+    if (!get_box(itsTreeNodes, first[level] + node).overlaps(theBox))
+      continue;
+
+    const size_t begin = node * tree_node_size;
+    if (level == 0)
+    {
+      const size_t end = min<size_t>(itsTreeSize, begin + tree_node_size);
+      for (size_t j = begin; j < end; j++)
+      {
+        const size_t item = itsTreeItems[j];
+        if (item < itsSize && get_box(itsBoxes, item).overlaps(theBox))
+          theRecords.push_back(item);
+      }
+    }
+    else
+    {
+      const size_t end = min<size_t>(itsTreeLevels[level - 1], begin + tree_node_size);
+      for (size_t j = begin; j < end; j++)
+        stack.push_back(make_pair(level - 1, j));
+    }
+  }
+
+  sort(theRecords.begin(), theRecords.end());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A shapefile main header for the cached shape
+ *
+ * The file length is left for ShpFile::Writer to fill in.
+ */
+// ----------------------------------------------------------------------
+
+string Reader::header() const
+{
+  string header(ShpFile::header_size, '\0');
+  ShpFile::putBigInt(&header[0], 9994);
+  ShpFile::putLittleInt(&header[28], 1000);
+  ShpFile::putLittleInt(&header[32], itsType);
+  if (!itsBox.empty())
+  {
+    ShpFile::putLittleDouble(&header[36], itsBox.xmin);
+    ShpFile::putLittleDouble(&header[44], itsBox.ymin);
+    ShpFile::putLittleDouble(&header[52], itsBox.xmax);
+    ShpFile::putLittleDouble(&header[60], itsBox.ymax);
+  }
+  return header;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Encode an element as shapefile record contents
+ */
+// ----------------------------------------------------------------------
+
+string Reader::contents(size_t theRecord) const
+{
+  const Record record = this->record(theRecord);
+  const int np = record.numParts();
+  const int n = record.numPoints();
+
+  string contents;
+  switch (record.type())
+  {
+    case 0:
+      contents.assign(4, '\0');
+      break;
+    case 1:
+      contents.assign(20, '\0');
+      ShpFile::putLittleDouble(&contents[4], record.x(0));
+      ShpFile::putLittleDouble(&contents[12], record.y(0));
+      break;
+    default:
+    {
+      const bool multipoint = (record.type() == 8);
+      const size_t points = (multipoint ? 40 : 44 + 4 * static_cast<size_t>(np));
+      contents.assign(points + 16 * static_cast<size_t>(n), '\0');
+
+      const ShpFile::Box box = (n > 0 ? record.box() : ShpFile::Box());
+      if (!box.empty())
+      {
+        ShpFile::putLittleDouble(&contents[4], box.xmin);
+        ShpFile::putLittleDouble(&contents[12], box.ymin);
+        ShpFile::putLittleDouble(&contents[20], box.xmax);
+        ShpFile::putLittleDouble(&contents[28], box.ymax);
+      }
+
+      if (multipoint)
+        ShpFile::putLittleInt(&contents[36], n);
+      else
+      {
+        ShpFile::putLittleInt(&contents[36], np);
+        ShpFile::putLittleInt(&contents[40], n);
+        for (int k = 0; k < np; k++)
+          ShpFile::putLittleInt(&contents[44 + 4 * k], record.part(k));
+      }
+
+      for (int j = 0; j < n; j++)
+      {
+        ShpFile::putLittleDouble(&contents[points + 16 * j], record.x(j));
+        ShpFile::putLittleDouble(&contents[points + 16 * j + 8], record.y(j));
+      }
+      break;
+    }
+  }
+  ShpFile::putLittleInt(&contents[0], record.type());
+  return contents;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The index of the field with the given name, or -1
+ */
+// ----------------------------------------------------------------------
+
+int Reader::field(const string &theName) const
+{
+  for (size_t i = 0; i < itsFields.size(); i++)
+    if (itsFields[i].name == theName)
+      return static_cast<int>(i);
+  return -1;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value of a field with the padding removed
+ */
+// ----------------------------------------------------------------------
+
+string Reader::value(size_t theRow, int theField) const
+{
+  if (theRow >= itsSize)
+    throw runtime_error("Row number out of range for '" + itsName + "'");
+
+  const ShpFile::DbfField &cell = itsCells.at(theField);
+  return ShpFile::dbfValue(itsColumns[theField] + theRow * cell.length, cell);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reassemble a .dbf row including the deletion flag
+ */
+// ----------------------------------------------------------------------
+
+void Reader::row(size_t theRow, string &theContents) const
+{
+  if (theRow >= itsSize)
+    throw runtime_error("Row number out of range for '" + itsName + "'");
+
+  theContents.assign(itsRowLength, ' ');
+  theContents[0] = itsAttributes[theRow];
+  for (size_t k = 0; k < itsFields.size(); k++)
+    memcpy(&theContents[itsFields[k].offset],
+           itsColumns[k] + theRow * itsFields[k].length,
+           itsFields[k].length);
+}
+
+}  // namespace ShapeCache
+
+// ======================================================================
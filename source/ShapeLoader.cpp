@@ -0,0 +1,395 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace ShapeLoader
+ */
+// ======================================================================
+
+#include "ShapeLoader.h"
+#include "ShapeCache.h"
+
+#include <imagine/NFmiEsriMultiPoint.h>
+#include <imagine/NFmiEsriPoint.h>
+#include <imagine/NFmiEsriPolyLine.h>
+#include <imagine/NFmiEsriPolygon.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Imagine;
+
+namespace
+{
+//! The attributes of the shape in column order
+struct Columns
+{
+  vector<NFmiEsriAttributeName *> names;
+  vector<NFmiEsriAttributeType> types;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the shape type can be decoded in parallel
+ */
+// ----------------------------------------------------------------------
+
+bool is_supported(int theType)
+{
+  return (theType == kFmiEsriPoint || theType == kFmiEsriMultiPoint ||
+          theType == kFmiEsriPolyLine || theType == kFmiEsriPolygon);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the shape with NFmiEsriShape::Read
+ */
+// ----------------------------------------------------------------------
+
+unique_ptr<NFmiEsriShape> read_serial(const string &theName, bool theAttributes)
+{
+  unique_ptr<NFmiEsriShape> shape(new NFmiEsriShape);
+  if (!shape->Read(theName, theAttributes))
+    throw runtime_error("Failed to read '" + theName + "'");
+  return shape;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add the parts of a record into a polyline or polygon
+ *
+ * \return False if the record has empty parts, which cannot be
+ *         represented by AddPart
+ */
+// ----------------------------------------------------------------------
+
+template <typename T, typename R>
+bool add_parts(T &theElement, const R &theRecord)
+{
+  for (int part = 0; part < theRecord.numParts(); part++)
+  {
+    const int i1 = theRecord.part(part);
+    const int i2 = (part + 1 < theRecord.numParts() ? theRecord.part(part + 1)
+                                                   : theRecord.numPoints());
+    if (i1 >= i2)
+      return false;
+
+    theElement.AddPart(NFmiEsriPoint(theRecord.x(i1), theRecord.y(i1)));
+    for (int i = i1 + 1; i < i2; i++)
+      theElement.Add(NFmiEsriPoint(theRecord.x(i), theRecord.y(i)));
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode the geometry of a record
+ *
+ * \return The new element, or null if the record cannot be decoded
+ *         in parallel
+ */
+// ----------------------------------------------------------------------
+
+template <typename R>
+NFmiEsriElement *decode_geometry(const R &theRecord, int theType)
+{
+  if (theRecord.type() != theType)
+    return nullptr;
+
+  switch (theType)
+  {
+    case kFmiEsriPoint:
+      return new NFmiEsriPoint(theRecord.x(0), theRecord.y(0));
+    case kFmiEsriMultiPoint:
+    {
+      NFmiEsriMultiPoint *elem = new NFmiEsriMultiPoint;
+      for (int i = 0; i < theRecord.numPoints(); i++)
+        elem->Add(NFmiEsriPoint(theRecord.x(i), theRecord.y(i)));
+      return elem;
+    }
+    case kFmiEsriPolyLine:
+    {
+      unique_ptr<NFmiEsriPolyLine> elem(new NFmiEsriPolyLine);
+      return (add_parts(*elem, theRecord) ? elem.release() : nullptr);
+    }
+    case kFmiEsriPolygon:
+    {
+      unique_ptr<NFmiEsriPolygon> elem(new NFmiEsriPolygon);
+      return (add_parts(*elem, theRecord) ? elem.release() : nullptr);
+    }
+  }
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value of a field in a .dbf file
+ */
+// ----------------------------------------------------------------------
+
+string field_value(const ShpFile::MappedDbf &theDbf, size_t theRow, size_t theField)
+{
+  return ShpFile::dbfValue(theDbf.row(theRow), theDbf.fields()[theField]);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value of a field in a shape cache
+ */
+// ----------------------------------------------------------------------
+
+string field_value(const ShapeCache::Reader &theCache, size_t theRow, size_t theField)
+{
+  return theCache.value(theRow, static_cast<int>(theField));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add the attributes of a row to an element
+ */
+// ----------------------------------------------------------------------
+
+template <typename A>
+void decode_attributes(NFmiEsriElement &theElement,
+                       const A &theAttributes,
+                       size_t theRow,
+                       const Columns &theColumns)
+{
+  for (size_t i = 0; i < theColumns.names.size(); i++)
+  {
+    const string value = field_value(theAttributes, theRow, i);
+    NFmiEsriAttributeName *name = theColumns.names[i];
+
+    switch (theColumns.types[i])
+    {
+      case kFmiEsriString:
+        theElement.Add(NFmiEsriAttribute(value, name));
+        break;
+      case kFmiEsriInteger:
+        theElement.Add(NFmiEsriAttribute(atoi(value.c_str()), name));
+        break;
+      case kFmiEsriDouble:
+        theElement.Add(NFmiEsriAttribute(atof(value.c_str()), name));
+        break;
+      case kFmiEsriDate:
+        theElement.Add(NFmiEsriAttribute(ShapeLoader::parseDate(value), name));
+        break;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a range of records into the given slots
+ *
+ * Decoding stops as soon as any thread finds a record which cannot
+ * be decoded in parallel or an error occurs.
+ */
+// ----------------------------------------------------------------------
+
+template <typename R, typename A>
+void decode_range(const R &theReader,
+                  const A *theAttributes,
+                  const Columns &theColumns,
+                  size_t theBegin,
+                  size_t theEnd,
+                  vector<NFmiEsriElement *> &theElements,
+                  atomic<bool> &theFailed,
+                  exception_ptr &theError)
+{
+  const int type = theReader.shapeType();
+
+  try
+  {
+    for (size_t i = theBegin; i < theEnd && !theFailed; i++)
+    {
+      NFmiEsriElement *elem = decode_geometry(theReader.record(i), type);
+      if (elem == nullptr)
+      {
+        theFailed = true;
+        return;
+      }
+      theElements[i] = elem;
+
+      if (theAttributes != nullptr)
+        decode_attributes(*elem, *theAttributes, i, theColumns);
+    }
+  }
+  catch (...)
+  {
+    theError = current_exception();
+    theFailed = true;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode all records into the shape in parallel
+ *
+ * \param theReader The records
+ * \param theAttributes The attributes, or null if they are not needed
+ * \param theShape The shape to fill
+ * \return False if some record cannot be represented by the parallel
+ *         decoder, in which case the shape must be discarded
+ */
+// ----------------------------------------------------------------------
+
+template <typename R, typename A>
+bool decode(const R &theReader, const A *theAttributes, NFmiEsriShape &theShape)
+{
+  // The shape owns the attribute names, the elements refer to them
+
+  Columns columns;
+  if (theAttributes != nullptr)
+  {
+    const vector<ShpFile::DbfField> &fields = theAttributes->fields();
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+      const NFmiEsriAttributeType atype = ShapeLoader::attributeType(fields[i]);
+      NFmiEsriAttributeName *name = new NFmiEsriAttributeName(
+          fields[i].name, atype, static_cast<int>(fields[i].length), fields[i].decimals);
+      theShape.Add(name);
+      columns.names.push_back(name);
+      columns.types.push_back(atype);
+    }
+  }
+
+  // Decode the records in chunks
+
+  const size_t n = theReader.size();
+  const size_t nthreads = max<size_t>(1, min<size_t>(thread::hardware_concurrency(), n));
+  const size_t chunk = (n + nthreads - 1) / nthreads;
+
+  vector<NFmiEsriElement *> elements(n, nullptr);
+  vector<exception_ptr> errors(nthreads);
+  atomic<bool> failed(false);
+
+  vector<thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+    threads.push_back(thread(decode_range<R, A>,
+                             std::cref(theReader),
+                             theAttributes,
+                             std::cref(columns),
+                             min(n, t * chunk),
+                             min(n, (t + 1) * chunk),
+                             std::ref(elements),
+                             std::ref(failed),
+                             std::ref(errors[t])));
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  if (failed)
+  {
+    for (size_t i = 0; i < n; i++)
+      delete elements[i];
+
+    for (size_t t = 0; t < errors.size(); t++)
+      if (errors[t])
+        rethrow_exception(errors[t]);
+
+    return false;
+  }
+
+  for (size_t i = 0; i < n; i++)
+    theShape.Add(elements[i]);
+
+  return true;
+}
+
+}  // namespace
+
+namespace ShapeLoader
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read a shapefile or a shape cache decoding the records in parallel
+ *
+ * \param theName The shapefile name with or without the .shp suffix,
+ *                or the name of a .shpc cache
+ * \param theAttributes True if the attributes are to be read too
+ * \return The shape, never null
+ */
+// ----------------------------------------------------------------------
+
+unique_ptr<NFmiEsriShape> read(const string &theName, bool theAttributes)
+{
+  if (ShapeCache::isCache(theName))
+  {
+    const ShapeCache::Reader cache(theName);
+    unique_ptr<NFmiEsriShape> shape(
+        new NFmiEsriShape(static_cast<NFmiEsriElementType>(cache.shapeType())));
+    if (!decode(cache, theAttributes ? &cache : nullptr, *shape))
+      throw runtime_error("'" + theName + "' contains empty parts or null elements");
+    return shape;
+  }
+
+  const ShpFile::MappedReader reader(theName);
+
+  const int type = reader.shapeType();
+  if (!is_supported(type))
+    return read_serial(theName, theAttributes);
+
+  unique_ptr<ShpFile::MappedDbf> dbf;
+  if (theAttributes)
+  {
+    dbf.reset(new ShpFile::MappedDbf(theName));
+    if (dbf->size() != reader.size())
+      throw runtime_error("The number of records in the .shp and .dbf files of '" + theName +
+                          "' differ");
+  }
+
+  unique_ptr<NFmiEsriShape> shape(new NFmiEsriShape(static_cast<NFmiEsriElementType>(type)));
+  if (!decode(reader, dbf.get(), *shape))
+    return read_serial(theName, theAttributes);
+
+  return shape;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The attribute type of a .dbf field
+ *
+ * Numeric fields without decimals are integers, other numeric
+ * fields doubles. Unknown types are handled as strings.
+ */
+// ----------------------------------------------------------------------
+
+NFmiEsriAttributeType attributeType(const ShpFile::DbfField &theField)
+{
+  switch (theField.type)
+  {
+    case 'N':
+      return (theField.decimals == 0 ? kFmiEsriInteger : kFmiEsriDouble);
+    case 'F':
+      return kFmiEsriDouble;
+    case 'D':
+      return kFmiEsriDate;
+    default:
+      return kFmiEsriString;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse a YYYYMMDD date
+ */
+// ----------------------------------------------------------------------
+
+NFmiMetTime parseDate(const string &theValue)
+{
+  if (theValue.size() != 8 || theValue.find_first_not_of("0123456789") != string::npos)
+    return NFmiMetTime();
+
+  const short year = static_cast<short>(atoi(theValue.substr(0, 4).c_str()));
+  const short month = static_cast<short>(atoi(theValue.substr(4, 2).c_str()));
+  const short day = static_cast<short>(atoi(theValue.substr(6, 2).c_str()));
+  return NFmiMetTime(year, month, day);
+}
+
+}  // namespace ShapeLoader
+
+// ======================================================================
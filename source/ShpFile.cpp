@@ -0,0 +1,1082 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace ShpFile
+ */
+// ======================================================================
+
+#include "ShpFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Strip a possible .shp suffix from a shapefile name
+ */
+// ----------------------------------------------------------------------
+
+string basename(const string &theName)
+{
+  if (theName.size() > 4 && theName.substr(theName.size() - 4) == ".shp")
+    return theName.substr(0, theName.size() - 4);
+  return theName;
+}
+
+//! Size of the fixed part of a .dbf header
+const size_t dbf_header_size = 32;
+
+//! Size of a .dbf field descriptor
+const size_t dbf_field_size = 32;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Throw if a record is too short
+ */
+// ----------------------------------------------------------------------
+
+void require_size(size_t theSize, size_t theRequired)
+{
+  if (theSize < theRequired)
+    throw runtime_error("Shapefile record is too short for its type");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the field descriptors of a .dbf header
+ *
+ * The field descriptors end with a 0x0D byte.
+ *
+ * \param theHeader The full header including the field descriptors
+ * \param theHeaderLength The length of the header
+ * \param theRowLength The length of a row including the deletion flag
+ * \param theName The file name for error messages
+ */
+// ----------------------------------------------------------------------
+
+vector<ShpFile::DbfField> parse_dbf_fields(const char *theHeader,
+                                           size_t theHeaderLength,
+                                           size_t theRowLength,
+                                           const string &theName)
+{
+  vector<ShpFile::DbfField> fields;
+
+  size_t offset = 1;
+  for (size_t pos = dbf_header_size;
+       pos + dbf_field_size <= theHeaderLength && theHeader[pos] != '\x0D';
+       pos += dbf_field_size)
+  {
+    const char *desc = theHeader + pos;
+    ShpFile::DbfField field;
+    field.name.assign(desc, strnlen(desc, 11));
+    field.type = desc[11];
+    field.length = static_cast<unsigned char>(desc[16]);
+    field.decimals = static_cast<unsigned char>(desc[17]);
+    field.offset = offset;
+    offset += field.length;
+    fields.push_back(field);
+  }
+
+  if (offset > theRowLength)
+    throw runtime_error("Field descriptors exceed the row length in '" + theName + "'");
+
+  return fields;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The index of the named field, or -1
+ */
+// ----------------------------------------------------------------------
+
+int find_dbf_field(const vector<ShpFile::DbfField> &theFields, const string &theName)
+{
+  for (size_t i = 0; i < theFields.size(); i++)
+    if (theFields[i].name == theName)
+      return static_cast<int>(i);
+  return -1;
+}
+
+}  // namespace
+
+namespace ShpFile
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a big endian 32-bit integer
+ */
+// ----------------------------------------------------------------------
+
+int getBigInt(const char *theData)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(theData);
+  return static_cast<int>((static_cast<unsigned int>(p[0]) << 24) |
+                          (static_cast<unsigned int>(p[1]) << 16) |
+                          (static_cast<unsigned int>(p[2]) << 8) | p[3]);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a little endian 32-bit integer
+ */
+// ----------------------------------------------------------------------
+
+int getLittleInt(const char *theData)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(theData);
+  return static_cast<int>((static_cast<unsigned int>(p[3]) << 24) |
+                          (static_cast<unsigned int>(p[2]) << 16) |
+                          (static_cast<unsigned int>(p[1]) << 8) | p[0]);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode a little endian IEEE double
+ */
+// ----------------------------------------------------------------------
+
+double getLittleDouble(const char *theData)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(theData);
+  unsigned long long bits = 0;
+  for (int i = 7; i >= 0; i--)
+    bits = (bits << 8) | p[i];
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Encode a big endian 32-bit integer
+ */
+// ----------------------------------------------------------------------
+
+void putBigInt(char *theData, int theValue)
+{
+  const unsigned int value = static_cast<unsigned int>(theValue);
+  theData[0] = static_cast<char>((value >> 24) & 0xFF);
+  theData[1] = static_cast<char>((value >> 16) & 0xFF);
+  theData[2] = static_cast<char>((value >> 8) & 0xFF);
+  theData[3] = static_cast<char>(value & 0xFF);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Encode a little endian 32-bit integer
+ */
+// ----------------------------------------------------------------------
+
+void putLittleInt(char *theData, int theValue)
+{
+  const unsigned int value = static_cast<unsigned int>(theValue);
+  theData[0] = static_cast<char>(value & 0xFF);
+  theData[1] = static_cast<char>((value >> 8) & 0xFF);
+  theData[2] = static_cast<char>((value >> 16) & 0xFF);
+  theData[3] = static_cast<char>((value >> 24) & 0xFF);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Encode a little endian IEEE double
+ */
+// ----------------------------------------------------------------------
+
+void putLittleDouble(char *theData, double theValue)
+{
+  unsigned long long bits;
+  memcpy(&bits, &theValue, sizeof(bits));
+  for (int i = 0; i < 8; i++)
+  {
+    theData[i] = static_cast<char>(bits & 0xFF);
+    bits >>= 8;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct an empty bounding box
+ */
+// ----------------------------------------------------------------------
+
+Box::Box()
+    : xmin(numeric_limits<double>::max()),
+      ymin(numeric_limits<double>::max()),
+      xmax(-numeric_limits<double>::max()),
+      ymax(-numeric_limits<double>::max())
+{
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the box is empty
+ */
+// ----------------------------------------------------------------------
+
+bool Box::empty() const
+{
+  return (xmin > xmax || ymin > ymax);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extend the box to cover the given point
+ */
+// ----------------------------------------------------------------------
+
+void Box::update(double theX, double theY)
+{
+  xmin = min(xmin, theX);
+  ymin = min(ymin, theY);
+  xmax = max(xmax, theX);
+  ymax = max(ymax, theY);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extend the box to cover the given box
+ */
+// ----------------------------------------------------------------------
+
+void Box::update(const Box &theBox)
+{
+  if (theBox.empty())
+    return;
+  update(theBox.xmin, theBox.ymin);
+  update(theBox.xmax, theBox.ymax);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether two boxes overlap
+ */
+// ----------------------------------------------------------------------
+
+bool Box::overlaps(const Box &theBox) const
+{
+  return !(xmin > theBox.xmax || xmax < theBox.xmin || ymin > theBox.ymax || ymax < theBox.ymin);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct a view to the record contents
+ *
+ * The contents start with the shape type, the record header
+ * is not included.
+ */
+// ----------------------------------------------------------------------
+
+Record::Record(const char *theData, size_t theSize)
+    : itsData(theData),
+      itsSize(theSize),
+      itsType(0),
+      itsNumParts(0),
+      itsNumPoints(0),
+      itsPartsOffset(0),
+      itsPointsOffset(0)
+{
+  require_size(itsSize, 4);
+  itsType = getLittleInt(itsData);
+
+  switch (itsType)
+  {
+    case 0:  // null
+      break;
+    case 1:   // point
+    case 11:  // pointz
+    case 21:  // pointm
+      require_size(itsSize, 20);
+      itsNumPoints = 1;
+      itsPointsOffset = 4;
+      break;
+    case 8:   // multipoint
+    case 18:  // multipointz
+    case 28:  // multipointm
+      require_size(itsSize, 40);
+      itsNumPoints = getLittleInt(itsData + 36);
+      itsPointsOffset = 40;
+      break;
+    case 3:   // polyline
+    case 5:   // polygon
+    case 13:  // polylinez
+    case 15:  // polygonz
+    case 23:  // polylinem
+    case 25:  // polygonm
+    case 31:  // multipatch
+      require_size(itsSize, 44);
+      itsNumParts = getLittleInt(itsData + 36);
+      itsNumPoints = getLittleInt(itsData + 40);
+      itsPartsOffset = 44;
+      // multipatch has part types after the part indices
+      itsPointsOffset = 44 + (itsType == 31 ? 8 : 4) * static_cast<size_t>(itsNumParts);
+      break;
+    default:
+      throw runtime_error("Unknown shape type in shapefile record");
+  }
+
+  if (itsNumParts < 0 || itsNumPoints < 0)
+    throw runtime_error("Negative part or point count in shapefile record");
+
+  require_size(itsSize, itsPointsOffset + 16 * static_cast<size_t>(itsNumPoints));
+
+  // Views index the points with the part offsets without checks
+
+  for (int i = 0; i < itsNumParts; i++)
+  {
+    const int offset = part(i);
+    if (offset < 0 || offset > itsNumPoints)
+      throw runtime_error("Part offset out of range in shapefile record");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type of the record
+ */
+// ----------------------------------------------------------------------
+
+int Record::type() const
+{
+  return itsType;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the record contains a bounding box
+ */
+// ----------------------------------------------------------------------
+
+bool Record::hasBox() const
+{
+  return (itsType != 0 && itsType != 1 && itsType != 11 && itsType != 21);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The bounding box of the record
+ *
+ * For points the box is calculated from the point itself.
+ */
+// ----------------------------------------------------------------------
+
+Box Record::box() const
+{
+  Box box;
+  if (hasBox())
+  {
+    box.xmin = getLittleDouble(itsData + 4);
+    box.ymin = getLittleDouble(itsData + 12);
+    box.xmax = getLittleDouble(itsData + 20);
+    box.ymax = getLittleDouble(itsData + 28);
+  }
+  else if (itsNumPoints > 0)
+    box.update(x(0), y(0));
+  return box;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The number of parts in the record
+ */
+// ----------------------------------------------------------------------
+
+int Record::numParts() const
+{
+  return itsNumParts;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The number of points in the record
+ */
+// ----------------------------------------------------------------------
+
+int Record::numPoints() const
+{
+  return itsNumPoints;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The start index of the given part
+ */
+// ----------------------------------------------------------------------
+
+int Record::part(int theIndex) const
+{
+  return getLittleInt(itsData + itsPartsOffset + 4 * theIndex);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The x-coordinate of the given point
+ */
+// ----------------------------------------------------------------------
+
+double Record::x(int theIndex) const
+{
+  return getLittleDouble(itsData + itsPointsOffset + 16 * theIndex);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The y-coordinate of the given point
+ */
+// ----------------------------------------------------------------------
+
+double Record::y(int theIndex) const
+{
+  return getLittleDouble(itsData + itsPointsOffset + 16 * theIndex + 8);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open the shapefile and read the record index
+ *
+ * \param theName The shapefile name with or without the .shp suffix
+ */
+// ----------------------------------------------------------------------
+
+Reader::Reader(const string &theName) : itsName(basename(theName))
+{
+  itsShp.open((itsName + ".shp").c_str(), ios::in | ios::binary);
+  if (!itsShp)
+    throw runtime_error("Failed to open '" + itsName + ".shp' for reading");
+
+  itsHeader.resize(header_size);
+  if (!itsShp.read(&itsHeader[0], header_size))
+    throw runtime_error("Failed to read the header of '" + itsName + ".shp'");
+
+  if (getBigInt(itsHeader.data()) != 9994)
+    throw runtime_error("'" + itsName + ".shp' is not a shapefile");
+
+  // The index file contains the offset and length of each record
+  // in 16-bit words
+
+  ifstream shx((itsName + ".shx").c_str(), ios::in | ios::binary);
+  if (!shx)
+    throw runtime_error("Failed to open '" + itsName + ".shx' for reading");
+
+  string buffer(header_size, '\0');
+  if (!shx.read(&buffer[0], header_size))
+    throw runtime_error("Failed to read the header of '" + itsName + ".shx'");
+
+  const int shxwords = getBigInt(buffer.data() + 24);
+  if (shxwords < 0 || 2 * static_cast<size_t>(shxwords) < header_size)
+    throw runtime_error("Invalid file length in '" + itsName + ".shx'");
+  const size_t records = (2 * static_cast<size_t>(shxwords) - header_size) / 8;
+
+  buffer.resize(8 * records);
+  if (records > 0 && !shx.read(&buffer[0], buffer.size()))
+    throw runtime_error("Failed to read the index in '" + itsName + ".shx'");
+
+  // The records must lie within the .shp file
+
+  itsShp.seekg(0, ios::end);
+  const streamoff shpsize = itsShp.tellg();
+  if (shpsize < 0)
+    throw runtime_error("Failed to determine the size of '" + itsName + ".shp'");
+  const size_t size = static_cast<size_t>(shpsize);
+
+  itsOffsets.reserve(records);
+  itsLengths.reserve(records);
+  for (size_t i = 0; i < records; i++)
+  {
+    const int offset = getBigInt(buffer.data() + 8 * i);
+    const int length = getBigInt(buffer.data() + 8 * i + 4);
+    if (offset < 0 || length < 0)
+      throw runtime_error("Invalid record index in '" + itsName + ".shx'");
+
+    const size_t start = 2 * static_cast<size_t>(offset) + record_header_size;
+    const size_t bytes = 2 * static_cast<size_t>(length);
+    if (start > size || bytes > size - start)
+      throw runtime_error("Record extends beyond the end of '" + itsName + ".shp'");
+
+    itsOffsets.push_back(start);
+    itsLengths.push_back(bytes);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type in the file header
+ */
+// ----------------------------------------------------------------------
+
+int Reader::shapeType() const
+{
+  return getLittleInt(itsHeader.data() + 32);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the contents of the given record
+ *
+ * \param theRecord The record number starting from 0
+ * \param theContents The buffer to fill
+ */
+// ----------------------------------------------------------------------
+
+void Reader::read(size_t theRecord, string &theContents)
+{
+  if (theRecord >= itsOffsets.size())
+    throw runtime_error("Record number out of range for '" + itsName + ".shp'");
+
+  theContents.resize(itsLengths[theRecord]);
+  itsShp.seekg(itsOffsets[theRecord]);
+  if (!theContents.empty() && !itsShp.read(&theContents[0], theContents.size()))
+    throw runtime_error("Failed to read a record from '" + itsName + ".shp'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Close the files if not already closed
+ */
+// ----------------------------------------------------------------------
+
+Writer::~Writer()
+{
+  try
+  {
+    close();
+  }
+  catch (...)
+  {
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open the .shp and .shx files for writing
+ *
+ * The given header is used as a template for the output header. The
+ * file lengths and the XY bounding box are updated when the files
+ * are closed, the rest such as the Z and M ranges are kept as is.
+ *
+ * \param theName The shapefile name with or without the .shp suffix
+ * \param theHeader The template header
+ */
+// ----------------------------------------------------------------------
+
+Writer::Writer(const string &theName, const string &theHeader)
+    : itsName(basename(theName)),
+      itsHeader(theHeader),
+      itsShp(),
+      itsShx(),
+      itsCount(0),
+      itsShpSize(header_size),
+      itsBox(),
+      itsClosed(false)
+{
+  if (itsHeader.size() != header_size)
+    throw runtime_error("Invalid shapefile header size");
+
+  itsShp.open((itsName + ".shp").c_str(), ios::out | ios::binary | ios::trunc);
+  if (!itsShp)
+    throw runtime_error("Failed to open '" + itsName + ".shp' for writing");
+
+  itsShx.open((itsName + ".shx").c_str(), ios::out | ios::binary | ios::trunc);
+  if (!itsShx)
+    throw runtime_error("Failed to open '" + itsName + ".shx' for writing");
+
+  // Placeholder headers, the final ones are written by close()
+  itsShp.write(itsHeader.data(), header_size);
+  itsShx.write(itsHeader.data(), header_size);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a record
+ *
+ * \param theContents The record contents starting from the shape type
+ */
+// ----------------------------------------------------------------------
+
+void Writer::write(const string &theContents)
+{
+  write(theContents.data(), theContents.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a record given as raw bytes, for example a mapped record
+ */
+// ----------------------------------------------------------------------
+
+void Writer::write(const char *theData, size_t theSize)
+{
+  if (itsClosed)
+    throw runtime_error("Attempting to write to closed shapefile '" + itsName + "'");
+
+  const Record record(theData, theSize);
+  itsBox.update(record.box());
+
+  const int words = static_cast<int>(theSize / 2);
+
+  char buffer[record_header_size];
+  putBigInt(buffer, static_cast<int>(++itsCount));
+  putBigInt(buffer + 4, words);
+  itsShp.write(buffer, record_header_size);
+  itsShp.write(theData, theSize);
+
+  putBigInt(buffer, static_cast<int>(itsShpSize / 2));
+  putBigInt(buffer + 4, words);
+  itsShx.write(buffer, record_header_size);
+
+  itsShpSize += record_header_size + theSize;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Finalize the headers and close the files
+ */
+// ----------------------------------------------------------------------
+
+void Writer::close()
+{
+  if (itsClosed)
+    return;
+  itsClosed = true;
+
+  if (!itsBox.empty())
+  {
+    putLittleDouble(&itsHeader[36], itsBox.xmin);
+    putLittleDouble(&itsHeader[44], itsBox.ymin);
+    putLittleDouble(&itsHeader[52], itsBox.xmax);
+    putLittleDouble(&itsHeader[60], itsBox.ymax);
+  }
+
+  putBigInt(&itsHeader[24], static_cast<int>(itsShpSize / 2));
+  itsShp.seekp(0);
+  itsShp.write(itsHeader.data(), header_size);
+  itsShp.close();
+
+  putBigInt(&itsHeader[24], static_cast<int>((header_size + record_header_size * itsCount) / 2));
+  itsShx.seekp(0);
+  itsShx.write(itsHeader.data(), header_size);
+  itsShx.close();
+
+  if (itsShp.fail() || itsShx.fail())
+    throw runtime_error("Failed to write shapefile '" + itsName + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Close the file if not already closed
+ */
+// ----------------------------------------------------------------------
+
+DbfWriter::~DbfWriter()
+{
+  try
+  {
+    close();
+  }
+  catch (...)
+  {
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Open a .dbf file for writing
+ *
+ * \param theName The shapefile name with or without the .shp suffix
+ * \param theHeader The header of the input file including the field
+ *                  descriptors, the row count is updated on closing
+ */
+// ----------------------------------------------------------------------
+
+DbfWriter::DbfWriter(const string &theName, const string &theHeader)
+    : itsName(basename(theName) + ".dbf"),
+      itsHeader(theHeader),
+      itsDbf(),
+      itsCount(0),
+      itsRowLength(0),
+      itsClosed(false)
+{
+  if (itsHeader.size() < dbf_header_size + 1)
+    throw runtime_error("Invalid .dbf header size");
+
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(itsHeader.data());
+  itsRowLength = p[10] | (static_cast<size_t>(p[11]) << 8);
+
+  itsDbf.open(itsName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!itsDbf)
+    throw runtime_error("Failed to open '" + itsName + "' for writing");
+
+  itsDbf.write(itsHeader.data(), itsHeader.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a row
+ */
+// ----------------------------------------------------------------------
+
+void DbfWriter::write(const string &theRow)
+{
+  if (theRow.size() != itsRowLength)
+    throw runtime_error("Row length does not match the header of '" + itsName + "'");
+  write(theRow.data());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a row of the length given in the header
+ */
+// ----------------------------------------------------------------------
+
+void DbfWriter::write(const char *theRow)
+{
+  if (itsClosed)
+    throw runtime_error("Attempting to write to closed file '" + itsName + "'");
+
+  itsDbf.write(theRow, itsRowLength);
+  ++itsCount;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the end of file marker and the final row count
+ */
+// ----------------------------------------------------------------------
+
+void DbfWriter::close()
+{
+  if (itsClosed)
+    return;
+  itsClosed = true;
+
+  itsDbf.put('\x1A');
+
+  char count[4];
+  putLittleInt(count, static_cast<int>(itsCount));
+  itsDbf.seekp(4);
+  itsDbf.write(count, 4);
+  itsDbf.close();
+
+  if (itsDbf.fail())
+    throw runtime_error("Failed to write '" + itsName + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value of a field in a row with the padding removed
+ */
+// ----------------------------------------------------------------------
+
+string dbfValue(const string &theRow, const DbfField &theField)
+{
+  if (theField.offset + theField.length > theRow.size())
+    throw runtime_error("Field '" + theField.name + "' exceeds the .dbf row");
+
+  return dbfValue(theRow.data(), theField);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value of a field in a row with the padding removed
+ *
+ * The row must be a full row of the file the field belongs to.
+ */
+// ----------------------------------------------------------------------
+
+string dbfValue(const char *theRow, const DbfField &theField)
+{
+  const char *first = theRow + theField.offset;
+  const char *last = first + theField.length;
+  while (first < last && (*first == ' ' || *first == '\0'))
+    ++first;
+  while (last > first && (last[-1] == ' ' || last[-1] == '\0'))
+    --last;
+  return string(first, last);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map a shapefile into memory
+ *
+ * \param theName The shapefile name with or without the .shp suffix
+ */
+// ----------------------------------------------------------------------
+
+MappedReader::MappedReader(const string &theName)
+    : itsName(basename(theName)),
+      itsShp(itsName + ".shp"),
+      itsShx(itsName + ".shx"),
+      itsCount(0)
+{
+  if (itsShp.size() < header_size || getBigInt(itsShp.data()) != 9994)
+    throw runtime_error("'" + itsName + ".shp' is not a shapefile");
+
+  if (itsShx.size() < header_size || getBigInt(itsShx.data()) != 9994)
+    throw runtime_error("'" + itsName + ".shx' is not a shapefile index");
+
+  itsCount = (itsShx.size() - header_size) / 8;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The shape type in the file header
+ */
+// ----------------------------------------------------------------------
+
+int MappedReader::shapeType() const
+{
+  return getLittleInt(itsShp.data() + 32);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A copy of the file header
+ */
+// ----------------------------------------------------------------------
+
+string MappedReader::header() const
+{
+  return string(itsShp.data(), header_size);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A view to the given record
+ *
+ * The view remains valid as long as the reader exists.
+ *
+ * \param theRecord The record number starting from 0
+ */
+// ----------------------------------------------------------------------
+
+Record MappedReader::record(size_t theRecord) const
+{
+  if (theRecord >= itsCount)
+    throw runtime_error("Record number out of range for '" + itsName + ".shp'");
+
+  const char *index = itsShx.data() + header_size + 8 * theRecord;
+  const int offset = getBigInt(index);
+  const int length = getBigInt(index + 4);
+  if (offset < 0 || length < 0)
+    throw runtime_error("Invalid record index in '" + itsName + ".shx'");
+
+  const size_t start = 2 * static_cast<size_t>(offset) + record_header_size;
+  const size_t bytes = 2 * static_cast<size_t>(length);
+  if (start > itsShp.size() || bytes > itsShp.size() - start)
+    throw runtime_error("Record extends beyond the end of '" + itsName + ".shp'");
+
+  return Record(itsShp.data() + start, bytes);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map a .dbf file into memory and parse its field descriptors
+ *
+ * \param theName The shapefile name with or without the .shp suffix
+ */
+// ----------------------------------------------------------------------
+
+MappedDbf::MappedDbf(const string &theName)
+    : itsDbf(basename(theName) + ".dbf"),
+      itsFields(),
+      itsCount(0),
+      itsHeaderLength(0),
+      itsRowLength(0)
+{
+  const string &name = itsDbf.name();
+
+  if (itsDbf.size() < dbf_header_size)
+    throw runtime_error("Failed to read the header of '" + name + "'");
+
+  const char *data = itsDbf.data();
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  itsCount = static_cast<unsigned int>(getLittleInt(data + 4));
+  itsHeaderLength = p[8] | (static_cast<size_t>(p[9]) << 8);
+  itsRowLength = p[10] | (static_cast<size_t>(p[11]) << 8);
+
+  if (itsHeaderLength < dbf_header_size + 1 || itsRowLength == 0 ||
+      itsHeaderLength > itsDbf.size())
+    throw runtime_error("Invalid header in '" + name + "'");
+
+  if (itsHeaderLength + itsCount * itsRowLength > itsDbf.size())
+    throw runtime_error("The rows of '" + name + "' extend beyond the end of the file");
+
+  itsFields = parse_dbf_fields(data, itsHeaderLength, itsRowLength, name);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A copy of the header including the field descriptors
+ */
+// ----------------------------------------------------------------------
+
+string MappedDbf::header() const
+{
+  return string(itsDbf.data(), itsHeaderLength);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The index of the field with the given name, or -1
+ */
+// ----------------------------------------------------------------------
+
+int MappedDbf::field(const string &theName) const
+{
+  return find_dbf_field(itsFields, theName);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A pointer to the given row, starting with the deletion flag
+ */
+// ----------------------------------------------------------------------
+
+const char *MappedDbf::row(size_t theRow) const
+{
+  if (theRow >= itsCount)
+    throw runtime_error("Row number out of range for '" + itsDbf.name() + "'");
+  return itsDbf.data() + itsHeaderLength + theRow * itsRowLength;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse the field descriptors of a complete .dbf header
+ */
+// ----------------------------------------------------------------------
+
+vector<DbfField> dbfFields(const string &theHeader)
+{
+  if (theHeader.size() < dbf_header_size + 1)
+    throw runtime_error("Invalid .dbf header");
+
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(theHeader.data());
+  const size_t rowlength = p[10] | (static_cast<size_t>(p[11]) << 8);
+
+  return parse_dbf_fields(theHeader.data(), theHeader.size(), rowlength, ".dbf header");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append a field descriptor to a complete .dbf header
+ *
+ * The values of the new field are to be appended to the end of each
+ * row of the old header.
+ *
+ * \param theHeader The header to extend
+ * \param theName The name of the new field, at most 10 characters
+ * \param theType The type of the new field
+ * \param theLength The width of the new field in bytes
+ * \param theDecimals The number of decimals for numeric fields
+ * \return The extended header
+ */
+// ----------------------------------------------------------------------
+
+string addDbfField(
+    const string &theHeader, const string &theName, char theType, int theLength, int theDecimals)
+{
+  const vector<DbfField> fields = dbfFields(theHeader);
+
+  if (theName.empty() || theName.size() > 10)
+    throw runtime_error("Invalid .dbf field name '" + theName + "'");
+  if (find_dbf_field(fields, theName) >= 0)
+    throw runtime_error("Field '" + theName + "' already exists in the .dbf header");
+  if (theLength < 1 || theLength > 255 || theDecimals < 0 || theDecimals > 255)
+    throw runtime_error("Invalid width for .dbf field '" + theName + "'");
+
+  const size_t pos = dbf_header_size + fields.size() * dbf_field_size;
+  if (pos >= theHeader.size() || theHeader[pos] != '\x0D')
+    throw runtime_error("Missing field terminator in .dbf header");
+
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(theHeader.data());
+  const size_t headerlength = theHeader.size() + dbf_field_size;
+  const size_t rowlength = (p[10] | (static_cast<size_t>(p[11]) << 8)) + theLength;
+  if (headerlength > 0xFFFF || rowlength > 0xFFFF)
+    throw runtime_error("Too many fields in .dbf header");
+
+  string desc(dbf_field_size, '\0');
+  theName.copy(&desc[0], theName.size());
+  desc[11] = theType;
+  desc[16] = static_cast<char>(theLength);
+  desc[17] = static_cast<char>(theDecimals);
+
+  string header = theHeader;
+  header.insert(pos, desc);
+  header[8] = static_cast<char>(headerlength & 0xFF);
+  header[9] = static_cast<char>(headerlength >> 8);
+  header[10] = static_cast<char>(rowlength & 0xFF);
+  header[11] = static_cast<char>(rowlength >> 8);
+  return header;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Copy the attribute file of a shapefile
+ *
+ * \param theInput The input shapefile name with or without .shp suffix
+ * \param theOutput The output shapefile name with or without .shp suffix
+ */
+// ----------------------------------------------------------------------
+
+void copyDbf(const string &theInput, const string &theOutput)
+{
+  const string infile = basename(theInput) + ".dbf";
+  const string outfile = basename(theOutput) + ".dbf";
+
+  ifstream in(infile.c_str(), ios::in | ios::binary);
+  if (!in)
+    throw runtime_error("Failed to open '" + infile + "' for reading");
+
+  ofstream out(outfile.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out)
+    throw runtime_error("Failed to open '" + outfile + "' for writing");
+
+  out << in.rdbuf();
+  if (out.fail())
+    throw runtime_error("Failed to write '" + outfile + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set the bounding box in the headers of a written shapefile
+ *
+ * Only the box is rewritten, the rest of the files is unaffected.
+ *
+ * \param theName The shapefile name with or without .shp suffix
+ * \param theBox The new bounding box, an empty box is ignored
+ */
+// ----------------------------------------------------------------------
+
+void setBox(const string &theName, const Box &theBox)
+{
+  if (theBox.empty())
+    return;
+
+  char data[32];
+  putLittleDouble(data, theBox.xmin);
+  putLittleDouble(data + 8, theBox.ymin);
+  putLittleDouble(data + 16, theBox.xmax);
+  putLittleDouble(data + 24, theBox.ymax);
+
+  const char *suffixes[2] = {".shp", ".shx"};
+  for (const char *suffix : suffixes)
+  {
+    const string filename = basename(theName) + suffix;
+    fstream file(filename.c_str(), ios::in | ios::out | ios::binary);
+    if (!file)
+      throw runtime_error("Failed to open '" + filename + "' for updating");
+    file.seekp(36);
+    file.write(data, sizeof(data));
+    if (file.fail())
+      throw runtime_error("Failed to write '" + filename + "'");
+  }
+}
+
+}  // namespace ShpFile
+
+// ======================================================================
@@ -0,0 +1,691 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of class Topology
+ */
+// ======================================================================
+
+#include "Topology.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+//! File identifier
+const char magic[] = "SHPTOPO1";
+
+//! Byte order marker
+const uint32_t byte_order = 0x01020304;
+
+//! Coordinates as bit patterns
+typedef pair<uint64_t, uint64_t> PointKey;
+
+//! Hash function for points and node pairs
+struct PairHash
+{
+  template <typename T>
+  size_t operator()(const pair<T, T> &thePair) const
+  {
+    return hash<uint64_t>()(static_cast<uint64_t>(thePair.first) * 0x9E3779B97F4A7C15ULL ^
+                            static_cast<uint64_t>(thePair.second));
+  }
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The key of a point
+ *
+ * Negative zero is mapped to zero so that it compares equal.
+ */
+// ----------------------------------------------------------------------
+
+PointKey point_key(double theX, double theY)
+{
+  const double x = theX + 0.0;
+  const double y = theY + 0.0;
+  PointKey key;
+  memcpy(&key.first, &x, sizeof(x));
+  memcpy(&key.second, &y, sizeof(y));
+  return key;
+}
+
+//! A segment between two nodes
+struct Segment
+{
+  size_t from;   //!< start node of the first traversal
+  size_t to;     //!< end node of the first traversal
+  long first;    //!< the element traversing the segment first
+  long second;   //!< the other element, -1 if none
+  size_t count;  //!< number of traversals
+  long arc;      //!< the arc containing the segment, -1 if none yet
+  bool forward;  //!< true if the arc runs from 'from' to 'to'
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The unordered pair of elements sharing a segment
+ */
+// ----------------------------------------------------------------------
+
+pair<long, long> owners(const Segment &theSegment)
+{
+  return make_pair(min(theSegment.first, theSegment.second),
+                   max(theSegment.first, theSegment.second));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Squared distance of a point from a line segment
+ */
+// ----------------------------------------------------------------------
+
+double segment_distance2(
+    double theX, double theY, double theX1, double theY1, double theX2, double theY2)
+{
+  const double dx = theX2 - theX1;
+  const double dy = theY2 - theY1;
+  const double len2 = dx * dx + dy * dy;
+  double t = 0;
+  if (len2 > 0)
+    t = max(0.0, min(1.0, ((theX - theX1) * dx + (theY - theY1) * dy) / len2));
+  const double px = theX1 + t * dx - theX;
+  const double py = theY1 + t * dy - theY;
+  return px * px + py * py;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Douglas-Peucker simplification of a range of points
+ *
+ * The endpoints of the range are assumed to be kept already.
+ */
+// ----------------------------------------------------------------------
+
+void douglas_peucker(const double *theX,
+                     const double *theY,
+                     size_t theFirst,
+                     size_t theLast,
+                     double theTolerance2,
+                     vector<char> &theKeep)
+{
+  vector<pair<size_t, size_t> > stack;
+  stack.push_back(make_pair(theFirst, theLast));
+
+  while (!stack.empty())
+  {
+    const size_t i1 = stack.back().first;
+    const size_t i2 = stack.back().second;
+    stack.pop_back();
+
+    double maxdist = -1;
+    size_t maxpos = i1;
+    for (size_t i = i1 + 1; i < i2; i++)
+    {
+      const double d = segment_distance2(theX[i], theY[i], theX[i1], theY[i1], theX[i2], theY[i2]);
+      if (d > maxdist)
+      {
+        maxdist = d;
+        maxpos = i;
+      }
+    }
+
+    if (maxdist > theTolerance2)
+    {
+      theKeep[maxpos] = 1;
+      stack.push_back(make_pair(i1, maxpos));
+      stack.push_back(make_pair(maxpos, i2));
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a vector of integers as 64-bit values
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void write_integers(ofstream &theOutput, const vector<T> &theValues)
+{
+  vector<int64_t> tmp(theValues.begin(), theValues.end());
+  theOutput.write(reinterpret_cast<const char *>(tmp.data()), tmp.size() * sizeof(int64_t));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read a vector of integers stored as 64-bit values
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void read_integers(ifstream &theInput, size_t theCount, vector<T> &theValues)
+{
+  vector<int64_t> tmp(theCount);
+  theInput.read(reinterpret_cast<char *>(tmp.data()), theCount * sizeof(int64_t));
+  theValues.assign(tmp.begin(), tmp.end());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether offsets start from zero, never decrease and end at the given size
+ */
+// ----------------------------------------------------------------------
+
+bool ascending(const vector<size_t> &theOffsets, size_t theSize)
+{
+  if (theOffsets.empty() || theOffsets.front() != 0 || theOffsets.back() != theSize)
+    return false;
+  for (size_t i = 1; i < theOffsets.size(); i++)
+    if (theOffsets[i] < theOffsets[i - 1])
+      return false;
+  return true;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the topology from rings
+ *
+ * \param theRings The rings, grouped by element
+ * \param theElements The element of each ring, in nondecreasing order
+ * \param theElementCount The number of elements
+ *
+ * Consecutive duplicate points are ignored, and rings with less than
+ * 3 distinct points have no arcs.
+ *
+ * An arc ends at a node where more than two segments meet, or where
+ * the elements sharing the segments change. Since this is a property
+ * of the segments and not of the rings, all rings sharing an arc
+ * agree on its endpoints.
+ */
+// ----------------------------------------------------------------------
+
+void Topology::build(const vector<Polygon> &theRings,
+                     const vector<long> &theElements,
+                     size_t theElementCount)
+{
+  if (theRings.size() != theElements.size())
+    throw runtime_error("Topology: ring and element counts differ");
+
+  // Number the nodes and express the rings in node numbers
+
+  unordered_map<PointKey, size_t, PairHash> nodenumbers;
+  vector<double> nodex;
+  vector<double> nodey;
+  vector<vector<size_t> > rings(theRings.size());
+
+  for (size_t r = 0; r < theRings.size(); r++)
+  {
+    if (r > 0 && theElements[r] < theElements[r - 1])
+      throw runtime_error("Topology: rings must be ordered by element");
+    if (theElements[r] < 0 || static_cast<size_t>(theElements[r]) >= theElementCount)
+      throw runtime_error("Topology: element number out of range");
+
+    vector<size_t> &ring = rings[r];
+    for (const Point &pt : theRings[r].data())
+    {
+      const size_t node =
+          nodenumbers.insert(make_pair(point_key(pt.x(), pt.y()), nodex.size())).first->second;
+      if (node == nodex.size())
+      {
+        nodex.push_back(pt.x());
+        nodey.push_back(pt.y());
+      }
+      if (ring.empty() || ring.back() != node)
+        ring.push_back(node);
+    }
+    if (ring.size() > 1 && ring.front() == ring.back())
+      ring.pop_back();
+    if (ring.size() < 3)
+      ring.clear();
+  }
+
+  // Collect the segments and their elements
+
+  unordered_map<pair<size_t, size_t>, size_t, PairHash> segmentnumbers;
+  vector<Segment> segments;
+  vector<vector<size_t> > ringsegments(rings.size());
+  itsSharedTooMany = 0;
+
+  for (size_t r = 0; r < rings.size(); r++)
+  {
+    const vector<size_t> &ring = rings[r];
+    const size_t m = ring.size();
+    for (size_t k = 0; k < m; k++)
+    {
+      const size_t u = ring[k];
+      const size_t v = ring[k + 1 == m ? 0 : k + 1];
+      const size_t s =
+          segmentnumbers.insert(make_pair(make_pair(min(u, v), max(u, v)), segments.size()))
+              .first->second;
+      if (s == segments.size())
+      {
+        Segment seg = {u, v, theElements[r], -1, 1, -1, true};
+        segments.push_back(seg);
+      }
+      else
+      {
+        Segment &seg = segments[s];
+        if (++seg.count == 2)
+          seg.second = theElements[r];
+        else if (seg.count == 3)
+          ++itsSharedTooMany;
+      }
+      ringsegments[r].push_back(s);
+    }
+  }
+
+  vector<unsigned int> degree(nodex.size(), 0);
+  for (const Segment &seg : segments)
+  {
+    ++degree[seg.from];
+    ++degree[seg.to];
+  }
+
+  // Build the arcs and the arc references of the rings
+
+  itsArcStart.assign(1, 0);
+  itsX.clear();
+  itsY.clear();
+  itsLeft.clear();
+  itsRight.clear();
+  itsRingStart.assign(1, 0);
+  itsRefs.clear();
+  itsElementStart.assign(theElementCount + 1, 0);
+
+  for (size_t r = 0; r < rings.size(); r++)
+  {
+    const vector<size_t> &ring = rings[r];
+    const vector<size_t> &segs = ringsegments[r];
+    const size_t m = ring.size();
+    const long element = theElements[r];
+
+    // An arc starts at vertex k if the ring is broken there
+
+    vector<char> breaks(m, 0);
+    size_t start = m;
+    for (size_t k = 0; k < m; k++)
+    {
+      const size_t previous = segs[k == 0 ? m - 1 : k - 1];
+      breaks[k] =
+          (degree[ring[k]] != 2 || owners(segments[previous]) != owners(segments[segs[k]]));
+      if (breaks[k] && start == m)
+        start = k;
+    }
+
+    // A ring without breaks is a single closed arc starting anywhere
+
+    if (m > 0 && start == m)
+    {
+      start = 0;
+      breaks[0] = 1;
+    }
+
+    for (size_t j = 0; j < m; j++)
+    {
+      const size_t k = (start + j) % m;
+      if (!breaks[k])
+        continue;
+
+      Segment &seg = segments[segs[k]];
+      const bool along = (ring[k] == seg.from);
+
+      if (seg.arc < 0)
+      {
+        // A new arc running along this ring
+
+        const long arc = static_cast<long>(itsLeft.size());
+        itsRight.push_back(element);
+        itsLeft.push_back(seg.second < 0 ? -1 : (seg.first == element ? seg.second : seg.first));
+
+        size_t i = k;
+        do
+        {
+          Segment &s = segments[segs[i]];
+          s.arc = arc;
+          s.forward = (ring[i] == s.from);
+          itsX.push_back(nodex[ring[i]]);
+          itsY.push_back(nodey[ring[i]]);
+          i = (i + 1) % m;
+        } while (!breaks[i]);
+
+        itsX.push_back(nodex[ring[i]]);
+        itsY.push_back(nodey[ring[i]]);
+        itsArcStart.push_back(itsX.size());
+        itsRefs.push_back(arc);
+      }
+      else if (along == seg.forward)
+        itsRefs.push_back(seg.arc);
+      else
+        itsRefs.push_back(-seg.arc - 1);
+    }
+
+    itsRingStart.push_back(itsRefs.size());
+    ++itsElementStart[element + 1];
+  }
+
+  for (size_t e = 0; e < theElementCount; e++)
+    itsElementStart[e + 1] += itsElementStart[e];
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Simplify the arcs
+ *
+ * Each arc is simplified with the Douglas-Peucker algorithm keeping
+ * its endpoints, hence the arcs remain connected and shared borders
+ * stay consistent. A closed arc is split at the point farthest from
+ * its start, and is left intact if it would collapse.
+ */
+// ----------------------------------------------------------------------
+
+void Topology::simplify(double theTolerance)
+{
+  const double tolerance2 = theTolerance * theTolerance;
+
+  vector<size_t> arcstart(1, 0);
+  vector<double> newx;
+  vector<double> newy;
+  vector<char> keep;
+
+  for (size_t a = 0; a < arcs(); a++)
+  {
+    const size_t first = arcBegin(a);
+    const size_t last = arcEnd(a) - 1;
+
+    keep.assign(last - first + 1, 0);
+    keep.front() = keep.back() = 1;
+
+    const double *xs = &itsX[first];
+    const double *ys = &itsY[first];
+    const size_t n = last - first;
+
+    if (xs[0] == xs[n] && ys[0] == ys[n])
+    {
+      size_t far = 0;
+      double fardist = -1;
+      for (size_t i = 1; i < n; i++)
+      {
+        const double d = (xs[i] - xs[0]) * (xs[i] - xs[0]) + (ys[i] - ys[0]) * (ys[i] - ys[0]);
+        if (d > fardist)
+        {
+          fardist = d;
+          far = i;
+        }
+      }
+      if (far > 0)
+      {
+        keep[far] = 1;
+        douglas_peucker(xs, ys, 0, far, tolerance2, keep);
+        douglas_peucker(xs, ys, far, n, tolerance2, keep);
+      }
+      if (count(keep.begin(), keep.end(), 1) < 4)
+        keep.assign(keep.size(), 1);
+    }
+    else
+      douglas_peucker(xs, ys, 0, n, tolerance2, keep);
+
+    for (size_t i = 0; i <= n; i++)
+      if (keep[i])
+      {
+        newx.push_back(xs[i]);
+        newy.push_back(ys[i]);
+      }
+    arcstart.push_back(newx.size());
+  }
+
+  itsArcStart.swap(arcstart);
+  itsX.swap(newx);
+  itsY.swap(newy);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Dissolve the elements into groups
+ *
+ * \param theGroups The group of each element, negative if none
+ * \param theRingGroups The group of each returned ring
+ * \return The boundary rings of the groups
+ *
+ * The arcs separating different groups are chained into rings which
+ * keep the group on their right side, hence outer rings are clockwise
+ * and holes counter-clockwise as in shapefiles. A chain which does not
+ * return to its start means the topology is inconsistent, and is
+ * reported as an error.
+ */
+// ----------------------------------------------------------------------
+
+vector<Polygon> Topology::dissolve(const vector<long> &theGroups,
+                                   vector<long> &theRingGroups) const
+{
+  if (theGroups.size() != elements())
+    throw runtime_error("Topology: the number of groups must equal the number of elements");
+
+  const auto group = [&theGroups](long theElement)
+  { return (theElement < 0 ? -1 : theGroups[theElement]); };
+
+  // The directed arcs of each group
+
+  vector<pair<long, long> > directed;  // group and arc reference
+  for (size_t a = 0; a < arcs(); a++)
+  {
+    const long gl = group(itsLeft[a]);
+    const long gr = group(itsRight[a]);
+    if (gl == gr)
+      continue;
+    if (gr >= 0)
+      directed.push_back(make_pair(gr, static_cast<long>(a)));
+    if (gl >= 0)
+      directed.push_back(make_pair(gl, -static_cast<long>(a) - 1));
+  }
+  stable_sort(directed.begin(),
+              directed.end(),
+              [](const pair<long, long> &a, const pair<long, long> &b) { return a.first < b.first; });
+
+  // The start and end points of a directed arc
+
+  const auto start_point = [this](long theRef)
+  {
+    const size_t i = (theRef >= 0 ? arcBegin(theRef) : arcEnd(-theRef - 1) - 1);
+    return point_key(itsX[i], itsY[i]);
+  };
+  const auto end_point = [this](long theRef)
+  {
+    const size_t i = (theRef >= 0 ? arcEnd(theRef) - 1 : arcBegin(-theRef - 1));
+    return point_key(itsX[i], itsY[i]);
+  };
+
+  vector<Polygon> rings;
+  theRingGroups.clear();
+
+  unordered_map<PointKey, vector<size_t>, PairHash> outgoing;
+  vector<char> used;
+
+  for (size_t begin = 0; begin < directed.size();)
+  {
+    size_t end = begin;
+    while (end < directed.size() && directed[end].first == directed[begin].first)
+      ++end;
+
+    outgoing.clear();
+    for (size_t i = begin; i < end; i++)
+      outgoing[start_point(directed[i].second)].push_back(i);
+    used.assign(end - begin, 0);
+
+    for (size_t i = begin; i < end; i++)
+    {
+      if (used[i - begin])
+        continue;
+
+      Polygon ring;
+      const PointKey ringstart = start_point(directed[i].second);
+      size_t current = i;
+
+      while (true)
+      {
+        used[current - begin] = 1;
+        const long ref = directed[current].second;
+        const size_t a = (ref >= 0 ? ref : -ref - 1);
+        const size_t n = arcEnd(a) - arcBegin(a);
+        for (size_t j = (ring.empty() ? 0 : 1); j < n; j++)
+        {
+          const size_t p = (ref >= 0 ? arcBegin(a) + j : arcEnd(a) - 1 - j);
+          ring.add(Point(itsX[p], itsY[p]));
+        }
+
+        const PointKey next = end_point(ref);
+        if (next == ringstart)
+          break;
+
+        // Continue with an unused arc starting from the end point
+
+        vector<size_t> &candidates = outgoing[next];
+        while (!candidates.empty() && used[candidates.back() - begin])
+          candidates.pop_back();
+        if (candidates.empty())
+          throw runtime_error("Topology: the boundary of group " +
+                              to_string(directed[i].first) + " is not closed");
+        current = candidates.back();
+      }
+
+      rings.push_back(ring);
+      theRingGroups.push_back(directed[i].first);
+    }
+
+    begin = end;
+  }
+
+  return rings;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the topology into a file
+ *
+ * The file starts with an identifier, a byte order marker and the
+ * sizes of the arrays as 64-bit integers, followed by the arrays
+ * themselves. Integers are stored as 64-bit values and coordinates as
+ * doubles, all in native byte order.
+ */
+// ----------------------------------------------------------------------
+
+void Topology::write(const string &theFile) const
+{
+  ofstream out(theFile.c_str(), ios::out | ios::binary);
+  if (!out)
+    throw runtime_error("Failed to open '" + theFile + "' for writing");
+
+  out.write(magic, 8);
+  out.write(reinterpret_cast<const char *>(&byte_order), sizeof(byte_order));
+
+  vector<size_t> sizes;
+  sizes.push_back(elements());
+  sizes.push_back(itsRingStart.size() - 1);
+  sizes.push_back(arcs());
+  sizes.push_back(itsX.size());
+  sizes.push_back(itsRefs.size());
+  sizes.push_back(itsSharedTooMany);
+  write_integers(out, sizes);
+
+  write_integers(out, itsArcStart);
+  out.write(reinterpret_cast<const char *>(itsX.data()), itsX.size() * sizeof(double));
+  out.write(reinterpret_cast<const char *>(itsY.data()), itsY.size() * sizeof(double));
+  write_integers(out, itsLeft);
+  write_integers(out, itsRight);
+  write_integers(out, itsElementStart);
+  write_integers(out, itsRingStart);
+  write_integers(out, itsRefs);
+
+  if (!out)
+    throw runtime_error("Failed while writing '" + theFile + "'");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Read the topology from a file
+ *
+ * The array sizes are validated against the file size before anything
+ * is allocated, and the offsets and arc references against the sizes.
+ */
+// ----------------------------------------------------------------------
+
+void Topology::read(const string &theFile)
+{
+  ifstream in(theFile.c_str(), ios::in | ios::binary);
+  if (!in)
+    throw runtime_error("Failed to open '" + theFile + "' for reading");
+
+  char header[8];
+  uint32_t order = 0;
+  in.read(header, 8);
+  in.read(reinterpret_cast<char *>(&order), sizeof(order));
+  if (!in || memcmp(header, magic, 8) != 0)
+    throw runtime_error("File '" + theFile + "' is not a topology file");
+  if (order != byte_order)
+    throw runtime_error("Topology file '" + theFile + "' has a foreign byte order");
+
+  vector<size_t> sizes;
+  read_integers(in, 6, sizes);
+  if (!in)
+    throw runtime_error("Topology file '" + theFile + "' is truncated");
+
+  const size_t nelements = sizes[0];
+  const size_t nrings = sizes[1];
+  const size_t narcs = sizes[2];
+  const size_t npoints = sizes[3];
+  const size_t nrefs = sizes[4];
+  itsSharedTooMany = sizes[5];
+
+  // Validate the sizes against the file size before allocating anything
+
+  const streamoff offset = in.tellg();
+  in.seekg(0, ios::end);
+  const streamoff filesize = in.tellg();
+  in.seekg(offset);
+  if (offset < 0 || filesize < offset)
+    throw runtime_error("Failed to determine the size of '" + theFile + "'");
+
+  const size_t words = static_cast<size_t>(filesize - offset) / 8;
+  for (size_t i = 0; i < 5; i++)
+    if (sizes[i] > words)
+      throw runtime_error("Topology file '" + theFile + "' is truncated");
+  if (3 * narcs + 1 + 2 * npoints + nelements + 1 + nrings + 1 + nrefs != words ||
+      (filesize - offset) % 8 != 0)
+    throw runtime_error("Topology file '" + theFile + "' is corrupt");
+
+  read_integers(in, narcs + 1, itsArcStart);
+  itsX.resize(npoints);
+  itsY.resize(npoints);
+  in.read(reinterpret_cast<char *>(itsX.data()), npoints * sizeof(double));
+  in.read(reinterpret_cast<char *>(itsY.data()), npoints * sizeof(double));
+  read_integers(in, narcs, itsLeft);
+  read_integers(in, narcs, itsRight);
+  read_integers(in, nelements + 1, itsElementStart);
+  read_integers(in, nrings + 1, itsRingStart);
+  read_integers(in, nrefs, itsRefs);
+
+  if (!in)
+    throw runtime_error("Topology file '" + theFile + "' is truncated");
+  if (!ascending(itsArcStart, npoints) || !ascending(itsElementStart, nrings) ||
+      !ascending(itsRingStart, nrefs))
+    throw runtime_error("Topology file '" + theFile + "' is corrupt");
+
+  for (long ref : itsRefs)
+    if (ref >= static_cast<long>(narcs) || ref < -static_cast<long>(narcs))
+      throw runtime_error("Topology file '" + theFile + "' is corrupt");
+  for (size_t a = 0; a < narcs; a++)
+    if (itsLeft[a] >= static_cast<long>(nelements) || itsRight[a] >= static_cast<long>(nelements))
+      throw runtime_error("Topology file '" + theFile + "' is corrupt");
+}
+
+// ======================================================================
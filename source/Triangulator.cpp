@@ -0,0 +1,1486 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of class Triangulator
+ */
+// ======================================================================
+/*!
+ * The triangulation is stored as a set of counter-clockwise triangles
+ * with neighbour links, edge i of a triangle being the one opposite
+ * to vertex i. The convex hull is closed with ghost triangles which
+ * share the vertex at infinity, so that every vertex has a complete
+ * star and points outside the hull need no special treatment. The
+ * circumcircle of a ghost triangle is the open half plane outside
+ * its hull edge.
+ */
+// ======================================================================
+
+#include "Triangulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+typedef Triangulator::size_type Index;
+
+//! Missing neighbour, also the vertex at infinity
+const Index none = static_cast<Index>(-1);
+
+//! Maximum nesting of constraint splits at intersections
+const int max_split_depth = 100;
+
+//! Relative distance at which intersections are snapped to segment endpoints
+const double snap_tolerance = 1e-12;
+
+inline int next(int i) { return (i == 2 ? 0 : i + 1); }
+inline int prev(int i) { return (i == 0 ? 2 : i - 1); }
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Exact arithmetic helpers
+ *
+ * The expansions are sums of non-overlapping doubles in increasing
+ * order of magnitude, see J.R. Shewchuk: Adaptive Precision
+ * Floating-Point Arithmetic and Fast Robust Geometric Predicates.
+ * They are needed only when the fast floating point filter fails,
+ * hence simplicity is preferred over speed.
+ */
+// ----------------------------------------------------------------------
+
+typedef vector<double> Expansion;
+
+inline void two_sum(double a, double b, double &x, double &y)
+{
+  x = a + b;
+  const double bv = x - a;
+  const double av = x - bv;
+  y = (a - av) + (b - bv);
+}
+
+inline void two_product(double a, double b, double &x, double &y)
+{
+  x = a * b;
+  y = fma(a, b, -x);
+}
+
+//! Add a double to an expansion
+void grow(Expansion &e, double b)
+{
+  Expansion h;
+  h.reserve(e.size() + 1);
+  double q = b;
+  for (double v : e)
+  {
+    double sum, err;
+    two_sum(q, v, sum, err);
+    if (err != 0)
+      h.push_back(err);
+    q = sum;
+  }
+  if (q != 0)
+    h.push_back(q);
+  e.swap(h);
+}
+
+//! Add the exact product of the given doubles to an expansion
+void add_product(Expansion &e, double theSign, const vector<double> &theFactors)
+{
+  vector<double> terms(1, theSign);
+  for (double f : theFactors)
+  {
+    vector<double> tmp;
+    tmp.reserve(2 * terms.size());
+    for (double t : terms)
+    {
+      double x, y;
+      two_product(t, f, x, y);
+      tmp.push_back(x);
+      if (y != 0)
+        tmp.push_back(y);
+    }
+    terms.swap(tmp);
+  }
+  for (double t : terms)
+    grow(e, t);
+}
+
+//! The sign of an expansion is the sign of its largest component
+inline double estimate(const Expansion &e) { return (e.empty() ? 0 : e.back()); }
+
+const double epsilon = 1.1102230246251565e-16;  // 2^-53
+const double ccwerrbound = (3 + 16 * epsilon) * epsilon;
+const double iccerrbound = (10 + 96 * epsilon) * epsilon;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Orientation test
+ *
+ * \return Positive if a,b,c are in counter-clockwise order, negative
+ *         if clockwise and zero if collinear
+ */
+// ----------------------------------------------------------------------
+
+double orient2d(double ax, double ay, double bx, double by, double cx, double cy)
+{
+  const double detleft = (ax - cx) * (by - cy);
+  const double detright = (ay - cy) * (bx - cx);
+  const double det = detleft - detright;
+  const double errbound = ccwerrbound * (fabs(detleft) + fabs(detright));
+  if (det > errbound || -det > errbound)
+    return det;
+
+  Expansion e;
+  add_product(e, 1, {ax, by});
+  add_product(e, -1, {ax, cy});
+  add_product(e, -1, {cx, by});
+  add_product(e, -1, {ay, bx});
+  add_product(e, 1, {ay, cx});
+  add_product(e, 1, {cy, bx});
+  return estimate(e);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Incircle test
+ *
+ * \return Positive if d is inside the circle through the counter-clockwise
+ *         points a,b,c, negative if outside and zero if on the circle
+ */
+// ----------------------------------------------------------------------
+
+double incircle(const double *ax,
+                const double *ay,
+                const double *bx,
+                const double *by,
+                const double *cx,
+                const double *cy,
+                const double *dx,
+                const double *dy)
+{
+  const double adx = *ax - *dx, ady = *ay - *dy;
+  const double bdx = *bx - *dx, bdy = *by - *dy;
+  const double cdx = *cx - *dx, cdy = *cy - *dy;
+
+  const double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+  const double cdxady = cdx * ady, adxcdy = adx * cdy;
+  const double adxbdy = adx * bdy, bdxady = bdx * ady;
+
+  const double alift = adx * adx + ady * ady;
+  const double blift = bdx * bdx + bdy * bdy;
+  const double clift = cdx * cdx + cdy * cdy;
+
+  const double det =
+      alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+
+  const double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift +
+                           (fabs(cdxady) + fabs(adxcdy)) * blift +
+                           (fabs(adxbdy) + fabs(bdxady)) * clift;
+
+  if (det > iccerrbound * permanent || -det > iccerrbound * permanent)
+    return det;
+
+  // Exact evaluation of the 4x4 determinant with rows (x, y, x^2+y^2, 1),
+  // expanded along the last column into four 3x3 minors
+
+  const double *xs[4] = {ax, bx, cx, dx};
+  const double *ys[4] = {ay, by, cy, dy};
+  const double cofactor[4] = {-1, 1, -1, 1};
+
+  Expansion e;
+  for (int row = 0; row < 4; row++)
+  {
+    int r[3];
+    for (int i = 0, k = 0; i < 4; i++)
+      if (i != row)
+        r[k++] = i;
+
+    // Expand the minor along the lift column
+    for (int k = 0; k < 3; k++)
+    {
+      const double sign = cofactor[row] * (k == 1 ? -1 : 1);
+      const int i = r[k];
+      const int j = r[k == 0 ? 1 : 0];
+      const int l = r[k == 2 ? 1 : 2];
+      const double xi = *xs[i], yi = *ys[i];
+      const double xj = *xs[j], yj = *ys[j];
+      const double xl = *xs[l], yl = *ys[l];
+      add_product(e, sign, {xi, xi, xj, yl});
+      add_product(e, -sign, {xi, xi, xl, yj});
+      add_product(e, sign, {yi, yi, xj, yl});
+      add_product(e, -sign, {yi, yi, xl, yj});
+    }
+  }
+  return estimate(e);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Position of a point along the Hilbert curve
+ */
+// ----------------------------------------------------------------------
+
+uint64_t hilbert_index(uint32_t n, uint32_t x, uint32_t y)
+{
+  uint64_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2)
+  {
+    const uint32_t rx = ((x & s) > 0);
+    const uint32_t ry = ((y & s) > 0);
+    d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    if (ry == 0)
+    {
+      if (rx == 1)
+      {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      swap(x, y);
+    }
+  }
+  return d;
+}
+
+//! A triangle with neighbour links and constraint flags per edge
+struct Triangle
+{
+  Index v[3];
+  Index n[3];
+  bool c[3];
+
+  int vertex(Index theVertex) const
+  {
+    return (v[0] == theVertex ? 0 : v[1] == theVertex ? 1 : v[2] == theVertex ? 2 : -1);
+  }
+
+  int neighbour(Index theTriangle) const
+  {
+    return (n[0] == theTriangle ? 0 : n[1] == theTriangle ? 1 : n[2] == theTriangle ? 2 : -1);
+  }
+
+  bool ghost() const { return (v[0] == none || v[1] == none || v[2] == none); }
+};
+
+//! A region seed
+struct Region
+{
+  double x;
+  double y;
+  double attribute;
+};
+
+//! Results of point location
+enum Location
+{
+  kInside,
+  kOnEdge,
+  kOnVertex
+};
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Implementation hiding pimple
+ */
+// ----------------------------------------------------------------------
+
+class Triangulator::Pimple
+{
+ public:
+  vector<double> itsX;
+  vector<double> itsY;
+  vector<pair<Index, Index>> itsConstraints;
+  vector<Region> itsRegions;
+
+  vector<Index> itsCorners;
+  vector<double> itsAttributes;
+
+  void triangulate();
+
+ private:
+  vector<Triangle> itsTriangles;
+  vector<Index> itsAlias;           //!< duplicate points map to the first one
+  vector<Index> itsVertexTriangle;  //!< some triangle containing each vertex
+  Index itsLast;                    //!< starting point for point location
+  uint32_t itsRandom;
+
+  double orient(Index a, Index b, Index c) const
+  {
+    return orient2d(itsX[a], itsY[a], itsX[b], itsY[b], itsX[c], itsY[c]);
+  }
+
+  bool between(Index a, Index b, Index p) const;
+  bool inCircle(const Triangle &theTriangle, Index theVertex) const;
+
+  Index create(Index a, Index b, Index c);
+  void relink(Index theTriangle, Index theOld, Index theNew);
+  void touch(Index theTriangle);
+
+  bool initialize(const vector<Index> &theOrder);
+  Location locate(double theX, double theY, Index &theTriangle, int &theIndex);
+  Location scan(double theX, double theY, Index &theTriangle, int &theIndex) const;
+  Location classify(Index theTriangle, double theX, double theY, int &theIndex) const;
+  Index insert(Index theVertex);
+
+  void split3(Index theTriangle, Index theVertex);
+  void split4(Index theTriangle, int theEdge, Index theVertex);
+  void flip(Index theTriangle, int theEdge);
+  void legalize(vector<pair<Index, int>> &theStack);
+
+  bool findEdge(Index a, Index b, Index &theTriangle, int &theEdge) const;
+  void constrain(Index a, Index b);
+  void unconstrain(Index a, Index b);
+  bool crosses(Index a, Index b, Index u, Index w) const;
+  void insertSegment(Index a, Index b, int theDepth);
+  void removeCrossings(Index a, Index b, const vector<pair<Index, Index>> &theCrossings);
+
+  void fillRegions();
+  void collect();
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether p is strictly between collinear points a and b
+ */
+// ----------------------------------------------------------------------
+
+bool Triangulator::Pimple::between(Index a, Index b, Index p) const
+{
+  const double dx = itsX[b] - itsX[a];
+  const double dy = itsY[b] - itsY[a];
+  const double t1 = (itsX[p] - itsX[a]) * dx + (itsY[p] - itsY[a]) * dy;
+  const double t2 = (itsX[p] - itsX[b]) * dx + (itsY[p] - itsY[b]) * dy;
+  return (t1 > 0 && t2 < 0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the vertex is strictly inside the circumcircle
+ */
+// ----------------------------------------------------------------------
+
+bool Triangulator::Pimple::inCircle(const Triangle &theTriangle, Index theVertex) const
+{
+  if (theVertex == none)
+    return false;
+
+  const int g = theTriangle.vertex(none);
+  if (g >= 0)
+  {
+    const Index a = theTriangle.v[next(g)];
+    const Index b = theTriangle.v[prev(g)];
+    const double o = orient(a, b, theVertex);
+    return (o > 0 || (o == 0 && between(a, b, theVertex)));
+  }
+
+  const Index a = theTriangle.v[0];
+  const Index b = theTriangle.v[1];
+  const Index c = theTriangle.v[2];
+  return incircle(&itsX[a],
+                  &itsY[a],
+                  &itsX[b],
+                  &itsY[b],
+                  &itsX[c],
+                  &itsY[c],
+                  &itsX[theVertex],
+                  &itsY[theVertex]) > 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create a new unlinked triangle
+ */
+// ----------------------------------------------------------------------
+
+Index Triangulator::Pimple::create(Index a, Index b, Index c)
+{
+  Triangle t;
+  t.v[0] = a;
+  t.v[1] = b;
+  t.v[2] = c;
+  t.n[0] = t.n[1] = t.n[2] = none;
+  t.c[0] = t.c[1] = t.c[2] = false;
+  itsTriangles.push_back(t);
+  return itsTriangles.size() - 1;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Replace a neighbour link
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::relink(Index theTriangle, Index theOld, Index theNew)
+{
+  Triangle &t = itsTriangles[theTriangle];
+  const int i = t.neighbour(theOld);
+  if (i < 0)
+    throw runtime_error("Triangulator: corrupted neighbour links");
+  t.n[i] = theNew;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Register the triangle as the star of its vertices
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::touch(Index theTriangle)
+{
+  const Triangle &t = itsTriangles[theTriangle];
+  for (int i = 0; i < 3; i++)
+    if (t.v[i] != none)
+      itsVertexTriangle[t.v[i]] = theTriangle;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the initial triangle and its three ghosts
+ *
+ * \return False if all the points are collinear
+ */
+// ----------------------------------------------------------------------
+
+bool Triangulator::Pimple::initialize(const vector<Index> &theOrder)
+{
+  const Index p0 = theOrder[0];
+  Index p1 = none;
+  Index p2 = none;
+
+  for (Index i = 1; i < theOrder.size() && p2 == none; i++)
+  {
+    const Index p = theOrder[i];
+    if (p1 == none)
+    {
+      if (itsX[p] != itsX[p0] || itsY[p] != itsY[p0])
+        p1 = p;
+    }
+    else if (orient(p0, p1, p) != 0)
+      p2 = p;
+  }
+
+  if (p2 == none)
+    return false;
+
+  if (orient(p0, p1, p2) < 0)
+    swap(p1, p2);
+
+  const Index t0 = create(p0, p1, p2);
+  const Index gbc = create(p2, p1, none);
+  const Index gca = create(p0, p2, none);
+  const Index gab = create(p1, p0, none);
+
+  Triangle *t = &itsTriangles[t0];
+  t->n[0] = gbc;
+  t->n[1] = gca;
+  t->n[2] = gab;
+
+  t = &itsTriangles[gab];
+  t->n[0] = gca;
+  t->n[1] = gbc;
+  t->n[2] = t0;
+
+  t = &itsTriangles[gbc];
+  t->n[0] = gab;
+  t->n[1] = gca;
+  t->n[2] = t0;
+
+  t = &itsTriangles[gca];
+  t->n[0] = gbc;
+  t->n[1] = gab;
+  t->n[2] = t0;
+
+  touch(t0);
+  itsLast = t0;
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Classify the position of a point relative to a triangle
+ *
+ * \return kOnVertex, kOnEdge or kInside, or -1 cast to Location with
+ *         theIndex set to the edge to cross if the point is not in the
+ *         triangle
+ */
+// ----------------------------------------------------------------------
+
+Location Triangulator::Pimple::classify(Index theTriangle,
+                                        double theX,
+                                        double theY,
+                                        int &theIndex) const
+{
+  const Triangle &t = itsTriangles[theTriangle];
+
+  for (int i = 0; i < 3; i++)
+    if (t.v[i] != none && itsX[t.v[i]] == theX && itsY[t.v[i]] == theY)
+    {
+      theIndex = i;
+      return kOnVertex;
+    }
+
+  const int g = t.vertex(none);
+  if (g >= 0)
+  {
+    const Index a = t.v[next(g)];
+    const Index b = t.v[prev(g)];
+    const double o = orient2d(itsX[a], itsY[a], itsX[b], itsY[b], theX, theY);
+    if (o < 0)
+    {
+      theIndex = g;
+      return static_cast<Location>(-1);
+    }
+    if (o > 0)
+      return kInside;
+
+    const double dx = itsX[b] - itsX[a];
+    const double dy = itsY[b] - itsY[a];
+    if ((theX - itsX[a]) * dx + (theY - itsY[a]) * dy < 0)
+    {
+      theIndex = prev(g);
+      return static_cast<Location>(-1);
+    }
+    if ((theX - itsX[b]) * dx + (theY - itsY[b]) * dy > 0)
+    {
+      theIndex = next(g);
+      return static_cast<Location>(-1);
+    }
+    theIndex = g;
+    return kOnEdge;
+  }
+
+  // Random starting edge guarantees termination of the walk
+
+  const int start = (itsRandom >> 16) % 3;
+  int zero = -1;
+  for (int k = 0; k < 3; k++)
+  {
+    const int i = (start + k) % 3;
+    const Index a = t.v[next(i)];
+    const Index b = t.v[prev(i)];
+    const double o = orient2d(itsX[a], itsY[a], itsX[b], itsY[b], theX, theY);
+    if (o < 0)
+    {
+      theIndex = i;
+      return static_cast<Location>(-1);
+    }
+    if (o == 0)
+      zero = i;
+  }
+
+  if (zero >= 0)
+  {
+    theIndex = zero;
+    return kOnEdge;
+  }
+  return kInside;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Locate a point with a stochastic visibility walk
+ *
+ * Walks in constrained triangulations may cycle, the walk falls back
+ * to a full scan if it takes too long.
+ */
+// ----------------------------------------------------------------------
+
+Location Triangulator::Pimple::locate(double theX, double theY, Index &theTriangle, int &theIndex)
+{
+  Index t = itsLast;
+  const size_t max_steps = 2 * itsTriangles.size() + 100;
+
+  for (size_t step = 0; step < max_steps; step++)
+  {
+    itsRandom = itsRandom * 1103515245 + 12345;
+    const int result = classify(t, theX, theY, theIndex);
+    if (result >= 0)
+    {
+      theTriangle = t;
+      return static_cast<Location>(result);
+    }
+    t = itsTriangles[t].n[theIndex];
+  }
+
+  return scan(theX, theY, theTriangle, theIndex);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Locate a point by testing all triangles
+ */
+// ----------------------------------------------------------------------
+
+Location Triangulator::Pimple::scan(double theX,
+                                    double theY,
+                                    Index &theTriangle,
+                                    int &theIndex) const
+{
+  for (Index t = 0; t < itsTriangles.size(); t++)
+  {
+    const int result = classify(t, theX, theY, theIndex);
+    if (result >= 0)
+    {
+      theTriangle = t;
+      return static_cast<Location>(result);
+    }
+  }
+  throw runtime_error("Triangulator: failed to locate a point");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Insert a new vertex
+ *
+ * \return The vertex itself, or the earlier vertex at the same location
+ */
+// ----------------------------------------------------------------------
+
+Index Triangulator::Pimple::insert(Index theVertex)
+{
+  Index t;
+  int i;
+  const Location loc = locate(itsX[theVertex], itsY[theVertex], t, i);
+
+  if (loc == kOnVertex)
+    return itsTriangles[t].v[i];
+
+  if (loc == kOnEdge)
+    split4(t, i, theVertex);
+  else
+    split3(t, theVertex);
+
+  return theVertex;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Split a triangle into three at the given interior vertex
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::split3(Index theTriangle, Index theVertex)
+{
+  const Triangle old = itsTriangles[theTriangle];
+  const Index a = old.v[0];
+  const Index b = old.v[1];
+  const Index c = old.v[2];
+  const Index p = theVertex;
+
+  const Index t = theTriangle;
+  const Index t1 = create(b, c, p);
+  const Index t2 = create(c, a, p);
+
+  Triangle &T = itsTriangles[t];
+  T.v[2] = p;
+  T.n[0] = t1;
+  T.n[1] = t2;
+  T.c[0] = T.c[1] = false;
+
+  Triangle &T1 = itsTriangles[t1];
+  T1.n[0] = t2;
+  T1.n[1] = t;
+  T1.n[2] = old.n[0];
+  T1.c[2] = old.c[0];
+
+  Triangle &T2 = itsTriangles[t2];
+  T2.n[0] = t;
+  T2.n[1] = t1;
+  T2.n[2] = old.n[1];
+  T2.c[2] = old.c[1];
+
+  relink(old.n[0], t, t1);
+  relink(old.n[1], t, t2);
+
+  touch(t);
+  touch(t1);
+  touch(t2);
+  itsLast = t;
+
+  vector<pair<Index, int>> stack;
+  stack.push_back(make_pair(t, 2));
+  stack.push_back(make_pair(t1, 2));
+  stack.push_back(make_pair(t2, 2));
+  legalize(stack);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Split the edge of a triangle and its neighbour at a vertex
+ *
+ * A constrained edge remains constrained in both halves.
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::split4(Index theTriangle, int theEdge, Index theVertex)
+{
+  const Index t = theTriangle;
+  const Triangle oldt = itsTriangles[t];
+  const Index s = oldt.n[theEdge];
+  const Triangle olds = itsTriangles[s];
+  const int j = olds.neighbour(t);
+
+  const int i = theEdge;
+  const Index c = oldt.v[i];
+  const Index a = oldt.v[next(i)];
+  const Index b = oldt.v[prev(i)];
+  const Index d = olds.v[j];
+  const Index p = theVertex;
+  const bool e = oldt.c[i];
+
+  const Index na = oldt.n[next(i)];  // edge b-c
+  const Index nb = oldt.n[prev(i)];  // edge c-a
+  const bool ca = oldt.c[next(i)];
+  const bool cb = oldt.c[prev(i)];
+
+  const Index sb = olds.n[next(j)];  // edge a-d
+  const Index sa = olds.n[prev(j)];  // edge d-b
+  const bool csb = olds.c[next(j)];
+  const bool csa = olds.c[prev(j)];
+
+  const Index t1 = create(c, p, b);
+  const Index s1 = create(d, p, a);
+
+  Triangle &T = itsTriangles[t];
+  T.v[0] = c;
+  T.v[1] = a;
+  T.v[2] = p;
+  T.n[0] = s1;
+  T.n[1] = t1;
+  T.n[2] = nb;
+  T.c[0] = e;
+  T.c[1] = false;
+  T.c[2] = cb;
+
+  Triangle &T1 = itsTriangles[t1];
+  T1.n[0] = s;
+  T1.n[1] = na;
+  T1.n[2] = t;
+  T1.c[0] = e;
+  T1.c[1] = ca;
+
+  Triangle &S = itsTriangles[s];
+  S.v[0] = d;
+  S.v[1] = b;
+  S.v[2] = p;
+  S.n[0] = t1;
+  S.n[1] = s1;
+  S.n[2] = sa;
+  S.c[0] = e;
+  S.c[1] = false;
+  S.c[2] = csa;
+
+  Triangle &S1 = itsTriangles[s1];
+  S1.n[0] = t;
+  S1.n[1] = sb;
+  S1.n[2] = s;
+  S1.c[0] = e;
+  S1.c[1] = csb;
+
+  relink(na, t, t1);
+  relink(sb, s, s1);
+
+  touch(t1);
+  touch(s1);
+  touch(s);
+  touch(t);
+  itsLast = t;
+
+  vector<pair<Index, int>> stack;
+  stack.push_back(make_pair(t, 2));
+  stack.push_back(make_pair(t1, 1));
+  stack.push_back(make_pair(s, 2));
+  stack.push_back(make_pair(s1, 1));
+  legalize(stack);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Flip the given edge of a triangle
+ *
+ * After the flip the triangle is (u,p,w) and the neighbour (w,q,u),
+ * where u was the vertex opposite to the edge p-q and w the vertex
+ * of the neighbour opposite to the same edge.
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::flip(Index theTriangle, int theEdge)
+{
+  const Index t = theTriangle;
+  const Triangle T = itsTriangles[t];
+  const int i = theEdge;
+  const Index s = T.n[i];
+  const Triangle S = itsTriangles[s];
+  const int j = S.neighbour(t);
+
+  const Index u = T.v[i];
+  const Index p = T.v[next(i)];
+  const Index q = T.v[prev(i)];
+  const Index w = S.v[j];
+
+  Triangle &newT = itsTriangles[t];
+  newT.v[0] = u;
+  newT.v[1] = p;
+  newT.v[2] = w;
+  newT.n[0] = S.n[next(j)];
+  newT.n[1] = s;
+  newT.n[2] = T.n[prev(i)];
+  newT.c[0] = S.c[next(j)];
+  newT.c[1] = false;
+  newT.c[2] = T.c[prev(i)];
+
+  Triangle &newS = itsTriangles[s];
+  newS.v[0] = w;
+  newS.v[1] = q;
+  newS.v[2] = u;
+  newS.n[0] = T.n[next(i)];
+  newS.n[1] = t;
+  newS.n[2] = S.n[prev(j)];
+  newS.c[0] = T.c[next(i)];
+  newS.c[1] = false;
+  newS.c[2] = S.c[prev(j)];
+
+  relink(newT.n[0], s, t);
+  relink(newS.n[0], t, s);
+
+  touch(t);
+  touch(s);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Restore the Delaunay property after an insertion
+ *
+ * The stack contains the edges opposite to the new vertex,
+ * which is vertex 0 after each flip.
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::legalize(vector<pair<Index, int>> &theStack)
+{
+  while (!theStack.empty())
+  {
+    const Index t = theStack.back().first;
+    const int i = theStack.back().second;
+    theStack.pop_back();
+
+    const Triangle &T = itsTriangles[t];
+    if (T.c[i])
+      continue;
+
+    const Index s = T.n[i];
+    const Triangle &S = itsTriangles[s];
+    const Index w = S.v[S.neighbour(t)];
+
+    if (inCircle(T, w))
+    {
+      flip(t, i);
+      theStack.push_back(make_pair(t, 0));
+      theStack.push_back(make_pair(s, 2));
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a triangle containing the edge a-b
+ */
+// ----------------------------------------------------------------------
+
+bool Triangulator::Pimple::findEdge(Index a, Index b, Index &theTriangle, int &theEdge) const
+{
+  const Index start = itsVertexTriangle[a];
+  Index t = start;
+  do
+  {
+    const Triangle &T = itsTriangles[t];
+    const int k = T.vertex(a);
+    if (T.v[next(k)] == b)
+    {
+      theTriangle = t;
+      theEdge = prev(k);
+      return true;
+    }
+    if (T.v[prev(k)] == b)
+    {
+      theTriangle = t;
+      theEdge = next(k);
+      return true;
+    }
+    t = T.n[next(k)];
+  } while (t != start);
+
+  return false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mark an existing edge constrained
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::constrain(Index a, Index b)
+{
+  Index t;
+  int i;
+  if (!findEdge(a, b, t, i))
+    throw runtime_error("Triangulator: failed to insert a constraint");
+
+  Triangle &T = itsTriangles[t];
+  T.c[i] = true;
+  Triangle &S = itsTriangles[T.n[i]];
+  S.c[S.neighbour(t)] = true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Mark an existing edge unconstrained
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::unconstrain(Index a, Index b)
+{
+  Index t;
+  int i;
+  if (!findEdge(a, b, t, i))
+    throw runtime_error("Triangulator: corrupted triangulation");
+
+  Triangle &T = itsTriangles[t];
+  T.c[i] = false;
+  Triangle &S = itsTriangles[T.n[i]];
+  S.c[S.neighbour(t)] = false;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether segments a-b and u-w intersect in their interiors
+ */
+// ----------------------------------------------------------------------
+
+bool Triangulator::Pimple::crosses(Index a, Index b, Index u, Index w) const
+{
+  if (u == a || u == b || w == a || w == b)
+    return false;
+  const double o1 = orient(a, b, u);
+  const double o2 = orient(a, b, w);
+  if (!((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)))
+    return false;
+  const double o3 = orient(u, w, a);
+  const double o4 = orient(u, w, b);
+  return ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Insert a constraint segment
+ *
+ * The segment is split at any vertices lying on it, and at any
+ * constrained edges crossing it.
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::insertSegment(Index a, Index b, int theDepth)
+{
+  if (theDepth > max_split_depth)
+    throw runtime_error("Triangulator: too many intersecting constraints");
+
+  while (a != b)
+  {
+    // Find the triangle around a through which the segment leaves a
+
+    Index t = itsVertexTriangle[a];
+    const Index start = t;
+    int k = -1;
+    Index stop = none;
+    do
+    {
+      const Triangle &T = itsTriangles[t];
+      k = T.vertex(a);
+      const Index v1 = T.v[next(k)];
+      const Index v2 = T.v[prev(k)];
+      if (v1 == b || v2 == b)
+      {
+        stop = b;
+        break;
+      }
+      if (v1 != none && v2 != none)
+      {
+        const double o1 = orient(a, v1, b);
+        const double o2 = orient(a, v2, b);
+        if (o1 == 0 && between(a, b, v1))
+        {
+          stop = v1;
+          break;
+        }
+        if (o2 == 0 && between(a, b, v2))
+        {
+          stop = v2;
+          break;
+        }
+        if (o1 > 0 && o2 < 0)
+          break;
+      }
+      t = T.n[next(k)];
+      k = -1;
+    } while (t != start);
+
+    if (stop != none)
+    {
+      constrain(a, stop);
+      a = stop;
+      continue;
+    }
+    if (k < 0)
+      throw runtime_error("Triangulator: constraint endpoint is not in the triangulation");
+
+    // Walk along the segment collecting the crossed edges
+
+    vector<pair<Index, Index>> crossings;
+    Index cur = t;
+    int ci = k;
+    bool split = false;
+
+    while (true)
+    {
+      const Triangle &T = itsTriangles[cur];
+      const Index left = T.v[prev(ci)];
+      const Index right = T.v[next(ci)];
+
+      if (T.c[ci])
+      {
+        // Split the crossing constraint at the intersection point
+
+        const double dx = itsX[b] - itsX[a];
+        const double dy = itsY[b] - itsY[a];
+        const double ex = itsX[right] - itsX[left];
+        const double ey = itsY[right] - itsY[left];
+        const double denom = dx * ey - dy * ex;
+        const double r = ((itsX[left] - itsX[a]) * ey - (itsY[left] - itsY[a]) * ex) / denom;
+        const double x = itsX[a] + r * dx;
+        const double y = itsY[a] + r * dy;
+
+        // The rounded intersection point is usually not exactly on
+        // either segment. It is hence inserted as an ordinary vertex,
+        // and both halves of the crossed constraint are inserted anew.
+        // Points practically at an endpoint are snapped to it, since
+        // nearly parallel segments would otherwise keep producing new
+        // intersections a rounding error apart.
+
+        unconstrain(left, right);
+
+        const double tolerance = snap_tolerance * (fabs(dx) + fabs(dy) + fabs(ex) + fabs(ey));
+
+        Index p = none;
+        for (Index v : {a, b, left, right})
+          if (fabs(x - itsX[v]) <= tolerance && fabs(y - itsY[v]) <= tolerance)
+          {
+            p = v;
+            break;
+          }
+
+        if (p == none)
+        {
+          p = itsX.size();
+          itsX.push_back(x);
+          itsY.push_back(y);
+          itsAlias.push_back(p);
+          itsVertexTriangle.push_back(none);
+          p = insert(p);
+          itsAlias.back() = p;
+        }
+
+        insertSegment(left, p, theDepth + 1);
+        insertSegment(p, right, theDepth + 1);
+        insertSegment(a, p, theDepth + 1);
+        a = p;
+        split = true;
+        break;
+      }
+
+      crossings.push_back(make_pair(left, right));
+
+      const Index s = T.n[ci];
+      const Triangle &S = itsTriangles[s];
+      const int j = S.neighbour(cur);
+      const Index w = S.v[j];
+
+      if (w == none)
+        throw runtime_error("Triangulator: constraint walked out of the triangulation");
+
+      if (w == b)
+      {
+        stop = b;
+        break;
+      }
+
+      const double o = orient(a, b, w);
+      if (o == 0)
+      {
+        stop = w;
+        break;
+      }
+
+      cur = s;
+      ci = (o > 0 ? next(j) : prev(j));
+    }
+
+    if (split)
+      continue;
+
+    removeCrossings(a, stop, crossings);
+    constrain(a, stop);
+    a = stop;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Flip away the edges crossing a-b and restore the Delaunay property
+ *
+ * See S.W. Sloan: A fast algorithm for generating constrained Delaunay
+ * triangulations, Computers & Structures 47 (1993). As long as edges
+ * cross the segment, at least one of them is the diagonal of a convex
+ * quadrilateral, hence a full pass over the queue without a flip
+ * means the triangulation is corrupted.
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::removeCrossings(Index a,
+                                           Index b,
+                                           const vector<pair<Index, Index>> &theCrossings)
+{
+  deque<pair<Index, Index>> queue(theCrossings.begin(), theCrossings.end());
+  vector<pair<Index, Index>> newedges;
+
+  // Number of edges requeued since the last flip
+  size_t stalled = 0;
+
+  while (!queue.empty())
+  {
+    if (stalled > queue.size())
+      throw runtime_error("Triangulator: no flippable edge crosses a constraint");
+
+    const pair<Index, Index> edge = queue.front();
+    queue.pop_front();
+
+    Index t;
+    int i;
+    if (!findEdge(edge.first, edge.second, t, i))
+      throw runtime_error("Triangulator: corrupted triangulation");
+
+    const Triangle &T = itsTriangles[t];
+    const Index u = T.v[i];
+    const Index p = T.v[next(i)];
+    const Index q = T.v[prev(i)];
+    const Triangle &S = itsTriangles[T.n[i]];
+    const Index w = S.v[S.neighbour(t)];
+
+    if (!(orient(u, p, w) > 0 && orient(w, q, u) > 0))
+    {
+      queue.push_back(edge);
+      ++stalled;
+      continue;
+    }
+
+    flip(t, i);
+    stalled = 0;
+
+    if (crosses(a, b, u, w))
+      queue.push_back(make_pair(u, w));
+    else
+      newedges.push_back(make_pair(u, w));
+  }
+
+  bool swapped = true;
+  while (swapped)
+  {
+    swapped = false;
+    for (pair<Index, Index> &edge : newedges)
+    {
+      if ((edge.first == a && edge.second == b) || (edge.first == b && edge.second == a))
+        continue;
+
+      Index t;
+      int i;
+      if (!findEdge(edge.first, edge.second, t, i))
+        throw runtime_error("Triangulator: corrupted triangulation");
+
+      const Triangle &T = itsTriangles[t];
+      if (T.c[i])
+        continue;
+
+      const Triangle &S = itsTriangles[T.n[i]];
+      const Index w = S.v[S.neighbour(t)];
+      if (inCircle(T, w))
+      {
+        const Index u = T.v[i];
+        flip(t, i);
+        edge = make_pair(u, w);
+        swapped = true;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Flood fill the regional attributes
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::fillRegions()
+{
+  const size_t n = itsTriangles.size();
+  itsAttributes.assign(n, 0);
+
+  vector<size_t> stamp(n, 0);
+  vector<Index> stack;
+
+  for (size_t r = 0; r < itsRegions.size(); r++)
+  {
+    const Region &region = itsRegions[r];
+
+    Index t;
+    int i;
+    const Location loc = locate(region.x, region.y, t, i);
+
+    // A seed on an edge or vertex belongs to either side, outside seeds are ignored
+    if (loc == kOnVertex || itsTriangles[t].ghost())
+      continue;
+
+    stack.push_back(t);
+    stamp[t] = r + 1;
+    while (!stack.empty())
+    {
+      const Index cur = stack.back();
+      stack.pop_back();
+      itsAttributes[cur] = region.attribute;
+
+      const Triangle &T = itsTriangles[cur];
+      for (int k = 0; k < 3; k++)
+      {
+        const Index s = T.n[k];
+        if (T.c[k] || stamp[s] == r + 1 || itsTriangles[s].ghost())
+          continue;
+        stamp[s] = r + 1;
+        stack.push_back(s);
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect the final triangles
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::collect()
+{
+  vector<double> attributes;
+  itsCorners.clear();
+  for (Index t = 0; t < itsTriangles.size(); t++)
+  {
+    const Triangle &T = itsTriangles[t];
+    if (T.ghost())
+      continue;
+    itsCorners.insert(itsCorners.end(), T.v, T.v + 3);
+    attributes.push_back(itsAttributes[t]);
+  }
+  itsAttributes.swap(attributes);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Perform the triangulation
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::Pimple::triangulate()
+{
+  itsTriangles.clear();
+  itsCorners.clear();
+  itsAttributes.clear();
+  itsLast = 0;
+  itsRandom = 1;
+
+  const size_t n = itsX.size();
+  itsAlias.resize(n);
+  itsVertexTriangle.assign(n, none);
+  for (size_t i = 0; i < n; i++)
+    itsAlias[i] = i;
+
+  if (n < 3)
+    return;
+
+  // Sort the points along the Hilbert curve for fast point location
+
+  double xmin = itsX[0], xmax = itsX[0], ymin = itsY[0], ymax = itsY[0];
+  for (size_t i = 1; i < n; i++)
+  {
+    xmin = min(xmin, itsX[i]);
+    xmax = max(xmax, itsX[i]);
+    ymin = min(ymin, itsY[i]);
+    ymax = max(ymax, itsY[i]);
+  }
+
+  const uint32_t side = 65536;
+  const double xscale = (xmax > xmin ? (side - 1) / (xmax - xmin) : 0);
+  const double yscale = (ymax > ymin ? (side - 1) / (ymax - ymin) : 0);
+
+  vector<pair<uint64_t, Index>> keys(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    const uint32_t hx = static_cast<uint32_t>((itsX[i] - xmin) * xscale);
+    const uint32_t hy = static_cast<uint32_t>((itsY[i] - ymin) * yscale);
+    keys[i] = make_pair(hilbert_index(side, hx, hy), i);
+  }
+  sort(keys.begin(), keys.end());
+
+  vector<Index> order(n);
+  for (size_t i = 0; i < n; i++)
+    order[i] = keys[i].second;
+
+  // Insert the points
+
+  if (!initialize(order))
+    return;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const Index p = order[i];
+    if (itsVertexTriangle[p] == none)
+      itsAlias[p] = insert(p);
+  }
+
+  // Insert the constraints
+
+  for (const pair<Index, Index> &constraint : itsConstraints)
+  {
+    const Index a = itsAlias[constraint.first];
+    const Index b = itsAlias[constraint.second];
+    if (a != b)
+      insertSegment(a, b, 0);
+  }
+
+  fillRegions();
+  collect();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Destructor
+ */
+// ----------------------------------------------------------------------
+
+Triangulator::~Triangulator() {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Constructor
+ */
+// ----------------------------------------------------------------------
+
+Triangulator::Triangulator() : itsPimple(new Pimple()) {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new point
+ *
+ * \return The ordinal of the point, starting from 0
+ */
+// ----------------------------------------------------------------------
+
+Triangulator::size_type Triangulator::addPoint(double theX, double theY)
+{
+  itsPimple->itsX.push_back(theX);
+  itsPimple->itsY.push_back(theY);
+  return itsPimple->itsX.size() - 1;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new constraint edge between two points
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::addConstraint(size_type theFirst, size_type theSecond)
+{
+  if (theFirst >= itsPimple->itsX.size() || theSecond >= itsPimple->itsX.size())
+    throw runtime_error("Triangulator: constraint refers to a nonexistent point");
+  itsPimple->itsConstraints.push_back(make_pair(theFirst, theSecond));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a new region seed
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::addRegion(double theX, double theY, double theAttribute)
+{
+  Region region;
+  region.x = theX;
+  region.y = theY;
+  region.attribute = theAttribute;
+  itsPimple->itsRegions.push_back(region);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Triangulate the points added so far
+ */
+// ----------------------------------------------------------------------
+
+void Triangulator::triangulate() { itsPimple->triangulate(); }
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The number of points, including constraint intersections
+ */
+// ----------------------------------------------------------------------
+
+Triangulator::size_type Triangulator::points() const { return itsPimple->itsX.size(); }
+
+double Triangulator::x(size_type thePoint) const { return itsPimple->itsX[thePoint]; }
+double Triangulator::y(size_type thePoint) const { return itsPimple->itsY[thePoint]; }
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The number of triangles
+ */
+// ----------------------------------------------------------------------
+
+Triangulator::size_type Triangulator::size() const { return itsPimple->itsAttributes.size(); }
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The point number of a triangle corner
+ */
+// ----------------------------------------------------------------------
+
+Triangulator::size_type Triangulator::corner(size_type theTriangle, int theCorner) const
+{
+  return itsPimple->itsCorners[3 * theTriangle + theCorner];
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The regional attribute of a triangle
+ */
+// ----------------------------------------------------------------------
+
+double Triangulator::attribute(size_type theTriangle) const
+{
+  return itsPimple->itsAttributes[theTriangle];
+}
+
+// ======================================================================
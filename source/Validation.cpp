@@ -0,0 +1,443 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Implementation of namespace Validation
+ */
+// ======================================================================
+
+#include "Validation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+//! A segment of a ring
+struct Segment
+{
+  size_t group;
+  size_t ring;
+  size_t vertex;
+  Point p1;
+  Point p2;
+  double xmin;
+  double ymin;
+  double xmax;
+  double ymax;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The orientation of a point with respect to a line
+ *
+ * Positive if the point is to the left, negative if to the right
+ * and zero if on the line.
+ */
+// ----------------------------------------------------------------------
+
+double orient(const Point &theA, const Point &theB, const Point &theC)
+{
+  return (theB.x() - theA.x()) * (theC.y() - theA.y()) -
+         (theB.y() - theA.y()) * (theC.x() - theA.x());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether a point on the line of a segment is strictly inside it
+ */
+// ----------------------------------------------------------------------
+
+bool strictly_inside(const Segment &theSegment, const Point &thePoint)
+{
+  return (thePoint != theSegment.p1 && thePoint != theSegment.p2 &&
+          thePoint.x() >= theSegment.xmin && thePoint.x() <= theSegment.xmax &&
+          thePoint.y() >= theSegment.ymin && thePoint.y() <= theSegment.ymax);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a problem involving two segments
+ */
+// ----------------------------------------------------------------------
+
+Validation::Problem make_problem(Validation::ProblemType theType,
+                                 const Segment &theFirst,
+                                 const Segment &theSecond,
+                                 const Point &theWhere)
+{
+  Validation::Problem problem;
+  problem.type = theType;
+  problem.ring = theFirst.ring;
+  problem.vertex = theFirst.vertex;
+  problem.otherRing = theSecond.ring;
+  problem.otherVertex = theSecond.vertex;
+  problem.where = theWhere;
+  return problem;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test a pair of segments for intersections
+ *
+ * The segments are ordered by their rings and vertices so that the
+ * report does not depend on the order the sweep met them.
+ */
+// ----------------------------------------------------------------------
+
+void test_pair(const Segment &theA, const Segment &theB, vector<Validation::Problem> &theProblems)
+{
+  const bool swapped =
+      (theB.ring < theA.ring || (theB.ring == theA.ring && theB.vertex < theA.vertex));
+  const Segment &a = (swapped ? theB : theA);
+  const Segment &b = (swapped ? theA : theB);
+
+  const double d1 = orient(a.p1, a.p2, b.p1);
+  const double d2 = orient(a.p1, a.p2, b.p2);
+  const double d3 = orient(b.p1, b.p2, a.p1);
+  const double d4 = orient(b.p1, b.p2, a.p2);
+
+  // Proper crossing
+
+  if (((d1 < 0 && d2 > 0) || (d1 > 0 && d2 < 0)) && ((d3 < 0 && d4 > 0) || (d3 > 0 && d4 < 0)))
+  {
+    const double t = d3 / (d3 - d4);
+    const Point where(a.p1.x() + t * (a.p2.x() - a.p1.x()), a.p1.y() + t * (a.p2.y() - a.p1.y()));
+    theProblems.push_back(make_problem(Validation::kCrossing, a, b, where));
+    return;
+  }
+
+  // Collinear segments overlap if their projections to the
+  // dominant axis overlap with a positive length
+
+  if (d1 == 0 && d2 == 0)
+  {
+    const bool usex = (a.xmax - a.xmin >= a.ymax - a.ymin);
+    const double alo = (usex ? a.xmin : a.ymin);
+    const double ahi = (usex ? a.xmax : a.ymax);
+    const double blo = (usex ? b.xmin : b.ymin);
+    const double bhi = (usex ? b.xmax : b.ymax);
+    if (min(ahi, bhi) > max(alo, blo))
+    {
+      const Point &bstart = ((usex ? b.p1.x() : b.p1.y()) == blo ? b.p1 : b.p2);
+      const Point &astart = ((usex ? a.p1.x() : a.p1.y()) == alo ? a.p1 : a.p2);
+      theProblems.push_back(make_problem(Validation::kOverlap, a, b, blo >= alo ? bstart : astart));
+    }
+    return;
+  }
+
+  // A vertex inside the other segment
+
+  if (d1 == 0 && strictly_inside(a, b.p1))
+    theProblems.push_back(make_problem(Validation::kTouching, a, b, b.p1));
+  else if (d2 == 0 && strictly_inside(a, b.p2))
+    theProblems.push_back(make_problem(Validation::kTouching, a, b, b.p2));
+  else if (d3 == 0 && strictly_inside(b, a.p1))
+    theProblems.push_back(make_problem(Validation::kTouching, a, b, a.p1));
+  else if (d4 == 0 && strictly_inside(b, a.p2))
+    theProblems.push_back(make_problem(Validation::kTouching, a, b, a.p2));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check the vertices of a single ring and collect its segments
+ */
+// ----------------------------------------------------------------------
+
+void check_ring(size_t theRing,
+                size_t theGroup,
+                const Polygon &thePolygon,
+                vector<Segment> &theSegments,
+                vector<Validation::Problem> &theProblems)
+{
+  const Polygon::DataType &pts = thePolygon.data();
+  const size_t n = pts.size();
+
+  Validation::Problem problem;
+  problem.ring = problem.otherRing = theRing;
+
+  // Duplicate consecutive vertices
+
+  size_t distinct = 0;
+  for (size_t k = 0; k < n; k++)
+  {
+    if (k > 0 && pts[k] == pts[k - 1])
+    {
+      problem.type = Validation::kDuplicateVertex;
+      problem.vertex = problem.otherVertex = k;
+      problem.where = pts[k];
+      theProblems.push_back(problem);
+    }
+    else if (k < n - 1 || pts[k] != pts[0])
+      ++distinct;
+  }
+
+  const bool closed = (n > 0 && pts[0] == pts[n - 1]);
+  if (n > 0 && !closed)
+  {
+    problem.type = Validation::kNotClosed;
+    problem.vertex = problem.otherVertex = n - 1;
+    problem.where = pts[n - 1];
+    theProblems.push_back(problem);
+  }
+
+  if (distinct < 3)
+  {
+    problem.type = Validation::kTooFewPoints;
+    problem.vertex = problem.otherVertex = 0;
+    problem.where = (n > 0 ? pts[0] : Point(0, 0));
+    theProblems.push_back(problem);
+    return;
+  }
+
+  // The segments, an unclosed ring is treated as if it was closed
+
+  for (size_t k = 0; k < n; k++)
+  {
+    if (k == n - 1 && closed)
+      break;
+    const Point &p1 = pts[k];
+    const Point &p2 = pts[k == n - 1 ? 0 : k + 1];
+    if (p1 == p2)
+      continue;
+
+    Segment s;
+    s.group = theGroup;
+    s.ring = theRing;
+    s.vertex = k;
+    s.p1 = p1;
+    s.p2 = p2;
+    s.xmin = min(p1.x(), p2.x());
+    s.xmax = max(p1.x(), p2.x());
+    s.ymin = min(p1.y(), p2.y());
+    s.ymax = max(p1.y(), p2.y());
+    theSegments.push_back(s);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Order problems by ring, vertex and type
+ */
+// ----------------------------------------------------------------------
+
+bool problem_less(const Validation::Problem &theA, const Validation::Problem &theB)
+{
+  if (theA.ring != theB.ring)
+    return theA.ring < theB.ring;
+  if (theA.vertex != theB.vertex)
+    return theA.vertex < theB.vertex;
+  if (theA.type != theB.type)
+    return theA.type < theB.type;
+  if (theA.otherRing != theB.otherRing)
+    return theA.otherRing < theB.otherRing;
+  return theA.otherVertex < theB.otherVertex;
+}
+
+}  // namespace
+
+namespace Validation
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief A human readable description of a problem type
+ */
+// ----------------------------------------------------------------------
+
+string describe(ProblemType theType)
+{
+  switch (theType)
+  {
+    case kTooFewPoints:
+      return "too few points";
+    case kNotClosed:
+      return "ring not closed";
+    case kDuplicateVertex:
+      return "duplicate vertex";
+    case kCrossing:
+      return "segments cross";
+    case kTouching:
+      return "vertex touches a segment";
+    case kOverlap:
+      return "segments overlap";
+  }
+  return "unknown problem";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The orientation of a ring
+ *
+ * Returns 1 for counter-clockwise rings, -1 for clockwise rings
+ * and 0 for rings with zero area. Note that the outer rings of
+ * shapefile polygons should be clockwise.
+ */
+// ----------------------------------------------------------------------
+
+int orientation(const Polygon &theRing)
+{
+  const Polygon::DataType &pts = theRing.data();
+  const size_t n = pts.size();
+  double sum = 0;
+  for (size_t k = 0; k < n; k++)
+  {
+    const Point &p1 = pts[k];
+    const Point &p2 = pts[k == n - 1 ? 0 : k + 1];
+    sum += p1.x() * p2.y() - p2.x() * p1.y();
+  }
+  return (sum > 0 ? 1 : (sum < 0 ? -1 : 0));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find all problems in the given rings
+ *
+ * Every ring is tested against every other ring. The problems are
+ * sorted by ring and vertex.
+ */
+// ----------------------------------------------------------------------
+
+vector<Problem> validate(const vector<Polygon> &theRings)
+{
+  return validate(theRings, vector<size_t>(theRings.size(), 0));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find all problems in the given groups of rings
+ *
+ * Segments are tested against each other only when their rings belong
+ * to the same group. Neighbouring polygons of a tessellation share
+ * their borders, hence placing the rings of each polygon into a group
+ * of their own checks the polygons without reporting the common
+ * borders. The problems are sorted by ring and vertex.
+ *
+ * \param theRings The rings
+ * \param theGroups The group of each ring
+ */
+// ----------------------------------------------------------------------
+
+vector<Problem> validate(const vector<Polygon> &theRings, const vector<size_t> &theGroups)
+{
+  if (theGroups.size() != theRings.size())
+    throw runtime_error("Validation: the number of ring groups does not match the rings");
+
+  vector<Problem> problems;
+  vector<Segment> segments;
+
+  for (size_t i = 0; i < theRings.size(); i++)
+    check_ring(i, theGroups[i], theRings[i], segments, problems);
+
+  const size_t n = segments.size();
+  if (n > 0)
+  {
+    // The rows of active segments
+
+    double ymin = segments[0].ymin;
+    double ymax = segments[0].ymax;
+    for (const Segment &s : segments)
+    {
+      ymin = min(ymin, s.ymin);
+      ymax = max(ymax, s.ymax);
+    }
+
+    const size_t nrows = max(static_cast<size_t>(1), static_cast<size_t>(sqrt(double(n))));
+    const double rowheight = (ymax > ymin ? (ymax - ymin) / nrows : 1);
+    const auto row = [ymin, rowheight, nrows](double y)
+    {
+      const double pos = floor((y - ymin) / rowheight);
+      return (pos <= 0 ? 0 : min(nrows - 1, static_cast<size_t>(pos)));
+    };
+
+    vector<vector<size_t> > active(nrows);
+
+    // The sweep
+
+    vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+      order[i] = i;
+    sort(order.begin(),
+         order.end(),
+         [&segments](size_t a, size_t b) { return segments[a].xmin < segments[b].xmin; });
+
+    for (size_t i : order)
+    {
+      const Segment &s = segments[i];
+      const size_t r1 = row(s.ymin);
+      const size_t r2 = row(s.ymax);
+
+      for (size_t r = r1; r <= r2; r++)
+      {
+        vector<size_t> &segs = active[r];
+        for (size_t k = 0; k < segs.size();)
+        {
+          const Segment &t = segments[segs[k]];
+
+          // Segments left behind by the sweep are removed
+
+          if (t.xmax < s.xmin)
+          {
+            segs[k] = segs.back();
+            segs.pop_back();
+            continue;
+          }
+
+          // Pairs spanning several rows are tested only in the row
+          // where their y-ranges start to overlap
+
+          if (t.group == s.group && t.ymin <= s.ymax && t.ymax >= s.ymin &&
+              row(max(s.ymin, t.ymin)) == r)
+            test_pair(s, t, problems);
+          ++k;
+        }
+        segs.push_back(i);
+      }
+    }
+  }
+
+  sort(problems.begin(), problems.end(), problem_less);
+  return problems;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Repair the trivial problems of a ring
+ *
+ * Duplicate consecutive vertices are removed and the ring is closed.
+ * An empty ring is returned if the ring has less than 3 distinct
+ * points.
+ */
+// ----------------------------------------------------------------------
+
+Polygon repair(const Polygon &theRing)
+{
+  Polygon ring;
+  const Polygon::DataType &pts = theRing.data();
+
+  size_t count = 0;
+  for (size_t k = 0; k < pts.size(); k++)
+  {
+    if (count == 0 || pts[k] != ring.data()[count - 1])
+    {
+      ring.add(pts[k]);
+      ++count;
+    }
+  }
+
+  if (count > 1 && ring.data()[0] == ring.data()[count - 1])
+    --count;
+
+  if (count < 3)
+    return Polygon();
+
+  if (ring.data()[0] != ring.data().back())
+    ring.add(ring.data()[0]);
+
+  return ring;
+}
+
+}  // namespace Validation
+
+// ======================================================================
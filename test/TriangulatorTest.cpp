@@ -0,0 +1,248 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for class Triangulator
+ */
+// ======================================================================
+
+#include "Triangulator.h"
+
+#include <regression/tframe.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace TriangulatorTest
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Points and constraints of a test case
+ */
+// ----------------------------------------------------------------------
+
+struct Input
+{
+  vector<double> x;
+  vector<double> y;
+  vector<pair<int, int>> constraints;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Uniformly distributed random points
+ */
+// ----------------------------------------------------------------------
+
+Input random_input(unsigned int theSeed, int thePoints, int theConstraints)
+{
+  Input input;
+  mt19937 gen(theSeed);
+  uniform_real_distribution<double> coord(0, 1000);
+  for (int i = 0; i < thePoints; i++)
+  {
+    input.x.push_back(coord(gen));
+    input.y.push_back(coord(gen));
+  }
+
+  uniform_int_distribution<int> point(0, thePoints - 1);
+  for (int i = 0; i < theConstraints; i++)
+  {
+    const int a = point(gen);
+    const int b = point(gen);
+    if (a != b)
+      input.constraints.push_back(make_pair(a, b));
+  }
+  return input;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Distinct points on a regular integer grid
+ *
+ * Grid points are collinear and cocircular in many ways, and the
+ * constraints frequently pass through other points.
+ */
+// ----------------------------------------------------------------------
+
+Input grid_input(unsigned int theSeed, int theSize, int thePoints, int theConstraints)
+{
+  vector<pair<int, int>> cells;
+  for (int i = 0; i < theSize; i++)
+    for (int j = 0; j < theSize; j++)
+      cells.push_back(make_pair(i, j));
+
+  mt19937 gen(theSeed);
+  shuffle(cells.begin(), cells.end(), gen);
+
+  Input input;
+  for (int i = 0; i < thePoints; i++)
+  {
+    input.x.push_back(cells[i].first);
+    input.y.push_back(cells[i].second);
+  }
+
+  uniform_int_distribution<int> point(0, thePoints - 1);
+  for (int i = 0; i < theConstraints; i++)
+  {
+    const int a = point(gen);
+    const int b = point(gen);
+    if (a != b)
+      input.constraints.push_back(make_pair(a, b));
+  }
+  return input;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Orientation of three points, scaled to a distance
+ */
+// ----------------------------------------------------------------------
+
+double side(double ax, double ay, double bx, double by, double cx, double cy)
+{
+  return ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax)) / hypot(bx - ax, by - ay);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Triangulate the input and validate the result
+ *
+ * The triangles must be counter-clockwise, and no triangle edge may
+ * cross a constraint. The tolerance allows for the rounding of the
+ * intersection points of crossing constraints.
+ *
+ * \return An error message, or an empty string for success
+ */
+// ----------------------------------------------------------------------
+
+string validate(const Input &theInput)
+{
+  const double tolerance = 1e-7;
+
+  Triangulator tri;
+  for (size_t i = 0; i < theInput.x.size(); i++)
+    tri.addPoint(theInput.x[i], theInput.y[i]);
+  for (const auto &constraint : theInput.constraints)
+    tri.addConstraint(constraint.first, constraint.second);
+
+  try
+  {
+    tri.triangulate();
+  }
+  catch (exception &e)
+  {
+    return e.what();
+  }
+
+  if (tri.size() == 0)
+    return "no triangles";
+
+  for (Triangulator::size_type t = 0; t < tri.size(); t++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      const auto u = tri.corner(t, i);
+      const auto w = tri.corner(t, (i + 1) % 3);
+      const auto v = tri.corner(t, (i + 2) % 3);
+      const double ux = tri.x(u), uy = tri.y(u);
+      const double wx = tri.x(w), wy = tri.y(w);
+
+      if (side(ux, uy, wx, wy, tri.x(v), tri.y(v)) < -tolerance)
+        return "clockwise triangle";
+
+      for (const auto &constraint : theInput.constraints)
+      {
+        const double ax = theInput.x[constraint.first], ay = theInput.y[constraint.first];
+        const double bx = theInput.x[constraint.second], by = theInput.y[constraint.second];
+
+        const double s1 = side(ax, ay, bx, by, ux, uy);
+        const double s2 = side(ax, ay, bx, by, wx, wy);
+        const double s3 = side(ux, uy, wx, wy, ax, ay);
+        const double s4 = side(ux, uy, wx, wy, bx, by);
+
+        if (((s1 > tolerance && s2 < -tolerance) || (s1 < -tolerance && s2 > tolerance)) &&
+            ((s3 > tolerance && s4 < -tolerance) || (s3 < -tolerance && s4 > tolerance)))
+          return "an edge crosses a constraint";
+      }
+    }
+  }
+
+  return "";
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test crossing constraints between random points
+ */
+// ----------------------------------------------------------------------
+
+void random_constraints()
+{
+  for (unsigned int seed = 0; seed < 300; seed++)
+  {
+    const string err = validate(random_input(seed, 300, 60));
+    if (!err.empty())
+    {
+      ostringstream out;
+      out << "Seed " << seed << ": " << err;
+      TEST_FAILED(out.str());
+    }
+  }
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test constraints on a grid with collinear and cocircular points
+ */
+// ----------------------------------------------------------------------
+
+void grid_constraints()
+{
+  for (unsigned int seed = 0; seed < 50; seed++)
+  {
+    string err = validate(grid_input(seed, 20, 300, 20));
+    if (err.empty())
+      err = validate(grid_input(seed, 31, 300, 60));
+    if (!err.empty())
+    {
+      ostringstream out;
+      out << "Seed " << seed << ": " << err;
+      TEST_FAILED(out.str());
+    }
+  }
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The test suite
+ */
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(random_constraints);
+    TEST(grid_constraints);
+  }
+};
+
+}  // namespace TriangulatorTest
+
+int main(void)
+{
+  cout << endl << "Triangulator tester" << endl << "===================" << endl;
+  TriangulatorTest::tests t;
+  return t.run();
+}
@@ -0,0 +1,165 @@
+// ======================================================================
+/*!
+ * \file
+ * \brief Regression tests for namespace Validation
+ */
+// ======================================================================
+
+#include "Validation.h"
+
+#include <regression/tframe.h>
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace ValidationTest
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a closed ring from a list of coordinates
+ */
+// ----------------------------------------------------------------------
+
+Polygon ring(const vector<pair<double, double> > &theCoordinates)
+{
+  Polygon polygon;
+  for (const auto &xy : theCoordinates)
+    polygon.add(Point(xy.first, xy.second));
+  polygon.add(Point(theCoordinates.front().first, theCoordinates.front().second));
+  return polygon;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Describe the problems found for error messages
+ */
+// ----------------------------------------------------------------------
+
+string report(const vector<Validation::Problem> &theProblems)
+{
+  ostringstream out;
+  out << theProblems.size() << " problems";
+  for (const Validation::Problem &problem : theProblems)
+    out << ", ring " << problem.ring << " vertex " << problem.vertex << ": "
+        << Validation::describe(problem.type);
+  return out.str();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test that two squares sharing a border validate clean
+ */
+// ----------------------------------------------------------------------
+
+void adjacent_squares()
+{
+  vector<Polygon> rings;
+  rings.push_back(ring({{0, 0}, {0, 1}, {1, 1}, {1, 0}}));
+  rings.push_back(ring({{1, 0}, {1, 1}, {2, 1}, {2, 0}}));
+
+  vector<size_t> groups;
+  groups.push_back(0);
+  groups.push_back(1);
+
+  const vector<Validation::Problem> problems = Validation::validate(rings, groups);
+  if (!problems.empty())
+    TEST_FAILED("Expected no problems, got " + report(problems));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test that a T-junction on a shared border validates clean
+ */
+// ----------------------------------------------------------------------
+
+void t_junction()
+{
+  vector<Polygon> rings;
+  rings.push_back(ring({{0, 0}, {0, 2}, {1, 2}, {1, 0}}));
+  rings.push_back(ring({{1, 0}, {1, 1}, {2, 1}, {2, 0}}));
+  rings.push_back(ring({{1, 1}, {1, 2}, {2, 2}, {2, 1}}));
+
+  vector<size_t> groups;
+  groups.push_back(0);
+  groups.push_back(1);
+  groups.push_back(2);
+
+  const vector<Validation::Problem> problems = Validation::validate(rings, groups);
+  if (!problems.empty())
+    TEST_FAILED("Expected no problems, got " + report(problems));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test that overlapping rings of the same group are reported
+ */
+// ----------------------------------------------------------------------
+
+void same_group()
+{
+  vector<Polygon> rings;
+  rings.push_back(ring({{0, 0}, {0, 1}, {1, 1}, {1, 0}}));
+  rings.push_back(ring({{1, 0}, {1, 1}, {2, 1}, {2, 0}}));
+
+  const vector<Validation::Problem> problems = Validation::validate(rings);
+  if (problems.size() != 1 || problems[0].type != Validation::kOverlap)
+    TEST_FAILED("Expected one overlap, got " + report(problems));
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test that a self-intersecting ring is reported
+ */
+// ----------------------------------------------------------------------
+
+void self_intersection()
+{
+  vector<Polygon> rings;
+  rings.push_back(ring({{0, 0}, {2, 2}, {2, 0}, {0, 2}}));
+
+  const vector<Validation::Problem> problems = Validation::validate(rings);
+  if (problems.size() != 1 || problems[0].type != Validation::kCrossing)
+    TEST_FAILED("Expected one crossing, got " + report(problems));
+
+  if (problems[0].where != Point(1, 1))
+    TEST_FAILED("The crossing should be at 1,1");
+
+  TEST_PASSED();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The test suite
+ */
+// ----------------------------------------------------------------------
+
+class tests : public tframe::tests
+{
+  virtual const char *error_message_prefix() const { return "\n\t"; }
+  void test(void)
+  {
+    TEST(adjacent_squares);
+    TEST(t_junction);
+    TEST(same_group);
+    TEST(self_intersection);
+  }
+};
+
+}  // namespace ValidationTest
+
+int main(void)
+{
+  cout << endl << "Validation tester" << endl << "=================" << endl;
+  ValidationTest::tests t;
+  return t.run();
+}